@@ -18,6 +18,7 @@
 
 #if defined(CONF_FAMILY_UNIX)
 	#include <sys/time.h>
+	#include <sys/mman.h>
 	#include <unistd.h>
 
 	/* unix net includes */
@@ -51,6 +52,7 @@
 	#include <winsock2.h>
 	#include <ws2tcpip.h>
 	#include <fcntl.h>
+	#include <io.h>
 	#include <direct.h>
 	#include <errno.h>
 	#include <process.h>
@@ -90,6 +92,13 @@ static int num_loggers = 0;
 
 static NETSTATS network_stats = {0};
 
+/* the network thread of the server sends and receives alongside the main thread */
+#if defined(CONF_FAMILY_WINDOWS)
+	#define NETSTATS_ADD(field, value) InterlockedExchangeAdd((volatile LONG *)&network_stats.field, (value))
+#else
+	#define NETSTATS_ADD(field, value) __sync_fetch_and_add(&network_stats.field, (value))
+#endif
+
 static NETSOCKET invalid_socket = {NETTYPE_INVALID, -1, -1};
 
 #define AF_WEBSOCKET_INET (0xee)
@@ -336,6 +345,64 @@ int io_error(IOHANDLE io)
 	return ferror((FILE*)io);
 }
 
+time_t io_mtime(IOHANDLE io)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	struct _stat64 sb;
+	if(_fstat64(_fileno((FILE*)io), &sb) != 0)
+		return 0;
+	return (time_t)sb.st_mtime;
+#else
+	struct stat sb;
+	if(fstat(fileno((FILE*)io), &sb) != 0)
+		return 0;
+	return sb.st_mtime;
+#endif
+}
+
+const void *io_map(IOHANDLE io, unsigned *size)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE*)io));
+	LARGE_INTEGER length;
+	HANDLE mapping;
+	void *data;
+	if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length) || length.QuadPart <= 0 || length.QuadPart > 0x7fffffff)
+		return 0;
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mapping)
+		return 0;
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	/* the view keeps the mapping alive */
+	CloseHandle(mapping);
+	if(!data)
+		return 0;
+	*size = (unsigned)length.QuadPart;
+	return data;
+#else
+	struct stat sb;
+	void *data;
+	if(fstat(fileno((FILE*)io), &sb) != 0 || sb.st_size <= 0 || sb.st_size > 0x7fffffff)
+		return 0;
+	data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fileno((FILE*)io), 0);
+	if(data == MAP_FAILED)
+		return 0;
+	*size = (unsigned)sb.st_size;
+	return data;
+#endif
+}
+
+void io_unmap(const void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap((void *)data, size);
+#endif
+}
+
 unsigned io_write(IOHANDLE io, const void *buffer, unsigned size)
 {
 	return fwrite(buffer, 1, size, (FILE*)io);
@@ -1508,6 +1575,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in(addr, &sa);
 
 			d = sendto((int)sock.ipv4sock, (const char*)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			NETSTATS_ADD(sent_syscalls, 1);
 		}
 		else
 			dbg_msg("net", "can't send ipv4 traffic to this socket");
@@ -1541,6 +1609,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in6(addr, &sa);
 
 			d = sendto((int)sock.ipv6sock, (const char*)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			NETSTATS_ADD(sent_syscalls, 1);
 		}
 		else
 			dbg_msg("net", "can't send ipv6 traffic to this socket");
@@ -1561,8 +1630,8 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 		dbg_msg("net", "\taddr = %s", addrstr);
 
 	}*/
-	network_stats.sent_bytes += size;
-	network_stats.sent_packets++;
+	NETSTATS_ADD(sent_bytes, size);
+	NETSTATS_ADD(sent_packets, 1);
 	return d;
 #else
 	return size;
@@ -1590,6 +1659,89 @@ void net_init_mmsgs(MMSGS* m)
 #endif
 }
 
+int net_udp_send_batched(NETSOCKET sock, const NETADDR *addr, const void *data, int size, MMSGS *m)
+{
+#if defined(CONF_PLATFORM_LINUX) && !defined(FUZZING)
+	int i;
+	int socket = -1;
+
+	/* broadcasts, websockets and oversized packets go out directly */
+	if(size > PACKETSIZE || (addr->type&NETTYPE_LINK_BROADCAST))
+		return net_udp_send(sock, addr, data, size);
+	if(addr->type == NETTYPE_IPV4)
+		socket = sock.ipv4sock;
+	else if(addr->type == NETTYPE_IPV6)
+		socket = sock.ipv6sock;
+	if(socket < 0)
+		return net_udp_send(sock, addr, data, size);
+
+	if(m->size >= VLEN)
+		net_udp_flush(m);
+
+	i = m->size++;
+	if(addr->type == NETTYPE_IPV4)
+	{
+		netaddr_to_sockaddr_in(addr, (struct sockaddr_in *)m->sockaddrs[i]);
+		m->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	}
+	else
+	{
+		netaddr_to_sockaddr_in6(addr, (struct sockaddr_in6 *)m->sockaddrs[i]);
+		m->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+	}
+	mem_copy(m->bufs[i], data, size);
+	m->iovecs[i].iov_len = size;
+	m->socks[i] = socket;
+	return size;
+#else
+	return net_udp_send(sock, addr, data, size);
+#endif
+}
+
+int net_udp_flush(MMSGS *m)
+{
+#if defined(CONF_PLATFORM_LINUX) && !defined(FUZZING)
+	int sent = 0;
+	int start = 0;
+
+	while(start < m->size)
+	{
+		/* sendmmsg works on one socket, send runs of packets to the same socket */
+		int end = start + 1;
+		int num;
+		while(end < m->size && m->socks[end] == m->socks[start])
+			end++;
+
+		num = sendmmsg(m->socks[start], &m->msgs[start], end - start, 0);
+		NETSTATS_ADD(sent_syscalls, 1);
+		if(num < 0)
+			num = 0;
+		while(start + num < end)
+		{
+			/* partially sent, retry the remaining packets one by one */
+			int i = start + num;
+			sendto(m->socks[i], m->bufs[i], m->iovecs[i].iov_len, 0, (struct sockaddr *)m->sockaddrs[i], m->msgs[i].msg_hdr.msg_namelen);
+			NETSTATS_ADD(sent_syscalls, 1);
+			num++;
+		}
+
+		for(; start < end; start++)
+		{
+			NETSTATS_ADD(sent_bytes, (int)m->iovecs[start].iov_len);
+			NETSTATS_ADD(sent_packets, 1);
+			m->iovecs[start].iov_len = PACKETSIZE;
+			m->msgs[start].msg_hdr.msg_namelen = sizeof(m->sockaddrs[start]);
+		}
+		sent = end;
+	}
+
+	m->size = 0;
+	return sent;
+#else
+	return 0;
+#endif
+}
+
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS* m, unsigned char **data)
 {
 #ifndef FUZZING
@@ -1655,8 +1807,8 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS
 	if(bytes > 0)
 	{
 		sockaddr_to_netaddr((struct sockaddr *)&sockaddrbuf, addr);
-		network_stats.recv_bytes += bytes;
-		network_stats.recv_packets++;
+		NETSTATS_ADD(recv_bytes, bytes);
+		NETSTATS_ADD(recv_packets, 1);
 		return bytes;
 	}
 	else if(bytes == 0)
@@ -2245,7 +2397,7 @@ void swap_endian(void *data, unsigned elem_size, unsigned num)
 	}
 }
 
-int net_socket_read_wait(NETSOCKET sock, int time)
+static int net_socket_read_wait_fd(NETSOCKET sock, int fd, int time)
 {
 	struct timeval tv;
 	fd_set readfds;
@@ -2256,6 +2408,11 @@ int net_socket_read_wait(NETSOCKET sock, int time)
 	sockid = 0;
 
 	FD_ZERO(&readfds);
+	if(fd >= 0)
+	{
+		FD_SET(fd, &readfds);
+		sockid = fd;
+	}
 	if(sock.ipv4sock >= 0)
 	{
 		FD_SET(sock.ipv4sock, &readfds);
@@ -2291,6 +2448,96 @@ int net_socket_read_wait(NETSOCKET sock, int time)
 	return 0;
 }
 
+int net_socket_read_wait(NETSOCKET sock, int time)
+{
+	return net_socket_read_wait_fd(sock, -1, time);
+}
+
+void net_signal_init(NETSIGNAL *sig)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	sig->event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+	if(pipe(sig->fds) != 0)
+	{
+		dbg_msg("net", "signal pipe failed: %d", errno);
+		sig->fds[0] = -1;
+		sig->fds[1] = -1;
+		return;
+	}
+	fcntl(sig->fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(sig->fds[1], F_SETFL, O_NONBLOCK);
+#endif
+}
+
+void net_signal_destroy(NETSIGNAL *sig)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	CloseHandle((HANDLE)sig->event);
+#else
+	if(sig->fds[0] >= 0)
+		close(sig->fds[0]);
+	if(sig->fds[1] >= 0)
+		close(sig->fds[1]);
+#endif
+}
+
+void net_signal_raise(NETSIGNAL *sig)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	SetEvent((HANDLE)sig->event);
+#else
+	char c = 0;
+	if(write(sig->fds[1], &c, 1) < 0)
+	{
+		/* the pipe is full, so the signal is raised already */
+	}
+#endif
+}
+
+#if !defined(CONF_FAMILY_WINDOWS)
+static void net_signal_clear(NETSIGNAL *sig)
+{
+	char buf[64];
+	while(read(sig->fds[0], buf, sizeof(buf)) > 0)
+	{
+	}
+}
+#endif
+
+int net_signal_wait(NETSIGNAL *sig, int time)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	return WaitForSingleObject((HANDLE)sig->event, time < 0 ? INFINITE : (time + 999) / 1000) == WAIT_OBJECT_0;
+#else
+	struct timeval tv;
+	fd_set readfds;
+
+	tv.tv_sec = time / 1000000;
+	tv.tv_usec = time % 1000000;
+	FD_ZERO(&readfds);
+	FD_SET(sig->fds[0], &readfds);
+	if(select(sig->fds[0]+1, &readfds, NULL, NULL, time < 0 ? NULL : &tv) <= 0)
+		return 0;
+	net_signal_clear(sig);
+	return 1;
+#endif
+}
+
+int net_socket_read_wait_signal(NETSOCKET sock, NETSIGNAL *sig, int time)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	/* select only takes sockets, look at the event at least every millisecond */
+	if(WaitForSingleObject((HANDLE)sig->event, 0) == WAIT_OBJECT_0)
+		return 0;
+	return net_socket_read_wait(sock, time < 0 || time > 1000 ? 1000 : time);
+#else
+	int result = net_socket_read_wait_fd(sock, sig->fds[0], time);
+	net_signal_clear(sig);
+	return result;
+#endif
+}
+
 int time_timestamp()
 {
 	return time(0);
@@ -2786,7 +3033,12 @@ int mem_comp(const void *a, const void *b, int size)
 
 void net_stats(NETSTATS *stats_inout)
 {
-	*stats_inout = network_stats;
+	/* adding nothing reads the counters atomically */
+	stats_inout->sent_packets = NETSTATS_ADD(sent_packets, 0);
+	stats_inout->sent_bytes = NETSTATS_ADD(sent_bytes, 0);
+	stats_inout->recv_packets = NETSTATS_ADD(recv_packets, 0);
+	stats_inout->recv_bytes = NETSTATS_ADD(recv_bytes, 0);
+	stats_inout->sent_syscalls = NETSTATS_ADD(sent_syscalls, 0);
 }
 
 int str_isspace(char c) { return c == ' ' || c == '\n' || c == '\t'; }
@@ -321,6 +321,52 @@ int io_flush(IOHANDLE io);
 */
 int io_error(IOHANDLE io);
 
+/*
+	Function: io_mtime
+		Gets the time of the last modification of an open file.
+
+	Parameters:
+		io - Handle to the file.
+
+	Returns:
+		Returns the modification time, 0 on error.
+*/
+time_t io_mtime(IOHANDLE io);
+
+/*
+	Function: io_map
+		Maps the whole file read-only and private into memory. Other
+		processes mapping the same file share the pages as long as
+		nobody writes to it.
+
+	Parameters:
+		io - Handle to the file.
+		size - Pointer to store the size of the mapping in.
+
+	Returns:
+		Returns a pointer to the mapped data, 0 on error or for an
+		empty file.
+
+	Remarks:
+		- The mapping stays valid after the file is closed.
+		- Changes to the file can show through the mapping and
+		  truncating it makes accesses past the new end fault. Keep
+		  the file open and check <io_length> and <io_mtime> before
+		  relying on the data, or replace the file by renaming a new
+		  one over it.
+*/
+const void *io_map(IOHANDLE io, unsigned *size);
+
+/*
+	Function: io_unmap
+		Releases a mapping created with <io_map>.
+
+	Parameters:
+		data - Pointer returned by <io_map>.
+		size - Size of the mapping.
+*/
+void io_unmap(const void *data, unsigned size);
+
 
 /*
 	Function: io_stdin
@@ -782,6 +828,7 @@ typedef struct
 	struct iovec iovecs[VLEN];
 	char bufs[VLEN][PACKETSIZE];
 	char sockaddrs[VLEN][128];
+	int socks[VLEN];
 #else
 	int dummy;
 #endif
@@ -789,6 +836,37 @@ typedef struct
 
 void net_init_mmsgs(MMSGS* m);
 
+/*
+	Function: net_udp_send_batched
+		Queues a packet to be sent over an UDP socket with the next
+		<net_udp_flush>. Falls back to <net_udp_send> where batching
+		isn't available.
+
+	Parameters:
+		sock - Socket to use.
+		addr - Where to send the packet.
+		data - Pointer to the packet data to send.
+		size - Size of the packet.
+		m - Send queue, initialized with <net_init_mmsgs>.
+
+	Returns:
+		On success it returns the number of bytes queued or sent.
+		Returns -1 on error.
+*/
+int net_udp_send_batched(NETSOCKET sock, const NETADDR *addr, const void *data, int size, MMSGS *m);
+
+/*
+	Function: net_udp_flush
+		Sends all packets queued by <net_udp_send_batched>.
+
+	Parameters:
+		m - Send queue to flush.
+
+	Returns:
+		The number of packets sent.
+*/
+int net_udp_flush(MMSGS *m);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
@@ -1634,6 +1712,59 @@ int net_would_block();
 
 int net_socket_read_wait(NETSOCKET sock, int time);
 
+/* Group: Network signals */
+/*
+	Structure: NETSIGNAL
+		Wakes up a thread that waits with <net_signal_wait> or
+		<net_socket_read_wait_signal> from another thread.
+*/
+typedef struct
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	void *event;
+#else
+	int fds[2];
+#endif
+} NETSIGNAL;
+
+void net_signal_init(NETSIGNAL *sig);
+void net_signal_destroy(NETSIGNAL *sig);
+
+/*
+	Function: net_signal_raise
+		Raises the signal, a thread that waits for it wakes up. If no
+		thread waits, the next wait returns right away.
+*/
+void net_signal_raise(NETSIGNAL *sig);
+
+/*
+	Function: net_signal_wait
+		Waits for the signal to be raised and clears it.
+
+	Parameters:
+		sig - Signal to wait for.
+		time - Time to wait at most in microseconds, -1 waits forever.
+
+	Returns:
+		1 if the signal was raised, 0 otherwise.
+*/
+int net_signal_wait(NETSIGNAL *sig, int time);
+
+/*
+	Function: net_socket_read_wait_signal
+		Waits for data on the socket or for the signal to be raised,
+		clears the signal.
+
+	Parameters:
+		sock - Socket to wait for.
+		sig - Signal to wait for.
+		time - Time to wait at most in microseconds, -1 waits forever.
+
+	Returns:
+		1 if the socket has data, 0 otherwise.
+*/
+int net_socket_read_wait_signal(NETSOCKET sock, NETSIGNAL *sig, int time);
+
 void swap_endian(void *data, unsigned elem_size, unsigned num);
 
 
@@ -1651,6 +1782,7 @@ typedef struct
 	int sent_bytes;
 	int recv_packets;
 	int recv_bytes;
+	int sent_syscalls;
 } NETSTATS;
 
 
@@ -33,6 +33,10 @@ public:
 	virtual unsigned Crc() = 0;
 	virtual int MapSize() = 0;
 	virtual IOHANDLE File() = 0;
+
+	// exchanges the loaded map with an opened datafile, so a map can be
+	// loaded elsewhere (e.g. on a job thread) and put in place later
+	virtual void SwapDataFile(class CDataFileReader *pDataFile) = 0;
 };
 
 extern IEngineMap *CreateEngineMap();
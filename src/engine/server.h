@@ -147,6 +147,8 @@ public:
 	virtual void SetClientCountry(int ClientID, int Country) = 0;
 	virtual void SetClientScore(int ClientID, int Score) = 0;
 	virtual void SetClientFlags(int ClientID, int Flags) = 0;
+	// tells the server that something in the server info changed
+	virtual void ExpireServerInfo() = 0;
 
 	virtual int SnapNewID() = 0;
 	virtual void SnapFreeID(int ID) = 0;
@@ -200,7 +202,6 @@ protected:
 public:
 	virtual void OnInit() = 0;
 	virtual void OnConsoleInit() = 0;
-	virtual void OnMapChange(char *pNewMapName, int MapNameSize) = 0;
 
 	// FullShutdown is true if the program is about to exit (not if the map is changed)
 	virtual void OnShutdown(bool FullShutdown = false) = 0;
@@ -221,6 +222,11 @@ public:
 
 	virtual bool IsClientReady(int ClientID) = 0;
 	virtual bool IsClientPlayer(int ClientID) = 0;
+	// the position of the character as the teehistorian records it
+	virtual bool GetCharacterPos(int ClientID, int *pX, int *pY) = 0;
+	// hash of the unrounded physics state of all characters, equal for
+	// builds that simulate the same
+	virtual unsigned CharacterChecksum() = 0;
 
 	virtual CUuid GameUuid() = 0;
 	virtual const char *GameType() = 0;
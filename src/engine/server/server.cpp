@@ -23,6 +23,7 @@
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
+#include <engine/shared/profiler.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/protocol_ex.h>
 #include <engine/shared/snapshot.h>
@@ -33,8 +34,13 @@
 // DDRace
 #include <string.h>
 #include <vector>
+#include <zlib.h>
 #include <engine/shared/linereader.h>
 #include <game/extrainfo.h>
+#include <game/mapitems.h>
+#include <game/server/teehistorian.h>
+
+#include <engine/external/json-parser/json.h>
 
 #include "register.h"
 #include "server.h"
@@ -197,9 +203,8 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 
 		if(NetMatch(&Data, Server()->m_NetServer.ClientAddr(i)))
 		{
-			CNetHash NetHash(&Data);
 			char aBuf[256];
-			MakeBanInfo(pBanPool->Find(&Data, &NetHash), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
+			MakeBanInfo(FindBan(&Data), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
 			Server()->m_NetServer.Drop(i, aBuf);
 		}
 	}
@@ -221,6 +226,26 @@ int CServerBan::BanRange(const CNetRange *pRange, int Seconds, const char *pReas
 	return -1;
 }
 
+int CServerBan::BanFile(const char *pFilename, int Seconds, const char *pReason)
+{
+	int Result = CNetBan::BanFile(pFilename, Seconds, pReason);
+	if(Result <= 0)
+		return Result;
+
+	// drop banned clients, authed ones are left alone like for single bans
+	for(int i = 0; i < MAX_CLIENTS; ++i)
+	{
+		if(Server()->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY || Server()->m_aClients[i].m_Authed != AUTHED_NO)
+			continue;
+
+		char aBuf[256];
+		if(IsBanned(Server()->m_NetServer.ClientAddr(i), aBuf, sizeof(aBuf)))
+			Server()->m_NetServer.Drop(i, aBuf);
+	}
+
+	return Result;
+}
+
 void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 {
 	CServerBan *pThis = static_cast<CServerBan *>(pUser);
@@ -274,6 +299,26 @@ CServer::CServer()
 
 	m_pCurrentMapData = 0;
 	m_CurrentMapSize = 0;
+	m_CurrentMapMapped = false;
+	m_CurrentMapFile = 0;
+	m_CurrentMapTime = 0;
+	m_MapLoadSwap = false;
+	m_NumMapLoads = 0;
+	for(int i = 0; i < MAP_CHUNK_CACHE_SIZE; i++)
+		m_aMapChunkCache[i].m_Chunk = -1;
+	m_MapChunkCacheHits = 0;
+	m_MapChunkCacheMisses = 0;
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		m_apSnapshotJobs[i] = 0;
+	m_SnapshotCacheLookups = 0;
+	m_SnapshotCacheHits = 0;
+
+	static const char *s_apProfilePhaseNames[NUM_PROFILE_PHASES] = {
+		"frame", "input", "tick", "snap", "snap.onsnap", "snap.delta", "snap.compress", "snap.send", "network"
+	};
+	for(int i = 0; i < NUM_PROFILE_PHASES; i++)
+		m_aProfilePhases[i] = g_Profiler.Register(s_apProfilePhaseNames[i]);
 
 	m_MapReload = 0;
 	m_ReloadedWhenEmpty = false;
@@ -285,6 +330,13 @@ CServer::CServer()
 
 	m_ServerInfoFirstRequest = 0;
 	m_ServerInfoNumRequests = 0;
+	m_ServerInfoNeedsUpdate = true;
+	m_ServerInfoRequests = 0;
+	m_ServerInfoCacheHits = 0;
+	m_ServerInfoRequestsLastSecond = 0;
+	m_ServerInfoRequestRate = 0;
+	m_SentPacketsLastSecond = 0;
+	m_PacketsPerClientTick = 0.0f;
 
 #ifdef CONF_FAMILY_UNIX
 	m_ConnLoggingSocketCreated = false;
@@ -340,6 +392,7 @@ int CServer::TrySetClientName(int ClientID, const char *pName)
 
 	// set the client name
 	str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
+	ExpireServerInfo();
 	return 0;
 }
 
@@ -389,6 +442,8 @@ void CServer::SetClientClan(int ClientID, const char *pClan)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY || !pClan)
 		return;
 
+	if(str_comp(m_aClients[ClientID].m_aClan, pClan) != 0)
+		ExpireServerInfo();
 	str_copy(m_aClients[ClientID].m_aClan, pClan, MAX_CLAN_LENGTH);
 }
 
@@ -397,6 +452,8 @@ void CServer::SetClientCountry(int ClientID, int Country)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
 
+	if(m_aClients[ClientID].m_Country != Country)
+		ExpireServerInfo();
 	m_aClients[ClientID].m_Country = Country;
 }
 
@@ -404,6 +461,8 @@ void CServer::SetClientScore(int ClientID, int Score)
 {
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
+	if(m_aClients[ClientID].m_Score != Score)
+		ExpireServerInfo();
 	m_aClients[ClientID].m_Score = Score;
 }
 
@@ -470,6 +529,7 @@ int CServer::Init()
 		m_aClients[i].m_aClan[0] = 0;
 		m_aClients[i].m_Country = -1;
 		m_aClients[i].m_Snapshots.Init();
+		m_aClients[i].m_Snapshots.InitRing(SNAPSHOT_STORAGE_TICKS, SNAPSHOT_STORAGE_TICKS*SNAPSHOT_STORAGE_AVGSIZE);
 		m_aClients[i].m_Traffic = 0;
 		m_aClients[i].m_TrafficSince = 0;
 		m_aClients[i].m_ShowIps = false;
@@ -641,6 +701,7 @@ void CServer::DummyJoin(int DummyID, const char* pDummyName, const char* pDummyC
 	str_copy(m_aClients[DummyID].m_aName, pDummyName[0] != '\0' ? pDummyName : pNames[DummyID], MAX_NAME_LENGTH);
 	str_copy(m_aClients[DummyID].m_aClan, pDummyClan, MAX_CLAN_LENGTH);
 	m_aClients[DummyID].m_Country = Country;
+	ExpireServerInfo();
 }
 
 // Dummy -WEIRD
@@ -649,6 +710,7 @@ void CServer::DummyLeave(int DummyID, const char* pReason)
 	GameServer()->OnClientDrop(DummyID, pReason);
 
 	m_aClients[DummyID].m_State = CClient::STATE_EMPTY;
+	ExpireServerInfo();
 	m_aClients[DummyID].m_aName[0] = 0;
 	m_aClients[DummyID].m_aClan[0] = 0;
 	m_aClients[DummyID].m_Country = -1;
@@ -663,32 +725,40 @@ void CServer::DummyLeave(int DummyID, const char* pReason)
 
 int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 {
-	CNetChunk Packet;
 	if(!pMsg)
 		return -1;
 
+	// HACK: modify the message id in the packet and store the system flag
+	*((unsigned char*)pMsg->Data()) <<= 1;
+	if(System)
+		*((unsigned char*)pMsg->Data()) |= 1;
+
+	return SendPackedMsg(pMsg->Data(), pMsg->Size(), Flags, ClientID);
+}
+
+// sends a message that already has the system flag in its id
+int CServer::SendPackedMsg(const unsigned char *pData, int Size, int Flags, int ClientID)
+{
+	CNetChunk Packet;
 	mem_zero(&Packet, sizeof(CNetChunk));
 
 	Packet.m_ClientID = ClientID;
-	Packet.m_pData = pMsg->Data();
-	Packet.m_DataSize = pMsg->Size();
-
-	// HACK: modify the message id in the packet and store the system flag
-	*((unsigned char*)Packet.m_pData) <<= 1;
-	if(System)
-		*((unsigned char*)Packet.m_pData) |= 1;
+	Packet.m_pData = pData;
+	Packet.m_DataSize = Size;
 
 	if(Flags&MSGFLAG_VITAL)
 		Packet.m_Flags |= NETSENDFLAG_VITAL;
 	if(Flags&MSGFLAG_FLUSH)
 		Packet.m_Flags |= NETSENDFLAG_FLUSH;
+	if(Flags&MSGFLAG_PRIORITY)
+		Packet.m_Flags |= NETSENDFLAG_PRIORITY;
 
 	// write message to demo recorder
 	if(!(Flags&MSGFLAG_NORECORD))
 	{
 		if(ClientID > -1)
-			m_aDemoRecorder[ClientID].RecordMessage(pMsg->Data(), pMsg->Size());
-		m_aDemoRecorder[MAX_CLIENTS].RecordMessage(pMsg->Data(), pMsg->Size());
+			m_aDemoRecorder[ClientID].RecordMessage(pData, Size);
+		m_aDemoRecorder[MAX_CLIENTS].RecordMessage(pData, Size);
 	}
 
 	if(!(Flags&MSGFLAG_NOSEND))
@@ -712,6 +782,8 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 
 void CServer::DoSnapshot()
 {
+	CProfileScope Scope(m_aProfilePhases[PROFILE_SNAP]);
+
 	GameServer()->OnPreSnap();
 
 	// create snapshot for demo recording
@@ -734,6 +806,11 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	int NumWorkers = g_Config.m_SvSnapshotThreads - 1;
+	if(m_SnapshotWorkers.NumThreads() != NumWorkers)
+		m_SnapshotWorkers.Init(NumWorkers);
+
+	int NumJobs = 0;
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		// client must be ingame to receive snapshots
@@ -748,113 +825,210 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick()%10) != 0)
 			continue;
 
+		if(!m_apSnapshotJobs[NumJobs])
+			m_apSnapshotJobs[NumJobs] = new CSnapshotJob;
+		CSnapshotJob *pJob = m_apSnapshotJobs[NumJobs];
+		pJob->m_ClientID = i;
+		BuildSnapshot(pJob);
+		FindDeltaBase(pJob);
+		pJob->m_SameAs = FindSameSnapshot(pJob, NumJobs);
+		NumJobs++;
+	}
+
+	// delta and compression don't touch the game world
+	m_SnapshotWorkers.Run(ProcessSnapshotWork, this, NumJobs);
+	if(g_Profiler.Active())
+	{
+		// summed up over all threads
+		for(int i = 0; i < NumJobs; i++)
 		{
-			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			char aCompData[CSnapshot::MAX_SIZE];
-			int SnapshotSize;
-			int Crc;
-			static CSnapshot EmptySnap;
-			CSnapshot *pDeltashot = &EmptySnap;
-			int DeltashotSize;
-			int DeltaTick = -1;
-			int DeltaSize;
+			if(m_apSnapshotJobs[i]->m_SameAs != -1)
+				continue;
+			g_Profiler.AddDuration(m_aProfilePhases[PROFILE_SNAP_DELTA], m_apSnapshotJobs[i]->m_DeltaTime);
+			g_Profiler.AddDuration(m_aProfilePhases[PROFILE_SNAP_COMPRESS], m_apSnapshotJobs[i]->m_CompressTime);
+		}
+	}
 
-			m_SnapshotBuilder.Init();
+	{
+		CProfileScope SendScope(m_aProfilePhases[PROFILE_SNAP_SEND]);
+		for(int i = 0; i < NumJobs; i++)
+			SendSnapshot(m_apSnapshotJobs[i]);
+	}
 
-			GameServer()->OnSnap(i);
+	GameServer()->OnPostSnap();
+}
 
-			// finish snapshot
-			SnapshotSize = m_SnapshotBuilder.Finish(pData);
+void CServer::BuildSnapshot(CSnapshotJob *pJob)
+{
+	int ClientID = pJob->m_ClientID;
 
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// for antiping: if the projectile netobjects contains extra data, this is removed and the original content restored before recording demo
-				unsigned char aExtraInfoRemoved[CSnapshot::MAX_SIZE];
-				mem_copy(aExtraInfoRemoved, aData, SnapshotSize);
-				SnapshotRemoveExtraInfo(aExtraInfoRemoved);
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aExtraInfoRemoved, SnapshotSize);
-			}
+	{
+		CProfileScope Scope(m_aProfilePhases[PROFILE_SNAP_ONSNAP]);
 
-			Crc = pData->Crc();
+		m_SnapshotBuilder.Init();
 
-			// remove old snapshos
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick-SERVER_TICK_SPEED*3);
+		GameServer()->OnSnap(ClientID);
 
-			// save it the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+		// finish snapshot
+		pJob->m_SnapshotSize = m_SnapshotBuilder.Finish(pJob->m_aData);
+	}
 
-			// find snapshot that we can perform delta against
-			EmptySnap.Clear();
+	if(m_aDemoRecorder[ClientID].IsRecording())
+	{
+		// for antiping: if the projectile netobjects contains extra data, this is removed and the original content restored before recording demo
+		unsigned char aExtraInfoRemoved[CSnapshot::MAX_SIZE];
+		mem_copy(aExtraInfoRemoved, pJob->m_aData, pJob->m_SnapshotSize);
+		SnapshotRemoveExtraInfo(aExtraInfoRemoved);
+		// write snapshot
+		m_aDemoRecorder[ClientID].RecordSnapshot(Tick(), aExtraInfoRemoved, pJob->m_SnapshotSize);
+	}
+}
 
-			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
-			}
+void CServer::FindDeltaBase(CSnapshotJob *pJob)
+{
+	CClient *pClient = &m_aClients[pJob->m_ClientID];
 
-			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+	pJob->m_Crc = ((CSnapshot *)pJob->m_aData)->Crc();
 
-			if(DeltaSize)
-			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
+	// remove old snapshos
+	// keep 3 seconds worth of snapshots
+	pClient->m_Snapshots.PurgeUntil(m_CurrentGameTick-SERVER_TICK_SPEED*3);
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+	// find snapshot that we can perform delta against
+	pJob->m_DeltaTick = -1;
+	pJob->m_DeltashotSize = pClient->m_Snapshots.Get(pClient->m_LastAckedSnapshot, 0, &pJob->m_pDeltashot, 0);
+	if(pJob->m_DeltashotSize >= 0)
+		pJob->m_DeltaTick = pClient->m_LastAckedSnapshot;
+	else
+	{
+		pJob->m_pDeltashot = 0;
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+		// no acked package found, force client to recover rate
+		if(pClient->m_SnapRate == CClient::SNAPRATE_FULL)
+			pClient->m_SnapRate = CClient::SNAPRATE_RECOVER;
+	}
+}
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-				}
+int CServer::FindSameSnapshot(CSnapshotJob *pJob, int NumJobs)
+{
+	// spectators and dummies often get byte-identical snapshots, reuse the
+	// compressed delta if another client has the same snapshot and base
+	m_SnapshotCacheLookups++;
+	for(int i = 0; i < NumJobs; i++)
+	{
+		CSnapshotJob *pOther = m_apSnapshotJobs[i];
+		if(pOther->m_SameAs != -1 || pOther->m_Crc != pJob->m_Crc || pOther->m_DeltaTick != pJob->m_DeltaTick ||
+			pOther->m_SnapshotSize != pJob->m_SnapshotSize || pOther->m_DeltashotSize != pJob->m_DeltashotSize)
+			continue;
+		if(pOther->m_pDeltashot != pJob->m_pDeltashot &&
+			mem_comp(pOther->m_pDeltashot, pJob->m_pDeltashot, pJob->m_DeltashotSize) != 0)
+			continue;
+		if(mem_comp(pOther->m_aData, pJob->m_aData, pJob->m_SnapshotSize) != 0)
+			continue;
+
+		m_SnapshotCacheHits++;
+		return i;
+	}
+	return -1;
+}
+
+void CServer::ProcessSnapshot(CSnapshotJob *pJob)
+{
+	CClient *pClient = &m_aClients[pJob->m_ClientID];
+	CSnapshot *pData = (CSnapshot*)pJob->m_aData;	// Fix compiler warning for strict-aliasing
+
+	// save it the snapshot
+	pClient->m_Snapshots.Add(m_CurrentGameTick, time_get(), pJob->m_SnapshotSize, pData, 0);
+
+	if(pJob->m_SameAs != -1)
+		return;
+
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	CSnapshot EmptySnap;
+	EmptySnap.Clear();
+
+	// the main thread waits for the workers, so the profiler state can't change
+	bool Profile = g_Profiler.Active();
+	int64 Start = Profile ? time_get_impl() : 0;
+
+	// create delta
+	int DeltaSize = m_SnapshotDelta.CreateDelta(pJob->m_pDeltashot ? pJob->m_pDeltashot : &EmptySnap, pData, aDeltaData);
+
+	int64 DeltaEnd = Profile ? time_get_impl() : 0;
+
+	// compress it
+	if(DeltaSize)
+		pJob->m_CompSize = CVariableInt::Compress(aDeltaData, DeltaSize, pJob->m_aCompData, sizeof(pJob->m_aCompData));
+	else
+		pJob->m_CompSize = 0;
+
+	if(Profile)
+	{
+		pJob->m_DeltaTime = DeltaEnd - Start;
+		pJob->m_CompressTime = time_get_impl() - DeltaEnd;
+	}
+}
+
+void CServer::ProcessSnapshotWork(int Index, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	pThis->ProcessSnapshot(pThis->m_apSnapshotJobs[Index]);
+}
+
+void CServer::SendSnapshot(CSnapshotJob *pJob)
+{
+	int ClientID = pJob->m_ClientID;
+	int DeltaTick = pJob->m_DeltaTick;
+	const char *pCompData = pJob->m_aCompData;
+	int CompSize = pJob->m_CompSize;
+	if(pJob->m_SameAs != -1)
+	{
+		pCompData = m_apSnapshotJobs[pJob->m_SameAs]->m_aCompData;
+		CompSize = m_apSnapshotJobs[pJob->m_SameAs]->m_CompSize;
+	}
+
+	if(CompSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		int SnapshotSize = CompSize;
+		int NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+
+		for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick-DeltaTick);
+				Msg.AddInt(pJob->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n*MaxSize], Chunk);
+				SendMsgEx(&Msg, MSGFLAG_FLUSH|MSGFLAG_PRIORITY, ClientID, true);
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY);
+				CMsgPacker Msg(NETMSG_SNAP);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick-DeltaTick);
-				SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pJob->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n*MaxSize], Chunk);
+				SendMsgEx(&Msg, MSGFLAG_FLUSH|MSGFLAG_PRIORITY, ClientID, true);
 			}
 		}
 	}
-
-	GameServer()->OnPostSnap();
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick-DeltaTick);
+		SendMsgEx(&Msg, MSGFLAG_FLUSH|MSGFLAG_PRIORITY, ClientID, true);
+	}
 }
 
 int CServer::ClientRejoinCallback(int ClientID, void *pUser)
@@ -879,6 +1053,7 @@ int CServer::NewClientNoAuthCallback(int ClientID, void *pUser)
 	pThis->m_aClients[ClientID].m_DnsblState = CClient::DNSBL_STATE_NONE;
 
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_CONNECTING;
+	pThis->ExpireServerInfo();
 	pThis->m_aClients[ClientID].m_SupportsMapSha256 = false;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
@@ -902,6 +1077,7 @@ int CServer::NewClientCallback(int ClientID, void *pUser)
 {
 	CServer *pThis = (CServer *)pUser;
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_AUTH;
+	pThis->ExpireServerInfo();
 	pThis->m_aClients[ClientID].m_SupportsMapSha256 = false;
 	pThis->m_aClients[ClientID].m_DnsblState = CClient::DNSBL_STATE_NONE;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
@@ -983,6 +1159,7 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 		pThis->GameServer()->OnClientDrop(ClientID, pReason);
 
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_EMPTY;
+	pThis->ExpireServerInfo();
 	pThis->m_aClients[ClientID].m_SupportsMapSha256 = false;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
@@ -1050,7 +1227,7 @@ void CServer::SendMap(int ClientID)
 
 void CServer::SendMapData(int ClientID, int Chunk)
 {
-	unsigned int ChunkSize = 1024-128;
+	unsigned int ChunkSize = MAP_CHUNK_SIZE;
 	unsigned int Offset = Chunk * ChunkSize;
 	int Last = 0;
 
@@ -1064,18 +1241,35 @@ void CServer::SendMapData(int ClientID, int Chunk)
 		Last = 1;
 	}
 
-	CMsgPacker Msg(NETMSG_MAP_DATA);
-	Msg.AddInt(Last);
-	Msg.AddInt(m_CurrentMapCrc);
-	Msg.AddInt(Chunk);
-	Msg.AddInt(ChunkSize);
-	Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
-	SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID, true);
+	// clients joining together request the same chunks, pack them once
+	CMapChunk *pCached = &m_aMapChunkCache[Chunk%MAP_CHUNK_CACHE_SIZE];
+	bool Hit = pCached->m_Chunk == Chunk;
+	if(!Hit)
+	{
+		if(!CheckMapData())
+			return;
+
+		CMsgPacker Msg(NETMSG_MAP_DATA);
+		Msg.AddInt(Last);
+		Msg.AddInt(m_CurrentMapCrc);
+		Msg.AddInt(Chunk);
+		Msg.AddInt(ChunkSize);
+		Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
+
+		pCached->m_Chunk = Chunk;
+		pCached->m_Size = Msg.Size();
+		mem_copy(pCached->m_aData, Msg.Data(), Msg.Size());
+		pCached->m_aData[0] = (pCached->m_aData[0]<<1)|1; // system message, like SendMsgEx
+		m_MapChunkCacheMisses++;
+	}
+	else
+		m_MapChunkCacheHits++;
+	SendPackedMsg(pCached->m_aData, pCached->m_Size, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
 
 	if(g_Config.m_Debug)
 	{
 		char aBuf[256];
-		str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
+		str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d%s", Chunk, ChunkSize, Hit ? " (cached)" : "");
 		Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
 	}
 }
@@ -1290,6 +1484,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 				m_aClients[ClientID].m_State = CClient::STATE_READY;
 				GameServer()->OnClientConnected(ClientID);
+				ExpireServerInfo();
 			}
 
 			SendConnectionReady(ClientID);
@@ -1306,6 +1501,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 				m_aClients[ClientID].m_State = CClient::STATE_INGAME;
 				GameServer()->OnClientEnter(ClientID);
+				ExpireServerInfo();
 			}
 		}
 		else if(Msg == NETMSG_INPUT)
@@ -1543,8 +1739,54 @@ void CServer::SendServerInfoConnless(const NETADDR *pAddr, int Token, int Type)
 	SendServerInfo(pAddr, Token, Type, SendClients);
 }
 
+void CServer::ExpireServerInfo()
+{
+	m_ServerInfoNeedsUpdate = true;
+}
+
 void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients)
 {
+	if(m_ServerInfoNeedsUpdate)
+	{
+		for(int i = 0; i < NUM_SERVERINFO_TYPES; i++)
+			for(int j = 0; j < 2; j++)
+				for(int k = 0; k <= SERVERINFO_MAX_TOKEN_LENGTH; k++)
+					m_aaaServerInfoCache[i][j][k].m_Valid = false;
+		m_ServerInfoNeedsUpdate = false;
+	}
+
+	// the packets only differ in the token, but its length decides where
+	// they are split
+	char aToken[16];
+	str_format(aToken, sizeof(aToken), "%d", Token);
+	int TokenLength = str_length(aToken);
+	CServerInfoCache *pCache = &m_aaaServerInfoCache[Type][SendClients][TokenLength];
+
+	m_ServerInfoRequests++;
+	if(pCache->m_Valid)
+		m_ServerInfoCacheHits++;
+	else
+		CacheServerInfo(pCache, Token, Type, SendClients);
+
+	CNetChunk Packet;
+	Packet.m_ClientID = -1;
+	Packet.m_Address = *pAddr;
+	Packet.m_Flags = NETSENDFLAG_CONNLESS;
+	for(unsigned i = 0; i < pCache->m_aPackets.size(); i++)
+	{
+		CServerInfoCache::CPacket *pPacket = &pCache->m_aPackets[i];
+		mem_copy(&pPacket->m_aData[sizeof(SERVERBROWSE_INFO)], aToken, TokenLength);
+		Packet.m_pData = pPacket->m_aData;
+		Packet.m_DataSize = pPacket->m_Size;
+		m_NetServer.Send(&Packet);
+	}
+}
+
+void CServer::CacheServerInfo(CServerInfoCache *pCache, int Token, int Type, bool SendClients)
+{
+	pCache->m_aPackets.clear();
+	pCache->m_Valid = true;
+
 	// One chance to improve the protocol!
 	CPacker p;
 	char aBuf[128];
@@ -1637,19 +1879,18 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 	int PrefixSize = p.Size();
 
 	CPacker pp;
-	CNetChunk Packet;
 	int PacketsSent = 0;
 	int PlayersSent = 0;
-	Packet.m_ClientID = -1;
-	Packet.m_Address = *pAddr;
-	Packet.m_Flags = NETSENDFLAG_CONNLESS;
 
+	// every packet starts with a header and the token
 	#define SEND(size) \
 		do \
 		{ \
-			Packet.m_pData = pp.Data(); \
-			Packet.m_DataSize = size; \
-			m_NetServer.Send(&Packet); \
+			CServerInfoCache::CPacket CachedPacket; \
+			dbg_assert((size) <= NET_MAX_PAYLOAD, "server info packet too big"); \
+			CachedPacket.m_Size = size; \
+			mem_copy(CachedPacket.m_aData, pp.Data(), size); \
+			pCache->m_aPackets.push_back(CachedPacket); \
 			PacketsSent++; \
 		} while(0)
 
@@ -1750,6 +1991,7 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 
 void CServer::UpdateServerInfo()
 {
+	ExpireServerInfo();
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
@@ -1762,6 +2004,7 @@ void CServer::UpdateServerInfo()
 
 void CServer::PumpNetwork()
 {
+	CProfileScope Scope(m_aProfilePhases[PROFILE_NETWORK]);
 	CNetChunk Packet;
 
 	m_NetServer.Update();
@@ -1822,15 +2065,268 @@ char *CServer::GetMapName()
 	return pMapShortName;
 }
 
+CMapLoadJob::CMapLoadJob(IStorage *pStorage, const char *pMapName, int ID)
+{
+	m_pStorage = pStorage;
+	str_copy(m_aMapName, pMapName, sizeof(m_aMapName));
+	str_format(m_aPath, sizeof(m_aPath), "maps/%s.map", pMapName);
+	m_ID = ID;
+	m_TempFile = false;
+	m_Loaded = false;
+	m_LoadTime = 0;
+	m_pMapData = 0;
+	m_MapSize = 0;
+	m_MapMapped = false;
+	m_MapFile = 0;
+	m_MapTime = 0;
+}
+
+CMapLoadJob::~CMapLoadJob()
+{
+	ReleaseMapData();
+	if(m_TempFile)
+		m_pStorage->RemoveFile(m_aPath, IStorage::TYPE_SAVE);
+}
+
+void CMapLoadJob::ReleaseMapData()
+{
+	if(m_MapMapped)
+		io_unmap(m_pMapData, m_MapSize);
+	else
+		free((void *)m_pMapData);
+	m_pMapData = 0;
+	m_MapMapped = false;
+	if(m_MapFile)
+		io_close(m_MapFile);
+	m_MapFile = 0;
+}
+
+// writes a copy of the map with the settings from the .cfg next to it,
+// returns false if there is no .cfg or the map has these settings already
+bool CMapLoadJob::ImportSettings(const char *pTempPath)
+{
+	char aConfig[512];
+	int Length = str_length(m_aPath) - 4;
+	str_format(aConfig, sizeof(aConfig), "%.*s.cfg", Length, m_aPath);
+
+	IOHANDLE File = m_pStorage->OpenFile(aConfig, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+	{
+		// No map-specific config, just return.
+		return false;
+	}
+	CLineReader LineReader;
+	LineReader.Init(File);
+
+	std::vector<char *> vpLines;
+	char *pLine;
+	int TotalLength = 0;
+	while((pLine = LineReader.Get()))
+	{
+		int Length = str_length(pLine) + 1;
+		char *pCopy = (char *)malloc(Length);
+		mem_copy(pCopy, pLine, Length);
+		vpLines.push_back(pCopy);
+		TotalLength += Length;
+	}
+	io_close(File);
+
+	char *pSettings = (char *)malloc(TotalLength);
+	int Offset = 0;
+	for(unsigned i = 0; i < vpLines.size(); i++)
+	{
+		int Length = str_length(vpLines[i]) + 1;
+		mem_copy(pSettings + Offset, vpLines[i], Length);
+		Offset += Length;
+		free(vpLines[i]);
+	}
+
+	CDataFileReader Reader;
+	if(!Reader.Open(m_pStorage, m_aPath, IStorage::TYPE_ALL))
+	{
+		free(pSettings);
+		return false;
+	}
+
+	CDataFileWriter Writer;
+	Writer.Init();
+
+	int SettingsIndex = Reader.NumData();
+	bool FoundInfo = false;
+	for(int i = 0; i < Reader.NumItems(); i++)
+	{
+		int TypeID;
+		int ItemID;
+		int *pData = (int *)Reader.GetItem(i, &TypeID, &ItemID);
+		int Size = Reader.GetItemSize(i);
+		CMapItemInfoSettings MapInfo;
+		if(TypeID == MAPITEMTYPE_INFO && ItemID == 0)
+		{
+			FoundInfo = true;
+			CMapItemInfoSettings *pInfo = (CMapItemInfoSettings *)pData;
+			if(Size >= (int)sizeof(CMapItemInfoSettings))
+			{
+				if(pInfo->m_Settings > -1)
+				{
+					SettingsIndex = pInfo->m_Settings;
+					char *pMapSettings = (char *)Reader.GetData(SettingsIndex);
+					int DataSize = Reader.GetDataSize(SettingsIndex);
+					if(DataSize == TotalLength && mem_comp(pSettings, pMapSettings, DataSize) == 0)
+					{
+						// Configs coincide, no need to update map.
+						free(pSettings);
+						return false;
+					}
+					Reader.UnloadData(pInfo->m_Settings);
+				}
+				else
+				{
+					MapInfo = *pInfo;
+					MapInfo.m_Settings = SettingsIndex;
+					pData = (int *)&MapInfo;
+					Size = sizeof(MapInfo);
+				}
+			}
+			else
+			{
+				*(CMapItemInfo *)&MapInfo = *(CMapItemInfo *)pInfo;
+				MapInfo.m_Settings = SettingsIndex;
+				pData = (int *)&MapInfo;
+				Size = sizeof(MapInfo);
+			}
+		}
+		Writer.AddItem(TypeID, ItemID, Size, pData);
+	}
+
+	if(!FoundInfo)
+	{
+		CMapItemInfoSettings Info;
+		Info.m_Version = 1;
+		Info.m_Author = -1;
+		Info.m_MapVersion = -1;
+		Info.m_Credits = -1;
+		Info.m_License = -1;
+		Info.m_Settings = SettingsIndex;
+		Writer.AddItem(MAPITEMTYPE_INFO, 0, sizeof(Info), &Info);
+	}
+
+	for(int i = 0; i < Reader.NumData() || i == SettingsIndex; i++)
+	{
+		if(i == SettingsIndex)
+		{
+			Writer.AddData(TotalLength, pSettings);
+			continue;
+		}
+		unsigned char *pData = (unsigned char *)Reader.GetData(i);
+		int Size = Reader.GetDataSize(i);
+		Writer.AddData(Size, pData);
+		Reader.UnloadData(i);
+	}
+
+	dbg_msg("mapchange", "imported settings");
+	Reader.Close();
+	Writer.OpenFile(m_pStorage, pTempPath);
+	Writer.Finish();
+	free(pSettings);
+	return true;
+}
+
+void CMapLoadJob::Load()
+{
+	int64 Start = time_get_impl();
+
+	// the temporary map is named after the job, a job started for the
+	// same map in the meantime doesn't touch it
+	char aTempPath[512];
+	str_format(aTempPath, sizeof(aTempPath), "%s.temp.%d.%d", m_aPath, pid(), m_ID);
+	if(ImportSettings(aTempPath))
+	{
+		str_copy(m_aPath, aTempPath, sizeof(m_aPath));
+		m_TempFile = true;
+	}
+
+	if(!m_DataFile.Open(m_pStorage, m_aPath, IStorage::TYPE_ALL))
+		return;
+
+	// decompress everything now instead of when the game asks for it
+	for(int i = 0; i < m_DataFile.NumData(); i++)
+		m_DataFile.GetData(i);
+
+	// map the file for downloads so servers sharing maps share the memory,
+	// read it if that's not possible
+	IOHANDLE File = m_pStorage->OpenFile(m_aPath, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+		return;
+	m_pMapData = (const unsigned char *)io_map(File, &m_MapSize);
+	m_MapMapped = m_pMapData != 0;
+	if(m_MapMapped)
+	{
+		m_MapFile = File;
+		m_MapTime = io_mtime(File);
+	}
+	else
+	{
+		m_MapSize = (unsigned int)io_length(File);
+		unsigned char *pData = (unsigned char *)malloc(m_MapSize);
+		io_read(File, pData, m_MapSize);
+		m_pMapData = pData;
+		io_close(File);
+	}
+
+	// the file could have changed since the datafile read it
+	if(crc32(0, m_pMapData, m_MapSize) != m_DataFile.Crc())
+	{
+		dbg_msg("server", "%s changed while loading", m_aPath);
+		ReleaseMapData();
+		return;
+	}
+
+	m_Loaded = true;
+	m_LoadTime = time_get_impl() - Start;
+}
+
+std::shared_ptr<CMapLoadJob> CServer::CreateMapLoad(const char *pMapName)
+{
+	return std::make_shared<CMapLoadJob>(Storage(), pMapName, m_NumMapLoads++);
+}
+
+void CServer::StartMapLoad(const char *pMapName, bool Force)
+{
+	if(m_pMapLoadJob && !Force && str_comp(m_pMapLoadJob->m_aMapName, pMapName) == 0)
+		return;
+
+	m_pMapLoadJob = CreateMapLoad(pMapName);
+	Kernel()->RequestInterface<IEngine>()->AddJob(m_pMapLoadJob);
+}
+
 int CServer::LoadMap(const char *pMapName)
 {
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
-	GameServer()->OnMapChange(aBuf, sizeof(aBuf));
+	// use a finished preload, load the map right away otherwise
+	std::shared_ptr<CMapLoadJob> pJob = m_pMapLoadJob;
+	if(!pJob || pJob->Status() != IJob::STATE_DONE || str_comp(pJob->m_aMapName, pMapName) != 0)
+	{
+		pJob = CreateMapLoad(pMapName);
+		pJob->Load();
+	}
+	return SwapMap(pJob);
+}
 
-	if(!m_pMap->Load(aBuf))
+int CServer::SwapMap(std::shared_ptr<CMapLoadJob> pJob)
+{
+	if(pJob == m_pMapLoadJob)
+		m_pMapLoadJob = nullptr;
+	m_MapLoadSwap = false;
+	if(!pJob->m_Loaded)
 		return 0;
 
+	char aBufMsg[256];
+	str_format(aBufMsg, sizeof(aBufMsg), "%s loaded in %.2f ms", pJob->m_aPath, pJob->m_LoadTime * 1000.0 / time_freq());
+	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
+
+	// the job keeps the previous map until the game let go of it
+	m_pMap->SwapDataFile(&pJob->m_DataFile);
+	m_pPrevMap = pJob;
+
 	for (int i = 0; i < MAX_CLIENTS; i++)
 	{
 		if (m_aClients[i].m_State == CClient::STATE_DUMMY)
@@ -1860,25 +2356,27 @@ int CServer::LoadMap(const char *pMapName)
 	// get the crc of the map
 	m_CurrentMapSha256 = m_pMap->Sha256();
 	m_CurrentMapCrc = m_pMap->Crc();
-	char aBufMsg[256];
 	char aSha256[SHA256_MAXSTRSIZE];
 	sha256_str(m_CurrentMapSha256, aSha256, sizeof(aSha256));
-	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
+	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", pJob->m_aPath, aSha256);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
-	str_format(aBufMsg, sizeof(aBufMsg), "%s crc is %08x", aBuf, m_CurrentMapCrc);
+	str_format(aBufMsg, sizeof(aBufMsg), "%s crc is %08x", pJob->m_aPath, m_CurrentMapCrc);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
 
-	str_copy(m_aCurrentMap, pMapName, sizeof(m_aCurrentMap));
-
-	// load complete map into memory for download
-	{
-		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
-		m_CurrentMapSize = (unsigned int)io_length(File);
-		free(m_pCurrentMapData);
-		m_pCurrentMapData = (unsigned char *)malloc(m_CurrentMapSize);
-		io_read(File, m_pCurrentMapData, m_CurrentMapSize);
-		io_close(File);
-	}
+	str_copy(m_aCurrentMap, pJob->m_aMapName, sizeof(m_aCurrentMap));
+
+	// take over the data for download
+	UnloadMapData();
+	m_pCurrentMapData = pJob->m_pMapData;
+	m_CurrentMapSize = pJob->m_MapSize;
+	m_CurrentMapMapped = pJob->m_MapMapped;
+	m_CurrentMapFile = pJob->m_MapFile;
+	m_CurrentMapTime = pJob->m_MapTime;
+	pJob->m_pMapData = 0;
+	pJob->m_MapMapped = false;
+	pJob->m_MapFile = 0;
+	for(int i = 0; i < MAP_CHUNK_CACHE_SIZE; i++)
+		m_aMapChunkCache[i].m_Chunk = -1;
 
 	for(int i=0; i<MAX_CLIENTS; i++)
 		m_aPrevStates[i] = m_aClients[i].m_State;
@@ -1886,6 +2384,48 @@ int CServer::LoadMap(const char *pMapName)
 	return 1;
 }
 
+void CServer::UnloadMapData()
+{
+	if(m_CurrentMapMapped)
+		io_unmap(m_pCurrentMapData, m_CurrentMapSize);
+	else
+		free((void *)m_pCurrentMapData);
+	m_pCurrentMapData = 0;
+	m_CurrentMapMapped = false;
+	if(m_CurrentMapFile)
+		io_close(m_CurrentMapFile);
+	m_CurrentMapFile = 0;
+}
+
+// a mapped map shows changes made to the file on disk, make sure it is
+// still what the clients were told before handing out data from it
+bool CServer::CheckMapData()
+{
+	if(!m_CurrentMapMapped)
+		return m_pCurrentMapData != 0;
+	if((unsigned int)io_length(m_CurrentMapFile) == m_CurrentMapSize && io_mtime(m_CurrentMapFile) == m_CurrentMapTime)
+		return true;
+
+	// read what is there now and keep serving it from memory if it's the same map
+	unsigned char *pData = (unsigned char *)malloc(m_CurrentMapSize);
+	bool Same = (unsigned int)io_length(m_CurrentMapFile) == m_CurrentMapSize &&
+		io_read(m_CurrentMapFile, pData, m_CurrentMapSize) == m_CurrentMapSize &&
+		crc32(0, pData, m_CurrentMapSize) == m_CurrentMapCrc &&
+		sha256(pData, m_CurrentMapSize) == m_CurrentMapSha256;
+	UnloadMapData();
+	if(Same)
+	{
+		m_pCurrentMapData = pData;
+		return true;
+	}
+
+	free(pData);
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "map file of '%s' changed on disk, not sending it anymore until the next map change", m_aCurrentMap);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	return false;
+}
+
 void CServer::InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole)
 {
 	m_Register.Init(pNetServer, pMasterServer, pConsole);
@@ -1902,6 +2442,9 @@ int CServer::Run()
 
 	m_PrintCBIndex = Console()->RegisterPrintCallback(g_Config.m_ConsoleOutputLevel, SendRconLineAuthed, this);
 
+	if(g_Config.m_SvTeeHistorianReplay[0])
+		return RunReplay();
+
 	// load map
 	if(!LoadMap(g_Config.m_SvMap))
 	{
@@ -1933,6 +2476,10 @@ int CServer::Run()
 	}
 
 	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
+	m_NetServer.SetSendBatching(g_Config.m_SvSendBatching);
+	m_NetServer.SetCoalesceSends(g_Config.m_SvCoalesceSends);
+	if(g_Config.m_SvNetThread && !m_NetServer.StartNetThread())
+		dbg_msg("server", "couldn't start network thread, handling network on the main thread");
 
 	m_Econ.Init(Console(), &m_ServerBan);
 
@@ -1971,6 +2518,8 @@ int CServer::Run()
 
 		while(m_RunServer)
 		{
+			int64 FrameStart = g_Profiler.Active() ? time_get_impl() : 0;
+
 			if(NonActive)
 				PumpNetwork();
 
@@ -1980,12 +2529,32 @@ int CServer::Run()
 			int NewTicks = 0;
 
 			// load new map TODO: don't poll this
+			int MapLoaded = -1;
 			if(str_comp(g_Config.m_SvMap, m_aCurrentMap) != 0 || m_MapReload)
 			{
+				if(g_Config.m_SvMapAsyncLoad)
+				{
+					// keep the game running until the map is loaded
+					StartMapLoad(g_Config.m_SvMap, m_MapReload);
+					m_MapLoadSwap = true;
+				}
+				else
+					MapLoaded = LoadMap(g_Config.m_SvMap);
 				m_MapReload = 0;
+			}
+			if(m_MapLoadSwap && m_pMapLoadJob && m_pMapLoadJob->Status() == IJob::STATE_DONE)
+			{
+				// sv_map might have been set back in the meantime
+				if(str_comp(m_pMapLoadJob->m_aMapName, g_Config.m_SvMap) == 0)
+					MapLoaded = SwapMap(m_pMapLoadJob);
+				else
+					m_MapLoadSwap = false;
+			}
 
+			if(MapLoaded != -1)
+			{
 				// load map
-				if(LoadMap(g_Config.m_SvMap))
+				if(MapLoaded)
 				{
 					// new map loaded
 					GameServer()->OnShutdown();
@@ -2010,6 +2579,7 @@ int CServer::Run()
 						break;
 					}
 					UpdateServerInfo();
+					m_pPrevMap = nullptr;
 				}
 				else
 				{
@@ -2066,6 +2636,7 @@ int CServer::Run()
 
 			while(t > TickStartTime(m_CurrentGameTick+1))
 			{
+				int64 InputStart = g_Profiler.Active() ? time_get_impl() : 0;
 				for(int c = 0; c < MAX_CLIENTS; c++)
 					if(m_aClients[c].m_State == CClient::STATE_INGAME)
 						for(int i = 0; i < 200; i++)
@@ -2075,6 +2646,20 @@ int CServer::Run()
 				m_CurrentGameTick++;
 				NewTicks++;
 
+				if(m_CurrentGameTick%TickSpeed() == 0)
+				{
+					m_ServerInfoRequestRate = m_ServerInfoRequests - m_ServerInfoRequestsLastSecond;
+					m_ServerInfoRequestsLastSecond = m_ServerInfoRequests;
+
+					int NumSentPackets = m_NetServer.NumSentPackets();
+					int NumIngame = 0;
+					for(int c = 0; c < MAX_CLIENTS; c++)
+						if(m_aClients[c].m_State == CClient::STATE_INGAME)
+							NumIngame++;
+					m_PacketsPerClientTick = NumIngame ? (NumSentPackets - m_SentPacketsLastSecond) / (float)(NumIngame * TickSpeed()) : 0.0f;
+					m_SentPacketsLastSecond = NumSentPackets;
+				}
+
 				// apply new input
 				for(int c = 0; c < MAX_CLIENTS; c++)
 				{
@@ -2089,8 +2674,13 @@ int CServer::Run()
 						}
 					}
 				}
+				if(InputStart)
+					g_Profiler.Add(m_aProfilePhases[PROFILE_INPUT], InputStart, time_get_impl());
 
-				GameServer()->OnTick();
+				{
+					CProfileScope Scope(m_aProfilePhases[PROFILE_TICK]);
+					GameServer()->OnTick();
+				}
 				if(ErrorShutdown())
 				{
 					break;
@@ -2116,6 +2706,17 @@ int CServer::Run()
 			if(!NonActive)
 				PumpNetwork();
 
+			// send everything queued during this iteration
+			m_NetServer.FlushConnections();
+			m_NetServer.FlushSends();
+
+			if(FrameStart)
+			{
+				g_Profiler.Add(m_aProfilePhases[PROFILE_FRAME], FrameStart, time_get_impl());
+				if(NewTicks)
+					g_Profiler.EndFrame();
+			}
+
 			NonActive = true;
 
 			for(int c = 0; c < MAX_CLIENTS; c++)
@@ -2139,7 +2740,7 @@ int CServer::Run()
 				if(g_Config.m_SvShutdownWhenEmpty)
 					m_RunServer = false;
 				else
-					net_socket_read_wait(m_NetServer.Socket(), 1000000);
+					m_NetServer.Wait(1000000);
 			}
 			else
 			{
@@ -2151,7 +2752,7 @@ int CServer::Run()
 
 				if(x > 0)
 				{
-					net_socket_read_wait(m_NetServer.Socket(), x);
+					m_NetServer.Wait(x);
 				}
 			}
 		}
@@ -2167,6 +2768,10 @@ int CServer::Run()
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 			m_NetServer.Drop(i, pDisconnectReason);
 	}
+	m_NetServer.FlushConnections();
+	m_NetServer.FlushSends();
+	m_NetServer.StopNetThread();
+	g_Profiler.StopTrace();
 
 	m_Econ.Shutdown();
 
@@ -2177,7 +2782,21 @@ int CServer::Run()
 	GameServer()->OnShutdown(true);
 	m_pMap->Unload();
 
-	free(m_pCurrentMapData);
+	UnloadMapData();
+	if(m_pMapLoadJob)
+	{
+		while(m_pMapLoadJob->Status() != IJob::STATE_DONE)
+			thread_sleep(1000);
+		m_pMapLoadJob = nullptr;
+	}
+	m_pPrevMap = nullptr;
+
+	m_SnapshotWorkers.Shutdown();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		delete m_apSnapshotJobs[i];
+		m_apSnapshotJobs[i] = 0;
+	}
 
 #if defined (CONF_SQL)
 	for (int i = 0; i < MAX_SQLSERVERS; i++)
@@ -2193,6 +2812,372 @@ int CServer::Run()
 	return ErrorShutdown();
 }
 
+struct CReplayPlayer
+{
+	bool m_Alive;
+	int m_X;
+	int m_Y;
+};
+
+struct CReplayCheck
+{
+	int m_NumChecked;
+	int m_NumDiffering;
+	int m_FirstTick;
+	int m_FirstClientID;
+	CReplayPlayer m_FirstRecorded;
+	CReplayPlayer m_FirstReplayed;
+};
+
+static void CheckReplayPositions(IGameServer *pGameServer, int Tick, const CReplayPlayer *pRecorded, CReplayCheck *pCheck)
+{
+	// the teehistorian records the players before they respawn in the same
+	// tick, so only recorded characters are compared
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(!pRecorded[i].m_Alive)
+			continue;
+		CReplayPlayer Replayed;
+		Replayed.m_Alive = pGameServer->GetCharacterPos(i, &Replayed.m_X, &Replayed.m_Y);
+		pCheck->m_NumChecked++;
+		if(Replayed.m_Alive && Replayed.m_X == pRecorded[i].m_X && Replayed.m_Y == pRecorded[i].m_Y)
+			continue;
+		if(!pCheck->m_NumDiffering++)
+		{
+			pCheck->m_FirstTick = Tick;
+			pCheck->m_FirstClientID = i;
+			pCheck->m_FirstRecorded = pRecorded[i];
+			pCheck->m_FirstReplayed = Replayed;
+		}
+	}
+}
+
+int CServer::RunReplay()
+{
+	const char *pFilename = g_Config.m_SvTeeHistorianReplay;
+	IOHANDLE File = Storage()->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+	{
+		dbg_msg("replay", "failed to open '%s'", pFilename);
+		return -1;
+	}
+	int Size = (int)io_length(File);
+	char *pData = (char *)malloc(Size);
+	io_read(File, pData, Size);
+	io_close(File);
+
+	CTeeHistorianReader Reader;
+	json_value *pHeader = 0;
+	if(Reader.Open(pData, Size))
+		pHeader = json_parse(Reader.Header(), str_length(Reader.Header()));
+	const json_value *pMapName = pHeader ? json_object_get(pHeader, "map_name") : &json_value_none;
+	if(pMapName->type != json_string)
+	{
+		dbg_msg("replay", "'%s' is not a teehistorian file: %s", pFilename, Reader.Error()[0] ? Reader.Error() : "invalid header");
+		if(pHeader)
+			json_value_free(pHeader);
+		free(pData);
+		return -1;
+	}
+
+	// the header only lists the settings that weren't the default
+	char aBuf[512];
+	const json_value *pConfig = json_object_get(pHeader, "config");
+	for(unsigned i = 0; pConfig->type == json_object && i < pConfig->u.object.length; i++)
+	{
+		const char *pName = pConfig->u.object.values[i].name;
+		const json_value *pValue = pConfig->u.object.values[i].value;
+		if(pValue->type != json_string || str_comp(pName, "sv_map") == 0 || str_comp_num(pName, "sv_tee_historian", 16) == 0)
+			continue;
+		str_format(aBuf, sizeof(aBuf), "%s \"", pName);
+		char *pDst = aBuf + str_length(aBuf);
+		str_escape(&pDst, json_string_get(pValue), aBuf + sizeof(aBuf));
+		str_append(aBuf, "\"", sizeof(aBuf));
+		Console()->ExecuteLine(aBuf);
+	}
+	str_copy(g_Config.m_SvMap, json_string_get(pMapName), sizeof(g_Config.m_SvMap));
+
+	if(!LoadMap(g_Config.m_SvMap))
+	{
+		dbg_msg("replay", "failed to load map. mapname='%s'", g_Config.m_SvMap);
+		json_value_free(pHeader);
+		free(pData);
+		return -1;
+	}
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(m_CurrentMapSha256, aSha256, sizeof(aSha256));
+	const json_value *pMapSha256 = json_object_get(pHeader, "map_sha256");
+	if(pMapSha256->type == json_string && str_comp(json_string_get(pMapSha256), aSha256) != 0)
+		dbg_msg("replay", "the map '%s' differs from the recorded one, the replay won't match", g_Config.m_SvMap);
+
+	// nothing ever connects, but the game sends to the slots of the players
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	net_addr_from_str(&BindAddr, "127.0.0.1");
+	if(!m_NetServer.Open(BindAddr, &m_ServerBan, MAX_CLIENTS, MAX_CLIENTS, 0))
+	{
+		dbg_msg("replay", "couldn't open socket");
+		json_value_free(pHeader);
+		free(pData);
+		return -1;
+	}
+
+	GameServer()->OnInit();
+	m_pConsole->StoreCommands(false);
+	const json_value *pTuning = json_object_get(pHeader, "tuning");
+	for(unsigned i = 0; pTuning->type == json_object && i < pTuning->u.object.length; i++)
+	{
+		const json_value *pValue = pTuning->u.object.values[i].value;
+		if(pValue->type != json_string)
+			continue;
+		str_format(aBuf, sizeof(aBuf), "tune %s %.2f", pTuning->u.object.values[i].name, str_toint(json_string_get(pValue)) / 100.0f);
+		Console()->ExecuteLine(aBuf);
+	}
+	json_value_free(pHeader);
+
+	g_Profiler.SetEnabled(true);
+	g_Profiler.SetRolling(false);
+	g_Profiler.Reset();
+
+	bool Check = g_Config.m_SvTeeHistorianReplayCheck;
+	bool CheckPending = false;
+	CReplayPlayer aRecorded[MAX_CLIENTS];
+	mem_zero(aRecorded, sizeof(aRecorded));
+	CReplayCheck Result;
+	mem_zero(&Result, sizeof(Result));
+	unsigned Checksum = 2166136261u;
+
+	m_GameStartTime = time_get();
+	m_CurrentGameTick = 0;
+	int64 Start = time_get_impl();
+
+	CTeeHistorianReader::CItem Item;
+	int Type = CTeeHistorianReader::ITEM_FINISH;
+	while(m_RunServer && !ErrorShutdown() && (Type = Reader.Next(&Item)) > CTeeHistorianReader::ITEM_FINISH)
+	{
+		// the recorded positions of a tick are complete with the first item
+		// that is not one
+		if(CheckPending && Type != CTeeHistorianReader::ITEM_PLAYER && Type != CTeeHistorianReader::ITEM_PLAYER_DEAD)
+		{
+			CheckReplayPositions(GameServer(), Tick(), aRecorded, &Result);
+			CheckPending = false;
+		}
+
+		int ClientID = Item.m_ClientID;
+		switch(Type)
+		{
+		case CTeeHistorianReader::ITEM_TICK:
+			while(Tick() < Reader.Tick() && m_RunServer)
+			{
+				ReplayTick();
+				if(Check)
+					Checksum = (Checksum ^ GameServer()->CharacterChecksum()) * 16777619u;
+			}
+			CheckPending = Check;
+			break;
+
+		case CTeeHistorianReader::ITEM_PLAYER:
+		case CTeeHistorianReader::ITEM_PLAYER_DEAD:
+			aRecorded[ClientID].m_Alive = Type == CTeeHistorianReader::ITEM_PLAYER;
+			aRecorded[ClientID].m_X = Item.m_X;
+			aRecorded[ClientID].m_Y = Item.m_Y;
+			break;
+
+		case CTeeHistorianReader::ITEM_JOIN:
+			if(m_aClients[ClientID].m_State != CClient::STATE_EMPTY)
+				break;
+			NewClientCallback(ClientID, this);
+			m_NetServer.DummyInit(ClientID);
+
+			// the handshake isn't recorded, the player is ready right away
+			m_aClients[ClientID].m_State = CClient::STATE_READY;
+			m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_FULL;
+			GameServer()->OnClientConnected(ClientID);
+			break;
+
+		case CTeeHistorianReader::ITEM_DROP:
+			if(m_aClients[ClientID].m_State == CClient::STATE_EMPTY)
+				break;
+			DelClientCallback(ClientID, Item.m_pString, this);
+			m_NetServer.DummyDelete(ClientID);
+			break;
+
+		case CTeeHistorianReader::ITEM_MESSAGE:
+		{
+			if(m_aClients[ClientID].m_State < CClient::STATE_READY)
+				break;
+			CUnpacker Unpacker;
+			Unpacker.Reset(Item.m_pData, Item.m_DataSize);
+			CMsgPacker Packer(NETMSG_EX);
+			int Msg;
+			bool Sys;
+			CUuid Uuid;
+			if(UnpackMessageID(&Msg, &Sys, &Uuid, &Unpacker, &Packer) != UNPACKMESSAGE_OK || Sys)
+				break;
+			GameServer()->OnMessage(Msg, &Unpacker, ClientID);
+			ReplayEnter(ClientID);
+			break;
+		}
+
+		case CTeeHistorianReader::ITEM_INPUT:
+		{
+			ReplayEnter(ClientID);
+			CClient *pClient = &m_aClients[ClientID];
+			if(pClient->m_State != CClient::STATE_INGAME)
+				break;
+
+			// when the input was meant for isn't recorded, use it for the
+			// next tick. a later one in the same tick replaces it
+			CClient::CInput *pInput = &pClient->m_aInputs[(pClient->m_CurrentInput + 199) % 200];
+			if(pInput->m_GameTick != Tick() + 1)
+			{
+				pInput = &pClient->m_aInputs[pClient->m_CurrentInput];
+				pClient->m_CurrentInput = (pClient->m_CurrentInput + 1) % 200;
+			}
+			pInput->m_GameTick = Tick() + 1;
+			mem_copy(pInput->m_aData, &Item.m_Input, sizeof(Item.m_Input));
+			mem_copy(pClient->m_LatestInput.m_aData, &Item.m_Input, sizeof(Item.m_Input));
+			GameServer()->OnClientDirectInput(ClientID, pClient->m_LatestInput.m_aData);
+			break;
+		}
+
+		case CTeeHistorianReader::ITEM_CONSOLE_COMMAND:
+		{
+			// older files have the profiling commands, they would disturb
+			// the measurement
+			if(str_comp(Item.m_pString, "sv_profile") == 0 || str_comp_num(Item.m_pString, "profile_", 8) == 0)
+				break;
+			str_copy(aBuf, Item.m_pString, sizeof(aBuf));
+			for(int i = 0; i < Item.m_NumArgs; i++)
+			{
+				str_append(aBuf, " \"", sizeof(aBuf));
+				char *pDst = aBuf + str_length(aBuf);
+				str_escape(&pDst, Item.m_apArgs[i], aBuf + sizeof(aBuf));
+				str_append(aBuf, "\"", sizeof(aBuf));
+			}
+			Console()->SetFlagMask(Item.m_FlagMask);
+			Console()->SetAccessLevel(IConsole::ACCESS_LEVEL_ADMIN);
+			Console()->ExecuteLine(aBuf, ClientID, false);
+			Console()->SetFlagMask(CFGFLAG_SERVER);
+			break;
+		}
+		}
+	}
+	if(CheckPending)
+		CheckReplayPositions(GameServer(), Tick(), aRecorded, &Result);
+	if(Type == CTeeHistorianReader::ITEM_ERROR)
+		dbg_msg("replay", "stopped early: %s", Reader.Error());
+
+	float Seconds = (time_get_impl() - Start) / (float)time_freq();
+	str_format(aBuf, sizeof(aBuf), "%d ticks in %.2fs, %.0f ticks per second, %.1fx real time",
+		Tick(), Seconds, Tick() / Seconds, Tick() / (Seconds * SERVER_TICK_SPEED));
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+	PrintProfile();
+	if(Check)
+	{
+		str_format(aBuf, sizeof(aBuf), "%d of %d recorded positions differ", Result.m_NumDiffering, Result.m_NumChecked);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+		if(Result.m_NumDiffering)
+		{
+			if(Result.m_FirstReplayed.m_Alive)
+				str_format(aBuf, sizeof(aBuf), "first at tick %d: cid=%d recorded=(%d, %d) replayed=(%d, %d)", Result.m_FirstTick, Result.m_FirstClientID,
+					Result.m_FirstRecorded.m_X, Result.m_FirstRecorded.m_Y, Result.m_FirstReplayed.m_X, Result.m_FirstReplayed.m_Y);
+			else
+				str_format(aBuf, sizeof(aBuf), "first at tick %d: cid=%d recorded=(%d, %d) replayed=dead", Result.m_FirstTick, Result.m_FirstClientID,
+					Result.m_FirstRecorded.m_X, Result.m_FirstRecorded.m_Y);
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+		}
+		str_format(aBuf, sizeof(aBuf), "checksum of the replayed characters: %08x", Checksum);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+	}
+
+	g_Profiler.SetRolling(true);
+	g_Profiler.SetEnabled(g_Config.m_SvProfile);
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_aClients[i].m_State == CClient::STATE_EMPTY)
+			continue;
+		DelClientCallback(i, "Server shutdown", this);
+		m_NetServer.DummyDelete(i);
+	}
+	GameServer()->OnShutdown(true);
+	m_pMap->Unload();
+	UnloadMapData();
+	m_SnapshotWorkers.Shutdown();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		delete m_apSnapshotJobs[i];
+		m_apSnapshotJobs[i] = 0;
+	}
+	free(pData);
+	return Type == CTeeHistorianReader::ITEM_ERROR || ErrorShutdown();
+}
+
+void CServer::ReplayTick()
+{
+	set_new_tick();
+	int64 FrameStart = time_get_impl();
+
+	{
+		CProfileScope Scope(m_aProfilePhases[PROFILE_INPUT]);
+		for(int c = 0; c < MAX_CLIENTS; c++)
+			if(m_aClients[c].m_State == CClient::STATE_INGAME)
+				for(int i = 0; i < 200; i++)
+					if(m_aClients[c].m_aInputs[i].m_GameTick == Tick() + 1)
+						GameServer()->OnClientPredictedEarlyInput(c, m_aClients[c].m_aInputs[i].m_aData);
+
+		m_CurrentGameTick++;
+
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(m_aClients[c].m_State != CClient::STATE_INGAME)
+				continue;
+			for(int i = 0; i < 200; i++)
+			{
+				if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
+				{
+					GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
+					break;
+				}
+			}
+		}
+	}
+
+	{
+		CProfileScope Scope(m_aProfilePhases[PROFILE_TICK]);
+		GameServer()->OnTick();
+	}
+
+	if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+	{
+		DoSnapshot();
+
+		// ack right away, so that the snapshots are deltas like for clients
+		// with a good connection
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(m_aClients[c].m_State != CClient::STATE_INGAME)
+				continue;
+			m_aClients[c].m_LastAckedSnapshot = m_CurrentGameTick;
+			m_aClients[c].m_SnapRate = CClient::SNAPRATE_FULL;
+		}
+	}
+
+	g_Profiler.Add(m_aProfilePhases[PROFILE_FRAME], FrameStart, time_get_impl());
+	g_Profiler.EndFrame();
+}
+
+void CServer::ReplayEnter(int ClientID)
+{
+	// what the client's NETMSG_ENTERGAME does, once the game sent it
+	// NETMSGTYPE_SV_READYTOENTER
+	if(m_aClients[ClientID].m_State != CClient::STATE_READY || !GameServer()->IsClientReady(ClientID))
+		return;
+	m_aClients[ClientID].m_State = CClient::STATE_INGAME;
+	GameServer()->OnClientEnter(ClientID);
+}
+
 void CServer::ConTestingCommands(CConsole::IResult *pResult, void *pUser)
 {
 	char aBuf[128];
@@ -2269,6 +3254,37 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 		}
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 	}
+
+	NETSTATS Stats;
+	net_stats(&Stats);
+	str_format(aBuf, sizeof(aBuf), "net sent_packets=%d send_syscalls=%d packets_per_syscall=%.2f batching=%s",
+		Stats.sent_packets, Stats.sent_syscalls, Stats.sent_syscalls ? Stats.sent_packets / (float)Stats.sent_syscalls : 0.0f,
+		g_Config.m_SvSendBatching ? "yes" : "no");
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	str_format(aBuf, sizeof(aBuf), "client packets per tick=%.2f coalescing=%s",
+		pThis->m_PacketsPerClientTick, g_Config.m_SvCoalesceSends ? "yes" : "no");
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	str_format(aBuf, sizeof(aBuf), "snapshot cache lookups=%lld hits=%lld hitrate=%.1f%%",
+		pThis->m_SnapshotCacheLookups, pThis->m_SnapshotCacheHits,
+		pThis->m_SnapshotCacheLookups ? pThis->m_SnapshotCacheHits * 100.0 / pThis->m_SnapshotCacheLookups : 0.0);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	str_format(aBuf, sizeof(aBuf), "server info requests=%lld rate=%lld/s cache hits=%lld hitrate=%.1f%%",
+		pThis->m_ServerInfoRequests, pThis->m_ServerInfoRequestRate, pThis->m_ServerInfoCacheHits,
+		pThis->m_ServerInfoRequests ? pThis->m_ServerInfoCacheHits * 100.0 / pThis->m_ServerInfoRequests : 0.0);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	str_format(aBuf, sizeof(aBuf), "map data %s size=%u chunk cache hits=%d misses=%d",
+		!pThis->m_pCurrentMapData ? "unavailable" : pThis->m_CurrentMapMapped ? "mapped" : "in memory", pThis->m_CurrentMapSize,
+		pThis->m_MapChunkCacheHits, pThis->m_MapChunkCacheMisses);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	const CNetConnLimiter *pConnLimiter = pThis->m_NetServer.ConnLimiter();
+	str_format(aBuf, sizeof(aBuf), "connlimit allowed=%d dropped_ip=%d dropped_network=%d evicted=%d",
+		pConnLimiter->NumAllowed(), pConnLimiter->NumDropped(), pConnLimiter->NumDroppedNetwork(), pConnLimiter->NumEvicted());
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	if(pThis->m_NetServer.NetThreadRunning())
+	{
+		str_format(aBuf, sizeof(aBuf), "net thread=yes recv_dropped=%d", pThis->m_NetServer.NetThreadDroppedPackets());
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
 }
 
 static int GetAuthLevel(const char *pLevel)
@@ -2554,6 +3570,7 @@ void CServer::DemoRecorder_HandleAutoStart()
 		char aDate[20];
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/%s_%s.demo", "auto/autorecord", aDate);
+		CheckMapData();
 		m_aDemoRecorder[MAX_CLIENTS].Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapSha256, m_CurrentMapCrc, "server", m_CurrentMapSize, m_pCurrentMapData);
 		if(g_Config.m_SvAutoDemoMax)
 		{
@@ -2590,6 +3607,7 @@ void CServer::StartRecord(int ClientID)
 	{
 		char aFilename[128];
 		str_format(aFilename, sizeof(aFilename), "demos/%s_%d_%d_tmp.demo", m_aCurrentMap, g_Config.m_SvPort, ClientID);
+		CheckMapData();
 		m_aDemoRecorder[ClientID].Start(Storage(), Console(), aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapSha256, m_CurrentMapCrc, "server", m_CurrentMapSize, m_pCurrentMapData);
 	}
 }
@@ -2624,6 +3642,7 @@ void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/demo_%s.demo", aDate);
 	}
+	pServer->CheckMapData();
 	pServer->m_aDemoRecorder[MAX_CLIENTS].Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, pServer->m_CurrentMapSha256, pServer->m_CurrentMapCrc, "server", pServer->m_CurrentMapSize, pServer->m_pCurrentMapData);
 }
 
@@ -2632,11 +3651,76 @@ void CServer::ConStopRecord(IConsole::IResult *pResult, void *pUser)
 	((CServer *)pUser)->m_aDemoRecorder[MAX_CLIENTS].Stop();
 }
 
+void CServer::ConProfileDump(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	if(!g_Config.m_SvProfile)
+	{
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profile", "profiling is off, enable it with sv_profile 1");
+		return;
+	}
+
+	pThis->PrintProfile();
+}
+
+void CServer::PrintProfile()
+{
+	char aBuf[256];
+	for(int i = 0; i < g_Profiler.NumPhases(); i++)
+	{
+		CProfiler::CStats Stats;
+		g_Profiler.GetStats(i, &Stats);
+		if(!Stats.m_NumSamples)
+			continue;
+		str_format(aBuf, sizeof(aBuf), "%-20s ticks=%5d avg=%6dus p50=%6dus p99=%6dus max=%6dus",
+			Stats.m_pName, Stats.m_NumSamples, (int)(Stats.m_Total / Stats.m_NumSamples), Stats.m_P50, Stats.m_P99, Stats.m_Max);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profile", aBuf);
+	}
+}
+
+void CServer::ConProfileTrace(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	const char *pFilename = pResult->GetString(0);
+	IOHANDLE File = pThis->Storage()->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	char aBuf[256];
+	if(!File)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to open '%s' for writing", pFilename);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profile", aBuf);
+		return;
+	}
+	g_Profiler.StartTrace(File);
+	str_format(aBuf, sizeof(aBuf), "writing trace events to '%s' until profile_trace_stop", pFilename);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profile", aBuf);
+}
+
+void CServer::ConProfileTraceStop(IConsole::IResult *pResult, void *pUser)
+{
+	g_Profiler.StopTrace();
+}
+
 void CServer::ConMapReload(IConsole::IResult *pResult, void *pUser)
 {
 	((CServer *)pUser)->m_MapReload = 1;
 }
 
+void CServer::ConPreloadMap(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	char aBuf[256];
+	if(pThis->m_MapLoadSwap)
+	{
+		str_format(aBuf, sizeof(aBuf), "map change to '%s' in progress", pThis->m_pMapLoadJob->m_aMapName);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+		return;
+	}
+	pThis->StartMapLoad(pResult->GetString(0), true);
+
+	str_format(aBuf, sizeof(aBuf), "preloading map '%s'", pResult->GetString(0));
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
 void CServer::ConLogout(IConsole::IResult *pResult, void *pUser)
 {
 	CServer *pServer = (CServer *)pUser;
@@ -2760,6 +3844,27 @@ void CServer::ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pU
 		((CServer *)pUserData)->m_NetServer.SetMaxClientsPerIP(pResult->GetInteger(0));
 }
 
+void CServer::ConchainSendBatchingUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		((CServer *)pUserData)->m_NetServer.SetSendBatching(pResult->GetInteger(0));
+}
+
+void CServer::ConchainCoalesceSendsUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		((CServer *)pUserData)->m_NetServer.SetCoalesceSends(pResult->GetInteger(0));
+}
+
+void CServer::ConchainProfileUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		g_Profiler.SetEnabled(pResult->GetInteger(0));
+}
+
 void CServer::ConchainCommandAccessUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	if(pResult->NumArguments() == 2)
@@ -2931,8 +4036,12 @@ void CServer::RegisterCommands()
 
 	Console()->Register("record", "?s[file]", CFGFLAG_SERVER|CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
+	Console()->Register("profile_dump", "", CFGFLAG_SERVER|CFGFLAG_NONTEEHISTORIC, ConProfileDump, this, "Show p50/p99/max of the time per tick spent in each phase (sv_profile)");
+	Console()->Register("profile_trace", "s[file]", CFGFLAG_SERVER|CFGFLAG_NONTEEHISTORIC, ConProfileTrace, this, "Write every profiled phase to a chrome trace event file");
+	Console()->Register("profile_trace_stop", "", CFGFLAG_SERVER|CFGFLAG_NONTEEHISTORIC, ConProfileTraceStop, this, "Stop writing trace events");
 
 	Console()->Register("reload", "", CFGFLAG_SERVER, ConMapReload, this, "Reload the map");
+	Console()->Register("preload_map", "r[map]", CFGFLAG_SERVER, ConPreloadMap, this, "Load a map in the background so that changing to it is quick");
 
 #if defined(CONF_SQL)
 	Console()->Register("add_sqlserver", "s['r'|'w'] s[Database] s[Prefix] s[User] s[Password] s[IP] i[Port] ?i[SetUpDatabase ?]", CFGFLAG_SERVER|CFGFLAG_NONTEEHISTORIC, ConAddSqlServer, this, "add a sqlserver");
@@ -2952,8 +4061,13 @@ void CServer::RegisterCommands()
 
 	Console()->Chain("sv_name", ConchainSpecialInfoupdate, this);
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
+	Console()->Chain("sv_spectator_slots", ConchainSpecialInfoupdate, this);
+	Console()->Chain("sv_reserved_slots", ConchainSpecialInfoupdate, this);
 
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
+	Console()->Chain("sv_send_batching", ConchainSendBatchingUpdate, this);
+	Console()->Chain("sv_coalesce_sends", ConchainCoalesceSendsUpdate, this);
+	Console()->Chain("sv_profile", ConchainProfileUpdate, this);
 	Console()->Chain("access_level", ConchainCommandAccessUpdate, this);
 	Console()->Chain("console_output_level", ConchainConsoleOutputLevelUpdate, this);
 
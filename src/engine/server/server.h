@@ -10,6 +10,7 @@
 #include <engine/server.h>
 
 #include <engine/map.h>
+#include <engine/shared/datafile.h>
 #include <engine/shared/demo.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
@@ -23,6 +24,10 @@
 
 #include <base/tl/array.h>
 
+#include <mastersrv/mastersrv.h>
+
+#include <vector>
+
 #include "authmanager.h"
 #include "name_ban.h"
 
@@ -66,6 +71,37 @@ public:
 };
 
 
+// opens a map, decompresses all of its data and prepares it for download.
+// runs on the job pool for background map changes and preloads
+class CMapLoadJob : public IJob
+{
+	virtual void Run() { Load(); }
+
+public:
+	CMapLoadJob(class IStorage *pStorage, const char *pMapName, int ID);
+	~CMapLoadJob();
+
+	bool ImportSettings(const char *pTempPath);
+	void Load();
+	void ReleaseMapData();
+
+	class IStorage *m_pStorage;
+	char m_aMapName[MAX_PATH_LENGTH];
+	char m_aPath[512];
+	int m_ID;
+	bool m_TempFile; // map with imported settings, removed with the job
+
+	bool m_Loaded;
+	int64 m_LoadTime;
+	CDataFileReader m_DataFile;
+	const unsigned char *m_pMapData;
+	unsigned int m_MapSize;
+	bool m_MapMapped;
+	IOHANDLE m_MapFile; // kept open while mapped to notice changes to it
+	time_t m_MapTime;
+};
+
+
 class CServerBan : public CNetBan
 {
 	class CServer *m_pServer;
@@ -79,6 +115,7 @@ public:
 
 	virtual int BanAddr(const NETADDR *pAddr, int Seconds, const char *pReason);
 	virtual int BanRange(const CNetRange *pRange, int Seconds, const char *pReason);
+	virtual int BanFile(const char *pFilename, int Seconds, const char *pReason);
 
 	static void ConBanExt(class IConsole::IResult *pResult, void *pUser);
 };
@@ -111,6 +148,15 @@ public:
 	enum
 	{
 		MAX_RCONCMD_SEND=16,
+
+		// DoSnapshot keeps 3 seconds worth of snapshots per client
+		SNAPSHOT_STORAGE_TICKS=SERVER_TICK_SPEED*3+1,
+		SNAPSHOT_STORAGE_AVGSIZE=4*1024,
+
+		// map downloads are sent in chunks of this size, the last few
+		// hundred chunk messages are kept for other downloading clients
+		MAP_CHUNK_SIZE=1024-128,
+		MAP_CHUNK_CACHE_SIZE=256,
 	};
 
 	class CClient
@@ -190,6 +236,45 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// per-client snapshot work, built on the main thread and
+	// delta'd and compressed by the snapshot workers
+	class CSnapshotJob
+	{
+	public:
+		int m_ClientID;
+		int m_SnapshotSize;
+		int m_Crc;
+		int m_DeltaTick;
+		CSnapshot *m_pDeltashot;
+		int m_DeltashotSize;
+		int m_SameAs; // job with identical snapshot and delta base, or -1
+		int m_CompSize;
+		int64 m_DeltaTime;
+		int64 m_CompressTime;
+		char m_aData[CSnapshot::MAX_SIZE];
+		char m_aCompData[CSnapshot::MAX_SIZE];
+	};
+	CSnapshotJob *m_apSnapshotJobs[MAX_CLIENTS];
+	CWorkerGroup m_SnapshotWorkers;
+	// one lookup per client snapshot, an int overflows within weeks
+	int64 m_SnapshotCacheLookups;
+	int64 m_SnapshotCacheHits;
+
+	enum
+	{
+		PROFILE_FRAME=0,
+		PROFILE_INPUT,
+		PROFILE_TICK,
+		PROFILE_SNAP,
+		PROFILE_SNAP_ONSNAP,
+		PROFILE_SNAP_DELTA,
+		PROFILE_SNAP_COMPRESS,
+		PROFILE_SNAP_SEND,
+		PROFILE_NETWORK,
+		NUM_PROFILE_PHASES
+	};
+	int m_aProfilePhases[NUM_PROFILE_PHASES];
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -215,8 +300,31 @@ public:
 	char m_aCurrentMap[MAX_PATH_LENGTH];
 	SHA256_DIGEST m_CurrentMapSha256;
 	unsigned m_CurrentMapCrc;
-	unsigned char *m_pCurrentMapData;
+	const unsigned char *m_pCurrentMapData;
 	unsigned int m_CurrentMapSize;
+	bool m_CurrentMapMapped;
+	IOHANDLE m_CurrentMapFile;
+	time_t m_CurrentMapTime;
+
+	// map loaded in the background or preloaded, m_MapLoadSwap is set
+	// when the map should be changed to it once it is done. the previous
+	// map's data is kept until the game is done with it
+	std::shared_ptr<CMapLoadJob> m_pMapLoadJob;
+	bool m_MapLoadSwap;
+	int m_NumMapLoads;
+	std::shared_ptr<CMapLoadJob> m_pPrevMap;
+
+	// finished NETMSG_MAP_DATA messages, indexed by chunk modulo the size
+	class CMapChunk
+	{
+	public:
+		int m_Chunk;
+		int m_Size;
+		unsigned char m_aData[MAP_CHUNK_SIZE+32];
+	};
+	CMapChunk m_aMapChunkCache[MAP_CHUNK_CACHE_SIZE];
+	int m_MapChunkCacheHits;
+	int m_MapChunkCacheMisses;
 
 	CDemoRecorder m_aDemoRecorder[MAX_CLIENTS+1];
 	CRegister m_Register;
@@ -227,6 +335,37 @@ public:
 	int64 m_ServerInfoFirstRequest;
 	int m_ServerInfoNumRequests;
 
+	// packed server info packets per SERVERINFO_* type, with or without
+	// the clients and by length of the token, only the token is replaced
+	// when they are sent. rebuilt on the next request after a change
+	class CServerInfoCache
+	{
+	public:
+		class CPacket
+		{
+		public:
+			int m_Size;
+			unsigned char m_aData[NET_MAX_PAYLOAD];
+		};
+		bool m_Valid;
+		std::vector<CPacket> m_aPackets;
+	};
+	enum
+	{
+		NUM_SERVERINFO_TYPES=SERVERINFO_INGAME+1,
+		SERVERINFO_MAX_TOKEN_LENGTH=11,
+	};
+	CServerInfoCache m_aaaServerInfoCache[NUM_SERVERINFO_TYPES][2][SERVERINFO_MAX_TOKEN_LENGTH+1];
+	bool m_ServerInfoNeedsUpdate;
+	// floods of requests overflow an int within days
+	int64 m_ServerInfoRequests;
+	int64 m_ServerInfoCacheHits;
+	int64 m_ServerInfoRequestsLastSecond;
+	int64 m_ServerInfoRequestRate;
+
+	int m_SentPacketsLastSecond;
+	float m_PacketsPerClientTick;
+
 	char m_aErrorShutdownReason[128];
 
 	array<CNameBan> m_aNameBans;
@@ -240,6 +379,7 @@ public:
 	virtual void SetClientCountry(int ClientID, int Country);
 	virtual void SetClientScore(int ClientID, int Score);
 	virtual void SetClientFlags(int ClientID, int Flags);
+	virtual void ExpireServerInfo();
 
 	void Kick(int ClientID, const char *pReason);
 	void Ban(int ClientID, int Seconds, const char *pReason);
@@ -270,8 +410,15 @@ public:
 
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
 	int SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System);
+	int SendPackedMsg(const unsigned char *pData, int Size, int Flags, int ClientID);
 
 	void DoSnapshot();
+	void BuildSnapshot(CSnapshotJob *pJob);
+	void FindDeltaBase(CSnapshotJob *pJob);
+	int FindSameSnapshot(CSnapshotJob *pJob, int NumJobs);
+	void ProcessSnapshot(CSnapshotJob *pJob);
+	static void ProcessSnapshotWork(int Index, void *pUser);
+	void SendSnapshot(CSnapshotJob *pJob);
 
 	static int NewClientCallback(int ClientID, void *pUser);
 	static int NewClientNoAuthCallback(int ClientID, void *pUser);
@@ -283,6 +430,8 @@ public:
 	void SendCapabilities(int ClientID);
 	void SendMap(int ClientID);
 	void SendMapData(int ClientID, int Chunk);
+	void UnloadMapData();
+	bool CheckMapData();
 	void SendConnectionReady(int ClientID);
 	void SendRconLine(int ClientID, const char *pLine);
 	static void SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighted = false);
@@ -295,6 +444,7 @@ public:
 
 	void SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients);
 	void SendServerInfoConnless(const NETADDR *pAddr, int Token, int Type);
+	void CacheServerInfo(CServerInfoCache *pCache, int Token, int Type, bool SendClients);
 	void UpdateServerInfo();
 	// Dummy
 	void DummyJoin(int DummyID, const char* pDummyName, const char* pDummyClan, int Country);
@@ -304,6 +454,9 @@ public:
 
 	char *GetMapName();
 	int LoadMap(const char *pMapName);
+	std::shared_ptr<CMapLoadJob> CreateMapLoad(const char *pMapName);
+	void StartMapLoad(const char *pMapName, bool Force);
+	int SwapMap(std::shared_ptr<CMapLoadJob> pJob);
 
 	void SaveDemo(int ClientID, float Time);
 	void StartRecord(int ClientID);
@@ -312,6 +465,12 @@ public:
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
 	int Run();
+	// runs the game through a teehistorian file as fast as possible and
+	// without network, see sv_tee_historian_replay
+	int RunReplay();
+	void ReplayTick();
+	void ReplayEnter(int ClientID);
+	void PrintProfile();
 
 	static void ConTestingCommands(IConsole::IResult *pResult, void *pUser);
 	static void ConRescue(IConsole::IResult *pResult, void *pUser);
@@ -320,7 +479,11 @@ public:
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
+	static void ConProfileDump(IConsole::IResult *pResult, void *pUser);
+	static void ConProfileTrace(IConsole::IResult *pResult, void *pUser);
+	static void ConProfileTraceStop(IConsole::IResult *pResult, void *pUser);
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
+	static void ConPreloadMap(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConShowIps(IConsole::IResult *pResult, void *pUser);
 
@@ -345,6 +508,9 @@ public:
 
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainSendBatchingUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainCoalesceSendsUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainProfileUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainCommandAccessUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainConsoleOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
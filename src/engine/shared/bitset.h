@@ -0,0 +1,160 @@
+#ifndef ENGINE_SHARED_BITSET_H
+#define ENGINE_SHARED_BITSET_H
+
+#include <base/system.h>
+
+// fixed size set of small numbers like client ids, kept in 64 bit words
+// so that counting and iterating cost one step per word and not per bit
+template<int NUM_BITS>
+class CBitset
+{
+	enum
+	{
+		NUM_WORDS=(NUM_BITS+63)/64,
+	};
+
+	uint64 m_aWords[NUM_WORDS];
+
+	static int PopCount(uint64 Word)
+	{
+#if defined(__GNUC__)
+		return __builtin_popcountll(Word);
+#else
+		int Count = 0;
+		for(; Word; Count++)
+			Word &= Word-1;
+		return Count;
+#endif
+	}
+
+	static int LowestBit(uint64 Word)
+	{
+#if defined(__GNUC__)
+		return __builtin_ctzll(Word);
+#else
+		int Index = 0;
+		while(!(Word&1))
+		{
+			Word >>= 1;
+			Index++;
+		}
+		return Index;
+#endif
+	}
+
+	void ClearPadding()
+	{
+		if(NUM_BITS%64)
+			m_aWords[NUM_WORDS-1] &= ((uint64)1<<(NUM_BITS%64))-1;
+	}
+
+public:
+	enum
+	{
+		SIZE=NUM_BITS,
+	};
+
+	CBitset() { Clear(); }
+
+	static CBitset All()
+	{
+		CBitset Set;
+		Set.SetAll();
+		return Set;
+	}
+
+	static CBitset One(int Index)
+	{
+		CBitset Set;
+		Set.Set(Index);
+		return Set;
+	}
+
+	void Clear()
+	{
+		for(int i = 0; i < NUM_WORDS; i++)
+			m_aWords[i] = 0;
+	}
+
+	void SetAll()
+	{
+		for(int i = 0; i < NUM_WORDS; i++)
+			m_aWords[i] = ~(uint64)0;
+		ClearPadding();
+	}
+
+	void Set(int Index) { m_aWords[Index/64] |= (uint64)1<<(Index%64); }
+	void Unset(int Index) { m_aWords[Index/64] &= ~((uint64)1<<(Index%64)); }
+	bool Test(int Index) const { return (m_aWords[Index/64]>>(Index%64))&1; }
+
+	bool Any() const
+	{
+		for(int i = 0; i < NUM_WORDS; i++)
+			if(m_aWords[i])
+				return true;
+		return false;
+	}
+
+	int Count() const
+	{
+		int Count = 0;
+		for(int i = 0; i < NUM_WORDS; i++)
+			Count += PopCount(m_aWords[i]);
+		return Count;
+	}
+
+	// returns the smallest member not below Index or SIZE if there is none,
+	// for(int i = Set.FindNext(0); i < Set.SIZE; i = Set.FindNext(i+1))
+	// visits all members in order
+	int FindNext(int Index) const
+	{
+		if(Index >= NUM_BITS)
+			return NUM_BITS;
+		int Word = Index/64;
+		uint64 Bits = m_aWords[Word] & (~(uint64)0<<(Index%64));
+		while(!Bits)
+		{
+			if(++Word == NUM_WORDS)
+				return NUM_BITS;
+			Bits = m_aWords[Word];
+		}
+		return Word*64 + LowestBit(Bits);
+	}
+
+	CBitset &operator|=(const CBitset &Other)
+	{
+		for(int i = 0; i < NUM_WORDS; i++)
+			m_aWords[i] |= Other.m_aWords[i];
+		return *this;
+	}
+
+	CBitset &operator&=(const CBitset &Other)
+	{
+		for(int i = 0; i < NUM_WORDS; i++)
+			m_aWords[i] &= Other.m_aWords[i];
+		return *this;
+	}
+
+	CBitset operator|(const CBitset &Other) const { CBitset Set = *this; return Set |= Other; }
+	CBitset operator&(const CBitset &Other) const { CBitset Set = *this; return Set &= Other; }
+
+	CBitset operator~() const
+	{
+		CBitset Set;
+		for(int i = 0; i < NUM_WORDS; i++)
+			Set.m_aWords[i] = ~m_aWords[i];
+		Set.ClearPadding();
+		return Set;
+	}
+
+	bool operator==(const CBitset &Other) const
+	{
+		for(int i = 0; i < NUM_WORDS; i++)
+			if(m_aWords[i] != Other.m_aWords[i])
+				return false;
+		return true;
+	}
+	bool operator!=(const CBitset &Other) const { return !(*this == Other); }
+};
+
+#endif
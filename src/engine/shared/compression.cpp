@@ -4,6 +4,12 @@
 
 #include "compression.h"
 
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
 {
@@ -51,7 +57,7 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 
 		if(!(*pSrc&0x80)) break;
 		pSrc++;
-		*pInOut |= (*pSrc&(0x7F))<<(6+7+7+7);
+		*pInOut |= (unsigned)(*pSrc&(0x7F))<<(6+7+7+7);
 	} while(0);
 
 	pSrc++;
@@ -59,6 +65,65 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 	return pSrc;
 }
 
+// the block versions below work on up to 8 bytes at once in a 64 bit
+// register: all bytes of a value are assembled or taken apart with shifts
+// and masks and the length comes from a bit scan instead of a branch per byte
+
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+static inline unsigned LowestBit(uint64 Value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long Index;
+	_BitScanForward64(&Index, Value);
+	return Index;
+#elif defined(__GNUC__)
+	return __builtin_ctzll(Value);
+#else
+	unsigned Index = 0;
+	while(!(Value&1))
+	{
+		Value >>= 1;
+		Index++;
+	}
+	return Index;
+#endif
+}
+
+static inline int PackFast(unsigned char *pDst, int i)
+{
+	unsigned Sign = (i>>25)&0x40;
+	unsigned Value = i^(i>>31);
+	int Length = 1 + (Value >= (1u<<6)) + (Value >= (1u<<13)) + (Value >= (1u<<20)) + (Value >= (1u<<27));
+
+	uint64 Word = Sign | (Value&0x3F) |
+		(uint64)((Value>>6)&0x7F)<<8 |
+		(uint64)((Value>>13)&0x7F)<<16 |
+		(uint64)((Value>>20)&0x7F)<<24 |
+		(uint64)(Value>>27)<<32;
+	// extend bits on all but the last byte
+	Word |= 0x80808080ull & ((1ull<<(8*(Length-1)))-1);
+	memcpy(pDst, &Word, 8);
+	return Length;
+}
+
+static inline int UnpackFast(const unsigned char *pSrc, int *pOut)
+{
+	uint64 Word;
+	memcpy(&Word, pSrc, 8);
+
+	// the fifth byte ends the value regardless of its extend bit
+	int Length = LowestBit((~Word&0x80808080ull) | 0x8000000000ull)/8 + 1;
+	Word &= (1ull<<(8*Length))-1;
+
+	unsigned Value = (Word&0x3F) |
+		((Word>>8)&0x7F)<<6 |
+		((Word>>16)&0x7F)<<13 |
+		((Word>>24)&0x7F)<<20 |
+		(unsigned)(((Word>>32)&0x7F)<<27);
+	*pOut = Value ^ -(unsigned)((Word>>6)&1);
+	return Length;
+}
+#endif
 
 long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_, int DstSize)
 {
@@ -66,6 +131,29 @@ long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_, int DstS
 	const unsigned char *pEnd = pSrc + Size;
 	int *pDst = (int *)pDst_;
 	int *pDstEnd = pDst + DstSize / 4;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	while(pEnd - pSrc >= 8 && pDst < pDstEnd)
+	{
+		uint64 Word;
+		memcpy(&Word, pSrc, 8);
+		if(!(Word&0x8080808080808080ull) && pDstEnd - pDst >= 8)
+		{
+			// eight single byte values, the common case for deltas
+			for(int i = 0; i < 8; i++)
+			{
+				unsigned Byte = (Word>>(i*8))&0xFF;
+				pDst[i] = (Byte&0x3F) ^ -(int)(Byte>>6);
+			}
+			pSrc += 8;
+			pDst += 8;
+		}
+		else
+		{
+			pSrc += UnpackFast(pSrc, pDst);
+			pDst++;
+		}
+	}
+#endif
 	while(pSrc < pEnd)
 	{
 		if(pDst >= pDstEnd)
@@ -82,6 +170,32 @@ long CVariableInt::Compress(const void *pSrc_, int Size, void *pDst_, int DstSiz
 	unsigned char *pDst = (unsigned char *)pDst_;
 	unsigned char *pDstEnd = pDst + DstSize;
 	Size /= 4;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	while(Size && pDstEnd - pDst >= 8)
+	{
+		if(Size >= 8)
+		{
+			unsigned Large = 0;
+			for(int i = 0; i < 8; i++)
+				Large |= (unsigned)pSrc[i]+64u;
+			if(Large < 128)
+			{
+				// eight values in [-64, 63], one byte each
+				uint64 Word = 0;
+				for(int i = 0; i < 8; i++)
+					Word |= (uint64)(((pSrc[i]>>25)&0x40) | ((pSrc[i]^(pSrc[i]>>31))&0x3F))<<(i*8);
+				memcpy(pDst, &Word, 8);
+				pDst += 8;
+				pSrc += 8;
+				Size -= 8;
+				continue;
+			}
+		}
+		pDst += PackFast(pDst, *pSrc);
+		Size--;
+		pSrc++;
+	}
+#endif
 	while(Size)
 	{
 		if(pDstEnd - pDst < 6)
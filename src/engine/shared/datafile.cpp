@@ -511,6 +511,13 @@ int CDataFileReader::NumItems()
 	return m_pDataFile->m_Header.m_NumItems;
 }
 
+void CDataFileReader::Swap(CDataFileReader *pOther)
+{
+	CDatafile *pDataFile = m_pDataFile;
+	m_pDataFile = pOther->m_pDataFile;
+	pOther->m_pDataFile = pDataFile;
+}
+
 bool CDataFileReader::Close()
 {
 	if(!m_pDataFile)
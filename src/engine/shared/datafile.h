@@ -24,6 +24,7 @@ public:
 
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
 	bool Close();
+	void Swap(CDataFileReader *pOther);
 
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
@@ -3,6 +3,8 @@
 #include <base/system.h>
 #include "huffman.h"
 
+#include <string.h>
+
 struct CHuffmanConstructNode
 {
 	unsigned short m_NodeId;
@@ -129,10 +131,167 @@ void CHuffman::Init(const unsigned *pFrequencies)
 			m_apDecodeLut[i] = pNode;
 	}
 
+	BuildDecodeTable();
+}
+
+void CHuffman::BuildDecodeTable()
+{
+	for(int i = 0; i < HUFFMAN_DECODESIZE; i++)
+	{
+		CDecodeEntry *pEntry = &m_aDecodeTable[i];
+		CNode *pNode = m_pStartNode;
+		int k;
+		for(k = 0; k < HUFFMAN_DECODEBITS; k++)
+		{
+			pNode = &m_aNodes[pNode->m_aLeafs[(i>>k)&1]];
+			if(!pNode->m_NumBits)
+				continue;
+
+			// the eof symbol ends the table entry
+			if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
+				break;
+			pEntry->m_aSymbols[pEntry->m_NumSymbols++] = pNode->m_Symbol;
+			pEntry->m_NumBits = k+1;
+			pNode = m_pStartNode;
+			if(pEntry->m_NumSymbols == HUFFMAN_DECODESYMBOLS)
+				break;
+		}
+
+		if(!pEntry->m_NumSymbols)
+		{
+			pEntry->m_Node = pNode - m_aNodes;
+			pEntry->m_NumBits = k < HUFFMAN_DECODEBITS ? k+1 : HUFFMAN_DECODEBITS;
+		}
+	}
 }
 
 //***************************************************************
+// the versions below keep up to 64 bits in flight: the encoder writes a
+// whole word of output at once and the decoder refills a word of input at
+// once and emits up to HUFFMAN_DECODESYMBOLS symbols per table lookup.
+// near the ends of the buffers they fall back to the byte wise code, so
+// the results (including failures) are the same as the legacy versions
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+{
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	const unsigned char *pSrc = (const unsigned char *)pInput;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
+	unsigned char *pDst = (unsigned char *)pOutput;
+	unsigned char *pDstEnd = pDst + OutputSize;
+
+	uint64 Bits = 0;
+	unsigned Bitcount = 0;
+
+	while(1)
+	{
+		int Symbol = pSrc != pSrcEnd ? *pSrc++ : (int)HUFFMAN_EOF_SYMBOL;
+		Bits |= (uint64)m_aNodes[Symbol].m_Bits << Bitcount;
+		Bitcount += m_aNodes[Symbol].m_NumBits;
+
+		bool Last = Symbol == HUFFMAN_EOF_SYMBOL;
+		if(Bitcount < HUFFMAN_MAXCODEBITS && !Last)
+			continue;
+
+		// write all complete bytes, the legacy version fails as soon as
+		// the output is full
+		unsigned NumBytes = Bitcount>>3;
+		if(NumBytes)
+		{
+			if(pDstEnd - pDst <= (long)NumBytes)
+				return -1;
+			if(pDstEnd - pDst >= 8)
+				memcpy(pDst, &Bits, 8);
+			else
+			{
+				for(unsigned i = 0; i < NumBytes; i++)
+					pDst[i] = (unsigned char)(Bits>>(i*8));
+			}
+			pDst += NumBytes;
+			Bits >>= NumBytes*8;
+			Bitcount &= 7;
+		}
+
+		if(Last)
+			break;
+	}
+
+	// write out the last bits
+	*pDst++ = (unsigned char)Bits;
+	return (int)(pDst - (const unsigned char *)pOutput);
+#else
+	return CompressLegacy(pInput, InputSize, pOutput, OutputSize);
+#endif
+}
+
+int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+{
+	const unsigned char *pSrc = (const unsigned char *)pInput;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
+	unsigned char *pDst = (unsigned char *)pOutput;
+	unsigned char *pDstEnd = pDst + OutputSize;
+
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+	uint64 Bits = 0;
+	unsigned Bitcount = 0;
+
+	while(pSrcEnd - pSrc >= 8)
+	{
+		// refill to at least 56 bits. the bits above Bitcount belong to the
+		// byte at pSrc and are loaded again at the same place next time
+		uint64 Word;
+		memcpy(&Word, pSrc, 8);
+		Bits |= Word << Bitcount;
+		pSrc += (63 - Bitcount)>>3;
+		Bitcount |= 56;
+
+		while(Bitcount >= HUFFMAN_MAXCODEBITS)
+		{
+			const CDecodeEntry *pEntry = &m_aDecodeTable[Bits&HUFFMAN_DECODEMASK];
+			Bits >>= pEntry->m_NumBits;
+			Bitcount -= pEntry->m_NumBits;
+
+			int NumSymbols = pEntry->m_NumSymbols;
+			if(NumSymbols)
+			{
+				if(pDstEnd - pDst >= HUFFMAN_DECODESYMBOLS)
+					memcpy(pDst, pEntry->m_aSymbols, HUFFMAN_DECODESYMBOLS);
+				else if(pDstEnd - pDst >= NumSymbols)
+					memcpy(pDst, pEntry->m_aSymbols, NumSymbols);
+				else
+					return -1;
+				pDst += NumSymbols;
+				continue;
+			}
+
+			// walk the tree bit by bit for long codes
+			const CNode *pNode = &m_aNodes[pEntry->m_Node];
+			while(!pNode->m_NumBits)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
+				Bits >>= 1;
+				Bitcount--;
+			}
+
+			if(pNode == pEof)
+				return (int)(pDst - (const unsigned char *)pOutput);
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+		}
+	}
+
+	// give the unused whole bytes back and decode the rest like before
+	pSrc -= Bitcount>>3;
+	Bitcount &= 7;
+	return DecompressBits((unsigned)Bits & ((1u<<Bitcount)-1), Bitcount, pSrc, pSrcEnd, pDst, pDstEnd, (const unsigned char *)pOutput);
+#else
+	return DecompressBits(0, 0, pSrc, pSrcEnd, pDst, pDstEnd, pDst);
+#endif
+}
+
+//***************************************************************
+int CHuffman::CompressLegacy(const void *pInput, int InputSize, void *pOutput, int OutputSize)
 {
 	// this macro loads a symbol for a byte into bits and bitcount
 #define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
@@ -199,17 +358,17 @@ int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int Out
 }
 
 //***************************************************************
-int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+int CHuffman::DecompressLegacy(const void *pInput, int InputSize, void *pOutput, int OutputSize)
 {
-	// setup buffer pointers
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
-	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
-
-	unsigned Bits = 0;
-	unsigned Bitcount = 0;
+	return DecompressBits(0, 0, pSrc, pSrc + InputSize, pDst, pDst + OutputSize, pDst);
+}
 
+// decodes symbol by symbol, starting with Bitcount bits already loaded into Bits
+int CHuffman::DecompressBits(unsigned Bits, unsigned Bitcount, const unsigned char *pSrc, const unsigned char *pSrcEnd,
+	unsigned char *pDst, unsigned char *pDstEnd, const unsigned char *pOutput)
+{
 	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
 	CNode *pNode = 0;
 
@@ -278,5 +437,5 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 	}
 
 	// return the size of the decompressed buffer
-	return (int)(pDst - (const unsigned char *)pOutput);
+	return (int)(pDst - pOutput);
 }
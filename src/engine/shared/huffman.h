@@ -16,7 +16,14 @@ class CHuffman
 
 		HUFFMAN_LUTBITS = 10,
 		HUFFMAN_LUTSIZE = (1<<HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1),
+
+		// the multi symbol table, codes are at most 32 bits (see CNode::m_Bits)
+		HUFFMAN_DECODEBITS = 11,
+		HUFFMAN_DECODESIZE = (1<<HUFFMAN_DECODEBITS),
+		HUFFMAN_DECODEMASK = (HUFFMAN_DECODESIZE-1),
+		HUFFMAN_DECODESYMBOLS = 4,
+		HUFFMAN_MAXCODEBITS = 32
 	};
 
 	struct CNode
@@ -32,13 +39,28 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	// all symbols that fit completely into the next HUFFMAN_DECODEBITS bits,
+	// up to the eof symbol. without symbols m_Node is either the eof symbol
+	// or the node to continue the tree walk from after m_NumBits bits
+	struct CDecodeEntry
+	{
+		unsigned char m_aSymbols[HUFFMAN_DECODESYMBOLS];
+		unsigned char m_NumSymbols;
+		unsigned char m_NumBits;
+		unsigned short m_Node;
+	};
+
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
 	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
+	CDecodeEntry m_aDecodeTable[HUFFMAN_DECODESIZE];
 
 	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
 	void ConstructTree(const unsigned *pFrequencies);
+	void BuildDecodeTable();
+	int DecompressBits(unsigned Bits, unsigned Bitcount, const unsigned char *pSrc, const unsigned char *pSrcEnd,
+		unsigned char *pDst, unsigned char *pDstEnd, const unsigned char *pOutput);
 
 public:
 	/*
@@ -87,5 +109,12 @@ public:
 	*/
 	int Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize);
 
+	/*
+		Function: CompressLegacy, DecompressLegacy
+			The symbol at a time versions of Compress and Decompress with
+			identical results, for tests and benchmarks.
+	*/
+	int CompressLegacy(const void *pInput, int InputSize, void *pOutput, int OutputSize);
+	int DecompressLegacy(const void *pInput, int InputSize, void *pOutput, int OutputSize);
 };
 #endif // __HUFFMAN_HEADER__
@@ -105,3 +105,80 @@ void CJobPool::Add(std::shared_ptr<IJob> pJob)
 	lock_unlock(m_Lock);
 	sphore_signal(&m_Semaphore);
 }
+
+CWorkerGroup::CWorkerGroup()
+{
+	m_NumThreads = 0;
+	m_Shutdown = false;
+	sphore_init(&m_WorkSemaphore);
+	sphore_init(&m_DoneSemaphore);
+	m_pfnWork = 0;
+	m_pUser = 0;
+	m_NumItems = 0;
+	m_NextItem = 0;
+}
+
+CWorkerGroup::~CWorkerGroup()
+{
+	Shutdown();
+	sphore_destroy(&m_WorkSemaphore);
+	sphore_destroy(&m_DoneSemaphore);
+}
+
+void CWorkerGroup::WorkerThread(void *pUser)
+{
+	CWorkerGroup *pGroup = (CWorkerGroup *)pUser;
+
+	while(1)
+	{
+		sphore_wait(&pGroup->m_WorkSemaphore);
+		if(pGroup->m_Shutdown)
+			break;
+		pGroup->Work();
+		sphore_signal(&pGroup->m_DoneSemaphore);
+	}
+}
+
+void CWorkerGroup::Work()
+{
+	int Index;
+	while((Index = m_NextItem++) < m_NumItems)
+		m_pfnWork(Index, m_pUser);
+}
+
+void CWorkerGroup::Init(int NumThreads)
+{
+	Shutdown();
+
+	m_Shutdown = false;
+	m_NumThreads = NumThreads > MAX_THREADS ? MAX_THREADS : NumThreads;
+	for(int i = 0; i < m_NumThreads; i++)
+		m_apThreads[i] = thread_init(WorkerThread, this, "CWorkerGroup worker");
+}
+
+void CWorkerGroup::Shutdown()
+{
+	m_Shutdown = true;
+	for(int i = 0; i < m_NumThreads; i++)
+		sphore_signal(&m_WorkSemaphore);
+	for(int i = 0; i < m_NumThreads; i++)
+	{
+		if(m_apThreads[i])
+			thread_wait(m_apThreads[i]);
+	}
+	m_NumThreads = 0;
+}
+
+void CWorkerGroup::Run(FWork pfnWork, void *pUser, int NumItems)
+{
+	m_pfnWork = pfnWork;
+	m_pUser = pUser;
+	m_NumItems = NumItems;
+	m_NextItem = 0;
+
+	for(int i = 0; i < m_NumThreads; i++)
+		sphore_signal(&m_WorkSemaphore);
+	Work();
+	for(int i = 0; i < m_NumThreads; i++)
+		sphore_wait(&m_DoneSemaphore);
+}
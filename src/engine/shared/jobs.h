@@ -60,4 +60,41 @@ public:
 	void Init(int NumThreads);
 	void Add(std::shared_ptr<IJob> pJob);
 };
+
+// runs a function for a range of indices on several threads and waits
+// until all of them are done, the calling thread helps out
+class CWorkerGroup
+{
+public:
+	typedef void (*FWork)(int Index, void *pUser);
+
+private:
+	enum
+	{
+		MAX_THREADS=32
+	};
+	int m_NumThreads;
+	void *m_apThreads[MAX_THREADS];
+	std::atomic<bool> m_Shutdown;
+
+	SEMAPHORE m_WorkSemaphore;
+	SEMAPHORE m_DoneSemaphore;
+
+	FWork m_pfnWork;
+	void *m_pUser;
+	int m_NumItems;
+	std::atomic<int> m_NextItem;
+
+	static void WorkerThread(void *pUser);
+	void Work();
+
+public:
+	CWorkerGroup();
+	~CWorkerGroup();
+
+	void Init(int NumThreads);
+	void Shutdown();
+	int NumThreads() const { return m_NumThreads; }
+	void Run(FWork pfnWork, void *pUser, int NumItems);
+};
 #endif
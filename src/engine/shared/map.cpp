@@ -58,6 +58,11 @@ public:
 	{
 		return m_DataFile.File();
 	}
+
+	virtual void SwapDataFile(CDataFileReader *pDataFile)
+	{
+		m_DataFile.Swap(pDataFile);
+	}
 };
 
 extern IEngineMap *CreateEngineMap() { return new CMap; }
@@ -3,6 +3,7 @@
 #include <engine/console.h>
 #include <engine/storage.h>
 #include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
 
 #include "netban.h"
 
@@ -44,11 +45,27 @@ int CNetBan::CNetHash::MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
 }
 
 
+template<class T, int HashCount>
+void CNetBan::CBanPool<T, HashCount>::Grow()
+{
+	// bans are never moved, so the free list is extended chunk by chunk
+	CBan<T> *pChunk = new CBan<T>[BANS_PER_CHUNK];
+	mem_zero(pChunk, sizeof(CBan<T>)*BANS_PER_CHUNK);
+	m_apChunks.push_back(pChunk);
+
+	for(int i = 0; i < BANS_PER_CHUNK; ++i)
+	{
+		pChunk[i].m_pPrev = i > 0 ? &pChunk[i-1] : 0;
+		pChunk[i].m_pNext = i < BANS_PER_CHUNK-1 ? &pChunk[i+1] : 0;
+	}
+	m_pFirstFree = pChunk;
+}
+
 template<class T, int HashCount>
 typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData, const CBanInfo *pInfo,  const CNetHash *pNetHash)
 {
 	if(!m_pFirstFree)
-		return 0;
+		Grow();
 
 	// create new ban
 	CBan<T> *pBan = m_pFirstFree;
@@ -197,25 +214,20 @@ void CNetBan::UnbanAll()
 {
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
+	m_aBanTries[0].Reset();
+	m_aBanTries[1].Reset();
 }
 
 template<class T, int HashCount>
 void CNetBan::CBanPool<T, HashCount>::Reset()
 {
 	mem_zero(m_paaHashList, sizeof(m_paaHashList));
-	mem_zero(m_aBans, sizeof(m_aBans));
+	for(unsigned i = 0; i < m_apChunks.size(); ++i)
+		delete[] m_apChunks[i];
+	m_apChunks.clear();
+	m_pFirstFree = 0;
 	m_pFirstUsed = 0;
 	m_CountUsed = 0;
-
-	for(int i = 1; i < MAX_BANS-1; ++i)
-	{
-		m_aBans[i].m_pNext = &m_aBans[i+1];
-		m_aBans[i].m_pPrev = &m_aBans[i-1];
-	}
-
-	m_aBans[0].m_pNext = &m_aBans[1];
-	m_aBans[MAX_BANS-1].m_pPrev = &m_aBans[MAX_BANS-2];
-	m_pFirstFree = &m_aBans[0];
 }
 
 template<class T, int HashCount>
@@ -234,6 +246,352 @@ typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Get(int Index) const
 }
 
 
+static inline int KeyBit(const unsigned char *pKey, int Bit)
+{
+	return (pKey[Bit>>3]>>(7-(Bit&7)))&1;
+}
+
+// whether the keys match up to Bits, the first Start bits are known to match
+static inline bool KeyMatches(const unsigned char *pKey1, const unsigned char *pKey2, int Start, int Bits)
+{
+	int i = Start>>3;
+	for(; i < Bits>>3; ++i)
+	{
+		if(pKey1[i] != pKey2[i])
+			return false;
+	}
+	return !(Bits&7) || !((pKey1[i]^pKey2[i])&(0xff00>>(Bits&7)));
+}
+
+// number of leading bits both keys share, at most MaxBits
+static int CommonBits(const unsigned char *pKey1, const unsigned char *pKey2, int Start, int MaxBits)
+{
+	for(int Bits = Start&~7; Bits < MaxBits; Bits += 8)
+	{
+		unsigned Diff = pKey1[Bits>>3]^pKey2[Bits>>3];
+		if(Diff)
+		{
+			while(!(Diff&0x80))
+			{
+				Diff <<= 1;
+				++Bits;
+			}
+			return minimum(Bits, MaxBits);
+		}
+	}
+	return MaxBits;
+}
+
+void CNetBan::CBanTrie::Reset()
+{
+	std::vector<CNode>().swap(m_aNodes);
+	std::vector<CRef>().swap(m_aRefs);
+	std::vector<CRootEntry>().swap(m_aRoot);
+	m_FirstFreeRef = -1;
+	m_NumRefs = 0;
+
+	// the root matches everything
+	unsigned char aZero[16] = {0};
+	NewNode(aZero, 0);
+}
+
+int CNetBan::CBanTrie::NewNode(const unsigned char *pKey, int Bits)
+{
+	CNode Node;
+	mem_copy(Node.m_aKey, pKey, sizeof(Node.m_aKey));
+	Node.m_Bits = Bits;
+	Node.m_aChildren[0] = Node.m_aChildren[1] = -1;
+	Node.m_FirstRef = -1;
+	m_aNodes.push_back(Node);
+	return m_aNodes.size()-1;
+}
+
+int CNetBan::CBanTrie::FindNode(const unsigned char *pPrefix, int Bits) const
+{
+	int Node = 0;
+	while(m_aNodes[Node].m_Bits < Bits)
+	{
+		int Child = m_aNodes[Node].m_aChildren[KeyBit(pPrefix, m_aNodes[Node].m_Bits)];
+		if(Child < 0 || m_aNodes[Child].m_Bits > Bits || !KeyMatches(m_aNodes[Child].m_aKey, pPrefix, m_aNodes[Node].m_Bits, m_aNodes[Child].m_Bits))
+			return -1;
+		Node = Child;
+	}
+	return Node;
+}
+
+void CNetBan::CBanTrie::Insert(const unsigned char *pPrefix, int Bits, void *pBan, bool Range)
+{
+	int Node = 0;
+	int Changed = Bits;
+	while(m_aNodes[Node].m_Bits < Bits)
+	{
+		int Side = KeyBit(pPrefix, m_aNodes[Node].m_Bits);
+		int Child = m_aNodes[Node].m_aChildren[Side];
+		if(Child < 0)
+		{
+			Child = NewNode(pPrefix, Bits);
+			m_aNodes[Node].m_aChildren[Side] = Child;
+			Node = Child;
+			break;
+		}
+
+		int Common = CommonBits(m_aNodes[Child].m_aKey, pPrefix, m_aNodes[Node].m_Bits, minimum(m_aNodes[Child].m_Bits, Bits));
+		if(Common < m_aNodes[Child].m_Bits)
+		{
+			// split the edge where the prefixes diverge
+			int Split = NewNode(pPrefix, Common);
+			m_aNodes[Split].m_aChildren[KeyBit(m_aNodes[Child].m_aKey, Common)] = Child;
+			m_aNodes[Node].m_aChildren[Side] = Split;
+			Child = Split;
+			Changed = Common;
+		}
+		Node = Child;
+	}
+
+	int Ref = m_FirstFreeRef;
+	if(Ref >= 0)
+		m_FirstFreeRef = m_aRefs[Ref].m_Next;
+	else
+	{
+		Ref = m_aRefs.size();
+		m_aRefs.push_back(CRef());
+	}
+	m_aRefs[Ref].m_pBan = pBan;
+	m_aRefs[Ref].m_Range = Range;
+	m_aRefs[Ref].m_Next = m_aNodes[Node].m_FirstRef;
+	m_aNodes[Node].m_FirstRef = Ref;
+	++m_NumRefs;
+
+	UpdateRoot(pPrefix, Changed);
+}
+
+void CNetBan::CBanTrie::Remove(const unsigned char *pPrefix, int Bits, const void *pBan)
+{
+	// empty nodes stay, CNetBan::Update rebuilds the trie once there are too many
+	int Node = FindNode(pPrefix, Bits);
+	if(Node < 0 || m_aNodes[Node].m_Bits != Bits)
+		return;
+
+	for(int *pRef = &m_aNodes[Node].m_FirstRef; *pRef >= 0; pRef = &m_aRefs[*pRef].m_Next)
+	{
+		if(m_aRefs[*pRef].m_pBan == pBan)
+		{
+			int Ref = *pRef;
+			*pRef = m_aRefs[Ref].m_Next;
+			m_aRefs[Ref].m_Next = m_FirstFreeRef;
+			m_FirstFreeRef = Ref;
+			--m_NumRefs;
+			UpdateRoot(pPrefix, Bits);
+			return;
+		}
+	}
+}
+
+void CNetBan::CBanTrie::UpdateRoot(const unsigned char *pPrefix, int Bits)
+{
+	if(m_aRoot.empty())
+	{
+		if(m_NumRefs < ROOT_MIN_REFS)
+			return;
+		m_aRoot.resize(1<<ROOT_BITS);
+		pPrefix = m_aNodes[0].m_aKey;
+		Bits = 0;
+	}
+
+	// every entry below the shallowest changed node
+	int Shift = ROOT_BITS - minimum(Bits, (int)ROOT_BITS);
+	int First = ((pPrefix[0]<<8)|pPrefix[1])>>Shift<<Shift;
+	for(int i = First; i < First+(1<<Shift); ++i)
+		UpdateRootEntry(i);
+}
+
+void CNetBan::CBanTrie::UpdateRootEntry(int Index)
+{
+	unsigned char aKey[2] = {(unsigned char)(Index>>8), (unsigned char)Index};
+	int Best = -1;
+	int Node = 0;
+	while(m_aNodes[Node].m_Bits < ROOT_BITS)
+	{
+		if(m_aNodes[Node].m_FirstRef >= 0)
+			Best = m_aNodes[Node].m_FirstRef;
+
+		int Child = m_aNodes[Node].m_aChildren[KeyBit(aKey, m_aNodes[Node].m_Bits)];
+		if(Child >= 0 && !KeyMatches(m_aNodes[Child].m_aKey, aKey, m_aNodes[Node].m_Bits, minimum(m_aNodes[Child].m_Bits, (int)ROOT_BITS)))
+			Child = -1;
+		Node = Child;
+		if(Node < 0)
+			break;
+	}
+	m_aRoot[Index].m_Node = Node;
+	m_aRoot[Index].m_BestRef = Best;
+}
+
+const void *CNetBan::CBanTrie::Find(const unsigned char *pAddr, int MaxBits, bool *pRange) const
+{
+	int Best = -1;
+	int Node = 0;
+	if(!m_aRoot.empty())
+	{
+		const CRootEntry *pEntry = &m_aRoot[(pAddr[0]<<8)|pAddr[1]];
+		Best = pEntry->m_BestRef;
+		Node = pEntry->m_Node;
+		if(Node >= 0 && !KeyMatches(m_aNodes[Node].m_aKey, pAddr, ROOT_BITS, m_aNodes[Node].m_Bits))
+			Node = -1;
+	}
+
+	// remember the deepest node with bans on the way down
+	while(Node >= 0)
+	{
+		const CNode *pNode = &m_aNodes[Node];
+		if(pNode->m_FirstRef >= 0)
+			Best = pNode->m_FirstRef;
+		if(pNode->m_Bits >= MaxBits)
+			break;
+
+		Node = pNode->m_aChildren[KeyBit(pAddr, pNode->m_Bits)];
+		if(Node >= 0 && !KeyMatches(m_aNodes[Node].m_aKey, pAddr, pNode->m_Bits, m_aNodes[Node].m_Bits))
+			Node = -1;
+	}
+
+	if(Best < 0)
+		return 0;
+	*pRange = m_aRefs[Best].m_Range;
+	return m_aRefs[Best].m_pBan;
+}
+
+
+static int TrieIndex(int Type)
+{
+	if(Type == NETTYPE_IPV4 || Type == NETTYPE_WEBSOCKET_IPV4)
+		return 0;
+	if(Type == NETTYPE_IPV6)
+		return 1;
+	return -1;
+}
+
+struct CNetPrefix
+{
+	unsigned char m_aIp[16];
+	int m_Bits;
+};
+
+// splits a range into the smallest list of prefixes covering exactly it,
+// at most 2*128 for ipv6
+static int RangeToPrefixes(const CNetRange *pRange, CNetPrefix *pPrefixes, int MaxPrefixes)
+{
+	int Length = pRange->m_LB.type == NETTYPE_IPV4 ? 4 : 16;
+	const unsigned char *pUB = pRange->m_UB.ip;
+	unsigned char aCur[16];
+	mem_copy(aCur, pRange->m_LB.ip, sizeof(aCur));
+
+	int Num = 0;
+	while(1)
+	{
+		// largest aligned block starting at the current address
+		int HostBits = 0;
+		for(int i = Length-1; i >= 0; --i)
+		{
+			if(aCur[i])
+			{
+				for(unsigned Byte = aCur[i]; !(Byte&1); Byte >>= 1)
+					++HostBits;
+				break;
+			}
+			HostBits += 8;
+		}
+
+		// shrink it until it ends within the range
+		unsigned char aLast[16];
+		while(1)
+		{
+			mem_copy(aLast, aCur, sizeof(aLast));
+			for(int i = Length-1, Bits = HostBits; Bits > 0; --i, Bits -= 8)
+				aLast[i] |= Bits >= 8 ? 0xff : (1<<Bits)-1;
+			if(mem_comp(aLast, pUB, Length) <= 0)
+				break;
+			--HostBits;
+		}
+
+		mem_copy(pPrefixes[Num].m_aIp, aCur, sizeof(aCur));
+		pPrefixes[Num].m_Bits = Length*8-HostBits;
+		++Num;
+
+		if(Num == MaxPrefixes || mem_comp(aLast, pUB, Length) == 0)
+			return Num;
+
+		// continue right after the block
+		mem_copy(aCur, aLast, sizeof(aCur));
+		for(int i = Length-1; i >= 0 && ++aCur[i] == 0; --i);
+	}
+}
+
+CNetBan::CBanAddr *CNetBan::FindBan(const NETADDR *pAddr) const
+{
+	int Index = TrieIndex(pAddr->type);
+	if(Index < 0)
+	{
+		CNetHash NetHash(pAddr);
+		return m_BanAddrPool.Find(pAddr, &NetHash);
+	}
+	return m_aBanTries[Index].FindExact(pAddr->ip, Index == 0 ? 32 : 128, false, pAddr);
+}
+
+CNetBan::CBanRange *CNetBan::FindBan(const CNetRange *pRange) const
+{
+	int Index = TrieIndex(pRange->m_LB.type);
+	if(Index < 0)
+	{
+		CNetHash NetHash(pRange);
+		return m_BanRangePool.Find(pRange, &NetHash);
+	}
+
+	// every range is stored at its first prefix
+	CNetPrefix Prefix;
+	RangeToPrefixes(pRange, &Prefix, 1);
+	return m_aBanTries[Index].FindExact(Prefix.m_aIp, Prefix.m_Bits, true, pRange);
+}
+
+void CNetBan::IndexBan(CBanAddr *pBan, bool Add)
+{
+	int Index = TrieIndex(pBan->m_Data.type);
+	if(Index < 0)
+		return;
+
+	int Bits = Index == 0 ? 32 : 128;
+	if(Add)
+		m_aBanTries[Index].Insert(pBan->m_Data.ip, Bits, pBan, false);
+	else
+		m_aBanTries[Index].Remove(pBan->m_Data.ip, Bits, pBan);
+}
+
+void CNetBan::IndexBan(CBanRange *pBan, bool Add)
+{
+	int Index = TrieIndex(pBan->m_Data.m_LB.type);
+	if(Index < 0)
+		return;
+
+	CNetPrefix aPrefixes[256];
+	int Num = RangeToPrefixes(&pBan->m_Data, aPrefixes, 256);
+	for(int i = 0; i < Num; ++i)
+	{
+		if(Add)
+			m_aBanTries[Index].Insert(aPrefixes[i].m_aIp, aPrefixes[i].m_Bits, pBan, true);
+		else
+			m_aBanTries[Index].Remove(aPrefixes[i].m_aIp, aPrefixes[i].m_Bits, pBan);
+	}
+}
+
+void CNetBan::RebuildIndex()
+{
+	m_aBanTries[0].Reset();
+	m_aBanTries[1].Reset();
+	for(CBanAddr *pBan = m_BanAddrPool.First(); pBan; pBan = pBan->m_pNext)
+		IndexBan(pBan, true);
+	for(CBanRange *pBan = m_BanRangePool.First(); pBan; pBan = pBan->m_pNext)
+		IndexBan(pBan, true);
+}
+
+
 template<class T>
 int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, const char *pReason)
 {
@@ -251,43 +609,54 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	Info.m_Expires = Stamp;
 	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
 
+	// add or adjust the ban and print result
+	bool Updated;
+	CBan<typename T::CDataType> *pBan = AddBan(pBanPool, pData, &Info, &Updated);
+	char aBuf[128];
+	MakeBanInfo(pBan, aBuf, sizeof(aBuf), Updated ? MSGTYPE_LIST : MSGTYPE_BANADD);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return Updated ? 1 : 0;
+}
+
+// CServerBan bans through these as well
+template int CNetBan::Ban(CBanAddrPool *pBanPool, const NETADDR *pData, int Seconds, const char *pReason);
+template int CNetBan::Ban(CBanRangePool *pBanPool, const CNetRange *pData, int Seconds, const char *pReason);
+
+template<class T>
+typename CNetBan::CBan<typename T::CDataType> *CNetBan::AddBan(T *pBanPool, const typename T::CDataType *pData, const CBanInfo *pInfo, bool *pUpdated)
+{
 	// check if it already exists
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = FindBan(pData);
 	if(pBan)
 	{
-		// adjust the ban
-		pBanPool->Update(pBan, &Info);
-		char aBuf[128];
-		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_LIST);
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return 1;
+		pBanPool->Update(pBan, pInfo);
+		*pUpdated = true;
+		return pBan;
 	}
 
-	// add ban and print result
-	pBan = pBanPool->Add(pData, &Info, &NetHash);
-	if(pBan)
-	{
-		char aBuf[128];
-		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return 0;
-	}
-	else
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (full banlist)");
-	return -1;
+	CNetHash NetHash(pData);
+	pBan = pBanPool->Add(pData, pInfo, &NetHash);
+	IndexBan(pBan, true);
+	*pUpdated = false;
+	return pBan;
+}
+
+template<class T>
+void CNetBan::RemoveBan(T *pBanPool, CBan<typename T::CDataType> *pBan)
+{
+	IndexBan(pBan, false);
+	pBanPool->Remove(pBan);
 }
 
 template<class T>
 int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 {
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = FindBan(pData);
 	if(pBan)
 	{
 		char aBuf[256];
 		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANREM);
-		pBanPool->Remove(pBan);
+		RemoveBan(pBanPool, pBan);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 		return 0;
 	}
@@ -302,12 +671,15 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	m_pStorage = pStorage;
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
+	m_aBanTries[0].Reset();
+	m_aBanTries[1].Reset();
 
 	net_host_lookup("localhost", &m_LocalhostIPV4, NETTYPE_IPV4);
 	net_host_lookup("localhost", &m_LocalhostIPV6, NETTYPE_IPV6);
 
 	Console()->Register("ban", "s[ip|id] ?i[minutes] r[reason]", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBan, this, "Ban ip for x minutes for any reason");
 	Console()->Register("ban_range", "s[first ip] s[last ip] ?i[minutes] r[reason]", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBanRange, this, "Ban ip range for x minutes for any reason");
+	Console()->Register("ban_file", "s[file] ?i[minutes] r[reason]", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBanFile, this, "Ban all addresses, ranges and cidr prefixes listed in a file, for life if minutes is 0");
 	Console()->Register("unban", "s[ip|entry]", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConUnban, this, "Unban ip/banlist entry");
 	Console()->Register("unban_range", "s[first ip] s[last ip]", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConUnbanRange, this, "Unban ip range");
 	Console()->Register("unban_all", "", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConUnbanAll, this, "Unban all entries");
@@ -325,13 +697,23 @@ void CNetBan::Update()
 	{
 		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanAddrPool.First()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanAddrPool.Remove(m_BanAddrPool.First());
+		RemoveBan(&m_BanAddrPool, m_BanAddrPool.First());
 	}
 	while(m_BanRangePool.First() && m_BanRangePool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanRangePool.First()->m_Info.m_Expires < Now)
 	{
 		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanRangePool.First()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanRangePool.Remove(m_BanRangePool.First());
+		RemoveBan(&m_BanRangePool, m_BanRangePool.First());
+	}
+
+	// drop the nodes left behind by removed bans once they dominate
+	for(int i = 0; i < 2; ++i)
+	{
+		if(m_aBanTries[i].NumNodes() > 4*(m_aBanTries[i].NumRefs()+256))
+		{
+			RebuildIndex();
+			break;
+		}
 	}
 }
 
@@ -365,13 +747,12 @@ int CNetBan::UnbanByRange(const CNetRange *pRange)
 
 int CNetBan::UnbanByIndex(int Index)
 {
-	int Result;
 	char aBuf[256];
 	CBanAddr *pBan = m_BanAddrPool.Get(Index);
 	if(pBan)
 	{
 		NetToString(&pBan->m_Data, aBuf, sizeof(aBuf));
-		Result = m_BanAddrPool.Remove(pBan);
+		RemoveBan(&m_BanAddrPool, pBan);
 	}
 	else
 	{
@@ -379,7 +760,7 @@ int CNetBan::UnbanByIndex(int Index)
 		if(pBan)
 		{
 			NetToString(&pBan->m_Data, aBuf, sizeof(aBuf));
-			Result = m_BanRangePool.Remove(pBan);
+			RemoveBan(&m_BanRangePool, pBan);
 		}
 		else
 		{
@@ -391,10 +772,154 @@ int CNetBan::UnbanByIndex(int Index)
 	char aMsg[256];
 	str_format(aMsg, sizeof(aMsg), "unbanned index %i (%s)", Index, aBuf);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aMsg);
-	return Result;
+	return 0;
+}
+
+static bool ParseBanAddr(const char *pStr, NETADDR *pAddr)
+{
+	// lists usually carry ipv6 addresses without brackets
+	char aBuf[128];
+	const char *pColon = str_find(pStr, ":");
+	if(pStr[0] != '[' && pColon && str_find(pColon+1, ":"))
+	{
+		str_format(aBuf, sizeof(aBuf), "[%s]", pStr);
+		pStr = aBuf;
+	}
+	if(net_addr_from_str(pAddr, pStr) != 0)
+		return false;
+	pAddr->port = 0;
+	return true;
+}
+
+static void TrimRight(char *pStr, char *pEnd)
+{
+	while(pEnd > pStr && (pEnd[-1] == ' ' || pEnd[-1] == '\t' || pEnd[-1] == '\r'))
+		--pEnd;
+	*pEnd = 0;
+}
+
+// parses "addr", "addr/bits" or "first-last", returns the number of
+// addresses given (1 or 2) or 0 if the line is invalid
+static int ParseBanLine(char *pLine, CNetRange *pRange)
+{
+	char *pSep = (char *)str_find(pLine, "/");
+	if(pSep)
+	{
+		TrimRight(pLine, pSep);
+		const char *pBits = str_skip_whitespaces(pSep+1);
+		if(!ParseBanAddr(pLine, &pRange->m_LB) || !pBits[0] || str_length(pBits) > 3 || !str_isallnum(pBits))
+			return 0;
+
+		int Length = pRange->m_LB.type == NETTYPE_IPV4 ? 4 : 16;
+		int HostBits = Length*8 - str_toint(pBits);
+		if(HostBits < 0)
+			return 0;
+
+		pRange->m_UB = pRange->m_LB;
+		for(int i = Length-1, Bits = HostBits; Bits > 0 && i >= 0; --i, Bits -= 8)
+		{
+			unsigned char Mask = Bits >= 8 ? 0xff : (1<<Bits)-1;
+			pRange->m_LB.ip[i] &= ~Mask;
+			pRange->m_UB.ip[i] |= Mask;
+		}
+		return HostBits == 0 ? 1 : 2;
+	}
+
+	pSep = (char *)str_find(pLine, "-");
+	if(pSep)
+	{
+		TrimRight(pLine, pSep);
+		if(!ParseBanAddr(pLine, &pRange->m_LB) || !ParseBanAddr(str_skip_whitespaces(pSep+1), &pRange->m_UB))
+			return 0;
+		if(NetComp(&pRange->m_LB, &pRange->m_UB) == 0)
+			return 1;
+		return pRange->IsValid() ? 2 : 0;
+	}
+
+	return ParseBanAddr(pLine, &pRange->m_LB) ? 1 : 0;
+}
+
+int CNetBan::ImportBans(IOHANDLE File, int Seconds, const char *pReason, int *pNumInvalid)
+{
+	// all entries share one stamp, which also keeps inserting them into
+	// the sorted used list cheap
+	CBanInfo Info = {0};
+	Info.m_Expires = Seconds > 0 ? time_timestamp()+Seconds : CBanInfo::EXPIRES_NEVER;
+	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
+
+	CLineReader LineReader;
+	LineReader.Init(File);
+	int NumAdded = 0;
+	*pNumInvalid = 0;
+	while(char *pLine = LineReader.Get())
+	{
+		// strip comments and surrounding whitespace
+		pLine = str_skip_whitespaces(pLine);
+		char *pComment = (char *)str_find(pLine, "#");
+		TrimRight(pLine, pComment ? pComment : pLine + str_length(pLine));
+		if(!pLine[0])
+			continue;
+
+		CNetRange Range;
+		int Num = ParseBanLine(pLine, &Range);
+		bool Localhost = Num == 1 ? NetMatch(&Range.m_LB, &m_LocalhostIPV4) || NetMatch(&Range.m_LB, &m_LocalhostIPV6) :
+			Num == 2 && (NetMatch(&Range, &m_LocalhostIPV4) || NetMatch(&Range, &m_LocalhostIPV6));
+		if(Num == 0 || Localhost)
+		{
+			++*pNumInvalid;
+			continue;
+		}
+
+		bool Updated;
+		if(Num == 1)
+			AddBan(&m_BanAddrPool, &Range.m_LB, &Info, &Updated);
+		else
+			AddBan(&m_BanRangePool, &Range, &Info, &Updated);
+		if(!Updated)
+			++NumAdded;
+	}
+	return NumAdded;
+}
+
+int CNetBan::BanFile(const char *pFilename, int Seconds, const char *pReason)
+{
+	char aBuf[256];
+	IOHANDLE File = Storage()->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to open banlist '%s'", pFilename);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+		return -1;
+	}
+
+	int NumInvalid;
+	int NumAdded = ImportBans(File, Seconds, pReason, &NumInvalid);
+	io_close(File);
+
+	str_format(aBuf, sizeof(aBuf), "added %d bans from '%s' (%d invalid or local entries skipped)", NumAdded, pFilename, NumInvalid);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return NumAdded;
+}
+
+bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const
+{
+	int Index = TrieIndex(pAddr->type);
+	if(Index < 0)
+		return false;
+
+	bool Range;
+	const void *pBan = m_aBanTries[Index].Find(pAddr->ip, Index == 0 ? 32 : 128, &Range);
+	if(!pBan)
+		return false;
+
+	if(Range)
+		MakeBanInfo((const CBanRange *)pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
+	else
+		MakeBanInfo((const CBanAddr *)pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
+	return true;
 }
 
-bool CNetBan::IsBanned(const NETADDR *pOrigAddr, char *pBuf, unsigned BufferSize) const
+bool CNetBan::IsBannedLegacy(const NETADDR *pOrigAddr, char *pBuf, unsigned BufferSize) const
 {
 	NETADDR addr;
 	const NETADDR *pAddr = pOrigAddr;
@@ -461,6 +986,15 @@ void CNetBan::ConBanRange(IConsole::IResult *pResult, void *pUser)
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban error (invalid range)");
 }
 
+void CNetBan::ConBanFile(IConsole::IResult *pResult, void *pUser)
+{
+	CNetBan *pThis = static_cast<CNetBan *>(pUser);
+
+	int Minutes = pResult->NumArguments()>1 ? clamp(pResult->GetInteger(1), 0, 44640) : 0;
+	const char *pReason = pResult->NumArguments()>2 ? pResult->GetString(2) : "No reason given";
+	pThis->BanFile(pResult->GetString(0), Minutes*60, pReason);
+}
+
 void CNetBan::ConUnban(IConsole::IResult *pResult, void *pUser)
 {
 	CNetBan *pThis = static_cast<CNetBan *>(pUser);
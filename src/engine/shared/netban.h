@@ -3,6 +3,8 @@
 
 #include <base/system.h>
 
+#include <vector>
+
 inline int NetComp(const NETADDR *pAddr1, const NETADDR *pAddr2)
 {
 	return mem_comp(pAddr1, pAddr2, pAddr1->type==NETTYPE_IPV4 ? 8 : 20);
@@ -102,13 +104,19 @@ protected:
 	public:
 		typedef T CDataType;
 
+		CBanPool() : m_pFirstFree(0), m_pFirstUsed(0), m_CountUsed(0) { mem_zero(m_paaHashList, sizeof(m_paaHashList)); }
+		~CBanPool()
+		{
+			for(unsigned i = 0; i < m_apChunks.size(); ++i)
+				delete[] m_apChunks[i];
+		}
+
 		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo, const CNetHash *pNetHash);
 		int Remove(CBan<CDataType> *pBan);
 		void Update(CBan<CDataType> *pBan, const CBanInfo *pInfo);
 		void Reset();
 
 		int Num() const { return m_CountUsed; }
-		bool IsFull() const { return m_CountUsed == MAX_BANS; }
 
 		CBan<CDataType> *First() const { return m_pFirstUsed; }
 		CBan<CDataType> *First(const CNetHash *pNetHash) const { return m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; }
@@ -127,11 +135,13 @@ protected:
 	private:
 		enum
 		{
-			MAX_BANS=1024,
+			BANS_PER_CHUNK=1024,
 		};
 
+		void Grow();
+
 		CBan<CDataType> *m_paaHashList[HashCount][256];
-		CBan<CDataType> m_aBans[MAX_BANS];
+		std::vector<CBan<CDataType> *> m_apChunks;
 		CBan<CDataType> *m_pFirstFree;
 		CBan<CDataType> *m_pFirstUsed;
 		int m_CountUsed;
@@ -142,14 +152,89 @@ protected:
 	typedef CBan<NETADDR> CBanAddr;
 	typedef CBan<CNetRange> CBanRange;
 
+	// path compressed binary trie for longest prefix matches, every node
+	// keeps the bans that cover its whole prefix. large tries get a table
+	// indexed by the first 16 bits to skip the top levels
+	class CBanTrie
+	{
+	public:
+		void Reset();
+		void Insert(const unsigned char *pPrefix, int Bits, void *pBan, bool Range);
+		void Remove(const unsigned char *pPrefix, int Bits, const void *pBan);
+		const void *Find(const unsigned char *pAddr, int MaxBits, bool *pRange) const;
+
+		template<class T> CBan<T> *FindExact(const unsigned char *pPrefix, int Bits, bool Range, const T *pData) const
+		{
+			int Node = FindNode(pPrefix, Bits);
+			for(int Ref = Node < 0 ? -1 : m_aNodes[Node].m_FirstRef; Ref >= 0; Ref = m_aRefs[Ref].m_Next)
+			{
+				CBan<T> *pBan = (CBan<T> *)m_aRefs[Ref].m_pBan;
+				if(m_aRefs[Ref].m_Range == Range && NetComp(&pBan->m_Data, pData) == 0)
+					return pBan;
+			}
+			return 0;
+		}
+
+		int NumNodes() const { return m_aNodes.size(); }
+		int NumRefs() const { return m_NumRefs; }
+
+	private:
+		enum
+		{
+			ROOT_BITS=16,
+			ROOT_MIN_REFS=1024,
+		};
+
+		struct CNode
+		{
+			unsigned char m_aKey[16];
+			int m_Bits;
+			int m_aChildren[2];
+			int m_FirstRef;
+		};
+
+		struct CRef
+		{
+			void *m_pBan;
+			bool m_Range;
+			int m_Next;
+		};
+
+		struct CRootEntry
+		{
+			int m_Node; // first node with at least ROOT_BITS bits on the path
+			int m_BestRef; // deepest bans above it
+		};
+
+		int NewNode(const unsigned char *pKey, int Bits);
+		int FindNode(const unsigned char *pPrefix, int Bits) const;
+		void UpdateRoot(const unsigned char *pPrefix, int Bits);
+		void UpdateRootEntry(int Index);
+
+		std::vector<CNode> m_aNodes;
+		std::vector<CRef> m_aRefs;
+		std::vector<CRootEntry> m_aRoot;
+		int m_FirstFreeRef;
+		int m_NumRefs;
+	};
+
 	template<class T> void MakeBanInfo(const CBan<T> *pBan, char *pBuf, unsigned BuffSize, int Type) const;
 	template<class T> int Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, const char *pReason);
 	template<class T> int Unban(T *pBanPool, const typename T::CDataType *pData);
+	template<class T> CBan<typename T::CDataType> *AddBan(T *pBanPool, const typename T::CDataType *pData, const CBanInfo *pInfo, bool *pUpdated);
+	template<class T> void RemoveBan(T *pBanPool, CBan<typename T::CDataType> *pBan);
+
+	CBanAddr *FindBan(const NETADDR *pAddr) const;
+	CBanRange *FindBan(const CNetRange *pRange) const;
+	void IndexBan(CBanAddr *pBan, bool Add);
+	void IndexBan(CBanRange *pBan, bool Add);
+	void RebuildIndex();
 
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
 	CBanAddrPool m_BanAddrPool;
 	CBanRangePool m_BanRangePool;
+	CBanTrie m_aBanTries[2]; // ipv4, ipv6
 	NETADDR m_LocalhostIPV4, m_LocalhostIPV6;
 
 public:
@@ -174,10 +259,14 @@ public:
 	int UnbanByRange(const CNetRange *pRange);
 	int UnbanByIndex(int Index);
 	void UnbanAll();
+	int ImportBans(IOHANDLE File, int Seconds, const char *pReason, int *pNumInvalid);
+	virtual int BanFile(const char *pFilename, int Seconds, const char *pReason);
 	bool IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const;
+	bool IsBannedLegacy(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const;
 
 	static void ConBan(class IConsole::IResult *pResult, void *pUser);
 	static void ConBanRange(class IConsole::IResult *pResult, void *pUser);
+	static void ConBanFile(class IConsole::IResult *pResult, void *pUser);
 	static void ConUnban(class IConsole::IResult *pResult, void *pUser);
 	static void ConUnbanRange(class IConsole::IResult *pResult, void *pUser);
 	static void ConUnbanAll(class IConsole::IResult *pResult, void *pUser);
@@ -90,6 +90,16 @@ int CNetRecvUnpacker::FetchChunk(CNetChunk *pChunk)
 	}
 }
 
+void CNetBase::SendRaw(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize)
+{
+	if(ms_pfnSendRaw)
+		ms_pfnSendRaw(pAddr, pData, DataSize, ms_pSendRawUser);
+	else if(ms_pSendQueue)
+		net_udp_send_batched(Socket, pAddr, pData, DataSize, ms_pSendQueue);
+	else
+		net_udp_send(Socket, pAddr, pData, DataSize);
+}
+
 static const unsigned char NET_HEADER_EXTENDED[] = {'x', 'e'};
 // packs the data tight and sends it
 void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize, bool Extended, unsigned char aExtra[4])
@@ -107,7 +117,7 @@ void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *
 		mem_copy(aBuffer + sizeof(NET_HEADER_EXTENDED), aExtra, 4);
 	}
 	mem_copy(aBuffer + DATA_OFFSET, pData, DataSize);
-	net_udp_send(Socket, pAddr, aBuffer, DataSize + DATA_OFFSET);
+	SendRaw(Socket, pAddr, aBuffer, DataSize + DATA_OFFSET);
 }
 
 void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken)
@@ -160,7 +170,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 		aBuffer[0] = ((pPacket->m_Flags<<4)&0xf0)|((pPacket->m_Ack>>8)&0xf);
 		aBuffer[1] = pPacket->m_Ack&0xff;
 		aBuffer[2] = pPacket->m_NumChunks;
-		net_udp_send(Socket, pAddr, aBuffer, FinalSize);
+		SendRaw(Socket, pAddr, aBuffer, FinalSize);
 
 		// log raw socket data
 		if(ms_DataLogSent)
@@ -324,6 +334,9 @@ int CNetBase::IsSeqInBackroom(int Seq, int Ack)
 IOHANDLE CNetBase::ms_DataLogSent = 0;
 IOHANDLE CNetBase::ms_DataLogRecv = 0;
 CHuffman CNetBase::ms_Huffman;
+thread_local MMSGS *CNetBase::ms_pSendQueue = 0;
+thread_local NETFUNC_SENDRAW CNetBase::ms_pfnSendRaw = 0;
+thread_local void *CNetBase::ms_pSendRawUser = 0;
 
 
 void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
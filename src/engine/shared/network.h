@@ -5,6 +5,7 @@
 
 #include "ringbuffer.h"
 #include "huffman.h"
+#include "protocol.h"
 
 #include <base/math.h>
 
@@ -35,6 +36,7 @@ enum
 	NETSENDFLAG_CONNLESS=2,
 	NETSENDFLAG_FLUSH=4,
 	NETSENDFLAG_EXTENDED=8,
+	NETSENDFLAG_PRIORITY=16,
 
 	NETSTATE_OFFLINE=0,
 	NETSTATE_CONNECTING,
@@ -53,7 +55,7 @@ enum
 	NET_MAX_PAYLOAD = NET_MAX_PACKETSIZE-6,
 	NET_MAX_CHUNKHEADERSIZE = 5,
 	NET_PACKETHEADERSIZE = 3,
-	NET_MAX_CLIENTS = 64,
+	NET_MAX_CLIENTS = CONF_MAX_CLIENTS,
 	NET_MAX_CONSOLE_CLIENTS = 4,
 	NET_MAX_SEQUENCE = 1<<10,
 	NET_SEQUENCE_MASK = NET_MAX_SEQUENCE-1,
@@ -84,8 +86,6 @@ enum
 
 	NET_CONN_BUFFERSIZE=1024*32,
 
-	NET_CONNLIMIT_IPS=16,
-
 	NET_ENUM_TERMINATOR
 };
 
@@ -105,6 +105,7 @@ typedef int (*NETFUNC_DELCLIENT)(int ClientID, const char *pReason, void *pUser)
 typedef int (*NETFUNC_NEWCLIENT)(int ClientID, void *pUser);
 typedef int (*NETFUNC_NEWCLIENT_NOAUTH)(int ClientID, void *pUser);
 typedef int (*NETFUNC_CLIENTREJOIN)(int ClientID, void *pUser);
+typedef void (*NETFUNC_SENDRAW)(const NETADDR *pAddr, const void *pData, int DataSize, void *pUser);
 
 struct CNetChunk
 {
@@ -182,6 +183,27 @@ private:
 
 	CNetPacketConstruct m_Construct;
 
+	// when coalescing, chunks wait here until the next flush packs them
+	// into as few packets as possible, priority chunks first
+	enum
+	{
+		MAX_PENDING_CHUNKS=256,
+		PENDING_BUFFER_SIZE=NET_MAX_PAYLOAD*8,
+	};
+	struct CPendingChunk
+	{
+		short m_Offset;
+		short m_Size;
+		bool m_Priority;
+	};
+	bool m_Coalesce;
+	bool m_FlushRequested;
+	int m_NumPendingChunks;
+	int m_PendingDataSize;
+	CPendingChunk m_aPendingChunks[MAX_PENDING_CHUNKS];
+	unsigned char m_aPendingData[PENDING_BUFFER_SIZE];
+	int m_NumSentPackets;
+
 	NETADDR m_PeerAddr;
 	NETSOCKET m_Socket;
 	NETSTATS m_Stats;
@@ -191,7 +213,9 @@ private:
 	void SetError(const char *pString);
 	void AckChunks(int Ack);
 
-	int QueueChunkEx(int Flags, int DataSize, const void *pData, int Sequence);
+	int QueueChunkEx(int Flags, int DataSize, const void *pData, int Sequence, bool Priority=false);
+	void AddPendingChunk(const CNetChunkHeader *pHeader, const void *pData, bool Priority);
+	int FlushPending();
 	void SendControl(int ControlMsg, const void *pExtra, int ExtraSize);
 	void ResendChunk(CNetChunkResend *pResend);
 	void Resend();
@@ -212,6 +236,11 @@ public:
 
 	int Feed(CNetPacketConstruct *pPacket, NETADDR *pAddr, SECURITY_TOKEN SecurityToken = NET_SECURITY_TOKEN_UNSUPPORTED);
 	int QueueChunk(int Flags, int DataSize, const void *pData);
+	int QueuePriorityChunk(int DataSize, const void *pData);
+	void SetCoalesce(bool Coalesce);
+	void RequestFlush() { m_FlushRequested = true; }
+	bool FlushRequested() const { return m_FlushRequested; }
+	int NumSentPackets() const { return m_NumSentPackets; }
 
 	const char *ErrorString();
 	void SignalResend();
@@ -291,6 +320,57 @@ public:
 	int FetchChunk(CNetChunk *pChunk);
 };
 
+// token buckets for connection attempts per address and per /24 (ipv4)
+// or /48 (ipv6) network, in a fixed size open addressing table. a bucket
+// is stored as the time at which it will be full again
+class CNetConnLimiter
+{
+public:
+	enum
+	{
+		TABLE_SIZE=8192,
+		MAX_PROBES=8,
+	};
+
+	void Reset();
+
+	// charges an attempt to the address and its network if both have
+	// one left, Burst and NetworkBurst attempts refill over Seconds and
+	// 0 disables the respective limit
+	bool Allow(const NETADDR *pAddr, int64 Now, int Burst, int NetworkBurst, int Seconds);
+
+	int NumAllowed() const { return m_NumAllowed; }
+	int NumDropped() const { return m_NumDropped; }
+	int NumDroppedNetwork() const { return m_NumDroppedNetwork; }
+	int NumEvicted() const { return m_NumEvicted; }
+
+private:
+	enum
+	{
+		KIND_UNUSED=0,
+		KIND_ADDR_IPV4,
+		KIND_ADDR_IPV6,
+		KIND_NETWORK_IPV4,
+		KIND_NETWORK_IPV6,
+	};
+
+	struct CEntry
+	{
+		unsigned char m_aKey[16];
+		int m_Kind;
+		int64 m_Full;
+	};
+
+	CEntry *Lookup(const unsigned char *pKey, int Kind, int64 Now, const CEntry *pKeep);
+
+	CEntry m_aEntries[TABLE_SIZE];
+	unsigned m_Seed;
+	int m_NumAllowed;
+	int m_NumDropped;
+	int m_NumDroppedNetwork;
+	int m_NumEvicted;
+};
+
 // server side
 class CNetServer
 {
@@ -298,19 +378,37 @@ class CNetServer
 	{
 	public:
 		CNetConnection m_Connection;
+
+		// kept by the network thread, which owns the connections while
+		// it runs
+		int m_Generation;
+		int m_ReportedState;
+		bool m_ReportedSituation;
 	};
 
-	struct CSpamConn
+	// what the main thread knows about the connections while the network
+	// thread runs. the generation changes with every new connection in
+	// the slot, so that nothing of an earlier one is mixed in
+	struct CSlotInfo
 	{
+		int m_State;
 		NETADDR m_Addr;
-		int64 m_Time;
-		int m_Conns;
+		SECURITY_TOKEN m_SecurityToken;
+		bool m_TimeoutProtected;
+		bool m_TimeoutSituation;
+		int m_Generation;
+		char m_aErrorString[256];
 	};
 
 	NETSOCKET m_Socket;
 	MMSGS m_MMSGS;
+	MMSGS m_SendMMSGS;
+	bool m_SendBatching;
+	bool m_CoalesceSends;
+	class CNetThread *m_pNetThread;
 	class CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CLIENTS];
+	CSlotInfo m_aSlotInfos[NET_MAX_CLIENTS];
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
 
@@ -329,7 +427,7 @@ class CNetServer
 	int64 m_VConnFirst;
 	int m_VConnNum;
 
-	CSpamConn m_aSpamConns[NET_CONNLIMIT_IPS];
+	CNetConnLimiter m_ConnLimiter;
 
 	CNetRecvUnpacker m_RecvUnpacker;
 
@@ -342,10 +440,33 @@ class CNetServer
 
 	int TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, bool VanillaAuth=false);
 	int NumClientsWithAddr(NETADDR Addr);
-	bool Connlimit(NETADDR Addr);
+	bool Connlimit(NETADDR &Addr, SECURITY_TOKEN SecurityToken);
 	void SendMsgs(NETADDR &Addr, const CMsgPacker *Msgs[], int num);
 
+	// the connection state as seen from the main thread
+	int SlotState(int ClientID) const { return m_pNetThread ? m_aSlotInfos[ClientID].m_State : m_aSlots[ClientID].m_Connection.State(); }
+	bool SlotDroppable(int ClientID) const;
+	void ResetSlotInfo(int ClientID, int State);
+
+	int ProcessPacket(NETADDR &Addr, unsigned char *pData, int Bytes, CNetChunk *pChunk);
+	int SendChunk(int ClientID, int Flags, int DataSize, const void *pData, bool Coalesce);
+	void FlushSlots(bool Coalesce);
+
+	// the network thread's side
+	static void NetThread(void *pUser);
+	static void SendRawCommand(const NETADDR *pAddr, const void *pData, int DataSize, void *pUser);
+	struct CNetCommand *NewCommand(int Type);
+	void PushCommand();
+	struct CNetEvent *NewEvent(int Type, int ClientID);
+	void PushEvent();
+	int FindConnection(const NETADDR &Addr);
+	void ThreadPacket(NETADDR &Addr, unsigned char *pData, int Bytes, bool Forwarded);
+	void ThreadCommand(struct CNetCommand *pCommand);
+	void ThreadUpdate();
+
 public:
+	CNetServer() : m_SendBatching(false), m_CoalesceSends(false), m_pNetThread(0) { net_init_mmsgs(&m_SendMMSGS); }
+
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_NEWCLIENT_NOAUTH pfnNewClientNoAuth, NETFUNC_CLIENTREJOIN pfnClientRejoin, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
@@ -358,6 +479,26 @@ public:
 	int Send(CNetChunk *pChunk);
 	int Update();
 
+	// when coalescing, the flushes requested while a tick is processed
+	// are done together by FlushConnections
+	void SetCoalesceSends(bool Enable);
+	void FlushConnections();
+	int NumSentPackets() const;
+
+	// batched sending, queued packets go out with FlushSends
+	void SetSendBatching(bool Enable);
+	void FlushSends();
+
+	// network thread, owns the connections and the socket while it runs.
+	// the main thread gets the received chunks and sends through it
+	bool StartNetThread();
+	void StopNetThread();
+	bool NetThreadRunning() const { return m_pNetThread != 0; }
+	int NetThreadDroppedPackets() const;
+	void Wait(int Microseconds);
+
+	const CNetConnLimiter *ConnLimiter() const { return &m_ConnLimiter; }
+
 	//
 	int Drop(int ClientID, const char *pReason);
 
@@ -365,8 +506,8 @@ public:
 	void DummyInit(int DummyID);
 	void DummyDelete(int DummyID);
 	// status requests
-	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
-	bool HasSecurityToken(int ClientID) const { return m_aSlots[ClientID].m_Connection.SecurityToken() != NET_SECURITY_TOKEN_UNSUPPORTED; }
+	const NETADDR *ClientAddr(int ClientID) const { return m_pNetThread ? &m_aSlotInfos[ClientID].m_Addr : m_aSlots[ClientID].m_Connection.PeerAddress(); }
+	bool HasSecurityToken(int ClientID) const { return (m_pNetThread ? m_aSlotInfos[ClientID].m_SecurityToken : m_aSlots[ClientID].m_Connection.SecurityToken()) != NET_SECURITY_TOKEN_UNSUPPORTED; }
 	NETSOCKET Socket() const { return m_Socket; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
 	int NetType() const { return m_Socket.type; }
@@ -469,9 +610,18 @@ class CNetBase
 	static IOHANDLE ms_DataLogSent;
 	static IOHANDLE ms_DataLogRecv;
 	static CHuffman ms_Huffman;
+	// per thread, the network thread of the server sends for the others
+	static thread_local MMSGS *ms_pSendQueue;
+	static thread_local NETFUNC_SENDRAW ms_pfnSendRaw;
+	static thread_local void *ms_pSendRawUser;
+
+	static void SendRaw(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize);
 public:
 	static void OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv);
 	static void CloseLog();
+	static void SetSendQueue(MMSGS *pSendQueue) { ms_pSendQueue = pSendQueue; }
+	// hands the packets of the calling thread to pfnSendRaw instead of the socket
+	static void SetSendRaw(NETFUNC_SENDRAW pfnSendRaw, void *pUser) { ms_pfnSendRaw = pfnSendRaw; ms_pSendRawUser = pUser; }
 	static void Init();
 	static int Compress(const void *pData, int DataSize, void *pOutput, int OutputSize);
 	static int Decompress(const void *pData, int DataSize, void *pOutput, int OutputSize);
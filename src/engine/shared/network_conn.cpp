@@ -43,6 +43,9 @@ void CNetConnection::Reset(bool Rejoin)
 	m_Buffer.Init();
 
 	mem_zero(&m_Construct, sizeof(m_Construct));
+	m_FlushRequested = false;
+	m_NumPendingChunks = 0;
+	m_PendingDataSize = 0;
 }
 
 const char *CNetConnection::ErrorString()
@@ -59,6 +62,8 @@ void CNetConnection::Init(NETSOCKET Socket, bool BlockCloseMsg)
 {
 	Reset();
 	ResetStats();
+	m_Coalesce = false;
+	m_NumSentPackets = 0;
 
 	m_Socket = Socket;
 	m_BlockCloseMsg = BlockCloseMsg;
@@ -87,6 +92,9 @@ void CNetConnection::SignalResend()
 
 int CNetConnection::Flush()
 {
+	if(m_NumPendingChunks)
+		return FlushPending();
+
 	int NumChunks = m_Construct.m_NumChunks;
 	if(!NumChunks && !m_Construct.m_Flags)
 		return 0;
@@ -94,39 +102,127 @@ int CNetConnection::Flush()
 	// send of the packets
 	m_Construct.m_Ack = m_Ack;
 	CNetBase::SendPacket(m_Socket, &m_PeerAddr, &m_Construct, m_SecurityToken);
+	m_NumSentPackets++;
 
 	// update send times
 	m_LastSendTime = time_get();
 
 	// clear construct so we can start building a new package
 	mem_zero(&m_Construct, sizeof(m_Construct));
+	m_FlushRequested = false;
 	return NumChunks;
 }
 
-int CNetConnection::QueueChunkEx(int Flags, int DataSize, const void *pData, int Sequence)
+void CNetConnection::SetCoalesce(bool Coalesce)
 {
-	if (m_State == NET_CONNSTATE_OFFLINE || m_State == NET_CONNSTATE_ERROR)
-		return -1;
-
-	unsigned char *pChunkData;
+	if(Coalesce == m_Coalesce)
+		return;
+	Flush();
+	m_Coalesce = Coalesce;
+}
 
-	// check if we have space for it, if not, flush the connection
-	if(m_Construct.m_DataSize + DataSize + NET_MAX_CHUNKHEADERSIZE > (int)sizeof(m_Construct.m_aChunkData) - (int)sizeof(SECURITY_TOKEN))
+void CNetConnection::AddPendingChunk(const CNetChunkHeader *pHeader, const void *pData, bool Priority)
+{
+	if(m_NumPendingChunks == MAX_PENDING_CHUNKS || m_PendingDataSize + pHeader->m_Size + NET_MAX_CHUNKHEADERSIZE > PENDING_BUFFER_SIZE)
 		Flush();
 
+	unsigned char *pChunkData = &m_aPendingData[m_PendingDataSize];
+	pChunkData = CNetChunkHeader(*pHeader).Pack(pChunkData);
+	mem_copy(pChunkData, pData, pHeader->m_Size);
+	pChunkData += pHeader->m_Size;
+
+	CPendingChunk *pChunk = &m_aPendingChunks[m_NumPendingChunks++];
+	pChunk->m_Offset = m_PendingDataSize;
+	pChunk->m_Size = (int)(pChunkData - m_aPendingData) - m_PendingDataSize;
+	pChunk->m_Priority = Priority;
+	m_PendingDataSize += pChunk->m_Size;
+}
+
+int CNetConnection::FlushPending()
+{
+	// the priority chunks (snapshot parts) each go into the first packet
+	// with room for them. the others follow in the order they were queued,
+	// never into an earlier packet than the chunk before them, so that
+	// vital chunks arrive in sequence
+	const int MaxSize = (int)sizeof(m_Construct.m_aChunkData) - (int)sizeof(SECURITY_TOKEN);
+	int aPacketSizes[MAX_PENDING_CHUNKS];
+	int aChunkPackets[MAX_PENDING_CHUNKS];
+	int NumPackets = 0;
+	for(int Priority = 1; Priority >= 0; Priority--)
+	{
+		int First = 0;
+		for(int i = 0; i < m_NumPendingChunks; i++)
+		{
+			if(m_aPendingChunks[i].m_Priority != (bool)Priority)
+				continue;
+			int Packet = First;
+			while(Packet < NumPackets && aPacketSizes[Packet] + m_aPendingChunks[i].m_Size > MaxSize)
+				Packet++;
+			if(Packet == NumPackets)
+				aPacketSizes[NumPackets++] = 0;
+			aPacketSizes[Packet] += m_aPendingChunks[i].m_Size;
+			aChunkPackets[i] = Packet;
+			if(!Priority)
+				First = Packet;
+		}
+	}
+
+	int NumChunks = m_NumPendingChunks;
+	for(int Packet = 0; Packet < NumPackets; Packet++)
+	{
+		for(int Priority = 1; Priority >= 0; Priority--)
+		{
+			for(int i = 0; i < m_NumPendingChunks; i++)
+			{
+				if(aChunkPackets[i] != Packet || m_aPendingChunks[i].m_Priority != (bool)Priority)
+					continue;
+				mem_copy(&m_Construct.m_aChunkData[m_Construct.m_DataSize], &m_aPendingData[m_aPendingChunks[i].m_Offset], m_aPendingChunks[i].m_Size);
+				m_Construct.m_DataSize += m_aPendingChunks[i].m_Size;
+				m_Construct.m_NumChunks++;
+			}
+		}
+
+		m_Construct.m_Ack = m_Ack;
+		CNetBase::SendPacket(m_Socket, &m_PeerAddr, &m_Construct, m_SecurityToken);
+		m_NumSentPackets++;
+		mem_zero(&m_Construct, sizeof(m_Construct));
+	}
+
+	m_LastSendTime = time_get();
+	m_NumPendingChunks = 0;
+	m_PendingDataSize = 0;
+	m_FlushRequested = false;
+	return NumChunks;
+}
+
+int CNetConnection::QueueChunkEx(int Flags, int DataSize, const void *pData, int Sequence, bool Priority)
+{
+	if (m_State == NET_CONNSTATE_OFFLINE || m_State == NET_CONNSTATE_ERROR)
+		return -1;
+
 	// pack all the data
 	CNetChunkHeader Header;
 	Header.m_Flags = Flags;
 	Header.m_Size = DataSize;
 	Header.m_Sequence = Sequence;
-	pChunkData = &m_Construct.m_aChunkData[m_Construct.m_DataSize];
-	pChunkData = Header.Pack(pChunkData);
-	mem_copy(pChunkData, pData, DataSize);
-	pChunkData += DataSize;
 
-	//
-	m_Construct.m_NumChunks++;
-	m_Construct.m_DataSize = (int)(pChunkData-m_Construct.m_aChunkData);
+	if(m_Coalesce)
+		AddPendingChunk(&Header, pData, Priority);
+	else
+	{
+		// check if we have space for it, if not, flush the connection
+		if(m_Construct.m_DataSize + DataSize + NET_MAX_CHUNKHEADERSIZE > (int)sizeof(m_Construct.m_aChunkData) - (int)sizeof(SECURITY_TOKEN))
+			Flush();
+
+		unsigned char *pChunkData = &m_Construct.m_aChunkData[m_Construct.m_DataSize];
+		pChunkData = Header.Pack(pChunkData);
+		mem_copy(pChunkData, pData, DataSize);
+		pChunkData += DataSize;
+
+		//
+		m_Construct.m_NumChunks++;
+		m_Construct.m_DataSize = (int)(pChunkData-m_Construct.m_aChunkData);
+	}
 
 	// set packet flags as well
 
@@ -161,9 +257,15 @@ int CNetConnection::QueueChunk(int Flags, int DataSize, const void *pData)
 	return QueueChunkEx(Flags, DataSize, pData, m_Sequence);
 }
 
+int CNetConnection::QueuePriorityChunk(int DataSize, const void *pData)
+{
+	return QueueChunkEx(0, DataSize, pData, m_Sequence, true);
+}
+
 void CNetConnection::SendControl(int ControlMsg, const void *pExtra, int ExtraSize)
 {
 	// send the control message
+	m_NumSentPackets++;
 	m_LastSendTime = time_get();
 	CNetBase::SendControlMsg(m_Socket, &m_PeerAddr, m_Ack, ControlMsg, pExtra, ExtraSize, m_SecurityToken);
 }
@@ -201,6 +303,10 @@ void CNetConnection::Disconnect(const char *pReason)
 
 	if(m_RemoteClosed == 0)
 	{
+		// don't lose messages that were meant to go out before the close
+		if(m_FlushRequested)
+			Flush();
+
 		if(!m_TimeoutSituation)
 		{
 			if(pReason)
@@ -0,0 +1,109 @@
+#include <base/math.h>
+#include <base/system.h>
+#include "network.h"
+
+static unsigned HashKey(const unsigned char *pKey, int Kind, unsigned Seed)
+{
+	// seeded so that clients can't pick addresses that collide
+	unsigned Hash = Seed ^ (Kind * 0x9e3779b9u);
+	for(int i = 0; i < 16; i += 4)
+	{
+		Hash ^= pKey[i] | (pKey[i+1] << 8) | (pKey[i+2] << 16) | ((unsigned)pKey[i+3] << 24);
+		Hash *= 0x85ebca6bu;
+		Hash ^= Hash >> 13;
+	}
+	Hash *= 0xc2b2ae35u;
+	return Hash ^ (Hash >> 16);
+}
+
+void CNetConnLimiter::Reset()
+{
+	mem_zero(m_aEntries, sizeof(m_aEntries));
+	secure_random_fill(&m_Seed, sizeof(m_Seed));
+	m_NumAllowed = 0;
+	m_NumDropped = 0;
+	m_NumDroppedNetwork = 0;
+	m_NumEvicted = 0;
+}
+
+CNetConnLimiter::CEntry *CNetConnLimiter::Lookup(const unsigned char *pKey, int Kind, int64 Now, const CEntry *pKeep)
+{
+	unsigned Index = HashKey(pKey, Kind, m_Seed);
+	CEntry *pVictim = 0;
+	for(int i = 0; i < MAX_PROBES; i++)
+	{
+		CEntry *pEntry = &m_aEntries[(Index + i) & (TABLE_SIZE - 1)];
+		if(pEntry->m_Kind == Kind && mem_comp(pEntry->m_aKey, pKey, sizeof(pEntry->m_aKey)) == 0)
+			return pEntry;
+		if(pEntry->m_Kind == KIND_UNUSED)
+		{
+			pVictim = pEntry;
+			break;
+		}
+		// entries that are full again carry no state, otherwise give up
+		// the one closest to it so that heavy hitters stay tracked
+		if(pEntry != pKeep && (!pVictim || pEntry->m_Full < pVictim->m_Full))
+			pVictim = pEntry;
+	}
+
+	if(pVictim->m_Kind != KIND_UNUSED && pVictim->m_Full > Now)
+		m_NumEvicted++;
+	mem_copy(pVictim->m_aKey, pKey, sizeof(pVictim->m_aKey));
+	pVictim->m_Kind = Kind;
+	pVictim->m_Full = 0;
+	return pVictim;
+}
+
+bool CNetConnLimiter::Allow(const NETADDR *pAddr, int64 Now, int Burst, int NetworkBurst, int Seconds)
+{
+	if(Seconds <= 0 || (Burst <= 0 && NetworkBurst <= 0))
+	{
+		m_NumAllowed++;
+		return true;
+	}
+
+	bool IPv6 = pAddr->type == NETTYPE_IPV6;
+	unsigned char aKey[16] = {0};
+	CEntry *apEntries[2] = {0, 0};
+	int aBurst[2] = {Burst, NetworkBurst};
+	if(Burst > 0)
+	{
+		mem_copy(aKey, pAddr->ip, IPv6 ? 16 : 4);
+		apEntries[0] = Lookup(aKey, IPv6 ? KIND_ADDR_IPV6 : KIND_ADDR_IPV4, Now, 0);
+	}
+	if(NetworkBurst > 0)
+	{
+		// spoofed or rotating addresses usually share a /24 or /48
+		mem_zero(aKey, sizeof(aKey));
+		mem_copy(aKey, pAddr->ip, IPv6 ? 6 : 3);
+		apEntries[1] = Lookup(aKey, IPv6 ? KIND_NETWORK_IPV6 : KIND_NETWORK_IPV4, Now, apEntries[0]);
+	}
+
+	// generic cell rate algorithm: m_Full advances by one interval per
+	// attempt and may run at most Burst-1 intervals ahead of now
+	int64 Period = Seconds * time_freq();
+	int64 aFull[2];
+	for(int i = 0; i < 2; i++)
+	{
+		if(!apEntries[i])
+			continue;
+		int64 Interval = Period / aBurst[i];
+		int64 Full = maximum(apEntries[i]->m_Full, Now);
+		if(Full - Now > Period - Interval)
+		{
+			if(i == 0)
+				m_NumDropped++;
+			else
+				m_NumDroppedNetwork++;
+			return false;
+		}
+		aFull[i] = Full + Interval;
+	}
+
+	// only charge when both buckets allow it
+	for(int i = 0; i < 2; i++)
+		if(apEntries[i])
+			apEntries[i]->m_Full = aFull[i];
+	m_NumAllowed++;
+	return true;
+}
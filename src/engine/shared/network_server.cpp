@@ -8,6 +8,7 @@
 #include "config.h"
 #include "netban.h"
 #include "network.h"
+#include "spscqueue.h"
 #include <engine/message.h>
 #include <engine/shared/protocol.h>
 
@@ -42,6 +43,89 @@ unsigned char g_aDummyMapData[] = {
 };
 
 
+// handed from the network thread to the main thread
+struct CNetEvent
+{
+	enum
+	{
+		CHUNK=0,
+		PACKET,
+		STATE,
+		REJOIN,
+	};
+
+	int m_Type;
+	int m_ClientID;
+	int m_Generation;
+	NETADDR m_Addr;
+	int m_Flags;
+	int m_State;
+	bool m_TimeoutSituation;
+	int m_DataSize;
+	unsigned char m_aData[NET_MAX_PACKETSIZE];
+};
+
+// handed from the main thread to the network thread, done in order
+struct CNetCommand
+{
+	enum
+	{
+		SEND=0,
+		DATAGRAM,
+		PACKET,
+		ACCEPT,
+		DROP,
+		TIMEDOUT,
+		DUMMY,
+		FLUSH,
+		BATCHING,
+	};
+
+	int m_Type;
+	int m_ClientID;
+	int m_Generation;
+	int m_Value;
+	NETADDR m_Addr;
+	SECURITY_TOKEN m_SecurityToken;
+	int m_Flags;
+	int m_DataSize;
+	unsigned char m_aData[NET_MAX_PACKETSIZE];
+};
+
+class CNetThread
+{
+public:
+	enum
+	{
+		EVENT_QUEUE_SIZE=1024,
+		COMMAND_QUEUE_SIZE=2048,
+		// the connections check for timeouts and resends at most this often
+		UPDATE_INTERVAL=1000,
+		MAX_WAIT=10000,
+	};
+
+	TSpscQueue<CNetEvent, EVENT_QUEUE_SIZE> m_Events;
+	TSpscQueue<CNetCommand, COMMAND_QUEUE_SIZE> m_Commands;
+	NETSIGNAL m_EventSignal;
+	NETSIGNAL m_CommandSignal;
+
+	// main thread
+	bool m_CommandsPushed;
+
+	// network thread
+	MMSGS m_RecvMMSGS;
+	MMSGS m_SendMMSGS;
+	bool m_Batching;
+	bool m_EventsPushed;
+	CNetRecvUnpacker m_RecvUnpacker;
+
+	std::atomic<bool> m_Shutdown;
+	std::atomic<int> m_NumDropped;
+	std::atomic<int> m_NumSentPackets;
+
+	void *m_pThread;
+};
+
 static SECURITY_TOKEN ToSecurityToken(const unsigned char *pData)
 {
 	return (int)pData[0] | (pData[1] << 8) | (pData[2] << 16) | (pData[3] << 24);
@@ -75,11 +159,13 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	m_VConnFirst = 0;
 
 	secure_random_fill(m_SecurityTokenSeed, sizeof(m_SecurityTokenSeed));
+	m_ConnLimiter.Reset();
 
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
 		m_aSlots[i].m_Connection.Init(m_Socket, true);
 
 	net_init_mmsgs(&m_MMSGS);
+	net_init_mmsgs(&m_SendMMSGS);
 
 	return true;
 }
@@ -121,7 +207,25 @@ int CNetServer::Drop(int ClientID, const char *pReason)
 	if(m_pfnDelClient)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
-	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
+	if(!m_pNetThread)
+	{
+		m_aSlots[ClientID].m_Connection.Disconnect(pReason);
+		return 0;
+	}
+
+	if(m_aSlotInfos[ClientID].m_State == NET_CONNSTATE_OFFLINE)
+		return 0;
+
+	CNetCommand *pCommand = NewCommand(CNetCommand::DROP);
+	pCommand->m_ClientID = ClientID;
+	pCommand->m_Value = pReason != 0;
+	if(pReason)
+		str_copy((char *)pCommand->m_aData, pReason, sizeof(pCommand->m_aData));
+	ResetSlotInfo(ClientID, NET_CONNSTATE_OFFLINE);
+	if(pReason)
+		str_copy(m_aSlotInfos[ClientID].m_aErrorString, (const char *)pCommand->m_aData, sizeof(m_aSlotInfos[ClientID].m_aErrorString));
+	pCommand->m_Generation = m_aSlotInfos[ClientID].m_Generation;
+	PushCommand();
 
 	return 0;
 }
@@ -130,27 +234,70 @@ int CNetServer::Update()
 {
 	for(int i = 0; i < MaxClients(); i++)
 	{
-		m_aSlots[i].m_Connection.Update();
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR &&
-			(!m_aSlots[i].m_Connection.m_TimeoutProtected ||
-			 !m_aSlots[i].m_Connection.m_TimeoutSituation))
-		{
-			Drop(i, m_aSlots[i].m_Connection.ErrorString());
-		}
+		// the network thread updates the connections on its own
+		if(!m_pNetThread)
+			m_aSlots[i].m_Connection.Update();
+		if(SlotDroppable(i))
+			Drop(i, ErrorString(i));
 	}
 
 	return 0;
 }
+
+bool CNetServer::SlotDroppable(int ClientID) const
+{
+	if(m_pNetThread)
+	{
+		const CSlotInfo *pInfo = &m_aSlotInfos[ClientID];
+		return pInfo->m_State == NET_CONNSTATE_ERROR && (!pInfo->m_TimeoutProtected || !pInfo->m_TimeoutSituation);
+	}
+
+	const CNetConnection *pConnection = &m_aSlots[ClientID].m_Connection;
+	return pConnection->State() == NET_CONNSTATE_ERROR && (!pConnection->m_TimeoutProtected || !pConnection->m_TimeoutSituation);
+}
+
+void CNetServer::ResetSlotInfo(int ClientID, int State)
+{
+	CSlotInfo *pInfo = &m_aSlotInfos[ClientID];
+	pInfo->m_State = State;
+	pInfo->m_TimeoutProtected = false;
+	pInfo->m_TimeoutSituation = false;
+	pInfo->m_aErrorString[0] = 0;
+	pInfo->m_Generation++;
+}
+
 // Dummy
 void CNetServer::DummyInit(int DummyID)
 {
-	m_aSlots[DummyID].m_Connection.DummyConnect();
+	if(!m_pNetThread)
+	{
+		m_aSlots[DummyID].m_Connection.DummyConnect();
+		return;
+	}
+
+	ResetSlotInfo(DummyID, NET_CONNSTATE_DUMMY);
+	CNetCommand *pCommand = NewCommand(CNetCommand::DUMMY);
+	pCommand->m_ClientID = DummyID;
+	pCommand->m_Generation = m_aSlotInfos[DummyID].m_Generation;
+	pCommand->m_Value = 1;
+	PushCommand();
 }
 
 // Dummy
 void CNetServer::DummyDelete(int DummyID)
 {
-	m_aSlots[DummyID].m_Connection.DummyDrop();
+	if(!m_pNetThread)
+	{
+		m_aSlots[DummyID].m_Connection.DummyDrop();
+		return;
+	}
+
+	ResetSlotInfo(DummyID, NET_CONNSTATE_OFFLINE);
+	CNetCommand *pCommand = NewCommand(CNetCommand::DUMMY);
+	pCommand->m_ClientID = DummyID;
+	pCommand->m_Generation = m_aSlotInfos[DummyID].m_Generation;
+	pCommand->m_Value = 0;
+	PushCommand();
 }
 SECURITY_TOKEN CNetServer::GetToken(const NETADDR &Addr)
 {
@@ -178,61 +325,28 @@ int CNetServer::NumClientsWithAddr(NETADDR Addr)
 	int FoundAddr = 0;
 	for(int i = 0; i < MaxClients(); ++i)
 	{
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE ||
-			(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR &&
-				(!m_aSlots[i].m_Connection.m_TimeoutProtected ||
-				 !m_aSlots[i].m_Connection.m_TimeoutSituation)))
+		if(SlotState(i) == NET_CONNSTATE_OFFLINE || SlotDroppable(i))
 			continue;
 
-		if(!net_addr_comp_noport(&Addr, m_aSlots[i].m_Connection.PeerAddress()))
+		if(!net_addr_comp_noport(&Addr, ClientAddr(i)))
 			FoundAddr++;
 	}
 
 	return FoundAddr;
 }
 
-bool CNetServer::Connlimit(NETADDR Addr)
+bool CNetServer::Connlimit(NETADDR &Addr, SECURITY_TOKEN SecurityToken)
 {
-	int64 Now = time_get();
-	int Oldest = 0;
-
-	for(int i = 0; i < NET_CONNLIMIT_IPS; ++i)
-	{
-		if(!net_addr_comp(&m_aSpamConns[i].m_Addr, &Addr))
-		{
-			if(m_aSpamConns[i].m_Time > Now - time_freq() * g_Config.m_SvConnlimitTime)
-			{
-				if(m_aSpamConns[i].m_Conns >= g_Config.m_SvConnlimit)
-					return true;
-			}
-			else
-			{
-				m_aSpamConns[i].m_Time = Now;
-				m_aSpamConns[i].m_Conns = 0;
-			}
-			m_aSpamConns[i].m_Conns++;
-			return false;
-		}
-
-		if(m_aSpamConns[i].m_Time < m_aSpamConns[Oldest].m_Time)
-			Oldest = i;
-	}
+	if(m_ConnLimiter.Allow(&Addr, time_get(), g_Config.m_SvConnlimit, g_Config.m_SvConnlimitPrefix, g_Config.m_SvConnlimitTime))
+		return false;
 
-	m_aSpamConns[Oldest].m_Addr = Addr;
-	m_aSpamConns[Oldest].m_Time = Now;
-	m_aSpamConns[Oldest].m_Conns = 1;
-	return false;
+	const char Msg[] = "Too many connections in a short time";
+	CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, Msg, sizeof(Msg), SecurityToken);
+	return true;
 }
 
 int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, bool VanillaAuth)
 {
-	if (Connlimit(Addr))
-	{
-		const char Msg[] = "Too many connections in a short time";
-		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, Msg, sizeof(Msg), SecurityToken);
-		return -1; // failed to add client
-	}
-
 	// check for sv_max_clients_per_ip
 	if (NumClientsWithAddr(Addr) + 1 > m_MaxClientsPerIP)
 	{
@@ -245,7 +359,7 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 	int Slot = -1;
 	for(int i = 0; i < MaxClients(); i++)
 	{
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+		if(SlotState(i) == NET_CONNSTATE_OFFLINE)
 		{
 			Slot = i;
 			break;
@@ -261,15 +375,32 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 	}
 
 	// init connection slot
-	m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken);
-
-	if (VanillaAuth)
+	if(m_pNetThread)
+	{
+		ResetSlotInfo(Slot, NET_CONNSTATE_ONLINE);
+		m_aSlotInfos[Slot].m_Addr = Addr;
+		m_aSlotInfos[Slot].m_SecurityToken = SecurityToken;
+
+		CNetCommand *pCommand = NewCommand(CNetCommand::ACCEPT);
+		pCommand->m_ClientID = Slot;
+		pCommand->m_Generation = m_aSlotInfos[Slot].m_Generation;
+		pCommand->m_Addr = Addr;
+		pCommand->m_SecurityToken = SecurityToken;
+		pCommand->m_Value = VanillaAuth;
+		PushCommand();
+	}
+	else
 	{
-		// client sequence is unknown if the auth was done
-		// connection-less
-		m_aSlots[Slot].m_Connection.SetUnknownSeq();
-		// correct sequence
-		m_aSlots[Slot].m_Connection.SetSequence(6);
+		m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken);
+
+		if (VanillaAuth)
+		{
+			// client sequence is unknown if the auth was done
+			// connection-less
+			m_aSlots[Slot].m_Connection.SetUnknownSeq();
+			// correct sequence
+			m_aSlots[Slot].m_Connection.SetSequence(6);
+		}
 	}
 
 	if (g_Config.m_Debug)
@@ -320,6 +451,11 @@ void CNetServer::OnPreConnMsg(NETADDR &Addr, CNetPacketConstruct &Packet)
 	bool IsCtrl = Packet.m_Flags&NET_PACKETFLAG_CONTROL;
 	int CtrlMsg = m_RecvUnpacker.m_Data.m_aChunkData[0];
 
+	// rate limit connection attempts before answering them, a vanilla
+	// connect is answered with a whole handshake
+	if(IsCtrl && CtrlMsg == NET_CTRLMSG_CONNECT && Connlimit(Addr, NET_SECURITY_TOKEN_UNSUPPORTED))
+		return;
+
 	// log flooding
 	//TODO: remove
 	if (g_Config.m_Debug)
@@ -512,7 +648,14 @@ void CNetServer::OnConnCtrlMsg(NETADDR &Addr, int ClientID, int ControlMsg, cons
 
 			// reset netconn and process rejoin
 			m_aSlots[ClientID].m_Connection.Reset(true);
-			m_pfnClientRejoin(ClientID, m_UserPtr);
+			if(m_pNetThread)
+			{
+				CNetEvent *pEvent = NewEvent(CNetEvent::REJOIN, ClientID);
+				if(pEvent)
+					PushEvent();
+			}
+			else
+				m_pfnClientRejoin(ClientID, m_UserPtr);
 		}
 	}
 }
@@ -527,6 +670,8 @@ void CNetServer::OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketC
 	{
 		// websocket client doesn't send token
 		// direct accept
+		if(Connlimit(Addr, NET_SECURITY_TOKEN_UNSUPPORTED))
+			return;
 		SendControl(Addr, NET_CTRLMSG_CONNECTACCEPT, SECURITY_TOKEN_MAGIC, sizeof(SECURITY_TOKEN_MAGIC), NET_SECURITY_TOKEN_UNSUPPORTED);
 		TryAcceptClient(Addr, NET_SECURITY_TOKEN_UNSUPPORTED);
 	}
@@ -545,7 +690,8 @@ void CNetServer::OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketC
 			// try to accept client
 			if(g_Config.m_Debug)
 				dbg_msg("security", "new client (ddnet token)");
-			TryAcceptClient(Addr, Token);
+			if(!Connlimit(Addr, Token))
+				TryAcceptClient(Addr, Token);
 		}
 		else
 		{
@@ -562,9 +708,9 @@ int CNetServer::GetClientSlot(const NETADDR &Addr)
 
 	for(int i = 0; i < MaxClients(); i++)
 	{
-		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
-			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_ERROR &&
-			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
+		if(SlotState(i) != NET_CONNSTATE_OFFLINE &&
+			SlotState(i) != NET_CONNSTATE_ERROR &&
+			net_addr_comp(ClientAddr(i), &Addr) == 0)
 
 		{
 			Slot = i;
@@ -574,6 +720,24 @@ int CNetServer::GetClientSlot(const NETADDR &Addr)
 	return Slot;
 }
 
+int CNetServer::FindConnection(const NETADDR &Addr)
+{
+	int Slot = -1;
+
+	for(int i = 0; i < MaxClients(); i++)
+	{
+		const CNetConnection *pConnection = &m_aSlots[i].m_Connection;
+		if(pConnection->State() != NET_CONNSTATE_OFFLINE &&
+			pConnection->State() != NET_CONNSTATE_ERROR &&
+			net_addr_comp(pConnection->PeerAddress(), &Addr) == 0)
+		{
+			Slot = i;
+		}
+	}
+
+	return Slot;
+}
+
 static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
 {
 	if(!(pPacket->m_Flags&NET_PACKETFLAG_CONTROL)
@@ -602,6 +766,54 @@ static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
 */
 int CNetServer::Recv(CNetChunk *pChunk)
 {
+	if(m_pNetThread)
+	{
+		CNetEvent *pEvent;
+		while((pEvent = m_pNetThread->m_Events.Front()))
+		{
+			int Result = 0;
+			int ClientID = pEvent->m_ClientID;
+			if(pEvent->m_Type == CNetEvent::PACKET)
+			{
+				mem_copy(m_RecvUnpacker.m_aBuffer, pEvent->m_aData, pEvent->m_DataSize);
+				Result = ProcessPacket(pEvent->m_Addr, m_RecvUnpacker.m_aBuffer, pEvent->m_DataSize, pChunk);
+			}
+			else if(pEvent->m_Generation != m_aSlotInfos[ClientID].m_Generation)
+			{
+				// left over from an earlier connection in the slot
+			}
+			else if(pEvent->m_Type == CNetEvent::CHUNK)
+			{
+				mem_copy(m_RecvUnpacker.m_aBuffer, pEvent->m_aData, pEvent->m_DataSize);
+				pChunk->m_ClientID = ClientID;
+				pChunk->m_Address = m_aSlotInfos[ClientID].m_Addr;
+				pChunk->m_Flags = pEvent->m_Flags;
+				pChunk->m_DataSize = pEvent->m_DataSize;
+				pChunk->m_pData = m_RecvUnpacker.m_aBuffer;
+				Result = 1;
+			}
+			else if(pEvent->m_Type == CNetEvent::STATE)
+			{
+				CSlotInfo *pInfo = &m_aSlotInfos[ClientID];
+				pInfo->m_State = pEvent->m_State;
+				pInfo->m_TimeoutSituation = pEvent->m_TimeoutSituation;
+				str_copy(pInfo->m_aErrorString, (const char *)pEvent->m_aData, sizeof(pInfo->m_aErrorString));
+
+				// drop right away like Update does, before the error
+				// string is taken for a timeout protection message
+				if(SlotDroppable(ClientID))
+					Drop(ClientID, pInfo->m_aErrorString);
+			}
+			else if(pEvent->m_Type == CNetEvent::REJOIN)
+				m_pfnClientRejoin(ClientID, m_UserPtr);
+
+			m_pNetThread->m_Events.Pop();
+			if(Result)
+				return 1;
+		}
+		return 0;
+	}
+
 	while(1)
 	{
 		NETADDR Addr;
@@ -618,69 +830,84 @@ int CNetServer::Recv(CNetChunk *pChunk)
 		if(Bytes <= 0)
 			break;
 
-		// check if we just should drop the packet
-		char aBuf[128];
-		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+		if(ProcessPacket(Addr, pData, Bytes, pChunk))
+			return 1;
+	}
+	return 0;
+}
+
+int CNetServer::ProcessPacket(NETADDR &Addr, unsigned char *pData, int Bytes, CNetChunk *pChunk)
+{
+	// check if we just should drop the packet
+	char aBuf[128];
+	if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+	{
+		// banned, reply with a message
+		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1, NET_SECURITY_TOKEN_UNSUPPORTED);
+		return 0;
+	}
+
+	if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data) != 0)
+		return 0;
+
+	if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
+	{
+		pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+		pChunk->m_ClientID = -1;
+		pChunk->m_Address = Addr;
+		pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
+		pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
+		if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_EXTENDED)
 		{
-			// banned, reply with a message
-			CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1, NET_SECURITY_TOKEN_UNSUPPORTED);
-			continue;
+			pChunk->m_Flags |= NETSENDFLAG_EXTENDED;
+			mem_copy(pChunk->m_aExtraData, m_RecvUnpacker.m_Data.m_aExtraData, sizeof(pChunk->m_aExtraData));
 		}
+		return 1;
+	}
 
-		if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data) == 0)
-		{
-			if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
-			{
-				pChunk->m_Flags = NETSENDFLAG_CONNLESS;
-				pChunk->m_ClientID = -1;
-				pChunk->m_Address = Addr;
-				pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
-				pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
-				if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_EXTENDED)
-				{
-					pChunk->m_Flags |= NETSENDFLAG_EXTENDED;
-					mem_copy(pChunk->m_aExtraData, m_RecvUnpacker.m_Data.m_aExtraData, sizeof(pChunk->m_aExtraData));
-				}
-				return 1;
-			}
-			else
-			{
-				// drop invalid ctrl packets
-				if (m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL &&
-						m_RecvUnpacker.m_Data.m_DataSize == 0)
-					continue;
+	// drop invalid ctrl packets
+	if (m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL &&
+			m_RecvUnpacker.m_Data.m_DataSize == 0)
+		return 0;
 
-				// normal packet, find matching slot
-				int Slot = GetClientSlot(Addr);
+	// normal packet, find matching slot
+	int Slot = GetClientSlot(Addr);
 
-				if (Slot != -1)
-				{
-					// found
+	if (Slot != -1 && m_pNetThread)
+	{
+		// the client got accepted after the network thread passed
+		// the packet on, it's up to its connection now
+		CNetCommand *pCommand = NewCommand(CNetCommand::PACKET);
+		pCommand->m_Addr = Addr;
+		pCommand->m_DataSize = Bytes;
+		mem_copy(pCommand->m_aData, pData, Bytes);
+		PushCommand();
+	}
+	else if (Slot != -1)
+	{
+		// found
 
-					// control
-					if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL)
-						OnConnCtrlMsg(Addr, Slot, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
+		// control
+		if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL)
+			OnConnCtrlMsg(Addr, Slot, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
 
-					if(m_aSlots[Slot].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
-					{
-						if(m_RecvUnpacker.m_Data.m_DataSize)
-							m_RecvUnpacker.Start(&Addr, &m_aSlots[Slot].m_Connection, Slot);
-					}
-				}
-				else
-				{
-					// not found, client that wants to connect
-
-					if(IsDDNetControlMsg(&m_RecvUnpacker.m_Data))
-						// got ddnet control msg
-						OnTokenCtrlMsg(Addr, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
-					else
-						// got connection-less ctrl or sys msg
-						OnPreConnMsg(Addr, m_RecvUnpacker.m_Data);
-				}
-			}
+		if(m_aSlots[Slot].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
+		{
+			if(m_RecvUnpacker.m_Data.m_DataSize)
+				m_RecvUnpacker.Start(&Addr, &m_aSlots[Slot].m_Connection, Slot);
 		}
 	}
+	else
+	{
+		// not found, client that wants to connect
+
+		if(IsDDNetControlMsg(&m_RecvUnpacker.m_Data))
+			// got ddnet control msg
+			OnTokenCtrlMsg(Addr, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
+		else
+			// got connection-less ctrl or sys msg
+			OnPreConnMsg(Addr, m_RecvUnpacker.m_Data);
+	}
 	return 0;
 }
 
@@ -697,31 +924,467 @@ int CNetServer::Send(CNetChunk *pChunk)
 		// send connectionless packet
 		CNetBase::SendPacketConnless(m_Socket, &pChunk->m_Address, pChunk->m_pData, pChunk->m_DataSize,
 				pChunk->m_Flags&NETSENDFLAG_EXTENDED, pChunk->m_aExtraData);
+		return 0;
+	}
+
+	dbg_assert(pChunk->m_ClientID >= 0, "errornous client id");
+	dbg_assert(pChunk->m_ClientID < MaxClients(), "errornous client id");
+
+	if(!m_pNetThread)
+		return SendChunk(pChunk->m_ClientID, pChunk->m_Flags, pChunk->m_DataSize, pChunk->m_pData, m_CoalesceSends);
+
+	CNetCommand *pCommand = NewCommand(CNetCommand::SEND);
+	pCommand->m_ClientID = pChunk->m_ClientID;
+	pCommand->m_Flags = pChunk->m_Flags;
+	pCommand->m_Value = m_CoalesceSends;
+	pCommand->m_DataSize = pChunk->m_DataSize;
+	mem_copy(pCommand->m_aData, pChunk->m_pData, pChunk->m_DataSize);
+	PushCommand();
+	return 0;
+}
+
+int CNetServer::SendChunk(int ClientID, int Flags, int DataSize, const void *pData, bool Coalesce)
+{
+	int ChunkFlags = 0;
+	if(Flags&NETSENDFLAG_VITAL)
+		ChunkFlags = NET_CHUNKFLAG_VITAL;
+
+	CNetConnection *pConnection = &m_aSlots[ClientID].m_Connection;
+	int Result;
+	if(Flags&NETSENDFLAG_PRIORITY && !(Flags&NETSENDFLAG_VITAL))
+		Result = pConnection->QueuePriorityChunk(DataSize, pData);
+	else
+		Result = pConnection->QueueChunk(ChunkFlags, DataSize, pData);
+
+	if(Result == 0)
+	{
+		if(Flags&NETSENDFLAG_FLUSH)
+		{
+			if(Coalesce)
+				pConnection->RequestFlush();
+			else
+				pConnection->Flush();
+		}
+	}
+	else
+	{
+		// Dummy
+		if (pConnection->State() == NET_CONNSTATE_DUMMY)
+			return -1;
+
+		//Drop(ClientID, "Error sending data");
+	}
+	return 0;
+}
+
+void CNetServer::SetCoalesceSends(bool Enable)
+{
+	// the connections pick it up with the next FlushConnections
+	m_CoalesceSends = Enable;
+}
+
+void CNetServer::FlushConnections()
+{
+	if(!m_pNetThread)
+	{
+		FlushSlots(m_CoalesceSends);
+		return;
+	}
+
+	CNetCommand *pCommand = NewCommand(CNetCommand::FLUSH);
+	pCommand->m_Value = m_CoalesceSends;
+	PushCommand();
+}
+
+void CNetServer::FlushSlots(bool Coalesce)
+{
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
+		if(m_aSlots[i].m_Connection.FlushRequested())
+			m_aSlots[i].m_Connection.Flush();
+		m_aSlots[i].m_Connection.SetCoalesce(Coalesce);
+	}
+}
+
+int CNetServer::NumSentPackets() const
+{
+	if(m_pNetThread)
+		return m_pNetThread->m_NumSentPackets.load();
+
+	int NumPackets = 0;
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+		NumPackets += m_aSlots[i].m_Connection.NumSentPackets();
+	return NumPackets;
+}
+
+void CNetServer::SetSendBatching(bool Enable)
+{
+	if(m_pNetThread)
+	{
+		CNetCommand *pCommand = NewCommand(CNetCommand::BATCHING);
+		pCommand->m_Value = Enable;
+		PushCommand();
 	}
 	else
+		FlushSends();
+	m_SendBatching = Enable;
+	CNetBase::SetSendQueue(Enable ? &m_SendMMSGS : 0);
+}
+
+void CNetServer::FlushSends()
+{
+	if(m_pNetThread)
 	{
-		int Flags = 0;
-		dbg_assert(pChunk->m_ClientID >= 0, "errornous client id");
-		dbg_assert(pChunk->m_ClientID < MaxClients(), "errornous client id");
+		// the network thread sends everything in order
+		if(m_pNetThread->m_CommandsPushed)
+		{
+			m_pNetThread->m_CommandsPushed = false;
+			net_signal_raise(&m_pNetThread->m_CommandSignal);
+		}
+		return;
+	}
 
-		if(pChunk->m_Flags&NETSENDFLAG_VITAL)
-			Flags = NET_CHUNKFLAG_VITAL;
+	if(m_SendBatching)
+		net_udp_flush(&m_SendMMSGS);
+}
 
-		if(m_aSlots[pChunk->m_ClientID].m_Connection.QueueChunk(Flags, pChunk->m_DataSize, pChunk->m_pData) == 0)
+CNetCommand *CNetServer::NewCommand(int Type)
+{
+	CNetCommand *pCommand;
+	while(!(pCommand = m_pNetThread->m_Commands.Back()))
+	{
+		// the network thread is behind, let it catch up
+		net_signal_raise(&m_pNetThread->m_CommandSignal);
+		thread_yield();
+	}
+	pCommand->m_Type = Type;
+	pCommand->m_ClientID = -1;
+	return pCommand;
+}
+
+void CNetServer::PushCommand()
+{
+	m_pNetThread->m_Commands.Push();
+	m_pNetThread->m_CommandsPushed = true;
+}
+
+void CNetServer::SendRawCommand(const NETADDR *pAddr, const void *pData, int DataSize, void *pUser)
+{
+	CNetServer *pThis = (CNetServer *)pUser;
+	CNetCommand *pCommand = pThis->NewCommand(CNetCommand::DATAGRAM);
+	pCommand->m_Addr = *pAddr;
+	pCommand->m_DataSize = DataSize;
+	mem_copy(pCommand->m_aData, pData, DataSize);
+	pThis->PushCommand();
+}
+
+CNetEvent *CNetServer::NewEvent(int Type, int ClientID)
+{
+	CNetEvent *pEvent = m_pNetThread->m_Events.Back();
+	if(!pEvent)
+		return 0;
+	pEvent->m_Type = Type;
+	pEvent->m_ClientID = ClientID;
+	pEvent->m_Generation = ClientID >= 0 ? m_aSlots[ClientID].m_Generation : 0;
+	return pEvent;
+}
+
+void CNetServer::PushEvent()
+{
+	m_pNetThread->m_Events.Push();
+	m_pNetThread->m_EventsPushed = true;
+}
+
+void CNetServer::NetThread(void *pUser)
+{
+	CNetServer *pThis = (CNetServer *)pUser;
+	CNetThread *pThread = pThis->m_pNetThread;
+	unsigned char aBuffer[NET_MAX_PACKETSIZE];
+	int64 LastUpdate = 0;
+
+	CNetBase::SetSendQueue(pThread->m_Batching ? &pThread->m_SendMMSGS : 0);
+
+	while(1)
+	{
+		// everything pushed before the shutdown still gets done
+		bool Shutdown = pThread->m_Shutdown.load();
+
+		CNetCommand *pCommand;
+		while((pCommand = pThread->m_Commands.Front()))
+		{
+			pThis->ThreadCommand(pCommand);
+			pThread->m_Commands.Pop();
+		}
+
+		for(int i = 0; i < CNetThread::EVENT_QUEUE_SIZE; i++)
+		{
+			NETADDR Addr;
+			unsigned char *pData;
+			int Bytes = net_udp_recv(pThis->m_Socket, &Addr, aBuffer, NET_MAX_PACKETSIZE, &pThread->m_RecvMMSGS, &pData);
+			if(Bytes <= 0)
+				break;
+			pThis->ThreadPacket(Addr, pData, Bytes, false);
+		}
+
+		int64 Now = time_get();
+		if(Now - LastUpdate >= time_freq()*CNetThread::UPDATE_INTERVAL/1000000)
 		{
-			if(pChunk->m_Flags&NETSENDFLAG_FLUSH)
-				m_aSlots[pChunk->m_ClientID].m_Connection.Flush();
+			LastUpdate = Now;
+			pThis->ThreadUpdate();
 		}
+
+		if(pThread->m_Batching)
+			net_udp_flush(&pThread->m_SendMMSGS);
+
+		int NumPackets = 0;
+		for(int i = 0; i < NET_MAX_CLIENTS; i++)
+			NumPackets += pThis->m_aSlots[i].m_Connection.NumSentPackets();
+		pThread->m_NumSentPackets = NumPackets;
+
+		if(pThread->m_EventsPushed)
+		{
+			pThread->m_EventsPushed = false;
+			net_signal_raise(&pThread->m_EventSignal);
+		}
+
+		if(Shutdown)
+			break;
+
+		net_socket_read_wait_signal(pThis->m_Socket, &pThread->m_CommandSignal, CNetThread::MAX_WAIT);
+	}
+
+	CNetBase::SetSendQueue(0);
+}
+
+void CNetServer::ThreadPacket(NETADDR &Addr, unsigned char *pData, int Bytes, bool Forwarded)
+{
+	CNetThread *pThread = m_pNetThread;
+	CNetRecvUnpacker *pUnpacker = &pThread->m_RecvUnpacker;
+
+	int Slot = FindConnection(Addr);
+	if(Slot != -1 && CNetBase::UnpackPacket(pData, Bytes, &pUnpacker->m_Data) != 0)
+		return;
+
+	if(Slot == -1 || pUnpacker->m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
+	{
+		// bans, handshakes and connless messages are up to the main
+		// thread. it only passes packets back if they have a connection
+		if(Forwarded)
+			return;
+
+		CNetEvent *pEvent = NewEvent(CNetEvent::PACKET, -1);
+		if(!pEvent)
+		{
+			pThread->m_NumDropped++;
+			return;
+		}
+		pEvent->m_Addr = Addr;
+		pEvent->m_DataSize = Bytes;
+		mem_copy(pEvent->m_aData, pData, Bytes);
+		PushEvent();
+		return;
+	}
+
+	// drop invalid ctrl packets
+	if(pUnpacker->m_Data.m_Flags&NET_PACKETFLAG_CONTROL && pUnpacker->m_Data.m_DataSize == 0)
+		return;
+
+	// don't ack anything the main thread has no room for
+	if(CNetThread::EVENT_QUEUE_SIZE - pThread->m_Events.Size() < pUnpacker->m_Data.m_NumChunks + 1)
+	{
+		pThread->m_NumDropped++;
+		return;
+	}
+
+	if(pUnpacker->m_Data.m_Flags&NET_PACKETFLAG_CONTROL)
+		OnConnCtrlMsg(Addr, Slot, pUnpacker->m_Data.m_aChunkData[0], pUnpacker->m_Data);
+
+	if(!m_aSlots[Slot].m_Connection.Feed(&pUnpacker->m_Data, &Addr) || !pUnpacker->m_Data.m_DataSize)
+		return;
+
+	pUnpacker->Start(&Addr, &m_aSlots[Slot].m_Connection, Slot);
+	CNetChunk Chunk;
+	while(pUnpacker->FetchChunk(&Chunk))
+	{
+		CNetEvent *pEvent = NewEvent(CNetEvent::CHUNK, Slot);
+		pEvent->m_Flags = Chunk.m_Flags;
+		pEvent->m_DataSize = Chunk.m_DataSize;
+		mem_copy(pEvent->m_aData, Chunk.m_pData, Chunk.m_DataSize);
+		PushEvent();
+	}
+}
+
+void CNetServer::ThreadCommand(CNetCommand *pCommand)
+{
+	CNetThread *pThread = m_pNetThread;
+	CSlot *pSlot = pCommand->m_ClientID >= 0 ? &m_aSlots[pCommand->m_ClientID] : 0;
+
+	switch(pCommand->m_Type)
+	{
+	case CNetCommand::SEND:
+		SendChunk(pCommand->m_ClientID, pCommand->m_Flags, pCommand->m_DataSize, pCommand->m_aData, pCommand->m_Value);
+		return;
+	case CNetCommand::DATAGRAM:
+		if(pThread->m_Batching)
+			net_udp_send_batched(m_Socket, &pCommand->m_Addr, pCommand->m_aData, pCommand->m_DataSize, &pThread->m_SendMMSGS);
 		else
+			net_udp_send(m_Socket, &pCommand->m_Addr, pCommand->m_aData, pCommand->m_DataSize);
+		return;
+	case CNetCommand::PACKET:
+		ThreadPacket(pCommand->m_Addr, pCommand->m_aData, pCommand->m_DataSize, true);
+		return;
+	case CNetCommand::FLUSH:
+		FlushSlots(pCommand->m_Value);
+		return;
+	case CNetCommand::BATCHING:
+		net_udp_flush(&pThread->m_SendMMSGS);
+		pThread->m_Batching = pCommand->m_Value;
+		CNetBase::SetSendQueue(pThread->m_Batching ? &pThread->m_SendMMSGS : 0);
+		return;
+	case CNetCommand::ACCEPT:
+		pSlot->m_Connection.DirectInit(pCommand->m_Addr, pCommand->m_SecurityToken);
+		if(pCommand->m_Value)
+		{
+			// client sequence is unknown if the auth was done
+			// connection-less
+			pSlot->m_Connection.SetUnknownSeq();
+			// correct sequence
+			pSlot->m_Connection.SetSequence(6);
+		}
+		break;
+	case CNetCommand::DROP:
+		pSlot->m_Connection.Disconnect(pCommand->m_Value ? (const char *)pCommand->m_aData : 0);
+		break;
+	case CNetCommand::TIMEDOUT:
 		{
-			// Dummy
-			if (m_aSlots[pChunk->m_ClientID].m_Connection.State() == NET_CONNSTATE_DUMMY)
-				return -1;
+			CNetConnection *pOrig = &m_aSlots[pCommand->m_Value].m_Connection;
+			pSlot->m_Connection.SetTimedOut(pOrig->PeerAddress(), pOrig->SeqSequence(), pOrig->AckSequence(), pOrig->SecurityToken(), pOrig->ResendBuffer());
+			pOrig->Reset();
+		}
+		break;
+	case CNetCommand::DUMMY:
+		if(pCommand->m_Value)
+			pSlot->m_Connection.DummyConnect();
+		else
+			pSlot->m_Connection.DummyDrop();
+		break;
+	}
+
+	// the slot holds another connection now
+	pSlot->m_Generation = pCommand->m_Generation;
+	pSlot->m_ReportedState = pSlot->m_Connection.State();
+}
+
+void CNetServer::ThreadUpdate()
+{
+	for(int i = 0; i < MaxClients(); i++)
+	{
+		CSlot *pSlot = &m_aSlots[i];
+		pSlot->m_Connection.Update();
 
-			//Drop(pChunk->m_ClientID, "Error sending data");
+		// tell the main thread about errors, it drops the client
+		int State = pSlot->m_Connection.State();
+		bool Situation = pSlot->m_Connection.m_TimeoutSituation;
+		if(State != NET_CONNSTATE_ERROR)
+		{
+			pSlot->m_ReportedState = State;
+			continue;
 		}
+		if(pSlot->m_ReportedState == State && pSlot->m_ReportedSituation == Situation)
+			continue;
+
+		CNetEvent *pEvent = NewEvent(CNetEvent::STATE, i);
+		if(!pEvent)
+			continue;
+		pEvent->m_State = State;
+		pEvent->m_TimeoutSituation = Situation;
+		str_copy((char *)pEvent->m_aData, pSlot->m_Connection.ErrorString(), sizeof(pEvent->m_aData));
+		pEvent->m_DataSize = str_length((char *)pEvent->m_aData) + 1;
+		PushEvent();
+
+		pSlot->m_ReportedState = State;
+		pSlot->m_ReportedSituation = Situation;
 	}
-	return 0;
+}
+
+bool CNetServer::StartNetThread()
+{
+	if(m_pNetThread)
+		return true;
+	if(m_Socket.type&NETTYPE_WEBSOCKET_IPV4)
+	{
+		dbg_msg("netserver", "network thread isn't supported with websockets");
+		return false;
+	}
+
+	// the connections change hands, the main thread keeps what it
+	// needs to know about them
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
+		CNetConnection *pConnection = &m_aSlots[i].m_Connection;
+		CSlotInfo *pInfo = &m_aSlotInfos[i];
+		pInfo->m_State = pConnection->State();
+		pInfo->m_Addr = *pConnection->PeerAddress();
+		pInfo->m_SecurityToken = pConnection->SecurityToken();
+		pInfo->m_TimeoutProtected = pConnection->m_TimeoutProtected;
+		pInfo->m_TimeoutSituation = pConnection->m_TimeoutSituation;
+		pInfo->m_Generation = 0;
+		str_copy(pInfo->m_aErrorString, pConnection->ErrorString(), sizeof(pInfo->m_aErrorString));
+		m_aSlots[i].m_Generation = 0;
+		m_aSlots[i].m_ReportedState = pConnection->State();
+		m_aSlots[i].m_ReportedSituation = pConnection->m_TimeoutSituation;
+	}
+
+	// send what's queued from this thread before the network thread takes over
+	FlushSends();
+
+	CNetThread *pThread = new CNetThread();
+	net_signal_init(&pThread->m_EventSignal);
+	net_signal_init(&pThread->m_CommandSignal);
+	pThread->m_CommandsPushed = false;
+	net_init_mmsgs(&pThread->m_RecvMMSGS);
+	net_init_mmsgs(&pThread->m_SendMMSGS);
+	pThread->m_Batching = m_SendBatching;
+	pThread->m_EventsPushed = false;
+	pThread->m_Shutdown = false;
+	pThread->m_NumDropped = 0;
+	pThread->m_NumSentPackets = NumSentPackets();
+	m_pNetThread = pThread;
+
+	// from now on the network thread sends what this thread sends
+	CNetBase::SetSendRaw(SendRawCommand, this);
+	pThread->m_pThread = thread_init(NetThread, this, "net");
+	return true;
+}
+
+void CNetServer::StopNetThread()
+{
+	if(!m_pNetThread)
+		return;
+
+	CNetThread *pThread = m_pNetThread;
+	pThread->m_Shutdown = true;
+	net_signal_raise(&pThread->m_CommandSignal);
+	thread_wait(pThread->m_pThread);
+
+	CNetBase::SetSendRaw(0, 0);
+	net_signal_destroy(&pThread->m_EventSignal);
+	net_signal_destroy(&pThread->m_CommandSignal);
+	m_pNetThread = 0;
+	delete pThread;
+}
+
+int CNetServer::NetThreadDroppedPackets() const
+{
+	return m_pNetThread ? m_pNetThread->m_NumDropped.load() : 0;
+}
+
+void CNetServer::Wait(int Microseconds)
+{
+	if(m_pNetThread)
+		net_signal_wait(&m_pNetThread->m_EventSignal, Microseconds);
+	else
+		net_socket_read_wait(m_Socket, Microseconds);
 }
 
 void CNetServer::SetMaxClientsPerIP(int Max)
@@ -737,9 +1400,28 @@ void CNetServer::SetMaxClientsPerIP(int Max)
 
 bool CNetServer::SetTimedOut(int ClientID, int OrigID)
 {
-	if (m_aSlots[ClientID].m_Connection.State() != NET_CONNSTATE_ERROR)
+	if (SlotState(ClientID) != NET_CONNSTATE_ERROR)
 		return false;
 
+	if(m_pNetThread)
+	{
+		CSlotInfo *pInfo = &m_aSlotInfos[ClientID];
+		const CSlotInfo *pOrig = &m_aSlotInfos[OrigID];
+		bool TimeoutProtected = pInfo->m_TimeoutProtected;
+		ResetSlotInfo(ClientID, NET_CONNSTATE_ONLINE);
+		pInfo->m_Addr = pOrig->m_Addr;
+		pInfo->m_SecurityToken = pOrig->m_SecurityToken;
+		pInfo->m_TimeoutProtected = TimeoutProtected;
+		ResetSlotInfo(OrigID, NET_CONNSTATE_OFFLINE);
+
+		CNetCommand *pCommand = NewCommand(CNetCommand::TIMEDOUT);
+		pCommand->m_ClientID = ClientID;
+		pCommand->m_Generation = pInfo->m_Generation;
+		pCommand->m_Value = OrigID;
+		PushCommand();
+		return true;
+	}
+
 	m_aSlots[ClientID].m_Connection.SetTimedOut(ClientAddr(OrigID), m_aSlots[OrigID].m_Connection.SeqSequence(), m_aSlots[OrigID].m_Connection.AckSequence(), m_aSlots[OrigID].m_Connection.SecurityToken(), m_aSlots[OrigID].m_Connection.ResendBuffer());
 	m_aSlots[OrigID].m_Connection.Reset();
 	return true;
@@ -747,16 +1429,24 @@ bool CNetServer::SetTimedOut(int ClientID, int OrigID)
 
 void CNetServer::SetTimeoutProtected(int ClientID)
 {
-	m_aSlots[ClientID].m_Connection.m_TimeoutProtected = true;
+	if(m_pNetThread)
+		m_aSlotInfos[ClientID].m_TimeoutProtected = true;
+	else
+		m_aSlots[ClientID].m_Connection.m_TimeoutProtected = true;
 }
 
 int CNetServer::ResetErrorString(int ClientID)
 {
-	m_aSlots[ClientID].m_Connection.ResetErrorString();
+	if(m_pNetThread)
+		m_aSlotInfos[ClientID].m_aErrorString[0] = 0;
+	else
+		m_aSlots[ClientID].m_Connection.ResetErrorString();
 	return 0;
 }
 
 const char *CNetServer::ErrorString(int ClientID)
 {
+	if(m_pNetThread)
+		return m_aSlotInfos[ClientID].m_aErrorString;
 	return m_aSlots[ClientID].m_Connection.ErrorString();
 }
@@ -0,0 +1,69 @@
+#include <base/system.h>
+
+#include <stdlib.h>
+
+#include "pool.h"
+
+CPool::CPool(int BlockSize, int SlabBlocks)
+{
+	// every block has to fit the free list pointer
+	if(BlockSize < (int)sizeof(void *))
+		BlockSize = sizeof(void *);
+	m_BlockSize = (BlockSize + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	m_SlabBlocks = SlabBlocks;
+	m_pSlabs = 0;
+	m_pFree = 0;
+	m_NumSlabs = 0;
+	m_NumLive = 0;
+	m_PeakLive = 0;
+}
+
+CPool::~CPool()
+{
+	while(m_pSlabs)
+	{
+		CSlab *pNext = m_pSlabs->m_pNext;
+		free(m_pSlabs);
+		m_pSlabs = pNext;
+	}
+}
+
+void CPool::NewSlab()
+{
+	// the header is padded so that the blocks stay aligned
+	CSlab *pSlab = (CSlab *)malloc(ALIGNMENT + m_BlockSize * m_SlabBlocks);
+	dbg_assert(pSlab != 0, "out of memory");
+	pSlab->m_pNext = m_pSlabs;
+	m_pSlabs = pSlab;
+	m_NumSlabs++;
+
+	// chain the blocks in address order, so that a run of allocations
+	// is laid out one after another
+	char *pBlocks = (char *)pSlab + ALIGNMENT;
+	for(int i = m_SlabBlocks - 1; i >= 0; i--)
+	{
+		void *pBlock = pBlocks + i * m_BlockSize;
+		*(void **)pBlock = m_pFree;
+		m_pFree = pBlock;
+	}
+}
+
+void *CPool::Allocate()
+{
+	if(!m_pFree)
+		NewSlab();
+	void *pBlock = m_pFree;
+	m_pFree = *(void **)pBlock;
+	if(++m_NumLive > m_PeakLive)
+		m_PeakLive = m_NumLive;
+	return pBlock;
+}
+
+void CPool::Free(void *pBlock)
+{
+	if(!pBlock)
+		return;
+	*(void **)pBlock = m_pFree;
+	m_pFree = pBlock;
+	m_NumLive--;
+}
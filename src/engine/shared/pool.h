@@ -0,0 +1,42 @@
+#ifndef ENGINE_SHARED_POOL_H
+#define ENGINE_SHARED_POOL_H
+
+// hands out blocks of one size from slabs of many blocks. freed blocks are
+// handed out again first, newest first, so they are likely still cached.
+// the slabs are only given back to the system with the pool
+class CPool
+{
+	struct CSlab
+	{
+		CSlab *m_pNext;
+	};
+
+	enum
+	{
+		ALIGNMENT=16,
+	};
+
+	int m_BlockSize;
+	int m_SlabBlocks;
+	CSlab *m_pSlabs;
+	void *m_pFree;
+
+	int m_NumSlabs;
+	int m_NumLive;
+	int m_PeakLive;
+
+	void NewSlab();
+
+public:
+	CPool(int BlockSize, int SlabBlocks = 64);
+	~CPool();
+
+	void *Allocate();
+	void Free(void *pBlock);
+
+	int NumLive() const { return m_NumLive; }
+	int PeakLive() const { return m_PeakLive; }
+	int Capacity() const { return m_NumSlabs * m_SlabBlocks; }
+};
+
+#endif
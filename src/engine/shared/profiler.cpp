@@ -0,0 +1,187 @@
+#include <base/math.h>
+
+#include "profiler.h"
+
+CProfiler g_Profiler;
+
+CProfiler::CProfiler()
+{
+	m_NumPhases = 0;
+	m_Enabled = false;
+	m_Rolling = true;
+	m_TraceFile = 0;
+	m_TraceStart = 0;
+	m_TraceFirstEvent = true;
+	Reset();
+}
+
+int CProfiler::Bucket(int Microseconds)
+{
+	// exact below 16us, above that 8 buckets per power of two, so the
+	// value of a bucket is off by at most 6%
+	if(Microseconds < 16)
+		return maximum(Microseconds, 0);
+	int Exponent = 4;
+	while(Microseconds >> (Exponent+1))
+		Exponent++;
+	return 16 + (Exponent-4)*8 + ((Microseconds >> (Exponent-3)) & 7);
+}
+
+int CProfiler::BucketValue(int Bucket)
+{
+	if(Bucket < 16)
+		return Bucket;
+	int Shift = (Bucket-16)/8 + 1;
+	return ((8 + (Bucket-16)%8) << Shift) + (1 << Shift)/2;
+}
+
+int CProfiler::Register(const char *pName)
+{
+	for(int i = 0; i < m_NumPhases; i++)
+		if(str_comp(m_aPhases[i].m_aName, pName) == 0)
+			return i;
+	if(m_NumPhases == MAX_PHASES)
+	{
+		dbg_msg("profiler", "too many phases, not profiling '%s'", pName);
+		return -1;
+	}
+	CPhase *pPhase = &m_aPhases[m_NumPhases];
+	mem_zero(pPhase, sizeof(*pPhase));
+	str_copy(pPhase->m_aName, pName, sizeof(pPhase->m_aName));
+	return m_NumPhases++;
+}
+
+void CProfiler::SetEnabled(bool Enabled)
+{
+	if(Enabled && !m_Enabled)
+		Reset();
+	m_Enabled = Enabled;
+}
+
+void CProfiler::Reset()
+{
+	for(int i = 0; i < m_NumPhases; i++)
+	{
+		m_aPhases[i].m_FrameTime = 0;
+		m_aPhases[i].m_FrameCount = 0;
+		mem_zero(m_aPhases[i].m_aWindows, sizeof(m_aPhases[i].m_aWindows));
+	}
+	m_CurrentWindow = 0;
+	m_WindowFrames = 0;
+}
+
+void CProfiler::Add(int Phase, int64 Start, int64 End)
+{
+	if(Phase < 0)
+		return;
+	m_aPhases[Phase].m_FrameTime += End - Start;
+	m_aPhases[Phase].m_FrameCount++;
+	if(m_TraceFile)
+		WriteTraceEvent(Phase, Start, End);
+}
+
+void CProfiler::AddDuration(int Phase, int64 Duration)
+{
+	if(Phase < 0)
+		return;
+	m_aPhases[Phase].m_FrameTime += Duration;
+	m_aPhases[Phase].m_FrameCount++;
+}
+
+void CProfiler::EndFrame()
+{
+	if(!m_Enabled)
+	{
+		// only tracing, the samples aren't wanted
+		for(int i = 0; i < m_NumPhases; i++)
+		{
+			m_aPhases[i].m_FrameTime = 0;
+			m_aPhases[i].m_FrameCount = 0;
+		}
+		return;
+	}
+
+	if(m_Rolling && ++m_WindowFrames > WINDOW_FRAMES)
+	{
+		m_CurrentWindow ^= 1;
+		m_WindowFrames = 1;
+		for(int i = 0; i < m_NumPhases; i++)
+			mem_zero(&m_aPhases[i].m_aWindows[m_CurrentWindow], sizeof(CWindow));
+	}
+
+	for(int i = 0; i < m_NumPhases; i++)
+	{
+		CPhase *pPhase = &m_aPhases[i];
+		if(!pPhase->m_FrameCount)
+			continue;
+		int Microseconds = (int)minimum(pPhase->m_FrameTime * 1000000 / time_freq(), (int64)0x7fffffff);
+		CWindow *pWindow = &pPhase->m_aWindows[m_CurrentWindow];
+		pWindow->m_aBuckets[Bucket(Microseconds)]++;
+		pWindow->m_NumSamples++;
+		pWindow->m_Total += Microseconds;
+		pWindow->m_Max = maximum(pWindow->m_Max, Microseconds);
+		pPhase->m_FrameTime = 0;
+		pPhase->m_FrameCount = 0;
+	}
+}
+
+void CProfiler::GetStats(int Phase, CStats *pStats) const
+{
+	const CPhase *pPhase = &m_aPhases[Phase];
+	pStats->m_pName = pPhase->m_aName;
+	pStats->m_NumSamples = pPhase->m_aWindows[0].m_NumSamples + pPhase->m_aWindows[1].m_NumSamples;
+	pStats->m_Total = pPhase->m_aWindows[0].m_Total + pPhase->m_aWindows[1].m_Total;
+	pStats->m_Max = maximum(pPhase->m_aWindows[0].m_Max, pPhase->m_aWindows[1].m_Max);
+	pStats->m_P50 = 0;
+	pStats->m_P99 = 0;
+	if(!pStats->m_NumSamples)
+		return;
+
+	int Rank50 = (pStats->m_NumSamples+1)/2;
+	int Rank99 = pStats->m_NumSamples - pStats->m_NumSamples/100;
+	int Seen = 0;
+	for(int b = 0; b < NUM_BUCKETS; b++)
+	{
+		int Count = pPhase->m_aWindows[0].m_aBuckets[b] + pPhase->m_aWindows[1].m_aBuckets[b];
+		if(!Count)
+			continue;
+		if(Seen < Rank50 && Seen + Count >= Rank50)
+			pStats->m_P50 = minimum(BucketValue(b), pStats->m_Max);
+		if(Seen < Rank99 && Seen + Count >= Rank99)
+		{
+			pStats->m_P99 = minimum(BucketValue(b), pStats->m_Max);
+			break;
+		}
+		Seen += Count;
+	}
+}
+
+void CProfiler::StartTrace(IOHANDLE File)
+{
+	StopTrace();
+	m_TraceFile = File;
+	m_TraceStart = time_get_impl();
+	m_TraceFirstEvent = true;
+	const char *pHeader = "{\"traceEvents\":[\n";
+	io_write(m_TraceFile, pHeader, str_length(pHeader));
+}
+
+void CProfiler::StopTrace()
+{
+	if(!m_TraceFile)
+		return;
+	const char *pFooter = "\n],\"displayTimeUnit\":\"ms\"}\n";
+	io_write(m_TraceFile, pFooter, str_length(pFooter));
+	io_close(m_TraceFile);
+	m_TraceFile = 0;
+}
+
+void CProfiler::WriteTraceEvent(int Phase, int64 Start, int64 End)
+{
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+		m_TraceFirstEvent ? "" : ",\n", m_aPhases[Phase].m_aName,
+		(Start - m_TraceStart) * 1000000.0 / time_freq(), (End - Start) * 1000000.0 / time_freq());
+	io_write(m_TraceFile, aBuf, str_length(aBuf));
+	m_TraceFirstEvent = false;
+}
@@ -0,0 +1,111 @@
+#ifndef ENGINE_SHARED_PROFILER_H
+#define ENGINE_SHARED_PROFILER_H
+
+#include <base/system.h>
+
+// collects the time spent in named phases of the server loop. a phase can
+// run several times per frame (one tick of the server), the sum is kept as
+// one sample in a log scale histogram. the histograms cover the last 10 to
+// 20 seconds, older samples are dropped a window at a time
+//
+// every call, AddDuration included, is for the main thread only, nothing
+// is locked. while the profiler is off, a scope costs one branch. times
+// come from time_get_impl, time_get only advances once per server loop
+class CProfiler
+{
+public:
+	enum
+	{
+		MAX_PHASES=32,
+		NUM_BUCKETS=256,
+		WINDOW_FRAMES=500,
+	};
+
+	struct CStats
+	{
+		const char *m_pName;
+		int m_NumSamples;
+		int64 m_Total;
+		int m_P50;
+		int m_P99;
+		int m_Max;
+	};
+
+private:
+	struct CWindow
+	{
+		int m_aBuckets[NUM_BUCKETS];
+		int m_NumSamples;
+		int64 m_Total;
+		int m_Max;
+	};
+
+	struct CPhase
+	{
+		char m_aName[32];
+		int64 m_FrameTime;
+		int m_FrameCount;
+		CWindow m_aWindows[2];
+	};
+
+	CPhase m_aPhases[MAX_PHASES];
+	int m_NumPhases;
+	int m_CurrentWindow;
+	int m_WindowFrames;
+	bool m_Enabled;
+	bool m_Rolling;
+
+	IOHANDLE m_TraceFile;
+	int64 m_TraceStart;
+	bool m_TraceFirstEvent;
+
+	static int Bucket(int Microseconds);
+	static int BucketValue(int Bucket);
+	void WriteTraceEvent(int Phase, int64 Start, int64 End);
+
+public:
+	CProfiler();
+
+	// returns the phase with this name, adding it if it is new
+	int Register(const char *pName);
+
+	void SetEnabled(bool Enabled);
+	// without rolling windows the stats cover everything since the last
+	// reset, for benchmarks
+	void SetRolling(bool Rolling) { m_Rolling = Rolling; }
+	bool Active() const { return m_Enabled || m_TraceFile; }
+	void Reset();
+
+	void Add(int Phase, int64 Start, int64 End);
+	// for time measured elsewhere, for example by worker threads. the main
+	// thread passes it on once they are done
+	void AddDuration(int Phase, int64 Duration);
+	void EndFrame();
+
+	int NumPhases() const { return m_NumPhases; }
+	void GetStats(int Phase, CStats *pStats) const;
+
+	// writes all scopes as chrome trace events (chrome://tracing, perfetto)
+	// until StopTrace, takes ownership of the file
+	void StartTrace(IOHANDLE File);
+	void StopTrace();
+	bool Tracing() const { return m_TraceFile != 0; }
+};
+
+extern CProfiler g_Profiler;
+
+class CProfileScope
+{
+	int m_Phase;
+	int64 m_Start;
+
+public:
+	CProfileScope(int Phase) : m_Phase(Phase), m_Start(g_Profiler.Active() ? time_get_impl() : 0) {}
+	~CProfileScope()
+	{
+		if(m_Start)
+			g_Profiler.Add(m_Phase, m_Start, time_get_impl());
+	}
+};
+
+#endif
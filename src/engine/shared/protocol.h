@@ -4,6 +4,7 @@
 #define ENGINE_SHARED_PROTOCOL_H
 
 #include <base/system.h>
+#include "bitset.h"
 
 /*
 	Connection diagram - How the initialization works.
@@ -74,13 +75,19 @@ enum
 	NUM_NETMSGS,
 };
 
+// the client count can be raised at build time, clients need to be
+// built with the same value to see more than 64 players
+#ifndef CONF_MAX_CLIENTS
+#define CONF_MAX_CLIENTS 64
+#endif
+
 // this should be revised
 enum
 {
 	SERVER_TICK_SPEED=50,
 	SERVER_FLAG_PASSWORD = 0x1,
 
-	MAX_CLIENTS=64,
+	MAX_CLIENTS=CONF_MAX_CLIENTS,
 	VANILLA_MAX_CLIENTS=16,
 
 	MAX_INPUT_SIZE=128,
@@ -94,9 +101,12 @@ enum
 	MSGFLAG_FLUSH=2,
 	MSGFLAG_NORECORD=4,
 	MSGFLAG_RECORD=8,
-	MSGFLAG_NOSEND=16
+	MSGFLAG_NOSEND=16,
+	MSGFLAG_PRIORITY=32
 };
 
+typedef CBitset<MAX_CLIENTS> CClientMask;
+
 enum
 {
 	VERSION_VANILLA = 0,
@@ -87,84 +87,333 @@ void CSnapshot::DebugDump()
 
 // CSnapshotDelta
 
-struct CItemList
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SNAPSHOT_SSE2 1
+	#include <emmintrin.h>
+	#if defined(__GNUC__)
+		#define SNAPSHOT_AVX2 1
+		#include <immintrin.h>
+	#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define SNAPSHOT_NEON 1
+	#include <arm_neon.h>
+#endif
+
+typedef int (*FDiffItem)(const int *pPast, const int *pCurrent, int *pOut, int Size);
+typedef void (*FUndiffItem)(const int *pPast, const int *pDiff, int *pOut, int Size);
+
+static int DiffItemScalar(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
+	int Needed = 0;
+	while(Size)
+	{
+		*pOut = (int)((unsigned)*pCurrent-(unsigned)*pPast);
+		Needed |= *pOut;
+		pOut++;
+		pPast++;
+		pCurrent++;
+		Size--;
+	}
 
-enum
+	return Needed;
+}
+
+static void UndiffItemScalar(const int *pPast, const int *pDiff, int *pOut, int Size)
 {
-	HASHLIST_SIZE = 256,
-};
+	while(Size)
+	{
+		*pOut = (int)((unsigned)*pPast+(unsigned)*pDiff);
+		pOut++;
+		pPast++;
+		pDiff++;
+		Size--;
+	}
+}
+
+#if defined(SNAPSHOT_SSE2)
+static int DiffItemSSE2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m128i Needed = _mm_setzero_si128();
+	int i = 0;
+	for(; i+4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent+i)), _mm_loadu_si128((const __m128i *)(pPast+i)));
+		_mm_storeu_si128((__m128i *)(pOut+i), Diff);
+		Needed = _mm_or_si128(Needed, Diff);
+	}
+	Needed = _mm_or_si128(Needed, _mm_shuffle_epi32(Needed, _MM_SHUFFLE(1, 0, 3, 2)));
+	Needed = _mm_or_si128(Needed, _mm_shuffle_epi32(Needed, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Needed) | DiffItemScalar(pPast+i, pCurrent+i, pOut+i, Size-i);
+}
 
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+static void UndiffItemSSE2(const int *pPast, const int *pDiff, int *pOut, int Size)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	int i = 0;
+	for(; i+4 <= Size; i += 4)
+		_mm_storeu_si128((__m128i *)(pOut+i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast+i)), _mm_loadu_si128((const __m128i *)(pDiff+i))));
+	UndiffItemScalar(pPast+i, pDiff+i, pOut+i, Size-i);
+}
+#endif
 
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+#if defined(SNAPSHOT_AVX2)
+__attribute__((target("avx2")))
+static int DiffItemAVX2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m256i Needed = _mm256_setzero_si256();
+	int i = 0;
+	for(; i+8 <= Size; i += 8)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		if(pHashlist[HashID].m_Num != 64)
-		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
-		}
+		__m256i Diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(pCurrent+i)), _mm256_loadu_si256((const __m256i *)(pPast+i)));
+		_mm256_storeu_si256((__m256i *)(pOut+i), Diff);
+		Needed = _mm256_or_si256(Needed, Diff);
 	}
+	__m128i Needed128 = _mm_or_si128(_mm256_castsi256_si128(Needed), _mm256_extracti128_si256(Needed, 1));
+	Needed128 = _mm_or_si128(Needed128, _mm_shuffle_epi32(Needed128, _MM_SHUFFLE(1, 0, 3, 2)));
+	Needed128 = _mm_or_si128(Needed128, _mm_shuffle_epi32(Needed128, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Needed128) | DiffItemSSE2(pPast+i, pCurrent+i, pOut+i, Size-i);
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+__attribute__((target("avx2")))
+static void UndiffItemAVX2(const int *pPast, const int *pDiff, int *pOut, int Size)
 {
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
-		{
-			if(pHashlist[HashID].m_aKeys[i] == Key)
-				return pHashlist[HashID].m_aIndex[i];
+	int i = 0;
+	for(; i+8 <= Size; i += 8)
+		_mm256_storeu_si256((__m256i *)(pOut+i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(pPast+i)), _mm256_loadu_si256((const __m256i *)(pDiff+i))));
+	UndiffItemSSE2(pPast+i, pDiff+i, pOut+i, Size-i);
+}
+#endif
+
+#if defined(SNAPSHOT_NEON)
+static int DiffItemNEON(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	int32x4_t Needed = vdupq_n_s32(0);
+	int i = 0;
+	for(; i+4 <= Size; i += 4)
+	{
+		int32x4_t Diff = vsubq_s32(vld1q_s32(pCurrent+i), vld1q_s32(pPast+i));
+		vst1q_s32(pOut+i, Diff);
+		Needed = vorrq_s32(Needed, Diff);
 	}
+	int32x2_t Needed64 = vorr_s32(vget_low_s32(Needed), vget_high_s32(Needed));
+	return vget_lane_s32(Needed64, 0) | vget_lane_s32(Needed64, 1) | DiffItemScalar(pPast+i, pCurrent+i, pOut+i, Size-i);
+}
 
-	return -1;
+static void UndiffItemNEON(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	int i = 0;
+	for(; i+4 <= Size; i += 4)
+		vst1q_s32(pOut+i, vaddq_s32(vld1q_s32(pPast+i), vld1q_s32(pDiff+i)));
+	UndiffItemScalar(pPast+i, pDiff+i, pOut+i, Size-i);
 }
+#endif
 
-int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+static bool DiffImplSupported(int Impl)
 {
-	int Needed = 0;
-	while(Size)
+	switch(Impl)
 	{
-		*pOut = *pCurrent-*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+	case CSnapshotDelta::DIFFIMPL_SCALAR:
+		return true;
+#if defined(SNAPSHOT_SSE2)
+	case CSnapshotDelta::DIFFIMPL_SSE2:
+		return true;
+#endif
+#if defined(SNAPSHOT_AVX2)
+	case CSnapshotDelta::DIFFIMPL_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+#if defined(SNAPSHOT_NEON)
+	case CSnapshotDelta::DIFFIMPL_NEON:
+		return true;
+#endif
 	}
+	return false;
+}
 
-	return Needed;
+static FDiffItem s_pfnDiffItem = DiffItemScalar;
+static FUndiffItem s_pfnUndiffItem = UndiffItemScalar;
+static int s_DiffImpl = CSnapshotDelta::DIFFIMPL_SCALAR;
+
+static bool SelectBestDiffImpl()
+{
+	for(int i = CSnapshotDelta::NUM_DIFFIMPLS-1; i > CSnapshotDelta::DIFFIMPL_SCALAR; i--)
+	{
+		if(CSnapshotDelta::SetDiffImpl(i))
+			return true;
+	}
+	return false;
 }
+static bool s_DiffImplSelected = SelectBestDiffImpl();
 
-void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size)
+bool CSnapshotDelta::SetDiffImpl(int Impl)
 {
-	while(Size)
+	if(!DiffImplSupported(Impl))
+		return false;
+
+	switch(Impl)
 	{
-		*pOut = *pPast+*pDiff;
+#if defined(SNAPSHOT_SSE2)
+	case DIFFIMPL_SSE2: s_pfnDiffItem = DiffItemSSE2; s_pfnUndiffItem = UndiffItemSSE2; break;
+#endif
+#if defined(SNAPSHOT_AVX2)
+	case DIFFIMPL_AVX2: s_pfnDiffItem = DiffItemAVX2; s_pfnUndiffItem = UndiffItemAVX2; break;
+#endif
+#if defined(SNAPSHOT_NEON)
+	case DIFFIMPL_NEON: s_pfnDiffItem = DiffItemNEON; s_pfnUndiffItem = UndiffItemNEON; break;
+#endif
+	default: s_pfnDiffItem = DiffItemScalar; s_pfnUndiffItem = UndiffItemScalar; break;
+	}
+	s_DiffImpl = Impl;
+	return true;
+}
 
-		if(*pDiff == 0)
-			m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
-		else
+int CSnapshotDelta::GetDiffImpl()
+{
+	return s_DiffImpl;
+}
+
+const char *CSnapshotDelta::DiffImplName(int Impl)
+{
+	static const char *s_apNames[NUM_DIFFIMPLS] = {"scalar", "sse2", "avx2", "neon"};
+	if(Impl < 0 || Impl >= NUM_DIFFIMPLS)
+		return "unknown";
+	return s_apNames[Impl];
+}
+
+// open addressing index from item key to item index, replaces the linear
+// searches and the 256 fixed buckets that used to be rebuilt on every call
+class CItemIndex
+{
+public:
+	enum
+	{
+		MAX_ITEMS=1024,
+		MAX_SLOTS=MAX_ITEMS*2,
+		// CreateDelta used to store at most 64 keys per bucket and treated
+		// the rest as missing, keep that so that the deltas stay the same
+		BUCKET_LIMIT=64,
+	};
+
+	const CSnapshot *m_pSnapshot;
+	int m_NumItems;
+	bool m_Capped;
+	int m_Mask;
+	int m_aItemKeys[MAX_ITEMS];
+	int m_aSlotKeys[MAX_SLOTS];
+	short m_aSlotIndex[MAX_SLOTS];
+
+	CItemIndex() : m_pSnapshot(0), m_NumItems(-1), m_Capped(false), m_Mask(0) {}
+
+	static unsigned Hash(int Key) { return ((unsigned)Key * 2654435761u) >> 16; }
+
+	bool Matches(CSnapshot *pSnapshot, bool Capped) const
+	{
+		if(m_pSnapshot != pSnapshot || m_NumItems != pSnapshot->NumItems() || m_Capped != Capped)
+			return false;
+		for(int i = 0; i < m_NumItems; i++)
 		{
-			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
-			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char*)aBuf) * 8;
+			if(m_aItemKeys[i] != pSnapshot->GetItem(i)->Key())
+				return false;
 		}
+		return true;
+	}
 
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
+	bool Build(CSnapshot *pSnapshot, bool Capped)
+	{
+		int NumItems = pSnapshot->NumItems();
+		m_pSnapshot = 0;
+		if(NumItems > MAX_ITEMS)
+			return false;
+
+		int NumSlots = 16;
+		while(NumSlots < NumItems*2)
+			NumSlots <<= 1;
+		m_Mask = NumSlots-1;
+		for(int i = 0; i < NumSlots; i++)
+			m_aSlotIndex[i] = -1;
+
+		unsigned char aBucketCount[256] = {0};
+		for(int i = 0; i < NumItems; i++)
+		{
+			int Key = pSnapshot->GetItem(i)->Key();
+			m_aItemKeys[i] = Key;
+
+			if(Capped)
+			{
+				int HashID = ((Key>>12)&0xf0) | (Key&0xf);
+				if(aBucketCount[HashID] == BUCKET_LIMIT)
+					continue;
+				aBucketCount[HashID]++;
+			}
+
+			// keep the first item for duplicate keys like a linear search
+			unsigned Slot = Hash(Key)&m_Mask;
+			while(m_aSlotIndex[Slot] != -1 && m_aSlotKeys[Slot] != Key)
+				Slot = (Slot+1)&m_Mask;
+			if(m_aSlotIndex[Slot] == -1)
+			{
+				m_aSlotKeys[Slot] = Key;
+				m_aSlotIndex[Slot] = i;
+			}
+		}
+
+		m_pSnapshot = pSnapshot;
+		m_NumItems = NumItems;
+		m_Capped = Capped;
+		return true;
+	}
+
+	int Find(int Key) const
+	{
+		unsigned Slot = Hash(Key)&m_Mask;
+		while(m_aSlotIndex[Slot] != -1)
+		{
+			if(m_aSlotKeys[Slot] == Key)
+				return m_aSlotIndex[Slot];
+			Slot = (Slot+1)&m_Mask;
+		}
+		return -1;
+	}
+};
+
+// the from snapshot is often the same for several deltas in a row (the
+// client doesn't ack or the server builds the deltas for a demo), so keep
+// its index around, per thread because the server deltas in parallel
+static CItemIndex *GetFromIndex(CSnapshot *pFrom, bool Capped)
+{
+	static thread_local CItemIndex s_Index;
+	if(!s_Index.Matches(pFrom, Capped) && !s_Index.Build(pFrom, Capped))
+		return 0;
+	return &s_Index;
+}
+
+static int VarIntBits(int Value)
+{
+	// bits CVariableInt::Pack needs for a non-zero value
+	Value ^= Value>>31;
+	Value >>= 6;
+	int Bytes = 1;
+	while(Value)
+	{
+		Bytes++;
+		Value >>= 7;
 	}
+	return Bytes*8;
+}
+
+int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+{
+	return s_pfnDiffItem(pPast, pCurrent, pOut, Size);
+}
+
+void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size)
+{
+	s_pfnUndiffItem(pPast, pDiff, pOut, Size);
+
+	int Rate = 0;
+	for(int i = 0; i < Size; i++)
+		Rate += pDiff[i] ? VarIntBits(pDiff[i]) : 1;
+	m_aSnapshotDataRate[m_SnapshotCurrent] += Rate;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -195,7 +444,6 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
@@ -211,14 +459,16 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList Hashlist[HASHLIST_SIZE];
-	GenerateHash(Hashlist, pTo);
+	CItemIndex ToIndex;
+	CItemIndex *pFromIndex = GetFromIndex(pFrom, true);
+	if(!ToIndex.Build(pTo, true) || !pFromIndex)
+		return 0;
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
 		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), Hashlist) == -1)
+		if(ToIndex.Find(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -227,8 +477,7 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		}
 	}
 
-	GenerateHash(Hashlist, pFrom);
-	int aPastIndecies[1024];
+	int aPastIndecies[CItemIndex::MAX_ITEMS];
 
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
@@ -236,7 +485,7 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	for(i = 0; i < NumItems; i++)
 	{
 		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndecies[i] = GetItemIndexHashed(pCurItem->Key(), Hashlist); // O(n) .. O(n^n)
+		aPastIndecies[i] = pFromIndex->Find(pCurItem->Key());
 	}
 
 	for(i = 0; i < NumItems; i++)
@@ -329,6 +578,8 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 	Builder.Init();
 
+	CItemIndex *pFromIndex = GetFromIndex(pFrom, false);
+
 	// unpack deleted stuff
 	pDeleted = pData;
 	pData += pDelta->m_NumDeletedItems;
@@ -390,7 +641,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 		//if(range_check(pEnd, pNewData, ItemSize)) return -4;
 
-		FromIndex = pFrom->GetItemIndex(Key);
+		FromIndex = pFromIndex ? pFromIndex->Find(Key) : pFrom->GetItemIndex(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need pTo apply the diff
@@ -414,12 +665,101 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 // CSnapshotStorage
 
+CSnapshotStorage::CSnapshotStorage()
+{
+	m_pFirst = 0;
+	m_pLast = 0;
+	m_paSlots = 0;
+	m_NumSlots = 0;
+	m_pArena = 0;
+	m_ArenaSize = 0;
+	m_ArenaRead = 0;
+	m_ArenaWrite = 0;
+}
+
+CSnapshotStorage::~CSnapshotStorage()
+{
+	PurgeAll();
+	free(m_paSlots);
+	free(m_pArena);
+}
+
 void CSnapshotStorage::Init()
 {
 	m_pFirst = 0;
 	m_pLast = 0;
 }
 
+void CSnapshotStorage::InitRing(int NumTicks, int ArenaSize)
+{
+	PurgeAll();
+	free(m_paSlots);
+	free(m_pArena);
+
+	// power of two, so that slot lookup is a mask
+	m_NumSlots = 1;
+	while(m_NumSlots < NumTicks)
+		m_NumSlots <<= 1;
+	m_paSlots = (CHolder *)calloc(m_NumSlots, sizeof(CHolder));
+	m_ArenaSize = ArenaSize;
+	m_pArena = (char *)malloc(ArenaSize);
+	m_ArenaRead = 0;
+	m_ArenaWrite = 0;
+}
+
+char *CSnapshotStorage::ArenaAlloc(int Size)
+{
+	// data is allocated in tick order and freed from the front, the live
+	// range is [m_ArenaRead, m_ArenaWrite) and may wrap around the end
+	Size = (Size+7)&~7;
+	if(m_ArenaWrite >= m_ArenaRead)
+	{
+		if(m_ArenaSize - m_ArenaWrite >= Size)
+		{
+			m_ArenaWrite += Size;
+			return m_pArena + m_ArenaWrite - Size;
+		}
+		// wrap, but never let write catch up with read
+		if(m_ArenaRead > Size)
+		{
+			m_ArenaWrite = Size;
+			return m_pArena;
+		}
+	}
+	else if(m_ArenaRead - m_ArenaWrite > Size)
+	{
+		m_ArenaWrite += Size;
+		return m_pArena + m_ArenaWrite - Size;
+	}
+	return 0;
+}
+
+void CSnapshotStorage::Free(CHolder *pHolder)
+{
+	if(!m_paSlots)
+	{
+		free(pHolder);
+		return;
+	}
+
+	if(!InArena(pHolder->m_pSnap))
+		free(pHolder->m_pSnap);
+	pHolder->m_pSnap = 0;
+
+	// holders are freed oldest first, move the arena read position to
+	// the oldest data still in use
+	for(CHolder *pNext = pHolder->m_pNext; pNext; pNext = pNext->m_pNext)
+	{
+		if(InArena(pNext->m_pSnap))
+		{
+			m_ArenaRead = (char *)pNext->m_pSnap - m_pArena;
+			return;
+		}
+	}
+	m_ArenaRead = 0;
+	m_ArenaWrite = 0;
+}
+
 void CSnapshotStorage::PurgeAll()
 {
 	CHolder *pHolder = m_pFirst;
@@ -428,13 +768,15 @@ void CSnapshotStorage::PurgeAll()
 	while(pHolder)
 	{
 		pNext = pHolder->m_pNext;
-		free(pHolder);
+		Free(pHolder);
 		pHolder = pNext;
 	}
 
 	// no more snapshots in storage
 	m_pFirst = 0;
 	m_pLast = 0;
+	m_ArenaRead = 0;
+	m_ArenaWrite = 0;
 }
 
 void CSnapshotStorage::PurgeUntil(int Tick)
@@ -447,7 +789,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 		pNext = pHolder->m_pNext;
 		if(pHolder->m_Tick >= Tick)
 			return; // no more to remove
-		free(pHolder);
+		Free(pHolder);
 
 		// did we come to the end of the list?
 		if (!pNext)
@@ -466,19 +808,35 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 
 void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt)
 {
-	// allocate memory for holder + snapshot_data
-	int TotalSize = sizeof(CHolder)+DataSize;
-
-	if(CreateAlt)
-		TotalSize += DataSize;
+	CHolder *pHolder;
+	int SnapSize = CreateAlt ? DataSize*2 : DataSize;
 
-	CHolder *pHolder = (CHolder *)malloc(TotalSize);
+	if(m_paSlots)
+	{
+		// the slot is taken by a snapshot that is more than m_NumSlots
+		// ticks older, drop it and everything before it
+		pHolder = &m_paSlots[Tick&(m_NumSlots-1)];
+		if(pHolder->m_pSnap)
+			PurgeUntil(pHolder->m_Tick+1);
+		// ticks are expected to increase, drop the rest otherwise
+		if(m_pLast && m_pLast->m_Tick >= Tick)
+			PurgeAll();
+
+		pHolder->m_pSnap = (CSnapshot *)ArenaAlloc(SnapSize);
+		if(!pHolder->m_pSnap)
+			pHolder->m_pSnap = (CSnapshot *)malloc(SnapSize);
+	}
+	else
+	{
+		// allocate memory for holder + snapshot_data
+		pHolder = (CHolder *)malloc(sizeof(CHolder)+SnapSize);
+		pHolder->m_pSnap = (CSnapshot*)(pHolder+1);
+	}
 
 	// set data
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
 	pHolder->m_SnapSize = DataSize;
-	pHolder->m_pSnap = (CSnapshot*)(pHolder+1);
 	mem_copy(pHolder->m_pSnap, pData, DataSize);
 
 	if(CreateAlt) // create alternative if wanted
@@ -502,25 +860,33 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 
 int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
 {
-	CHolder *pHolder = m_pFirst;
+	CHolder *pHolder = 0;
 
-	while(pHolder)
+	if(m_paSlots)
+	{
+		pHolder = &m_paSlots[Tick&(m_NumSlots-1)];
+		if(!pHolder->m_pSnap || pHolder->m_Tick != Tick)
+			pHolder = 0;
+	}
+	else
 	{
-		if(pHolder->m_Tick == Tick)
+		for(pHolder = m_pFirst; pHolder; pHolder = pHolder->m_pNext)
 		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
+			if(pHolder->m_Tick == Tick)
+				break;
 		}
-
-		pHolder = pHolder->m_pNext;
 	}
 
-	return -1;
+	if(!pHolder)
+		return -1;
+
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->m_pSnap;
+	if(ppAltData)
+		*ppAltData = pHolder->m_pAltSnap;
+	return pHolder->m_SnapSize;
 }
 
 // CSnapshotBuilder
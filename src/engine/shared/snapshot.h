@@ -74,6 +74,21 @@ private:
 	void UndiffItem(int *pPast, int *pDiff, int *pOut, int Size);
 
 public:
+	enum
+	{
+		DIFFIMPL_SCALAR=0,
+		DIFFIMPL_SSE2,
+		DIFFIMPL_AVX2,
+		DIFFIMPL_NEON,
+		NUM_DIFFIMPLS
+	};
+
+	// the item diff kernels are picked at startup, the best one the cpu
+	// supports is used. all of them produce the same output
+	static bool SetDiffImpl(int Impl);
+	static int GetDiffImpl();
+	static const char *DiffImplName(int Impl);
+
 	static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &old);
@@ -109,7 +124,28 @@ public:
 	CHolder *m_pFirst;
 	CHolder *m_pLast;
 
+private:
+	// ring mode: holders live in a slot array indexed by tick and the
+	// snapshot data in one contiguous arena that is used as a fifo
+	CHolder *m_paSlots;
+	int m_NumSlots;
+	char *m_pArena;
+	int m_ArenaSize;
+	int m_ArenaRead;
+	int m_ArenaWrite;
+
+	bool InArena(const void *pData) const { return m_pArena && (const char *)pData >= m_pArena && (const char *)pData < m_pArena + m_ArenaSize; }
+	char *ArenaAlloc(int Size);
+	void Free(CHolder *pHolder);
+
+public:
+	CSnapshotStorage();
+	~CSnapshotStorage();
+
 	void Init();
+	// keeps up to NumTicks consecutive ticks without allocating per snapshot,
+	// snapshots that don't fit into the arena fall back to the heap
+	void InitRing(int NumTicks, int ArenaSize);
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt);
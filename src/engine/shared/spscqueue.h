@@ -0,0 +1,61 @@
+#ifndef ENGINE_SHARED_SPSCQUEUE_H
+#define ENGINE_SHARED_SPSCQUEUE_H
+
+#include <atomic>
+
+// lock-free queue for exactly one producer and one consumer thread
+//
+// the producer fills the slot returned by Back() and publishes it with
+// Push(), the consumer reads Front() and releases it with Pop()
+template<typename T, int TSIZE>
+class TSpscQueue
+{
+	T m_aItems[TSIZE];
+	std::atomic<unsigned> m_Read;
+	std::atomic<unsigned> m_Write;
+
+public:
+	TSpscQueue() : m_Read(0), m_Write(0) {}
+
+	// producer side
+	T *Back()
+	{
+		unsigned Write = m_Write.load(std::memory_order_relaxed);
+		if(Write - m_Read.load(std::memory_order_acquire) >= (unsigned)TSIZE)
+			return 0;
+		return &m_aItems[Write%TSIZE];
+	}
+	void Push() { m_Write.store(m_Write.load(std::memory_order_relaxed)+1, std::memory_order_release); }
+	bool Push(const T &Item)
+	{
+		T *pItem = Back();
+		if(!pItem)
+			return false;
+		*pItem = Item;
+		Push();
+		return true;
+	}
+
+	// consumer side
+	T *Front()
+	{
+		unsigned Read = m_Read.load(std::memory_order_relaxed);
+		if(Read == m_Write.load(std::memory_order_acquire))
+			return 0;
+		return &m_aItems[Read%TSIZE];
+	}
+	void Pop() { m_Read.store(m_Read.load(std::memory_order_relaxed)+1, std::memory_order_release); }
+	bool Pop(T *pItem)
+	{
+		T *pFront = Front();
+		if(!pFront)
+			return false;
+		*pItem = *pFront;
+		Pop();
+		return true;
+	}
+
+	int Size() const { return (int)(m_Write.load(std::memory_order_acquire) - m_Read.load(std::memory_order_acquire)); }
+};
+
+#endif
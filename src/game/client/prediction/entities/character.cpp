@@ -931,11 +931,19 @@ void CCharacter::DDRacePostCoreTick()
 	HandleSkippableTiles(CurrentIndex);
 
 	// handle Anti-Skip tiles
-	std::list < int > Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
-		for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
-			HandleTiles(*i);
-	else
+	vec2 PrevPos = m_PrevPos;
+	vec2 Pos = m_Pos;
+	int aIndices[16];
+	CCollision::CMapIndicesCursor Cursor;
+	bool Found = false;
+	int Num;
+	while((Num = Collision()->GetMapIndices(PrevPos, Pos, aIndices, 16, &Cursor)) > 0)
+	{
+		Found = true;
+		for(int i = 0; i < Num; i++)
+			HandleTiles(aIndices[i]);
+	}
+	if(!Found)
 	{
 		HandleTiles(CurrentIndex);
 	}
@@ -1,5 +1,4 @@
 #include <ctype.h>
-#include <list>
 
 #include <base/math.h>
 #include <engine/serverbrowser.h>
@@ -78,16 +77,22 @@ bool CRaceHelper::IsStart(CGameClient *pClient, vec2 Prev, vec2 Pos)
 	}
 	else
 	{
-		std::list < int > Indices = pCollision->GetMapIndices(Prev, Pos);
-		if(!Indices.empty())
-			for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
+		int aIndices[16];
+		CCollision::CMapIndicesCursor Cursor;
+		bool Found = false;
+		int Num;
+		while((Num = pCollision->GetMapIndices(Prev, Pos, aIndices, 16, &Cursor)) > 0)
+		{
+			Found = true;
+			for(int i = 0; i < Num; i++)
 			{
-				if(pCollision->GetTileIndex(*i) == TILE_BEGIN)
+				if(pCollision->GetTileIndex(aIndices[i]) == TILE_BEGIN)
 					return true;
-				if(pCollision->GetFTileIndex(*i) == TILE_BEGIN)
+				if(pCollision->GetFTileIndex(aIndices[i]) == TILE_BEGIN)
 					return true;
 			}
-		else
+		}
+		if(!Found)
 		{
 			if(pCollision->GetTileIndex(pCollision->GetPureMapIndex(Pos)) == TILE_BEGIN)
 				return true;
@@ -28,6 +28,7 @@ CCollision::CCollision()
 	m_pDoor = 0;
 	m_pSwitchers = 0;
 	m_pTune = 0;
+	m_pSpecial = 0;
 }
 
 CCollision::~CCollision()
@@ -129,6 +130,10 @@ void CCollision::Init(class CLayers *pLayers)
 			}
 		}
 	}
+
+	m_pSpecial = new unsigned char[m_Width*m_Height];
+	for(int i = 0; i < m_Width*m_Height; i++)
+		m_pSpecial[i] = FindSpecialTiles(i);
 }
 
 int CCollision::GetTile(int x, int y)
@@ -145,17 +150,123 @@ int CCollision::GetTile(int x, int y)
 	return 0;
 }
 
-// TODO: rewrite this smarter!
+// the line checks look at the line at every pixel, at the samples
+// mix(Pos0, Pos1, i/Divisor). what they check only depends on the tile
+// the rounded sample is in, so only the first sample in every tile has to
+// be looked at. they are found by stepping from tile border to tile border
+// and checking the guesses against the real samples, which gives exactly
+// the same positions as looking at every sample
+class CLineWalk
+{
+	vec2 m_Pos0;
+	vec2 m_Pos1;
+	float m_Divisor;
+	int m_NumSamples;
+	int m_Sample;
+	int m_TileX;
+	int m_TileY;
+
+	// sample of the next border in x and y and the samples between borders
+	float m_MaxX;
+	float m_MaxY;
+	float m_DeltaX;
+	float m_DeltaY;
+
+	static int Tile(float f)
+	{
+		int i = round_to_int(f);
+		return i >= 0 ? i / 32 : -((31 - i) / 32);
+	}
+
+	static void InitAxis(float Pos0, float Pos1, float Divisor, float Never, float *pMax, float *pDelta)
+	{
+		float Dir = Pos1 - Pos0;
+		if(Dir == 0)
+		{
+			*pMax = Never;
+			*pDelta = Never;
+			return;
+		}
+		// the rounded sample changes its tile half a pixel before the border
+		float Border = Tile(Pos0) * 32 - 0.5f + (Dir > 0 ? 32 : 0);
+		*pMax = (Border - Pos0) / Dir * Divisor;
+		*pDelta = 32 / absolute(Dir) * Divisor;
+	}
+
+	static void Advance(float *pMax, float Delta, float Sample)
+	{
+		if(*pMax < Sample)
+			*pMax += ceilf((Sample - *pMax) / Delta) * Delta;
+	}
+
+public:
+	CLineWalk(vec2 Pos0, vec2 Pos1, float Divisor, int NumSamples)
+	{
+		m_Pos0 = Pos0;
+		m_Pos1 = Pos1;
+		m_Divisor = Divisor;
+		m_NumSamples = NumSamples;
+		m_Sample = 0;
+		if(m_NumSamples <= 0)
+			return;
+		vec2 First = Pos(0);
+		m_TileX = Tile(First.x);
+		m_TileY = Tile(First.y);
+		InitAxis(Pos0.x, Pos1.x, Divisor, NumSamples * 2.0f, &m_MaxX, &m_DeltaX);
+		InitAxis(Pos0.y, Pos1.y, Divisor, NumSamples * 2.0f, &m_MaxY, &m_DeltaY);
+	}
+
+	bool Done() const { return m_Sample >= m_NumSamples; }
+	vec2 Pos(int Sample) const { return mix(m_Pos0, m_Pos1, Sample/m_Divisor); }
+	vec2 Pos() const { return Pos(m_Sample); }
+	vec2 PrevPos() const { return m_Sample ? Pos(m_Sample - 1) : m_Pos0; }
+
+	// go to the first sample in the next tile
+	void Next()
+	{
+		int i = m_Sample;
+		while(i < m_NumSamples - 1)
+		{
+			float Guess = minimum(m_MaxX, m_MaxY);
+			int j = Guess < m_NumSamples - 1 ? maximum(i + 1, (int)ceilf(Guess)) : m_NumSamples - 1;
+			vec2 Sample = Pos(j);
+			int TileX = Tile(Sample.x);
+			int TileY = Tile(Sample.y);
+			if(TileX != m_TileX || TileY != m_TileY)
+			{
+				// the guess can be late by a sample because of rounding
+				while(j - 1 > i)
+				{
+					Sample = Pos(j - 1);
+					if(Tile(Sample.x) == m_TileX && Tile(Sample.y) == m_TileY)
+						break;
+					TileX = Tile(Sample.x);
+					TileY = Tile(Sample.y);
+					j--;
+				}
+				Advance(&m_MaxX, m_DeltaX, j);
+				Advance(&m_MaxY, m_DeltaY, j);
+				m_Sample = j;
+				m_TileX = TileX;
+				m_TileY = TileY;
+				return;
+			}
+			i = j;
+			Advance(&m_MaxX, m_DeltaX, i);
+			Advance(&m_MaxY, m_DeltaY, i);
+		}
+		m_Sample = m_NumSamples;
+	}
+};
+
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	for(CLineWalk Walk(Pos0, Pos1, End, End+1); !Walk.Done(); Walk.Next())
 	{
-		float a = i/(float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walk.Pos();
 		ix = round_to_int(Pos.x);
 		iy = round_to_int(Pos.y);
 
@@ -164,11 +275,9 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -181,14 +290,12 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
+	for(CLineWalk Walk(Pos0, Pos1, End, End+1); !Walk.Done(); Walk.Next())
 	{
-		float a = i/(float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walk.Pos();
 		ix = round_to_int(Pos.x);
 		iy = round_to_int(Pos.y);
 
@@ -202,7 +309,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			return TILE_TELEINHOOK;
 		}
 
@@ -221,11 +328,9 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			return hit;
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -238,12 +343,10 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	for(CLineWalk Walk(Pos0, Pos1, End, End+1); !Walk.Done(); Walk.Next())
 	{
-		float a = i/(float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walk.Pos();
 		ix = round_to_int(Pos.x);
 		iy = round_to_int(Pos.y);
 
@@ -257,7 +360,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			return TILE_TELEINWEAPON;
 		}
 
@@ -266,11 +369,9 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -398,6 +499,8 @@ void CCollision::Dest()
 		delete[] m_pDoor;
 	if(m_pSwitchers)
 		delete[] m_pSwitchers;
+	if(m_pSpecial)
+		delete[] m_pSpecial;
 	m_pTiles = 0;
 	m_Width = 0;
 	m_Height = 0;
@@ -409,6 +512,7 @@ void CCollision::Dest()
 	m_pTune = 0;
 	m_pDoor = 0;
 	m_pSwitchers = 0;
+	m_pSpecial = 0;
 }
 
 int CCollision::IsSolid(int x, int y)
@@ -679,26 +783,35 @@ int CCollision::GetPureMapIndex(float x, float y)
 	return Ny*m_Width+Nx;
 }
 
-bool CCollision::TileExists(int Index)
+int CCollision::FindSpecialTiles(int Index)
 {
-	if(Index < 0)
-		return false;
-
+	int Special = 0;
 	if(m_pTiles[Index].m_Index >= TILE_FREEZE && m_pTiles[Index].m_Index <= TILE_ENTITIES_OFF_2)
-		return true;
+		Special |= SPECIAL_GAME;
 	if(m_pFront && m_pFront[Index].m_Index >= TILE_FREEZE && m_pFront[Index].m_Index  <= TILE_ENTITIES_OFF_2)
-		return true;
+		Special |= SPECIAL_FRONT;
 	if(m_pTele && (m_pTele[Index].m_Type == TILE_TELEIN || m_pTele[Index].m_Type == TILE_TELEINEVIL || m_pTele[Index].m_Type == TILE_TELECHECKINEVIL ||m_pTele[Index].m_Type == TILE_TELECHECK || m_pTele[Index].m_Type == TILE_TELECHECKIN))
-		return true;
+		Special |= SPECIAL_TELE;
 	if(m_pSpeedup && m_pSpeedup[Index].m_Force > 0)
-		return true;
+		Special |= SPECIAL_SPEEDUP;
 	if(m_pDoor && m_pDoor[Index].m_Index)
-		return true;
+		Special |= SPECIAL_DOOR;
 	if(m_pSwitch && m_pSwitch[Index].m_Type)
-		return true;
+		Special |= SPECIAL_SWITCH;
 	if(m_pTune && m_pTune[Index].m_Type)
-			return true;
-	return TileExistsNext(Index);
+		Special |= SPECIAL_TUNE;
+	if(TileExistsNext(Index))
+		Special |= SPECIAL_STOPPER;
+	return Special;
+}
+
+void CCollision::UpdateSpecialTiles(int Index)
+{
+	// the stoppers next to a tile count for it too
+	int aIndices[5] = {Index, Index - 1, Index + 1, Index - m_Width, Index + m_Width};
+	for(int i = 0; i < 5; i++)
+		if(aIndices[i] >= 0 && aIndices[i] < m_Width * m_Height)
+			m_pSpecial[aIndices[i]] = FindSpecialTiles(aIndices[i]);
 }
 
 bool CCollision::TileExistsNext(int Index)
@@ -755,50 +868,100 @@ int CCollision::GetMapIndex(vec2 Pos)
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices)
+int CCollision::SampleMapIndex(vec2 PrevPos, vec2 Pos, float Distance, int Sample)
+{
+	vec2 Tmp = mix(PrevPos, Pos, Sample/Distance);
+	int Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
+	int Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
+	return Ny * m_Width + Nx;
+}
+
+int CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices, CMapIndicesCursor *pCursor)
 {
-	std::list< int > Indices;
+	// the path is sampled every pixel and the tiles of the samples are
+	// reported in order. instead of looking at every sample, the tile
+	// borders the path crosses are walked and only the samples next to
+	// them are looked at, which gives the same tiles
 	float d = distance(PrevPos, Pos);
 	int End(d + 1);
+	int Num = 0;
+	if(pCursor->m_Sample >= End || MaxIndices <= 0)
+		return 0;
 	if(!d)
 	{
-		int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
-		int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
-		int Index = Ny * m_Width + Nx;
-
+		int Index = GetMapIndex(Pos);
+		pCursor->m_Sample = End;
 		if(TileExists(Index))
-		{
-			Indices.push_back(Index);
-			return Indices;
-		}
-		else
-			return Indices;
+			pIndices[Num++] = Index;
+		return Num;
 	}
-	else
+
+	// parameter of the next border in x and y and of the step between two
+	// borders, starting from the tile of the first unhandled sample
+	vec2 Dir = Pos - PrevPos;
+	int i = pCursor->m_Sample;
+	vec2 Tmp = mix(PrevPos, Pos, i/d);
+	float MaxX = 2.0f, MaxY = 2.0f;
+	float DeltaX = 2.0f, DeltaY = 2.0f;
+	if(Dir.x != 0)
+	{
+		float Border = (floorf(Tmp.x / 32) + (Dir.x > 0 ? 1 : 0)) * 32;
+		MaxX = (Border - PrevPos.x) / Dir.x;
+		DeltaX = 32 / absolute(Dir.x);
+	}
+	if(Dir.y != 0)
+	{
+		float Border = (floorf(Tmp.y / 32) + (Dir.y > 0 ? 1 : 0)) * 32;
+		MaxY = (Border - PrevPos.y) / Dir.y;
+		DeltaY = 32 / absolute(Dir.y);
+	}
+
+	int Index = SampleMapIndex(PrevPos, Pos, d, i);
+	while(1)
 	{
-		float a = 0.0f;
-		vec2 Tmp = vec2(0, 0);
-		int Nx = 0;
-		int Ny = 0;
-		int Index,LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		if(TileExists(Index) && pCursor->m_LastIndex != Index)
 		{
-			a = i/d;
-			Tmp = mix(PrevPos, Pos, a);
-			Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
-			Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
-			Index = Ny * m_Width + Nx;
-			if(TileExists(Index) && LastIndex != Index)
+			if(Num == MaxIndices)
 			{
-				if(MaxIndices && Indices.size() > MaxIndices)
-					return Indices;
-				Indices.push_back(Index);
-				LastIndex = Index;
+				pCursor->m_Sample = i;
+				return Num;
 			}
+			pIndices[Num++] = Index;
+			pCursor->m_LastIndex = Index;
 		}
 
-		return Indices;
+		// find the first sample in another tile. the guess from the next
+		// border can be off by a sample because of rounding, and borders
+		// outside of the map don't change the tile
+		int Next = Index;
+		while(Next == Index && i < End - 1)
+		{
+			float Guess = minimum(MaxX, MaxY) * d;
+			int j = Guess < End - 1 ? maximum(i + 1, (int)ceilf(Guess)) : End - 1;
+			Next = SampleMapIndex(PrevPos, Pos, d, j);
+			if(Next != Index)
+			{
+				int Prev;
+				while(j - 1 > i && (Prev = SampleMapIndex(PrevPos, Pos, d, j - 1)) != Index)
+				{
+					Next = Prev;
+					j--;
+				}
+			}
+			i = j;
+			float a = i/d;
+			if(MaxX < a)
+				MaxX += ceilf((a - MaxX) / DeltaX) * DeltaX;
+			if(MaxY < a)
+				MaxY += ceilf((a - MaxY) / DeltaY) * DeltaY;
+		}
+		if(Next == Index)
+			break;
+		Index = Next;
 	}
+
+	pCursor->m_Sample = End;
+	return Num;
 }
 
 vec2 CCollision::GetPos(int Index)
@@ -957,6 +1120,7 @@ void CCollision::SetCollisionAt(float x, float y, int id)
 	int Ny = clamp(round_to_int(y)/32, 0, m_Height-1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = id;
+	UpdateSpecialTiles(Ny * m_Width + Nx);
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -969,6 +1133,7 @@ void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Numb
 	m_pDoor[Ny * m_Width + Nx].m_Index = Type;
 	m_pDoor[Ny * m_Width + Nx].m_Flags = Flags;
 	m_pDoor[Ny * m_Width + Nx].m_Number = Number;
+	UpdateSpecialTiles(Ny * m_Width + Nx);
 }
 
 int CCollision::GetDTileIndex(int Index)
@@ -1028,12 +1193,10 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *Ox, int *Oy)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
 
-	for(float f = 0; f < d; f++)
+	for(CLineWalk Walk(Pos0, Pos1, d, (int)ceilf(d)); !Walk.Done(); Walk.Next())
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walk.Pos();
 		int Nx = clamp(round_to_int(Pos.x)/32, 0, m_Width-1);
 		int Ny = clamp(round_to_int(Pos.y)/32, 0, m_Height-1);
 		if(GetIndex(Nx, Ny) == TILE_SOLID
@@ -1044,12 +1207,11 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			if (GetFIndex(Nx, Ny) == TILE_NOLASER)	return GetFCollisionAt(Pos.x, Pos.y);
 			else return GetCollisionAt(Pos.x, Pos.y);
 
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1061,22 +1223,19 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
 
-	for(float f = 0; f < d; f++)
+	for(CLineWalk Walk(Pos0, Pos1, d, (int)ceilf(d)); !Walk.Done(); Walk.Next())
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walk.Pos();
 		if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || IsFNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y))) return GetCollisionAt(Pos.x, Pos.y);
 			else return  GetFCollisionAt(Pos.x, Pos.y);
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1088,25 +1247,22 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
 
-	for(float f = 0; f < d; f++)
+	for(CLineWalk Walk(Pos0, Pos1, d, (int)ceilf(d)); !Walk.Done(); Walk.Next())
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walk.Pos();
 		if(IsSolid(round_to_int(Pos.x), round_to_int(Pos.y)) || (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y))))
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walk.PrevPos();
 			if(!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y)))
 				return -1;
 			else
 				if (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y))) return GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
 				else return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -6,8 +6,6 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
-#include <list>
-
 class CCollision
 {
 	class CTile *m_pTiles;
@@ -53,10 +51,18 @@ public:
 	int Entity(int x, int y, int Layer);
 	int GetPureMapIndex(float x, float y);
 	int GetPureMapIndex(vec2 Pos) { return GetPureMapIndex(Pos.x, Pos.y); }
-	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0);
+	// where GetMapIndices continues after it filled the buffer
+	struct CMapIndicesCursor
+	{
+		int m_Sample;
+		int m_LastIndex;
+		CMapIndicesCursor() : m_Sample(0), m_LastIndex(0) {}
+	};
+	int GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices, CMapIndicesCursor *pCursor);
 	int GetMapIndex(vec2 Pos);
-	bool TileExists(int Index);
+	bool TileExists(int Index) { return Index >= 0 && m_pSpecial[Index]; }
 	bool TileExistsNext(int Index);
+	int SpecialTiles(int Index) { return Index < 0 ? 0 : m_pSpecial[Index]; }
 	vec2 GetPos(int Index);
 	int GetTileIndex(int Index);
 	int GetFTileIndex(int Index);
@@ -96,7 +102,26 @@ public:
 	class CLayers *Layers() { return m_pLayers; }
 	int m_NumSwitchers;
 
+	// the layers that have a tile for the character at an index, so
+	// that TileExists only needs to look at one byte
+	enum
+	{
+		SPECIAL_GAME=1<<0,
+		SPECIAL_FRONT=1<<1,
+		SPECIAL_TELE=1<<2,
+		SPECIAL_SPEEDUP=1<<3,
+		SPECIAL_DOOR=1<<4,
+		SPECIAL_SWITCH=1<<5,
+		SPECIAL_TUNE=1<<6,
+		SPECIAL_STOPPER=1<<7,
+	};
+
 private:
+	int SampleMapIndex(vec2 PrevPos, vec2 Pos, float Distance, int Sample);
+	int FindSpecialTiles(int Index);
+	void UpdateSpecialTiles(int Index);
+
+	unsigned char *m_pSpecial;
 
 	class CTeleTile *m_pTele;
 	class CSpeedupTile *m_pSpeedup;
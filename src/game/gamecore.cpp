@@ -121,6 +121,26 @@ void CCharacterCore::Reset()
 	m_DeepFrozen = false;
 }
 
+int CWorldCore::FindCharacters(vec2 Pos0, vec2 Pos1, float Margin, int *pIDs, int IncludeID) const
+{
+	// one more for the rounding of the exact checks
+	Margin += 1.0f;
+	vec2 Min = vec2(minimum(Pos0.x, Pos1.x) - Margin, minimum(Pos0.y, Pos1.y) - Margin);
+	vec2 Max = vec2(maximum(Pos0.x, Pos1.x) + Margin, maximum(Pos0.y, Pos1.y) + Margin);
+
+	int Num = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CCharacterCore *pCharCore = m_apCharacters[i];
+		if(!pCharCore)
+			continue;
+		if(i != IncludeID && (pCharCore->m_Pos.x < Min.x || pCharCore->m_Pos.x > Max.x || pCharCore->m_Pos.y < Min.y || pCharCore->m_Pos.y > Max.y))
+			continue;
+		pIDs[Num++] = i;
+	}
+	return Num;
+}
+
 void CCharacterCore::Tick(bool UseInput)
 {
 	float PhysSize = 28.0f;
@@ -307,10 +327,13 @@ void CCharacterCore::Tick(bool UseInput)
 		if(this->m_Hook && m_pWorld && m_pWorld->m_Tuning[g_Config.m_ClDummy].m_PlayerHooking)
 		{
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			int aIDs[MAX_CLIENTS];
+			int Num = m_pWorld->FindCharacters(m_HookPos, NewPos, PhysSize+2.0f, aIDs);
+			for(int j = 0; j < Num; j++)
 			{
+				int i = aIDs[j];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-				if(!pCharCore || pCharCore == this || (!(m_Super || pCharCore->m_Super) && (!m_pTeams->CanCollide(i, m_Id) || pCharCore->m_Solo || m_Solo)))
+				if(pCharCore == this || (!(m_Super || pCharCore->m_Super) && (!m_pTeams->CanCollide(i, m_Id) || pCharCore->m_Solo || m_Solo)))
 					continue;
 
 				vec2 ClosestPoint = closest_point_on_line(m_HookPos, NewPos, pCharCore->m_Pos);
@@ -415,11 +438,13 @@ void CCharacterCore::Tick(bool UseInput)
 
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		// the players close enough to collide, and the hooked one
+		int aIDs[MAX_CLIENTS];
+		int Num = m_pWorld->FindCharacters(m_Pos, m_Pos, PhysSize*1.25f, aIDs, m_HookedPlayer);
+		for(int j = 0; j < Num; j++)
 		{
+			int i = aIDs[j];
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-			if(!pCharCore)
-				continue;
 
 			//player *p = (player*)ent;
 			//if(pCharCore == this) // || !(p->flags&FLAG_ALIVE)
@@ -533,14 +558,17 @@ void CCharacterCore::Move()
 		float Distance = distance(m_Pos, NewPos);
 		int End = Distance+1;
 		vec2 LastPos = m_Pos;
+		int aIDs[MAX_CLIENTS];
+		int Num = m_pWorld->FindCharacters(m_Pos, NewPos, 28.0f, aIDs);
 		for(int i = 0; i < End; i++)
 		{
 			float a = i/Distance;
 			vec2 Pos = mix(m_Pos, NewPos, a);
-			for(int p = 0; p < MAX_CLIENTS; p++)
+			for(int j = 0; j < Num; j++)
 			{
+				int p = aIDs[j];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
-				if(!pCharCore || pCharCore == this )
+				if(pCharCore == this)
 					continue;
 				if((!(pCharCore->m_Super || m_Super) && (m_Solo || pCharCore->m_Solo || !pCharCore->m_Collision || pCharCore->m_NoCollision || (m_Id != -1 && !m_pTeams->CanCollide(m_Id, p)))))
 					continue;
@@ -177,6 +177,11 @@ public:
 
 	CTuningParams m_Tuning[2];
 	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
+
+	// the ids of the characters in the box around Pos0 and Pos1 grown by
+	// Margin, and IncludeID if it exists, in ascending order. a cheap test
+	// to skip the far away ones before the exact checks
+	int FindCharacters(vec2 Pos0, vec2 Pos1, float Margin, int *pIDs, int IncludeID = -1) const;
 };
 
 class CCharacterCore
@@ -798,7 +798,7 @@ void CCharacter::TickDefered()
 	bool StuckAfterMove = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
 	m_Core.Quantize();
 	bool StuckAfterQuant = GameServer()->Collision()->TestBox(m_Core.m_Pos, vec2(28.0f, 28.0f));
-	m_Pos = m_Core.m_Pos;
+	GameWorld()->MoveEntity(this, m_Core.m_Pos);
 
 	if(!StuckBefore && (StuckAfterMove || StuckAfterQuant))
 	{
@@ -984,7 +984,7 @@ bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon)
 	// do damage Hit sound
 	if(From >= 0 && From != m_pPlayer->GetCID() && GameServer()->m_apPlayers[From])
 	{
-		int64_t Mask = CmaskOne(From);
+		CClientMask Mask = CmaskOne(From);
 		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
 			if(GameServer()->m_apPlayers[i] && GameServer()->m_apPlayers[i]->GetTeam() == TEAM_SPECTATORS && GameServer()->m_apPlayers[i]->m_SpectatorID == From)
@@ -1244,15 +1244,7 @@ int CCharacter::NetworkClipped(int SnappingClient, vec2 CheckPos)
 	if(SnappingClient == -1 || GameServer()->m_apPlayers[SnappingClient]->m_ShowAll)
 		return 0;
 
-	float dx = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.x-CheckPos.x;
-	float dy = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.y-CheckPos.y;
-
-	if(absolute(dx) > 1000.0f || absolute(dy) > 800.0f)
-		return 1;
-
-	if(distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos) > 4000.0f)
-		return 1;
-	return 0;
+	return NetworkClippedPos(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos);
 }
 
 // DDRace
@@ -2264,17 +2256,23 @@ void CCharacter::DDRacePostCoreTick()
 		return;
 
 	// handle Anti-Skip tiles
-	std::list < int > Indices = GameServer()->Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
-	{
-		for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
+	vec2 PrevPos = m_PrevPos;
+	vec2 Pos = m_Pos;
+	int aIndices[16];
+	CCollision::CMapIndicesCursor Cursor;
+	bool Found = false;
+	int Num;
+	while((Num = GameServer()->Collision()->GetMapIndices(PrevPos, Pos, aIndices, 16, &Cursor)) > 0)
+	{
+		Found = true;
+		for(int i = 0; i < Num; i++)
 		{
-			HandleTiles(*i);
+			HandleTiles(aIndices[i]);
 			if(!m_Alive)
 				return;
 		}
 	}
-	else
+	if(!Found)
 	{
 		HandleTiles(CurrentIndex);
 		if(!m_Alive)
@@ -2460,7 +2458,7 @@ void CCharacter::Rescue()
 		if (GameServer()->Collision()->GetTileIndex(index) == TILE_FREEZE || GameServer()->Collision()->GetFTileIndex(index) == TILE_FREEZE) {
 			m_LastRescue = Server()->Tick();
 			m_Core.m_Pos = m_PrevSavePos;
-			m_Pos = m_PrevSavePos;
+			GameWorld()->MoveEntity(this, m_PrevSavePos);
 			m_PrevPos = m_PrevSavePos;
 			m_Core.m_Vel = vec2(0, 0);
 			m_Core.m_HookedPlayer = -1;
@@ -113,3 +113,10 @@ void CDoor::Snap(int SnappingClient)
 	}
 	pObj->m_StartTick = Server()->Tick();
 }
+
+int CDoor::SnapPositions(vec2 *pPositions, int Max)
+{
+	pPositions[0] = m_Pos;
+	pPositions[1] = m_To;
+	return 2;
+}
@@ -24,6 +24,7 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void Snap(int SnappingClient);
+	virtual int SnapPositions(vec2 *pPositions, int Max);
 };
 
 #endif // GAME_SERVER_ENTITIES_DOOR_H
@@ -387,6 +387,24 @@ void CDragger::Snap(int SnappingClient)
 	}
 }
 
+int CDragger::SnapPositions(vec2 *pPositions, int Max)
+{
+	// the lasers to solo targets get new snap ids in every Snap, keep
+	// that going for every client
+	if (m_SoloIDs[0] != -1)
+		return -1;
+	for (int i = 0; i < MAX_CLIENTS; i++)
+		if (m_SoloEnts[i])
+			return -1;
+
+	// the laser is there if either end can be seen
+	int Num = 0;
+	pPositions[Num++] = m_Pos;
+	if (m_Target)
+		pPositions[Num++] = m_Target->m_Pos;
+	return Num;
+}
+
 CDraggerTeam::CDraggerTeam(CGameWorld *pGameWorld, vec2 Pos, float Strength,
 		bool NW, int Layer, int Number)
 {
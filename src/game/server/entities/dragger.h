@@ -26,6 +26,7 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void Snap(int snapping_client);
+	virtual int SnapPositions(vec2 *pPositions, int Max);
 };
 
 class CDraggerTeam
@@ -161,3 +161,10 @@ void CLight::Snap(int SnappingClient)
 		StartTick = Server()->Tick();
 	pObj->m_StartTick = StartTick;
 }
+
+int CLight::SnapPositions(vec2 *pPositions, int Max)
+{
+	pPositions[0] = m_Pos;
+	pPositions[1] = m_To;
+	return 2;
+}
@@ -31,6 +31,7 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void Snap(int SnappingClient);
+	virtual int SnapPositions(vec2 *pPositions, int Max);
 };
 
 #endif // GAME_SERVER_ENTITIES_LIGHT_H
@@ -175,6 +175,12 @@ void CPickup::Snap(int SnappingClient)
 	pP->m_Subtype = m_Subtype;
 }
 
+int CPickup::SnapPositions(vec2 *pPositions, int Max)
+{
+	// pickups are never clipped
+	return -1;
+}
+
 void CPickup::Move()
 {
 	if (Server()->Tick()%int(Server()->TickSpeed() * 0.15f) == 0)
@@ -16,6 +16,7 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual int SnapPositions(vec2 *pPositions, int Max);
 
 private:
 
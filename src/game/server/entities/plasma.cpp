@@ -7,6 +7,8 @@
 #include <game/server/gamemodes/DDRace.h>
 #include "plasma.h"
 
+MACRO_ALLOC_POOL_IMPL(CPlasma)
+
 CPlasma::CPlasma(CGameWorld *pGameWorld, vec2 Pos, vec2 Dir, bool Freeze,
 		bool Explosive, int ResponsibleTeam, int Owner, float Accel, float Lifetime) :
 		CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
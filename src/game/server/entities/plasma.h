@@ -8,6 +8,8 @@ class CGun;
 
 class CPlasma: public CEntity
 {
+	MACRO_ALLOC_POOL()
+
 	vec2 m_Core;
 	int m_EvalTick;
 	int m_LifeTime;
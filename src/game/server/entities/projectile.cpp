@@ -8,6 +8,8 @@
 #include <engine/shared/config.h>
 #include <game/server/teams.h>
 
+MACRO_ALLOC_POOL_IMPL(CProjectile)
+
 CProjectile::CProjectile
 	(
 		CGameWorld *pGameWorld,
@@ -126,7 +128,7 @@ void CProjectile::Tick()
 	if(m_LifeSpan > -1)
 		m_LifeSpan--;
 
-	int64_t TeamMask = -1LL;
+	CClientMask TeamMask = CmaskAll();
 	bool IsWeaponCollide = false;
 	if
 	(
@@ -161,9 +163,9 @@ void CProjectile::Tick()
 			for(int i = 0; i < Number; i++)
 			{
 				GameServer()->CreateExplosion(ColPos, m_Owner, m_Type, m_Owner == -1, (!pTargetChr ? -1 : pTargetChr->Team()),
-				(m_Owner != -1)? TeamMask : -1LL);
+				(m_Owner != -1)? TeamMask : CmaskAll());
 				GameServer()->CreateSound(ColPos, m_SoundImpact,
-				(m_Owner != -1)? TeamMask : -1LL);
+				(m_Owner != -1)? TeamMask : CmaskAll());
 			}
 		}
 		else if(m_Freeze)
@@ -235,7 +237,7 @@ void CProjectile::Tick()
 		}
 		else if (m_Type == WEAPON_GUN)
 		{
-			GameServer()->CreateDamageInd(CurPos, -atan2(m_Direction.x, m_Direction.y), 10, (m_Owner != -1)? TeamMask : -1LL);
+			GameServer()->CreateDamageInd(CurPos, -atan2(m_Direction.x, m_Direction.y), 10, (m_Owner != -1)? TeamMask : CmaskAll());
 			GameServer()->m_World.DestroyEntity(this);
 			return;
 		}
@@ -255,16 +257,16 @@ void CProjectile::Tick()
 			if(m_Owner >= 0)
 				pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
 
-			int64_t TeamMask = -1LL;
+			CClientMask TeamMask = CmaskAll();
 			if (pOwnerChar && pOwnerChar->IsAlive())
 			{
 					TeamMask = pOwnerChar->Teams()->TeamMask(pOwnerChar->Team(), -1, m_Owner);
 			}
 
 			GameServer()->CreateExplosion(ColPos, m_Owner, m_Type, m_Owner == -1, (!pOwnerChar ? -1 : pOwnerChar->Team()),
-			(m_Owner != -1)? TeamMask : -1LL);
+			(m_Owner != -1)? TeamMask : CmaskAll());
 			GameServer()->CreateSound(ColPos, m_SoundImpact,
-			(m_Owner != -1)? TeamMask : -1LL);
+			(m_Owner != -1)? TeamMask : CmaskAll());
 		}
 		GameServer()->m_World.DestroyEntity(this);
 		return;
@@ -312,7 +314,7 @@ void CProjectile::Snap(int SnappingClient)
 		return;
 
 	CCharacter *pOwnerChar = 0;
-	int64_t TeamMask = -1LL;
+	CClientMask TeamMask = CmaskAll();
 
 	if(m_Owner >= 0)
 		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
@@ -333,6 +335,13 @@ void CProjectile::Snap(int SnappingClient)
 	}
 }
 
+int CProjectile::SnapPositions(vec2 *pPositions, int Max)
+{
+	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
+	pPositions[0] = GetPos(Ct);
+	return 1;
+}
+
 // DDRace
 
 void CProjectile::SetBouncing(int Value)
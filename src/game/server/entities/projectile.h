@@ -5,6 +5,8 @@
 
 class CProjectile : public CEntity
 {
+	MACRO_ALLOC_POOL()
+
 public:
 	CProjectile
 	(
@@ -29,6 +31,7 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual int SnapPositions(vec2 *pPositions, int Max);
 
 private:
 	vec2 m_Direction;
@@ -20,6 +20,13 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType)
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+	m_InsertOrder = 0;
+
+	m_pPrevGridEntity = 0;
+	m_pNextGridEntity = 0;
+	m_GridBucket = -1;
+	m_GridX = 0;
+	m_GridY = 0;
 }
 
 CEntity::~CEntity()
@@ -38,15 +45,7 @@ int CEntity::NetworkClipped(int SnappingClient, vec2 CheckPos)
 	if(SnappingClient == -1)
 		return 0;
 
-	float dx = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.x-CheckPos.x;
-	float dy = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.y-CheckPos.y;
-
-	if(absolute(dx) > 1000.0f || absolute(dy) > 800.0f)
-		return 1;
-
-	if(distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos) > 4000.0f)
-		return 1;
-	return 0;
+	return NetworkClippedPos(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos);
 }
 
 bool CEntity::GameLayerClipped(vec2 CheckPos)
@@ -5,6 +5,7 @@
 
 #include <new>
 #include <base/vmath.h>
+#include <engine/shared/pool.h>
 #include <game/server/gameworld.h>
 
 #define MACRO_ALLOC_HEAP() \
@@ -57,6 +58,33 @@
 		mem_zero(ms_PoolData##POOLTYPE[id], sizeof(POOLTYPE)); \
 	}
 
+// for entities that come and go all the time, like the ones created by
+// shots. they are zeroed like with MACRO_ALLOC_HEAP
+#define MACRO_ALLOC_POOL() \
+	public: \
+	void *operator new(size_t Size); \
+	void operator delete(void *pPtr); \
+	static const CPool *Pool(); \
+	private:
+
+#define MACRO_ALLOC_POOL_IMPL(POOLTYPE) \
+	static CPool ms_Pool##POOLTYPE(sizeof(POOLTYPE)); \
+	void *POOLTYPE::operator new(size_t Size) \
+	{ \
+		dbg_assert(sizeof(POOLTYPE) == Size, "size error"); \
+		void *p = ms_Pool##POOLTYPE.Allocate(); \
+		mem_zero(p, Size); \
+		return p; \
+	} \
+	void POOLTYPE::operator delete(void *pPtr) \
+	{ \
+		ms_Pool##POOLTYPE.Free(pPtr); \
+	} \
+	const CPool *POOLTYPE::Pool() \
+	{ \
+		return &ms_Pool##POOLTYPE; \
+	}
+
 /*
 	Class: Entity
 		Basic entity class.
@@ -68,6 +96,14 @@ class CEntity
 	friend class CGameWorld;	// entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	int64 m_InsertOrder;
+
+	// spatial grid, see CGameWorld::MoveEntity
+	CEntity *m_pPrevGridEntity;
+	CEntity *m_pNextGridEntity;
+	int m_GridBucket;
+	int m_GridX;
+	int m_GridY;
 
 protected:
 	class CGameWorld *m_pGameWorld;
@@ -148,6 +184,28 @@ public:
 	virtual int NetworkClipped(int SnappingClient);
 	virtual int NetworkClipped(int SnappingClient, vec2 CheckPos);
 
+	// the test NetworkClipped does for a client looking at ViewPos
+	static bool NetworkClippedPos(vec2 ViewPos, vec2 CheckPos)
+	{
+		return absolute(ViewPos.x - CheckPos.x) > 1000.0f || absolute(ViewPos.y - CheckPos.y) > 800.0f;
+	}
+
+	/*
+		Function: SnapPositions
+			Tells the world the positions Snap passes to NetworkClipped,
+			so that the entity is only snapped for the clients that can
+			see at least one of them.
+
+		Arguments:
+			positions - Array to fill with the positions.
+			max - Number of positions that fit into the array.
+
+		Returns:
+			Number of positions, or -1 if the entity has to be snapped
+			for every client.
+	*/
+	virtual int SnapPositions(vec2 *pPositions, int Max) { pPositions[0] = m_Pos; return 1; }
+
 	bool GameLayerClipped(vec2 CheckPos);
 
 	/*
@@ -11,6 +11,7 @@
 #include <engine/server/server.h>
 #include <engine/shared/datafile.h>
 #include <engine/shared/linereader.h>
+#include <engine/shared/profiler.h>
 #include <engine/storage.h>
 #include "gamecontext.h"
 #include <game/version.h>
@@ -18,6 +19,9 @@
 #include <game/gamecore.h>
 
 #include "gamemodes/DDRace.h"
+#include "entities/laser.h"
+#include "entities/plasma.h"
+#include "entities/projectile.h"
 #include "score.h"
 #include "score/file_score.h"
 #if defined(CONF_SQL)
@@ -54,7 +58,6 @@ void CGameContext::Construct(int Resetting)
 		m_NumVoteMutes = 0;
 	}
 	m_ChatResponseTargetID = -1;
-	m_aDeleteTempfile[0] = 0;
 	m_TeeHistorianActive = false;
 
 	m_pRandomMapResult = nullptr;
@@ -105,6 +108,8 @@ void CGameContext::Clear()
 
 void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUser)
 {
+	static int s_ProfilePhase = g_Profiler.Register("teehistorian.write");
+	CProfileScope Scope(s_ProfilePhase);
 	CGameContext *pSelf = (CGameContext *)pUser;
 	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
 }
@@ -130,7 +135,7 @@ bool CGameContext::EmulateBug(int Bug)
 	return m_MapBugs.Contains(Bug);
 }
 
-void CGameContext::CreateDamageInd(vec2 Pos, float Angle, int Amount, int64_t Mask)
+void CGameContext::CreateDamageInd(vec2 Pos, float Angle, int Amount, CClientMask Mask)
 {
 	float a = 3 * 3.14159f / 2 + Angle;
 	//float a = get_angle(dir);
@@ -149,7 +154,7 @@ void CGameContext::CreateDamageInd(vec2 Pos, float Angle, int Amount, int64_t Ma
 	}
 }
 
-void CGameContext::CreateHammerHit(vec2 Pos, int64_t Mask)
+void CGameContext::CreateHammerHit(vec2 Pos, CClientMask Mask)
 {
 	// create the event
 	CNetEvent_HammerHit *pEvent = (CNetEvent_HammerHit *)m_Events.Create(NETEVENTTYPE_HAMMERHIT, sizeof(CNetEvent_HammerHit), Mask);
@@ -160,7 +165,7 @@ void CGameContext::CreateHammerHit(vec2 Pos, int64_t Mask)
 	}
 }
 
-void CGameContext::CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamage, int ActivatedTeam, int64_t Mask)
+void CGameContext::CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamage, int ActivatedTeam, CClientMask Mask)
 {
 	// create the event
 	CNetEvent_Explosion *pEvent = (CNetEvent_Explosion *)m_Events.Create(NETEVENTTYPE_EXPLOSION, sizeof(CNetEvent_Explosion), Mask);
@@ -175,7 +180,7 @@ void CGameContext::CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamag
 	float Radius = 135.0f;
 	float InnerRadius = 48.0f;
 	int Num = m_World.FindEntities(Pos, Radius, (CEntity**)apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
-	int64_t TeamMask = -1;
+	CBitset<MAX_CLIENTS+1> ExplodedTeams;
 	for(int i = 0; i < Num; i++)
 	{
 		vec2 Diff = apEnts[i]->m_Pos - Pos;
@@ -202,8 +207,8 @@ void CGameContext::CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamag
 			int PlayerTeam = ((CGameControllerDDRace*)m_pController)->m_Teams.m_Core.Team(apEnts[i]->GetPlayer()->GetCID());
 			if(GetPlayerChar(Owner) ? GetPlayerChar(Owner)->m_Hit&CCharacter::DISABLE_HIT_GRENADE : !g_Config.m_SvHit || NoDamage)
 			{
-				if(!CmaskIsSet(TeamMask, PlayerTeam)) continue;
-				TeamMask = CmaskUnset(TeamMask, PlayerTeam);
+				if(ExplodedTeams.Test(PlayerTeam)) continue;
+				ExplodedTeams.Set(PlayerTeam);
 			}
 
 			apEnts[i]->TakeDamage(ForceDir*Dmg*2, (int)Dmg, Owner, Weapon);
@@ -211,7 +216,7 @@ void CGameContext::CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamag
 	}
 }
 
-void CGameContext::CreatePlayerSpawn(vec2 Pos, int64_t Mask)
+void CGameContext::CreatePlayerSpawn(vec2 Pos, CClientMask Mask)
 {
 	// create the event
 	CNetEvent_Spawn *ev = (CNetEvent_Spawn *)m_Events.Create(NETEVENTTYPE_SPAWN, sizeof(CNetEvent_Spawn), Mask);
@@ -222,7 +227,7 @@ void CGameContext::CreatePlayerSpawn(vec2 Pos, int64_t Mask)
 	}
 }
 
-void CGameContext::CreateDeath(vec2 Pos, int ClientID, int64_t Mask)
+void CGameContext::CreateDeath(vec2 Pos, int ClientID, CClientMask Mask)
 {
 	// create the event
 	CNetEvent_Death *pEvent = (CNetEvent_Death *)m_Events.Create(NETEVENTTYPE_DEATH, sizeof(CNetEvent_Death), Mask);
@@ -234,7 +239,7 @@ void CGameContext::CreateDeath(vec2 Pos, int ClientID, int64_t Mask)
 	}
 }
 
-void CGameContext::CreateSound(vec2 Pos, int Sound, int64_t Mask)
+void CGameContext::CreateSound(vec2 Pos, int Sound, CClientMask Mask)
 {
 	if (Sound < 0)
 		return;
@@ -2185,6 +2190,26 @@ void CGameContext::ConMapbug(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CGameContext::ConDumpEntities(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	char aBuf[128];
+	for(int i = 0; i < CGameWorld::NUM_ENTTYPES; i++)
+	{
+		str_format(aBuf, sizeof(aBuf), "%s live=%d peak=%d", CGameWorld::TypeName(i), pSelf->m_World.NumEntities(i), pSelf->m_World.PeakEntities(i));
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "entities", aBuf);
+	}
+
+	// the pools are shared by all worlds and keep their slabs
+	static const char *s_apPoolNames[] = {"projectile", "laser", "plasma"};
+	const CPool *apPools[] = {CProjectile::Pool(), CLaser::Pool(), CPlasma::Pool()};
+	for(unsigned i = 0; i < sizeof(apPools) / sizeof(apPools[0]); i++)
+	{
+		str_format(aBuf, sizeof(aBuf), "%s pool live=%d peak=%d capacity=%d", s_apPoolNames[i], apPools[i]->NumLive(), apPools[i]->PeakLive(), apPools[i]->Capacity());
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "entities", aBuf);
+	}
+}
+
 void CGameContext::ConSwitchOpen(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
@@ -2588,6 +2613,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("mapbug", "s[mapbug]", CFGFLAG_SERVER|CFGFLAG_GAME, ConMapbug, this, "Enable map compatibility mode using the specified bug (example: grenade-doublexplosion@ddnet.tw)");
 	Console()->Register("switch_open", "i[switch]", CFGFLAG_SERVER|CFGFLAG_GAME, ConSwitchOpen, this, "Whether a switch is deactivated by default (otherwise activated)");
 	Console()->Register("pause_game", "", CFGFLAG_SERVER, ConPause, this, "Pause/unpause game");
+	Console()->Register("dump_entities", "", CFGFLAG_SERVER, ConDumpEntities, this, "Show the number of entities per type and the most there were at once");
 	Console()->Register("change_map", "?r[map]", CFGFLAG_SERVER|CFGFLAG_STORE, ConChangeMap, this, "Change map");
 	Console()->Register("random_map", "?i[stars]", CFGFLAG_SERVER, ConRandomMap, this, "Random map");
 	Console()->Register("random_unfinished_map", "?i[stars]", CFGFLAG_SERVER, ConRandomUnfinishedMap, this, "Random unfinished map");
@@ -2623,8 +2649,6 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 	m_GameUuid = RandomUuid();
 	Console()->SetTeeHistorianCommandCallback(CommandCallback, this);
 
-	DeleteTempfile();
-
 	//if(!data) // only load once
 		//data = load_data_from_memory(internal_data);
 
@@ -2904,140 +2928,6 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 #endif
 }
 
-void CGameContext::DeleteTempfile()
-{
-	if(m_aDeleteTempfile[0] != 0)
-	{
-		Storage()->RemoveFile(m_aDeleteTempfile, IStorage::TYPE_SAVE);
-		m_aDeleteTempfile[0] = 0;
-	}
-}
-
-void CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
-{
-	char aConfig[128];
-	char aTemp[128];
-	str_format(aConfig, sizeof(aConfig), "maps/%s.cfg", g_Config.m_SvMap);
-	str_format(aTemp, sizeof(aTemp), "%s.temp.%d", pNewMapName, pid());
-
-	IOHANDLE File = Storage()->OpenFile(aConfig, IOFLAG_READ, IStorage::TYPE_ALL);
-	if(!File)
-	{
-		// No map-specific config, just return.
-		return;
-	}
-	CLineReader LineReader;
-	LineReader.Init(File);
-
-	array<char *> aLines;
-	char *pLine;
-	int TotalLength = 0;
-	while((pLine = LineReader.Get()))
-	{
-		int Length = str_length(pLine) + 1;
-		char *pCopy = (char *)malloc(Length);
-		mem_copy(pCopy, pLine, Length);
-		aLines.add(pCopy);
-		TotalLength += Length;
-	}
-	io_close(File);
-
-	char *pSettings = (char *)malloc(TotalLength);
-	int Offset = 0;
-	for(int i = 0; i < aLines.size(); i++)
-	{
-		int Length = str_length(aLines[i]) + 1;
-		mem_copy(pSettings + Offset, aLines[i], Length);
-		Offset += Length;
-		free(aLines[i]);
-	}
-
-	CDataFileReader Reader;
-	Reader.Open(Storage(), pNewMapName, IStorage::TYPE_ALL);
-
-	CDataFileWriter Writer;
-	Writer.Init();
-
-	int SettingsIndex = Reader.NumData();
-	bool FoundInfo = false;
-	for(int i = 0; i < Reader.NumItems(); i++)
-	{
-		int TypeID;
-		int ItemID;
-		int *pData = (int *)Reader.GetItem(i, &TypeID, &ItemID);
-		int Size = Reader.GetItemSize(i);
-		CMapItemInfoSettings MapInfo;
-		if(TypeID == MAPITEMTYPE_INFO && ItemID == 0)
-		{
-			FoundInfo = true;
-			CMapItemInfoSettings *pInfo = (CMapItemInfoSettings *)pData;
-			if(Size >= (int)sizeof(CMapItemInfoSettings))
-			{
-				if(pInfo->m_Settings > -1)
-				{
-					SettingsIndex = pInfo->m_Settings;
-					char *pMapSettings = (char *)Reader.GetData(SettingsIndex);
-					int DataSize = Reader.GetDataSize(SettingsIndex);
-					if(DataSize == TotalLength && mem_comp(pSettings, pMapSettings, DataSize) == 0)
-					{
-						// Configs coincide, no need to update map.
-						return;
-					}
-					Reader.UnloadData(pInfo->m_Settings);
-				}
-				else
-				{
-					MapInfo = *pInfo;
-					MapInfo.m_Settings = SettingsIndex;
-					pData = (int *)&MapInfo;
-					Size = sizeof(MapInfo);
-				}
-			}
-			else
-			{
-				*(CMapItemInfo *)&MapInfo = *(CMapItemInfo *)pInfo;
-				MapInfo.m_Settings = SettingsIndex;
-				pData = (int *)&MapInfo;
-				Size = sizeof(MapInfo);
-			}
-		}
-		Writer.AddItem(TypeID, ItemID, Size, pData);
-	}
-
-	if(!FoundInfo)
-	{
-		CMapItemInfoSettings Info;
-		Info.m_Version = 1;
-		Info.m_Author = -1;
-		Info.m_MapVersion = -1;
-		Info.m_Credits = -1;
-		Info.m_License = -1;
-		Info.m_Settings = SettingsIndex;
-		Writer.AddItem(MAPITEMTYPE_INFO, 0, sizeof(Info), &Info);
-	}
-
-	for(int i = 0; i < Reader.NumData() || i == SettingsIndex; i++)
-	{
-		if(i == SettingsIndex)
-		{
-			Writer.AddData(TotalLength, pSettings);
-			continue;
-		}
-		unsigned char *pData = (unsigned char *)Reader.GetData(i);
-		int Size = Reader.GetDataSize(i);
-		Writer.AddData(Size, pData);
-		Reader.UnloadData(i);
-	}
-
-	dbg_msg("mapchange", "imported settings");
-	Reader.Close();
-	Writer.OpenFile(Storage(), aTemp);
-	Writer.Finish();
-
-	str_copy(pNewMapName, aTemp, MapNameSize);
-	str_copy(m_aDeleteTempfile, aTemp, sizeof(m_aDeleteTempfile));
-}
-
 void CGameContext::OnShutdown(bool FullShutdown)
 {
 	if (FullShutdown)
@@ -3057,7 +2947,6 @@ void CGameContext::OnShutdown(bool FullShutdown)
 		aio_free(m_pTeeHistorianFile);
 	}
 
-	DeleteTempfile();
 	Console()->ResetServerGameSettings();
 	Collision()->Dest();
 	delete m_pController;
@@ -3128,7 +3017,11 @@ void CGameContext::OnSnap(int ClientID)
 		m_apPlayers[ClientID]->FakeSnap();
 
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	m_World.PrepareSnap();
+}
+
 void CGameContext::OnPostSnap()
 {
 	m_Events.Clear();
@@ -3144,6 +3037,35 @@ bool CGameContext::IsClientPlayer(int ClientID)
 	return m_apPlayers[ClientID] && m_apPlayers[ClientID]->GetTeam() == TEAM_SPECTATORS ? false : true;
 }
 
+bool CGameContext::GetCharacterPos(int ClientID, int *pX, int *pY)
+{
+	if(!m_apPlayers[ClientID] || !m_apPlayers[ClientID]->GetCharacter())
+		return false;
+	CNetObj_CharacterCore Char;
+	m_apPlayers[ClientID]->GetCharacter()->GetCore().Write(&Char);
+	*pX = Char.m_X;
+	*pY = Char.m_Y;
+	return true;
+}
+
+unsigned CGameContext::CharacterChecksum()
+{
+	// fnv-1a over the floats as they are
+	unsigned Hash = 2166136261u;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CCharacterCore *pCore = m_World.m_Core.m_apCharacters[i];
+		if(!pCore)
+			continue;
+		float aState[] = {pCore->m_Pos.x, pCore->m_Pos.y, pCore->m_Vel.x, pCore->m_Vel.y, pCore->m_HookPos.x, pCore->m_HookPos.y};
+		const unsigned char *pData = (const unsigned char *)aState;
+		for(unsigned b = 0; b < sizeof(aState); b++)
+			Hash = (Hash ^ pData[b]) * 16777619u;
+		Hash = (Hash ^ (unsigned)(pCore->m_HookedPlayer + 1)) * 16777619u;
+	}
+	return Hash;
+}
+
 CUuid CGameContext::GameUuid() { return m_GameUuid; }
 const char *CGameContext::GameType() { return m_pController && m_pController->m_pGameType ? m_pController->m_pGameType : ""; }
 const char *CGameContext::Version() { return GAME_VERSION; }
@@ -93,6 +93,7 @@ class CGameContext : public IGameServer
 	static void ConTuneSetZoneMsgEnter(IConsole::IResult *pResult, void *pUserData);
 	static void ConTuneSetZoneMsgLeave(IConsole::IResult *pResult, void *pUserData);
 	static void ConMapbug(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpEntities(IConsole::IResult *pResult, void *pUserData);
 	static void ConSwitchOpen(IConsole::IResult *pResult, void *pUserData);
 	static void ConPause(IConsole::IResult *pResult, void *pUserData);
 	static void ConChangeMap(IConsole::IResult *pResult, void *pUserData);
@@ -160,9 +161,6 @@ public:
 	char m_aaZoneEnterMsg[NUM_TUNEZONES][256]; // 0 is used for switching from or to area without tunings
 	char m_aaZoneLeaveMsg[NUM_TUNEZONES][256];
 
-	char m_aDeleteTempfile[128];
-	void DeleteTempfile();
-
 	enum
 	{
 		VOTE_ENFORCE_UNKNOWN=0,
@@ -174,12 +172,12 @@ public:
 	CVoteOptionServer *m_pVoteOptionLast;
 
 	// helper functions
-	void CreateDamageInd(vec2 Pos, float AngleMod, int Amount, int64_t Mask=-1);
-	void CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamage, int ActivatedTeam, int64_t Mask);
-	void CreateHammerHit(vec2 Pos, int64_t Mask=-1);
-	void CreatePlayerSpawn(vec2 Pos, int64_t Mask=-1);
-	void CreateDeath(vec2 Pos, int Who, int64_t Mask=-1);
-	void CreateSound(vec2 Pos, int Sound, int64_t Mask=-1);
+	void CreateDamageInd(vec2 Pos, float AngleMod, int Amount, CClientMask Mask=CClientMask::All());
+	void CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamage, int ActivatedTeam, CClientMask Mask);
+	void CreateHammerHit(vec2 Pos, CClientMask Mask=CClientMask::All());
+	void CreatePlayerSpawn(vec2 Pos, CClientMask Mask=CClientMask::All());
+	void CreateDeath(vec2 Pos, int Who, CClientMask Mask=CClientMask::All());
+	void CreateSound(vec2 Pos, int Sound, CClientMask Mask=CClientMask::All());
 	void CreateSoundGlobal(int Sound, int Target=-1);
 
 
@@ -217,7 +215,6 @@ public:
 	// engine events
 	virtual void OnInit();
 	virtual void OnConsoleInit();
-	virtual void OnMapChange(char *pNewMapName, int MapNameSize);
 	virtual void OnShutdown(bool FullShutdown = false);
 
 	virtual void OnTick();
@@ -239,6 +236,8 @@ public:
 
 	virtual bool IsClientReady(int ClientID);
 	virtual bool IsClientPlayer(int ClientID);
+	virtual bool GetCharacterPos(int ClientID, int *pX, int *pY);
+	virtual unsigned CharacterChecksum();
 
 	virtual CUuid GameUuid();
 	virtual const char *GameType();
@@ -431,9 +430,9 @@ public:
 	int m_ChatPrintCBIndex;
 };
 
-inline int64_t CmaskAll() { return -1LL; }
-inline int64_t CmaskOne(int ClientID) { return 1LL<<ClientID; }
-inline int64_t CmaskUnset(int64_t Mask, int ClientID) { return Mask^CmaskOne(ClientID); }
-inline int64_t CmaskAllExceptOne(int ClientID) { return CmaskUnset(CmaskAll(), ClientID); }
-inline bool CmaskIsSet(int64_t Mask, int ClientID) { return (Mask&CmaskOne(ClientID)) != 0; }
+inline CClientMask CmaskAll() { return CClientMask::All(); }
+inline CClientMask CmaskOne(int ClientID) { return CClientMask::One(ClientID); }
+inline CClientMask CmaskUnset(CClientMask Mask, int ClientID) { Mask.Unset(ClientID); return Mask; }
+inline CClientMask CmaskAllExceptOne(int ClientID) { return CmaskUnset(CmaskAll(), ClientID); }
+inline bool CmaskIsSet(const CClientMask &Mask, int ClientID) { return Mask.Test(ClientID); }
 #endif
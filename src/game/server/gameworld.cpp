@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <utility>
 #include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
 
 //////////////////////////////////////////////////
 // game world
@@ -19,7 +20,27 @@ CGameWorld::CGameWorld()
 	m_Paused = false;
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
 		m_apFirstEntityTypes[i] = 0;
+		m_aNumEntities[i] = 0;
+		m_aPeakEntities[i] = 0;
+	}
+	m_NextInsertOrder = 0;
+
+	for(int i = 0; i < NUM_GRID_BUCKETS; i++)
+		m_apGridBuckets[i] = 0;
+	m_NumGridEntities = 0;
+	m_GridMaxRadius = 0;
+
+	m_SnapTick = -1;
+	m_SnapSeenStamp = 0;
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		char aName[32];
+		str_format(aName, sizeof(aName), "world.%s", TypeName(i));
+		m_aProfilePhases[i] = g_Profiler.Register(aName);
+	}
 }
 
 CGameWorld::~CGameWorld()
@@ -36,16 +57,139 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 	m_pServer = m_pGameServer->Server();
 }
 
+static int GridCoord(float Coord, float CellSize = CGameWorld::GRID_CELL_SIZE)
+{
+	// far outside of every map (or nan), the cells at the border take it
+	const float Limit = 1e7f;
+	if(!(Coord > -Limit))
+		Coord = -Limit;
+	else if(Coord > Limit)
+		Coord = Limit;
+	return (int)floorf(Coord / CellSize);
+}
+
+static int GridBucket(int X, int Y, unsigned NumBuckets = CGameWorld::NUM_GRID_BUCKETS)
+{
+	return ((unsigned)X * 73856093u ^ (unsigned)Y * 19349663u) % NumBuckets;
+}
+
+void CGameWorld::GridInsert(CEntity *pEnt)
+{
+	pEnt->m_GridX = GridCoord(pEnt->m_Pos.x);
+	pEnt->m_GridY = GridCoord(pEnt->m_Pos.y);
+	pEnt->m_GridBucket = GridBucket(pEnt->m_GridX, pEnt->m_GridY);
+
+	CEntity **ppFirst = &m_apGridBuckets[pEnt->m_GridBucket];
+	if(*ppFirst)
+		(*ppFirst)->m_pPrevGridEntity = pEnt;
+	pEnt->m_pNextGridEntity = *ppFirst;
+	pEnt->m_pPrevGridEntity = 0;
+	*ppFirst = pEnt;
+
+	m_NumGridEntities++;
+	m_GridMaxRadius = maximum(m_GridMaxRadius, pEnt->m_ProximityRadius);
+}
+
+void CGameWorld::GridRemove(CEntity *pEnt)
+{
+	if(pEnt->m_GridBucket < 0)
+		return;
+
+	if(pEnt->m_pPrevGridEntity)
+		pEnt->m_pPrevGridEntity->m_pNextGridEntity = pEnt->m_pNextGridEntity;
+	else
+		m_apGridBuckets[pEnt->m_GridBucket] = pEnt->m_pNextGridEntity;
+	if(pEnt->m_pNextGridEntity)
+		pEnt->m_pNextGridEntity->m_pPrevGridEntity = pEnt->m_pPrevGridEntity;
+
+	pEnt->m_pNextGridEntity = 0;
+	pEnt->m_pPrevGridEntity = 0;
+	pEnt->m_GridBucket = -1;
+	m_NumGridEntities--;
+}
+
+void CGameWorld::MoveEntity(CEntity *pEnt, vec2 Pos)
+{
+	pEnt->m_Pos = Pos;
+	if(pEnt->m_GridBucket < 0 || (GridCoord(Pos.x) == pEnt->m_GridX && GridCoord(Pos.y) == pEnt->m_GridY))
+		return;
+	GridRemove(pEnt);
+	GridInsert(pEnt);
+}
+
+bool CGameWorld::CompareInsertOrder(const CEntity *pA, const CEntity *pB)
+{
+	// the lists start with the newest
+	return pA->m_InsertOrder > pB->m_InsertOrder;
+}
+
+int CGameWorld::FindCharacters(vec2 Pos0, vec2 Pos1, float Radius, CEntity **ppEnts)
+{
+	// the characters that can be closer than Radius to the line from Pos0
+	// to Pos1, in the order of the list so that the callers pick the same
+	// ones as when walking it. ppEnts must fit MAX_CLIENTS, there are no
+	// more characters than that
+	float Margin = Radius + m_GridMaxRadius + 1.0f;
+	int X0 = GridCoord(minimum(Pos0.x, Pos1.x) - Margin);
+	int Y0 = GridCoord(minimum(Pos0.y, Pos1.y) - Margin);
+	int X1 = GridCoord(maximum(Pos0.x, Pos1.x) + Margin);
+	int Y1 = GridCoord(maximum(Pos0.y, Pos1.y) + Margin);
+
+	int Num = 0;
+	if((int64)(X1-X0+1)*(Y1-Y0+1) > m_NumGridEntities)
+	{
+		// more cells than characters, looking at all of them is cheaper
+		for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt && Num < MAX_CLIENTS; pEnt = pEnt->m_pNextTypeEntity)
+			ppEnts[Num++] = pEnt;
+		return Num;
+	}
+
+	for(int y = Y0; y <= Y1; y++)
+		for(int x = X0; x <= X1; x++)
+			for(CEntity *pEnt = m_apGridBuckets[GridBucket(x, y)]; pEnt; pEnt = pEnt->m_pNextGridEntity)
+				if(pEnt->m_GridX == x && pEnt->m_GridY == y && Num < MAX_CLIENTS)
+					ppEnts[Num++] = pEnt;
+	std::sort(ppEnts, ppEnts + Num, CompareInsertOrder);
+	return Num;
+}
+
 CEntity *CGameWorld::FindFirst(int Type)
 {
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
 }
 
+const char *CGameWorld::TypeName(int Type)
+{
+	static const char *s_apNames[NUM_ENTTYPES] = {
+		"projectile", "laser", "pickup", "flag", "character"
+	};
+	return Type < 0 || Type >= NUM_ENTTYPES ? "unknown" : s_apNames[Type];
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
+	if(Type == ENTTYPE_CHARACTER)
+	{
+		CEntity *apChars[MAX_CLIENTS];
+		int NumChars = FindCharacters(Pos, Pos, Radius, apChars);
+		int Num = 0;
+		for(int i = 0; i < NumChars; i++)
+		{
+			if(distance(apChars[i]->m_Pos, Pos) < Radius+apChars[i]->m_ProximityRadius)
+			{
+				if(ppEnts)
+					ppEnts[Num] = apChars[i];
+				Num++;
+				if(Num == Max)
+					break;
+			}
+		}
+		return Num;
+	}
+
 	int Num = 0;
 	for(CEntity *pEnt = m_apFirstEntityTypes[Type];	pEnt; pEnt = pEnt->m_pNextTypeEntity)
 	{
@@ -75,6 +219,12 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+	pEnt->m_InsertOrder = m_NextInsertOrder++;
+	if(++m_aNumEntities[pEnt->m_ObjType] > m_aPeakEntities[pEnt->m_ObjType])
+		m_aPeakEntities[pEnt->m_ObjType] = m_aNumEntities[pEnt->m_ObjType];
+
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		GridInsert(pEnt);
 }
 
 void CGameWorld::DestroyEntity(CEntity *pEnt)
@@ -102,18 +252,115 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+	GridRemove(pEnt);
+	m_aNumEntities[pEnt->m_ObjType]--;
 }
 
 //
-void CGameWorld::Snap(int SnappingClient)
+void CGameWorld::PrepareSnap()
 {
+	m_SnapTick = Server()->Tick();
+	m_vpSnapEntities.clear();
+	m_vSnapAlways.clear();
+	m_vSnapUnsorted.clear();
+	for(int i = 0; i <= NUM_SNAP_BUCKETS; i++)
+		m_aSnapBuckets[i] = 0;
+
+	vec2 aPositions[MAX_SNAP_POSITIONS];
 	for(int i = 0; i < NUM_ENTTYPES; i++)
-		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
 		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
-			pEnt = m_pNextTraverseEntity;
+			int Entity = m_vpSnapEntities.size();
+			m_vpSnapEntities.push_back(pEnt);
+			int Num = pEnt->SnapPositions(aPositions, MAX_SNAP_POSITIONS);
+			// nan is never clipped
+			for(int j = 0; j < Num; j++)
+				if(aPositions[j].x != aPositions[j].x || aPositions[j].y != aPositions[j].y)
+					Num = -1;
+			if(Num < 0)
+			{
+				m_vSnapAlways.push_back(Entity);
+				continue;
+			}
+			for(int j = 0; j < Num; j++)
+			{
+				CSnapPos Pos;
+				Pos.m_Pos = aPositions[j];
+				Pos.m_Entity = Entity;
+				Pos.m_Bucket = GridBucket(GridCoord(Pos.m_Pos.x, SNAP_CELL_SIZE), GridCoord(Pos.m_Pos.y, SNAP_CELL_SIZE), NUM_SNAP_BUCKETS);
+				m_vSnapUnsorted.push_back(Pos);
+				m_aSnapBuckets[Pos.m_Bucket+1]++;
+			}
 		}
+
+	// sort the positions by bucket
+	for(int i = 0; i < NUM_SNAP_BUCKETS; i++)
+		m_aSnapBuckets[i+1] += m_aSnapBuckets[i];
+	int aNext[NUM_SNAP_BUCKETS];
+	mem_copy(aNext, m_aSnapBuckets, sizeof(aNext));
+	m_vSnapPositions.resize(m_vSnapUnsorted.size());
+	for(unsigned i = 0; i < m_vSnapUnsorted.size(); i++)
+		m_vSnapPositions[aNext[m_vSnapUnsorted[i].m_Bucket]++] = m_vSnapUnsorted[i];
+
+	m_vSnapSeen.assign(m_vpSnapEntities.size(), 0);
+	m_SnapSeenStamp = 0;
+}
+
+void CGameWorld::Snap(int SnappingClient)
+{
+	// demos and clients that see everything visit all entities, and so
+	// does everyone in small worlds, where that is quicker than the index
+	CPlayer *pPlayer = SnappingClient >= 0 ? GameServer()->m_apPlayers[SnappingClient] : 0;
+	vec2 ViewPos = pPlayer ? pPlayer->m_ViewPos : vec2(0, 0);
+	if(!pPlayer || pPlayer->m_ShowAll || m_SnapTick != Server()->Tick() || (int)m_vSnapPositions.size() < SNAP_INDEX_MIN_POSITIONS
+		|| ViewPos.x != ViewPos.x || ViewPos.y != ViewPos.y)
+	{
+		for(int i = 0; i < NUM_ENTTYPES; i++)
+			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+			{
+				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				pEnt->Snap(SnappingClient);
+				pEnt = m_pNextTraverseEntity;
+			}
+		return;
+	}
+
+	// the cells a bit beyond the view, the positions in them are then
+	// tested like NetworkClipped does
+	m_vSnapVisible.clear();
+	int Stamp = ++m_SnapSeenStamp;
+	int MinX = GridCoord(ViewPos.x - 1001.0f, SNAP_CELL_SIZE);
+	int MaxX = GridCoord(ViewPos.x + 1001.0f, SNAP_CELL_SIZE);
+	int MinY = GridCoord(ViewPos.y - 801.0f, SNAP_CELL_SIZE);
+	int MaxY = GridCoord(ViewPos.y + 801.0f, SNAP_CELL_SIZE);
+	for(int y = MinY; y <= MaxY; y++)
+		for(int x = MinX; x <= MaxX; x++)
+		{
+			int Bucket = GridBucket(x, y, NUM_SNAP_BUCKETS);
+			for(int i = m_aSnapBuckets[Bucket]; i < m_aSnapBuckets[Bucket+1]; i++)
+			{
+				const CSnapPos &Pos = m_vSnapPositions[i];
+				if(m_vSnapSeen[Pos.m_Entity] != Stamp && !CEntity::NetworkClippedPos(ViewPos, Pos.m_Pos))
+				{
+					m_vSnapSeen[Pos.m_Entity] = Stamp;
+					m_vSnapVisible.push_back(Pos.m_Entity);
+				}
+			}
+		}
+
+	// merge with the entities that are always snapped, in the order of
+	// the full walk
+	std::sort(m_vSnapVisible.begin(), m_vSnapVisible.end());
+	unsigned Visible = 0, Always = 0;
+	while(Visible < m_vSnapVisible.size() || Always < m_vSnapAlways.size())
+	{
+		int Entity;
+		if(Always == m_vSnapAlways.size() || (Visible < m_vSnapVisible.size() && m_vSnapVisible[Visible] < m_vSnapAlways[Always]))
+			Entity = m_vSnapVisible[Visible++];
+		else
+			Entity = m_vSnapAlways[Always++];
+		m_vpSnapEntities[Entity]->Snap(SnappingClient);
+	}
 }
 
 void CGameWorld::Reset()
@@ -250,35 +497,49 @@ void CGameWorld::Tick()
 			GameServer()->SendChat(-1, CGameContext::CHAT_ALL, "Teams have been balanced");
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			CProfileScope Scope(m_aProfilePhases[i]);
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->Tick();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 
 		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			CProfileScope Scope(m_aProfilePhases[i]);
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->TickDefered();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 	}
 	else
 	{
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			CProfileScope Scope(m_aProfilePhases[i]);
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->TickPaused();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 	}
 
 	RemoveEntities();
 
+#ifdef CONF_DEBUG
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		dbg_assert(pEnt->m_GridX == GridCoord(pEnt->m_Pos.x) && pEnt->m_GridY == GridCoord(pEnt->m_Pos.y), "character moved without MoveEntity");
+#endif
+
 	UpdatePlayerMaps();
 
 	// find the characters' strong/weak id
@@ -298,9 +559,11 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	CEntity *apChars[MAX_CLIENTS];
+	int NumChars = FindCharacters(Pos0, Pos1, Radius, apChars);
+	for(int i = 0; i < NumChars; i++)
 	{
+		CCharacter *p = (CCharacter *)apChars[i];
 		if(p == pNotThis)
 			continue;
 
@@ -331,9 +594,11 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	float ClosestRange = Radius*2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	CEntity *apChars[MAX_CLIENTS];
+	int NumChars = FindCharacters(Pos, Pos, Radius, apChars);
+	for(int i = 0; i < NumChars; i++)
 	{
+		CCharacter *p = (CCharacter *)apChars[i];
 		if(p == pNotThis)
 			continue;
 
@@ -355,9 +620,11 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 {
 	std::list< CCharacter * > listOfChars;
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	CEntity *apChars[MAX_CLIENTS];
+	int NumChars = FindCharacters(Pos0, Pos1, Radius, apChars);
+	for(int i = 0; i < NumChars; i++)
 	{
+		CCharacter *pChr = (CCharacter *)apChars[i];
 		if(pChr == pNotThis)
 			continue;
 
@@ -6,6 +6,7 @@
 #include <game/gamecore.h>
 
 #include <list>
+#include <vector>
 
 class CEntity;
 class CCharacter;
@@ -25,7 +26,15 @@ public:
 		ENTTYPE_PICKUP,
 		ENTTYPE_FLAG,
 		ENTTYPE_CHARACTER,
-		NUM_ENTTYPES
+		NUM_ENTTYPES,
+
+		GRID_CELL_SIZE=128,
+		NUM_GRID_BUCKETS=256,
+
+		SNAP_CELL_SIZE=512,
+		NUM_SNAP_BUCKETS=64,
+		MAX_SNAP_POSITIONS=4,
+		SNAP_INDEX_MIN_POSITIONS=256,
 	};
 
 private:
@@ -34,6 +43,42 @@ private:
 
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
+	int64 m_NextInsertOrder;
+	int m_aNumEntities[NUM_ENTTYPES];
+	int m_aPeakEntities[NUM_ENTTYPES];
+	int m_aProfilePhases[NUM_ENTTYPES];
+
+	// the characters are also filed in a spatial hash grid, so that the
+	// lookups by position only visit the ones nearby. the other types are
+	// never looked up by position
+	CEntity *m_apGridBuckets[NUM_GRID_BUCKETS];
+	int m_NumGridEntities;
+	float m_GridMaxRadius;
+
+	void GridInsert(CEntity *pEnt);
+	void GridRemove(CEntity *pEnt);
+	int FindCharacters(vec2 Pos0, vec2 Pos1, float Radius, CEntity **ppEnts);
+	static bool CompareInsertOrder(const CEntity *pA, const CEntity *pB);
+
+	// before the snapshots are built, the positions the entities are
+	// clipped at are filed by cell, so that every client only visits the
+	// entities around its view. the entities are numbered in the order
+	// Snap visits them
+	struct CSnapPos
+	{
+		vec2 m_Pos;
+		int m_Entity;
+		int m_Bucket;
+	};
+	int m_SnapTick;
+	std::vector<CEntity *> m_vpSnapEntities;
+	std::vector<int> m_vSnapAlways;
+	std::vector<CSnapPos> m_vSnapUnsorted;
+	std::vector<CSnapPos> m_vSnapPositions;
+	int m_aSnapBuckets[NUM_SNAP_BUCKETS+1];
+	std::vector<int> m_vSnapSeen;
+	int m_SnapSeenStamp;
+	std::vector<int> m_vSnapVisible;
 
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
@@ -55,6 +100,11 @@ public:
 
 	CEntity *FindFirst(int Type);
 
+	static const char *TypeName(int Type);
+	// the entities of a type in the world, and the most there were at once
+	int NumEntities(int Type) const { return m_aNumEntities[Type]; }
+	int PeakEntities(int Type) const { return m_aPeakEntities[Type]; }
+
 	/*
 		Function: find_entities
 			Finds entities close to a position and returns them in a list.
@@ -120,6 +170,18 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: move_entity
+			Changes the position of an entity. The position of a
+			character that is in the world must only be changed
+			through this.
+
+		Arguments:
+			entity - Entity to move
+			pos - New position
+	*/
+	void MoveEntity(CEntity *pEntity, vec2 Pos);
+
 	/*
 		Function: destroy_entity
 			Destroys an entity in the world.
@@ -129,10 +191,17 @@ public:
 	*/
 	void DestroyEntity(CEntity *pEntity);
 
+	/*
+		Function: prepare_snap
+			Files the entities by the positions they are clipped at,
+			before the snapshots of a tick are created.
+	*/
+	void PrepareSnap();
+
 	/*
 		Function: snap
-			Calls snap on all the entities in the world to create
-			the snapshot.
+			Calls snap on the entities in the world the client can
+			see to create the snapshot.
 
 		Arguments:
 			snapping_client - ID of the client which snapshot
@@ -131,7 +131,7 @@ void CSaveTee::load(CCharacter *pChr, int Team)
 	if(m_Time)
 		pChr->m_StartTime = pChr->Server()->Tick() - m_Time;
 
-	pChr->m_Pos = m_Pos;
+	pChr->GameWorld()->MoveEntity(pChr, m_Pos);
 	pChr->m_PrevPos = m_PrevPos;
 	pChr->m_TeleCheckpoint = m_TeleCheckpoint;
 	pChr->m_LastPenalty = m_LastPenalty;
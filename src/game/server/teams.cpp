@@ -20,7 +20,7 @@ void CGameTeams::Reset()
 		m_LastChat[i] = 0;
 		m_TeamLocked[i] = false;
 		m_IsSaving[i] = false;
-		m_Invited[i] = 0;
+		m_Invited[i].Clear();
 	}
 }
 
@@ -321,9 +321,9 @@ bool CGameTeams::TeamFinished(int Team)
 	return true;
 }
 
-int64_t CGameTeams::TeamMask(int Team, int ExceptID, int Asker)
+CClientMask CGameTeams::TeamMask(int Team, int ExceptID, int Asker)
 {
-	int64_t Mask = 0;
+	CClientMask Mask;
 
 	for (int i = 0; i < MAX_CLIENTS; ++i)
 	{
@@ -375,7 +375,7 @@ int64_t CGameTeams::TeamMask(int Team, int ExceptID, int Asker)
 			}
 		}
 
-		Mask |= 1LL << i;
+		Mask.Set(i);
 	}
 	return Mask;
 }
@@ -693,7 +693,7 @@ void CGameTeams::SetTeamLock(int Team, bool Lock)
 
 void CGameTeams::ResetInvited(int Team)
 {
-	m_Invited[Team] = 0;
+	m_Invited[Team].Clear();
 }
 
 void CGameTeams::SetClientInvited(int Team, int ClientID, bool Invited)
@@ -701,9 +701,9 @@ void CGameTeams::SetClientInvited(int Team, int ClientID, bool Invited)
 	if(Team > TEAM_FLOCK && Team < TEAM_SUPER)
 	{
 		if(Invited)
-			m_Invited[Team] |= 1ULL << ClientID;
+			m_Invited[Team].Set(ClientID);
 		else
-			m_Invited[Team] &= ~(1ULL << ClientID);
+			m_Invited[Team].Unset(ClientID);
 	}
 }
 
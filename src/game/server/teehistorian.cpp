@@ -558,3 +558,209 @@ void CTeeHistorian::Finish()
 
 	Write(Buffer.Data(), Buffer.Size());
 }
+
+CTeeHistorianReader::CTeeHistorianReader()
+{
+	m_pHeader = "";
+	m_aError[0] = 0;
+	m_Finished = true;
+	m_Tick = 0;
+	m_LastPlayerID = MAX_CLIENTS;
+	m_HasPending = false;
+	mem_zero(m_aPlayers, sizeof(m_aPlayers));
+}
+
+bool CTeeHistorianReader::Open(const void *pData, int DataSize)
+{
+	*this = CTeeHistorianReader();
+
+	const char *pStart = (const char *)pData;
+	if(DataSize < (int)sizeof(CUuid) || mem_comp(pStart, &TEEHISTORIAN_UUID, sizeof(CUuid)) != 0)
+	{
+		str_copy(m_aError, "not a teehistorian file", sizeof(m_aError));
+		return false;
+	}
+
+	const char *pHeader = pStart + sizeof(CUuid);
+	const char *pHeaderEnd = pHeader;
+	while(pHeaderEnd < pStart + DataSize && *pHeaderEnd)
+		pHeaderEnd++;
+	if(pHeaderEnd == pStart + DataSize)
+	{
+		str_copy(m_aError, "header is not terminated", sizeof(m_aError));
+		return false;
+	}
+
+	// like the writer, start before tick 1, so that its player data starts
+	// a tick without an explicit one
+	m_pHeader = pHeader;
+	m_Unpacker.Reset(pHeaderEnd + 1, DataSize - (pHeaderEnd + 1 - pStart));
+	m_Finished = false;
+	return true;
+}
+
+int CTeeHistorianReader::Fail(const char *pError)
+{
+	str_format(m_aError, sizeof(m_aError), "%s at tick %d", pError, m_Tick);
+	m_Finished = true;
+	return ITEM_ERROR;
+}
+
+bool CTeeHistorianReader::ReadClientID(int *pClientID)
+{
+	*pClientID = m_Unpacker.GetInt();
+	return !m_Unpacker.Error() && *pClientID >= 0 && *pClientID < MAX_CLIENTS;
+}
+
+int CTeeHistorianReader::Next(CItem *pItem)
+{
+	if(m_HasPending)
+	{
+		*pItem = m_Pending;
+		m_HasPending = false;
+		return pItem->m_Type;
+	}
+	if(m_Finished)
+		return m_aError[0] ? ITEM_ERROR : ITEM_FINISH;
+
+	mem_zero(pItem, sizeof(*pItem));
+	int Type = m_Unpacker.GetInt();
+	if(m_Unpacker.Error())
+		return Fail("unexpected end of file");
+
+	if(Type >= 0 || Type == -TEEHISTORIAN_PLAYER_NEW || Type == -TEEHISTORIAN_PLAYER_OLD)
+	{
+		if(Type >= 0)
+		{
+			pItem->m_ClientID = Type;
+			if(pItem->m_ClientID >= MAX_CLIENTS)
+				return Fail("invalid client id");
+			CPlayer *pPlayer = &m_aPlayers[pItem->m_ClientID];
+			pPlayer->m_X += m_Unpacker.GetInt();
+			pPlayer->m_Y += m_Unpacker.GetInt();
+		}
+		else
+		{
+			if(!ReadClientID(&pItem->m_ClientID))
+				return Fail("invalid player data");
+			if(Type == -TEEHISTORIAN_PLAYER_NEW)
+			{
+				m_aPlayers[pItem->m_ClientID].m_X = m_Unpacker.GetInt();
+				m_aPlayers[pItem->m_ClientID].m_Y = m_Unpacker.GetInt();
+			}
+		}
+		if(m_Unpacker.Error())
+			return Fail("invalid player data");
+
+		pItem->m_Type = Type == -TEEHISTORIAN_PLAYER_OLD ? ITEM_PLAYER_DEAD : ITEM_PLAYER;
+		pItem->m_X = m_aPlayers[pItem->m_ClientID].m_X;
+		pItem->m_Y = m_aPlayers[pItem->m_ClientID].m_Y;
+
+		// player data comes in ascending client ids, if it starts over
+		// without an explicit tick, it is the next tick
+		if(pItem->m_ClientID <= m_LastPlayerID)
+		{
+			m_Pending = *pItem;
+			m_HasPending = true;
+			m_Tick++;
+			m_LastPlayerID = pItem->m_ClientID;
+			pItem->m_Type = ITEM_TICK;
+			pItem->m_ClientID = -1;
+			return ITEM_TICK;
+		}
+		m_LastPlayerID = pItem->m_ClientID;
+		return pItem->m_Type;
+	}
+
+	switch(-Type)
+	{
+	case TEEHISTORIAN_FINISH:
+		m_Finished = true;
+		return ITEM_FINISH;
+
+	case TEEHISTORIAN_TICK_SKIP:
+	{
+		int Skip = m_Unpacker.GetInt();
+		if(m_Unpacker.Error() || Skip < 0)
+			return Fail("invalid tick skip");
+		m_Tick += Skip + 1;
+		m_LastPlayerID = -1;
+		pItem->m_Type = ITEM_TICK;
+		pItem->m_ClientID = -1;
+		return ITEM_TICK;
+	}
+
+	case TEEHISTORIAN_INPUT_NEW:
+	case TEEHISTORIAN_INPUT_DIFF:
+	{
+		if(!ReadClientID(&pItem->m_ClientID))
+			return Fail("invalid input");
+		int *pInput = (int *)&m_aPlayers[pItem->m_ClientID].m_Input;
+		for(int i = 0; i < (int)(sizeof(CNetObj_PlayerInput) / sizeof(int)); i++)
+		{
+			int Value = m_Unpacker.GetInt();
+			pInput[i] = -Type == TEEHISTORIAN_INPUT_NEW ? Value : pInput[i] + Value;
+		}
+		if(m_Unpacker.Error())
+			return Fail("invalid input");
+		pItem->m_Type = ITEM_INPUT;
+		pItem->m_Input = m_aPlayers[pItem->m_ClientID].m_Input;
+		return ITEM_INPUT;
+	}
+
+	case TEEHISTORIAN_MESSAGE:
+		if(!ReadClientID(&pItem->m_ClientID))
+			return Fail("invalid message");
+		pItem->m_DataSize = m_Unpacker.GetInt();
+		pItem->m_pData = m_Unpacker.GetRaw(pItem->m_DataSize);
+		if(m_Unpacker.Error())
+			return Fail("invalid message");
+		pItem->m_Type = ITEM_MESSAGE;
+		return ITEM_MESSAGE;
+
+	case TEEHISTORIAN_JOIN:
+		if(!ReadClientID(&pItem->m_ClientID))
+			return Fail("invalid join");
+		pItem->m_Type = ITEM_JOIN;
+		return ITEM_JOIN;
+
+	case TEEHISTORIAN_DROP:
+		if(!ReadClientID(&pItem->m_ClientID))
+			return Fail("invalid drop");
+		pItem->m_pString = m_Unpacker.GetString(0);
+		if(m_Unpacker.Error())
+			return Fail("invalid drop");
+		pItem->m_Type = ITEM_DROP;
+		return ITEM_DROP;
+
+	case TEEHISTORIAN_CONSOLE_COMMAND:
+		// commands of the server itself have negative client ids
+		pItem->m_ClientID = m_Unpacker.GetInt();
+		pItem->m_FlagMask = m_Unpacker.GetInt();
+		pItem->m_pString = m_Unpacker.GetString(0);
+		pItem->m_NumArgs = m_Unpacker.GetInt();
+		if(m_Unpacker.Error() || pItem->m_ClientID >= MAX_CLIENTS || pItem->m_NumArgs < 0 || pItem->m_NumArgs > MAX_ARGS)
+			return Fail("invalid console command");
+		for(int i = 0; i < pItem->m_NumArgs; i++)
+			pItem->m_apArgs[i] = m_Unpacker.GetString(0);
+		if(m_Unpacker.Error())
+			return Fail("invalid console command");
+		pItem->m_Type = ITEM_CONSOLE_COMMAND;
+		return ITEM_CONSOLE_COMMAND;
+
+	case TEEHISTORIAN_EX:
+	{
+		const void *pUuid = m_Unpacker.GetRaw(sizeof(CUuid));
+		pItem->m_DataSize = m_Unpacker.GetInt();
+		pItem->m_pData = m_Unpacker.GetRaw(pItem->m_DataSize);
+		if(m_Unpacker.Error())
+			return Fail("invalid extra data");
+		mem_copy(&pItem->m_Uuid, pUuid, sizeof(CUuid));
+		pItem->m_ClientID = -1;
+		pItem->m_Type = ITEM_EX;
+		return ITEM_EX;
+	}
+	}
+
+	return Fail("unknown item");
+}
@@ -112,4 +112,84 @@ private:
 	CPlayer m_aPrevPlayers[MAX_CLIENTS];
 };
 
+// reads what CTeeHistorian wrote, one item at a time. ticks that are only
+// implied by the player data are returned as ITEM_TICK like the explicit
+// ones, positions and inputs are returned whole instead of as differences
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		ITEM_ERROR=-1,
+		ITEM_FINISH=0,
+		ITEM_TICK,
+		ITEM_PLAYER,
+		ITEM_PLAYER_DEAD,
+		ITEM_INPUT,
+		ITEM_MESSAGE,
+		ITEM_JOIN,
+		ITEM_DROP,
+		ITEM_CONSOLE_COMMAND,
+		ITEM_EX,
+
+		MAX_ARGS=16,
+	};
+
+	struct CItem
+	{
+		int m_Type;
+		int m_ClientID;
+
+		// ITEM_PLAYER
+		int m_X;
+		int m_Y;
+
+		// ITEM_INPUT
+		CNetObj_PlayerInput m_Input;
+
+		// ITEM_MESSAGE, ITEM_EX
+		CUuid m_Uuid;
+		const void *m_pData;
+		int m_DataSize;
+
+		// ITEM_DROP (the reason), ITEM_CONSOLE_COMMAND
+		const char *m_pString;
+		int m_FlagMask;
+		int m_NumArgs;
+		const char *m_apArgs[MAX_ARGS];
+	};
+
+	CTeeHistorianReader();
+
+	// the data must stay around while reading, the strings point into it
+	bool Open(const void *pData, int DataSize);
+	const char *Header() const { return m_pHeader; }
+	const char *Error() const { return m_aError; }
+	int Tick() const { return m_Tick; }
+
+	int Next(CItem *pItem);
+
+private:
+	int Fail(const char *pError);
+	bool ReadClientID(int *pClientID);
+
+	CUnpacker m_Unpacker;
+	const char *m_pHeader;
+	char m_aError[128];
+	bool m_Finished;
+
+	int m_Tick;
+	int m_LastPlayerID;
+	CItem m_Pending;
+	bool m_HasPending;
+
+	struct CPlayer
+	{
+		int m_X;
+		int m_Y;
+		CNetObj_PlayerInput m_Input;
+	};
+	CPlayer m_aPlayers[MAX_CLIENTS];
+};
+
 #endif // GAME_SERVER_TEEHISTORIAN_H
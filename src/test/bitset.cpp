@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/bitset.h>
+
+#include <set>
+
+template<class T>
+static void CheckMatches(const T &Set, const std::set<int> &Expected)
+{
+	EXPECT_EQ(Set.Count(), (int)Expected.size());
+	EXPECT_EQ(Set.Any(), !Expected.empty());
+	std::set<int>::const_iterator it = Expected.begin();
+	for(int i = Set.FindNext(0); i < Set.SIZE; i = Set.FindNext(i+1), ++it)
+	{
+		ASSERT_TRUE(it != Expected.end());
+		EXPECT_EQ(i, *it);
+	}
+	EXPECT_TRUE(it == Expected.end());
+	for(int i = 0; i < Set.SIZE; i++)
+		EXPECT_EQ(Set.Test(i), Expected.count(i) != 0) << i;
+}
+
+TEST(Bitset, Empty)
+{
+	CBitset<64> Set;
+	CheckMatches(Set, std::set<int>());
+	EXPECT_EQ(Set.FindNext(64), 64);
+}
+
+TEST(Bitset, AllAndComplement)
+{
+	// the unused bits of the last word must never show up
+	CBitset<130> Set = CBitset<130>::All();
+	EXPECT_EQ(Set.Count(), 130);
+	EXPECT_EQ(Set.FindNext(129), 129);
+	Set.Unset(129);
+	EXPECT_EQ(Set.FindNext(129), 130);
+	CBitset<130> Complement = ~Set;
+	std::set<int> Expected;
+	Expected.insert(129);
+	CheckMatches(Complement, Expected);
+	EXPECT_TRUE((Set | Complement) == CBitset<130>::All());
+	EXPECT_FALSE((Set & Complement).Any());
+}
+
+TEST(Bitset, MatchesStdSet)
+{
+	unsigned Seed = 3;
+	for(int Round = 0; Round < 50; Round++)
+	{
+		CBitset<256> A, B;
+		std::set<int> ExpectedA, ExpectedB;
+		int Num = Round * 5;
+		for(int i = 0; i < Num; i++)
+		{
+			Seed = Seed * 1103515245 + 12345;
+			int Index = (Seed >> 8) % 256;
+			if(Seed % 3)
+			{
+				A.Set(Index);
+				ExpectedA.insert(Index);
+			}
+			else
+			{
+				B.Set(Index);
+				ExpectedB.insert(Index);
+			}
+		}
+		CheckMatches(A, ExpectedA);
+		CheckMatches(B, ExpectedB);
+
+		std::set<int> ExpectedOr = ExpectedA, ExpectedAnd;
+		ExpectedOr.insert(ExpectedB.begin(), ExpectedB.end());
+		for(std::set<int>::iterator it = ExpectedA.begin(); it != ExpectedA.end(); ++it)
+			if(ExpectedB.count(*it))
+				ExpectedAnd.insert(*it);
+		CheckMatches(A | B, ExpectedOr);
+		CheckMatches(A & B, ExpectedAnd);
+
+		if(!ExpectedA.empty())
+		{
+			A.Unset(*ExpectedA.begin());
+			ExpectedA.erase(ExpectedA.begin());
+			CheckMatches(A, ExpectedA);
+		}
+	}
+}
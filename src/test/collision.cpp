@@ -0,0 +1,460 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <vector>
+
+// the sampling GetMapIndices did before it walked the tile borders
+static std::vector<int> SampledMapIndices(CCollision *pCollision, vec2 PrevPos, vec2 Pos)
+{
+	std::vector<int> Indices;
+	int Width = pCollision->GetWidth();
+	int Height = pCollision->GetHeight();
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	if(!d)
+	{
+		int Index = pCollision->GetMapIndex(Pos);
+		if(pCollision->TileExists(Index))
+			Indices.push_back(Index);
+		return Indices;
+	}
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		vec2 Tmp = mix(PrevPos, Pos, i/d);
+		int Nx = clamp((int)Tmp.x / 32, 0, Width - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, Height - 1);
+		int Index = Ny * Width + Nx;
+		if(pCollision->TileExists(Index) && LastIndex != Index)
+		{
+			Indices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return Indices;
+}
+
+// the line checks as they were before they walked the tile borders
+static int SteppedIntersectLine(CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance+1);
+	vec2 Last = Pos0;
+	int ix = 0, iy = 0; // Temporary position for checking collision
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i/(float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		ix = round_to_int(Pos.x);
+		iy = round_to_int(Pos.y);
+
+		if(pCollision->CheckPoint(ix, iy))
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			return pCollision->GetCollisionAt(ix, iy);
+		}
+
+		Last = Pos;
+	}
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int SteppedIntersectLineTeleHook(CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance+1);
+	vec2 Last = Pos0;
+	int ix = 0, iy = 0; // Temporary position for checking collision
+	int dx = 0, dy = 0; // Offset for checking the "through" tile
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i/(float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		ix = round_to_int(Pos.x);
+		iy = round_to_int(Pos.y);
+
+		int Index = pCollision->GetPureMapIndex(Pos);
+		if (g_Config.m_SvOldTeleportHook)
+			*pTeleNr = pCollision->IsTeleport(Index);
+		else
+			*pTeleNr = pCollision->IsTeleportHook(Index);
+		if(*pTeleNr)
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int hit = 0;
+		if(pCollision->CheckPoint(ix, iy))
+		{
+			if(!pCollision->IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				hit = pCollision->GetCollisionAt(ix, iy);
+		}
+		else if(pCollision->IsHookBlocker(ix, iy, Pos0, Pos1))
+		{
+			hit = TILE_NOHOOK;
+		}
+		if(hit)
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			return hit;
+		}
+
+		Last = Pos;
+	}
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int SteppedIntersectLineTeleWeapon(CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance+1);
+	vec2 Last = Pos0;
+	int ix = 0, iy = 0; // Temporary position for checking collision
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i/(float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		ix = round_to_int(Pos.x);
+		iy = round_to_int(Pos.y);
+
+		int Index = pCollision->GetPureMapIndex(Pos);
+		if (g_Config.m_SvOldTeleportWeapons)
+			*pTeleNr = pCollision->IsTeleport(Index);
+		else
+			*pTeleNr = pCollision->IsTeleportWeapon(Index);
+		if(*pTeleNr)
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			return TILE_TELEINWEAPON;
+		}
+
+		if(pCollision->CheckPoint(ix, iy))
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			return pCollision->GetCollisionAt(ix, iy);
+		}
+
+		Last = Pos;
+	}
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int SteppedIntersectNoLaser(CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+
+	for(float f = 0; f < d; f++)
+	{
+		float a = f/d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int Nx = clamp(round_to_int(Pos.x)/32, 0, pCollision->GetWidth()-1);
+		int Ny = clamp(round_to_int(Pos.y)/32, 0, pCollision->GetHeight()-1);
+		if(pCollision->GetIndex(Nx, Ny) == TILE_SOLID
+			|| pCollision->GetIndex(Nx, Ny) == TILE_NOHOOK
+			|| pCollision->GetIndex(Nx, Ny) == TILE_NOLASER
+			|| pCollision->GetFIndex(Nx, Ny) == TILE_NOLASER)
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			if (pCollision->GetFIndex(Nx, Ny) == TILE_NOLASER)	return pCollision->GetFCollisionAt(Pos.x, Pos.y);
+			else return pCollision->GetCollisionAt(Pos.x, Pos.y);
+
+		}
+		Last = Pos;
+	}
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int SteppedIntersectNoLaserNW(CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+
+	for(float f = 0; f < d; f++)
+	{
+		float a = f/d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		if(pCollision->IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || pCollision->IsFNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			if(pCollision->IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y))) return pCollision->GetCollisionAt(Pos.x, Pos.y);
+			else return  pCollision->GetFCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int SteppedIntersectAir(CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+
+	for(float f = 0; f < d; f++)
+	{
+		float a = f/d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		if(pCollision->IsSolid(round_to_int(Pos.x), round_to_int(Pos.y)) || (!pCollision->GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !pCollision->GetFTile(round_to_int(Pos.x), round_to_int(Pos.y))))
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			if(!pCollision->GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !pCollision->GetFTile(round_to_int(Pos.x), round_to_int(Pos.y)))
+				return -1;
+			else
+				if (!pCollision->GetTile(round_to_int(Pos.x), round_to_int(Pos.y))) return pCollision->GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
+				else return pCollision->GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
+		}
+		Last = Pos;
+	}
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static std::vector<int> WalkedMapIndices(CCollision *pCollision, vec2 PrevPos, vec2 Pos, int BufferSize)
+{
+	std::vector<int> Indices;
+	int aIndices[16];
+	CCollision::CMapIndicesCursor Cursor;
+	int Num;
+	while((Num = pCollision->GetMapIndices(PrevPos, Pos, aIndices, BufferSize, &Cursor)) > 0)
+		Indices.insert(Indices.end(), aIndices, aIndices + Num);
+	return Indices;
+}
+
+class CollisionMap : public ::testing::TestWithParam<const char *>
+{
+protected:
+	IKernel *m_pKernel;
+	IEngineMap *m_pMap;
+	CLayers m_Layers;
+	CCollision m_Collision;
+	unsigned m_Seed;
+
+	void SetUp()
+	{
+		m_pKernel = IKernel::Create();
+		m_pKernel->RegisterInterface(CreateLocalStorage());
+		m_pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(static_cast<IMap *>(m_pMap), false);
+		m_pKernel->RegisterInterface(m_pMap);
+		char aFilename[128];
+		str_format(aFilename, sizeof(aFilename), "data/maps/%s.map", GetParam());
+		ASSERT_TRUE(m_pMap->Load(aFilename)) << aFilename;
+		m_Layers.Init(m_pKernel);
+		m_Collision.Init(&m_Layers);
+		m_Seed = 1;
+	}
+
+	void TearDown()
+	{
+		delete m_pKernel;
+	}
+
+	unsigned Random()
+	{
+		m_Seed ^= m_Seed << 13;
+		m_Seed ^= m_Seed >> 17;
+		m_Seed ^= m_Seed << 5;
+		return m_Seed;
+	}
+
+	float RandomFloat(float Min, float Max)
+	{
+		return Min + (Max - Min) * (Random() % 100000) / 100000.0f;
+	}
+
+	// somewhere on the map or a bit outside of it, often on a tile border
+	vec2 RandomPos()
+	{
+		vec2 Pos(RandomFloat(-100, m_Collision.GetWidth() * 32 + 100), RandomFloat(-100, m_Collision.GetHeight() * 32 + 100));
+		if(Random() % 4 == 0)
+			Pos = vec2(round_to_int(Pos.x / 32) * 32, round_to_int(Pos.y / 32) * 32);
+		return Pos;
+	}
+};
+
+TEST_P(CollisionMap, MapIndicesMatchSampling)
+{
+	int NumFound = 0;
+	for(int i = 0; i < 20000; i++)
+	{
+		vec2 PrevPos = RandomPos();
+		vec2 Pos;
+		switch(Random() % 5)
+		{
+		case 0: Pos = PrevPos; break;
+		case 1: Pos = PrevPos + vec2(RandomFloat(-40, 40), RandomFloat(-40, 40)); break;
+		case 2: Pos = PrevPos + vec2(RandomFloat(-400, 400), RandomFloat(-400, 400)); break;
+		case 3: Pos = PrevPos + (Random() % 2 ? vec2(RandomFloat(-300, 300), 0) : vec2(0, RandomFloat(-300, 300))); break;
+		default: Pos = RandomPos();
+		}
+
+		std::vector<int> Expected = SampledMapIndices(&m_Collision, PrevPos, Pos);
+		NumFound += Expected.size();
+		ASSERT_EQ(WalkedMapIndices(&m_Collision, PrevPos, Pos, 16), Expected)
+			<< "from " << PrevPos.x << "," << PrevPos.y << " to " << Pos.x << "," << Pos.y;
+		ASSERT_EQ(WalkedMapIndices(&m_Collision, PrevPos, Pos, 1 + Random() % 3), Expected)
+			<< "from " << PrevPos.x << "," << PrevPos.y << " to " << Pos.x << "," << Pos.y;
+	}
+	EXPECT_GT(NumFound, 0);
+}
+
+TEST_P(CollisionMap, LinesMatchStepping)
+{
+	int NumHits = 0;
+	for(int i = 0; i < 10000; i++)
+	{
+		// lasers, hooks, short steps, straight lines and lines anywhere
+		vec2 Pos0 = RandomPos();
+		vec2 Dir = normalize(vec2(RandomFloat(-1, 1), RandomFloat(-1, 1)));
+		vec2 Pos1;
+		switch(Random() % 6)
+		{
+		case 0: Pos1 = Pos0 + Dir * 800.0f; break;
+		case 1: Pos1 = Pos0 + Dir * 380.0f; break;
+		case 2: Pos1 = Pos0 + Dir * RandomFloat(0, 40); break;
+		case 3: Pos1 = Pos0 + (Random() % 2 ? vec2(RandomFloat(-700, 700), 0) : vec2(0, RandomFloat(-700, 700))); break;
+		case 4: Pos1 = Pos0 + vec2(Random() % 2 ? 1 : -1, Random() % 2 ? 1 : -1) * RandomFloat(0, 500); break;
+		default: Pos1 = Random() % 8 ? RandomPos() : Pos0;
+		}
+
+		for(int Old = 0; Old < 2; Old++)
+		{
+			g_Config.m_SvOldTeleportHook = Old;
+			g_Config.m_SvOldTeleportWeapons = Old;
+			for(int Type = 0; Type < 6; Type++)
+			{
+				vec2 aCol[2], aBefore[2];
+				int aHit[2], aTeleNr[2] = {0, 0};
+				switch(Type)
+				{
+				case 0:
+					aHit[0] = SteppedIntersectLine(&m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0]);
+					aHit[1] = m_Collision.IntersectLine(Pos0, Pos1, &aCol[1], &aBefore[1]);
+					break;
+				case 1:
+					aHit[0] = SteppedIntersectLineTeleHook(&m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0], &aTeleNr[0]);
+					aHit[1] = m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aCol[1], &aBefore[1], &aTeleNr[1]);
+					break;
+				case 2:
+					aHit[0] = SteppedIntersectLineTeleWeapon(&m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0], &aTeleNr[0]);
+					aHit[1] = m_Collision.IntersectLineTeleWeapon(Pos0, Pos1, &aCol[1], &aBefore[1], &aTeleNr[1]);
+					break;
+				case 3:
+					aHit[0] = SteppedIntersectNoLaser(&m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0]);
+					aHit[1] = m_Collision.IntersectNoLaser(Pos0, Pos1, &aCol[1], &aBefore[1]);
+					break;
+				case 4:
+					aHit[0] = SteppedIntersectNoLaserNW(&m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0]);
+					aHit[1] = m_Collision.IntersectNoLaserNW(Pos0, Pos1, &aCol[1], &aBefore[1]);
+					break;
+				default:
+					aHit[0] = SteppedIntersectAir(&m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0]);
+					aHit[1] = m_Collision.IntersectAir(Pos0, Pos1, &aCol[1], &aBefore[1]);
+				}
+				NumHits += aHit[0] != 0;
+				ASSERT_TRUE(aHit[0] == aHit[1] && aCol[0] == aCol[1] && aBefore[0] == aBefore[1] && aTeleNr[0] == aTeleNr[1])
+					<< "type " << Type << " from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y
+					<< ": hit " << aHit[0] << " at " << aCol[0].x << "," << aCol[0].y << " before " << aBefore[0].x << "," << aBefore[0].y
+					<< " instead of " << aHit[1] << " at " << aCol[1].x << "," << aCol[1].y << " before " << aBefore[1].x << "," << aBefore[1].y;
+			}
+		}
+	}
+	g_Config.m_SvOldTeleportHook = 0;
+	g_Config.m_SvOldTeleportWeapons = 0;
+	EXPECT_GT(NumHits, 0);
+}
+
+TEST_P(CollisionMap, SpecialTilesFollowChanges)
+{
+	// an air tile without anything special around it
+	int Width = m_Collision.GetWidth();
+	int Index = -1;
+	for(int i = Width + 1; i < Width * (m_Collision.GetHeight() - 1) && Index < 0; i++)
+	{
+		if(m_Collision.GetTileIndex(i) == TILE_AIR && !m_Collision.SpecialTiles(i) &&
+			!m_Collision.SpecialTiles(i - 1) && !m_Collision.SpecialTiles(i + 1) &&
+			!m_Collision.SpecialTiles(i - Width) && !m_Collision.SpecialTiles(i + Width))
+			Index = i;
+	}
+	ASSERT_GE(Index, 0);
+	vec2 Pos = m_Collision.GetPos(Index);
+
+	m_Collision.SetCollisionAt(Pos.x, Pos.y, TILE_STOPA);
+	EXPECT_EQ(m_Collision.SpecialTiles(Index - 1), (int)CCollision::SPECIAL_STOPPER);
+	EXPECT_EQ(m_Collision.SpecialTiles(Index + Width), (int)CCollision::SPECIAL_STOPPER);
+	m_Collision.SetCollisionAt(Pos.x, Pos.y, TILE_FREEZE);
+	EXPECT_EQ(m_Collision.SpecialTiles(Index), (int)CCollision::SPECIAL_GAME);
+	EXPECT_FALSE(m_Collision.TileExists(Index - 1));
+	m_Collision.SetCollisionAt(Pos.x, Pos.y, TILE_AIR);
+	EXPECT_FALSE(m_Collision.TileExists(Index));
+
+	m_Collision.SetDCollisionAt(Pos.x, Pos.y, TILE_STOPA, 0, 0);
+	if(m_Collision.GetDTileIndex(Index))
+	{
+		EXPECT_EQ(m_Collision.SpecialTiles(Index), (int)CCollision::SPECIAL_DOOR);
+		EXPECT_TRUE(m_Collision.TileExists(Index + 1));
+		m_Collision.SetDCollisionAt(Pos.x, Pos.y, 0, 0, 0);
+		EXPECT_FALSE(m_Collision.TileExists(Index));
+		EXPECT_FALSE(m_Collision.TileExists(Index + 1));
+	}
+}
+
+INSTANTIATE_TEST_CASE_P(Maps, CollisionMap, ::testing::Values("Kobra 4", "Goo!"));
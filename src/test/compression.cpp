@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+
+static unsigned s_Seed = 7;
+static unsigned Random()
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return s_Seed;
+}
+
+static int RandomInt()
+{
+	// mostly small values like in snapshot deltas
+	unsigned Value = (Random() >> 8) ^ (Random() << 16);
+	switch(Random() % 4)
+	{
+	case 0: return Value & 0x3f;
+	case 1: return -(int)(Value & 0x1fff);
+	case 2: return Value & 0xfffff;
+	default: return Value;
+	}
+}
+
+static long ReferenceCompress(const int *pSrc, int Num, unsigned char *pDst, int DstSize)
+{
+	unsigned char *pCur = pDst;
+	for(int i = 0; i < Num; i++)
+	{
+		if(pDst + DstSize - pCur < 6)
+			return -1;
+		pCur = CVariableInt::Pack(pCur, pSrc[i]);
+	}
+	return pCur - pDst;
+}
+
+static long ReferenceDecompress(const unsigned char *pSrc, int Size, int *pDst, int DstSize)
+{
+	const unsigned char *pEnd = pSrc + Size;
+	int *pCur = pDst;
+	while(pSrc < pEnd)
+	{
+		if(pCur >= pDst + DstSize/4)
+			return -1;
+		pSrc = CVariableInt::Unpack(pSrc, pCur);
+		pCur++;
+	}
+	return (pCur - pDst) * 4;
+}
+
+TEST(VariableInt, EdgeValues)
+{
+	const int aValues[] = {0, 1, -1, 63, 64, -64, -65, 8191, 8192, -8192, -8193, (1<<20)-1, 1<<20, (1<<27)-1, 1<<27, -(1<<27)-1, 0x7fffffff, (int)0x80000000};
+	const int Num = sizeof(aValues)/sizeof(aValues[0]);
+	unsigned char aExpected[Num*5+16], aOut[Num*5+16];
+	int aDecoded[Num];
+
+	long ExpectedSize = ReferenceCompress(aValues, Num, aExpected, sizeof(aExpected));
+	long Size = CVariableInt::Compress(aValues, sizeof(aValues), aOut, sizeof(aOut));
+	ASSERT_EQ(Size, ExpectedSize);
+	EXPECT_EQ(mem_comp(aOut, aExpected, Size), 0);
+
+	EXPECT_EQ(CVariableInt::Decompress(aOut, Size, aDecoded, sizeof(aDecoded)), (long)sizeof(aValues));
+	EXPECT_EQ(mem_comp(aDecoded, aValues, sizeof(aValues)), 0);
+}
+
+TEST(VariableInt, MatchesPackUnpack)
+{
+	static int s_aValues[4096];
+	static int s_aDecoded[4096];
+	static int s_aExpectedDecoded[4096];
+	static unsigned char s_aExpected[4096*5+16];
+	static unsigned char s_aOut[4096*5+16];
+
+	for(int Round = 0; Round < 200; Round++)
+	{
+		int Num = Random() % 4096;
+		for(int i = 0; i < Num; i++)
+		{
+			// runs of single byte values take a separate path
+			if(Round%2 && Random()%16)
+				s_aValues[i] = (int)((Random()>>8)%128) - 64;
+			else
+				s_aValues[i] = RandomInt();
+		}
+
+		// also with too small buffers
+		int DstSize = Round%5 == 0 ? Random() % (Num*5+16) : sizeof(s_aOut);
+		long ExpectedSize = ReferenceCompress(s_aValues, Num, s_aExpected, DstSize);
+		long Size = CVariableInt::Compress(s_aValues, Num*4, s_aOut, DstSize);
+		ASSERT_EQ(Size, ExpectedSize);
+		if(Size < 0)
+			continue;
+		ASSERT_EQ(mem_comp(s_aOut, s_aExpected, Size), 0);
+
+		int DecodeSize = Round%7 == 0 ? Random() % (Num*4+4) : sizeof(s_aDecoded);
+		long ExpectedDecoded = ReferenceDecompress(s_aOut, Size, s_aExpectedDecoded, DecodeSize);
+		long Decoded = CVariableInt::Decompress(s_aOut, Size, s_aDecoded, DecodeSize);
+		ASSERT_EQ(Decoded, ExpectedDecoded);
+		if(Decoded >= 0)
+		{
+			ASSERT_EQ(Decoded, Num*4);
+			ASSERT_EQ(mem_comp(s_aDecoded, s_aValues, Decoded), 0);
+		}
+	}
+}
+
+TEST(VariableInt, GarbageInput)
+{
+	// arbitrary bytes, including extend bits on the fifth byte, must
+	// decode exactly like before
+	static unsigned char s_aData[2048+8];
+	static int s_aExpected[2048];
+	static int s_aDecoded[2048];
+
+	for(int Round = 0; Round < 200; Round++)
+	{
+		int Size = Random() % 2048;
+		for(int i = 0; i < Size; i++)
+			s_aData[i] = Random() >> 13;
+		for(int i = Size; i < Size+8; i++)
+			s_aData[i] = 0;
+
+		long Expected = ReferenceDecompress(s_aData, Size, s_aExpected, sizeof(s_aExpected));
+		long Decoded = CVariableInt::Decompress(s_aData, Size, s_aDecoded, sizeof(s_aDecoded));
+		ASSERT_EQ(Decoded, Expected);
+		if(Decoded > 0)
+		{
+			ASSERT_EQ(mem_comp(s_aDecoded, s_aExpected, Decoded), 0);
+		}
+	}
+}
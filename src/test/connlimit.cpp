@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/network.h>
+
+static NETADDR Addr(const char *pStr)
+{
+	NETADDR Addr;
+	EXPECT_EQ(net_addr_from_str(&Addr, pStr), 0);
+	return Addr;
+}
+
+class ConnLimit : public ::testing::Test
+{
+protected:
+	CNetConnLimiter *m_pLimiter;
+
+	ConnLimit()
+	{
+		EXPECT_EQ(secure_random_init(), 0);
+		m_pLimiter = new CNetConnLimiter;
+		m_pLimiter->Reset();
+	}
+	~ConnLimit()
+	{
+		delete m_pLimiter;
+	}
+};
+
+TEST_F(ConnLimit, BurstAndRefill)
+{
+	NETADDR Client = Addr("1.2.3.4:8303");
+	int64 Now = 1000 * time_freq();
+	for(int i = 0; i < 4; i++)
+		EXPECT_TRUE(m_pLimiter->Allow(&Client, Now, 4, 0, 20));
+	EXPECT_FALSE(m_pLimiter->Allow(&Client, Now, 4, 0, 20));
+	// one attempt refills every 5 seconds, independent of the port
+	Client.port = 8304;
+	EXPECT_FALSE(m_pLimiter->Allow(&Client, Now + 4 * time_freq(), 4, 0, 20));
+	EXPECT_TRUE(m_pLimiter->Allow(&Client, Now + 5 * time_freq(), 4, 0, 20));
+	EXPECT_FALSE(m_pLimiter->Allow(&Client, Now + 5 * time_freq(), 4, 0, 20));
+	for(int i = 0; i < 4; i++)
+		EXPECT_TRUE(m_pLimiter->Allow(&Client, Now + 30 * time_freq(), 4, 0, 20));
+
+	NETADDR Other = Addr("1.2.3.5");
+	EXPECT_TRUE(m_pLimiter->Allow(&Other, Now, 4, 0, 20));
+	EXPECT_EQ(m_pLimiter->NumDropped(), 3);
+	EXPECT_EQ(m_pLimiter->NumDroppedNetwork(), 0);
+}
+
+TEST_F(ConnLimit, Networks)
+{
+	int64 Now = 1000 * time_freq();
+	const char *apSame[] = {"10.0.0.1", "10.0.0.2", "10.0.0.200", "[2001:db8:1::1]", "[2001:db8:1:ffff::2]", "[2001:db8:1::3]"};
+	const char *apOther[] = {"10.0.1.1", "[2001:db8:2::1]"};
+	for(unsigned i = 0; i < sizeof(apSame)/sizeof(apSame[0]); i++)
+	{
+		NETADDR Client = Addr(apSame[i]);
+		EXPECT_EQ(m_pLimiter->Allow(&Client, Now, 4, 2, 20), i%3 < 2) << apSame[i];
+	}
+	for(unsigned i = 0; i < sizeof(apOther)/sizeof(apOther[0]); i++)
+	{
+		NETADDR Client = Addr(apOther[i]);
+		EXPECT_TRUE(m_pLimiter->Allow(&Client, Now, 4, 2, 20)) << apOther[i];
+	}
+	EXPECT_EQ(m_pLimiter->NumDroppedNetwork(), 2);
+
+	// an attempt dropped by the network limit isn't charged to the address
+	NETADDR Client = Addr("10.0.0.1");
+	EXPECT_FALSE(m_pLimiter->Allow(&Client, Now, 2, 2, 20));
+	EXPECT_TRUE(m_pLimiter->Allow(&Client, Now + 10 * time_freq(), 2, 2, 20));
+}
+
+TEST_F(ConnLimit, Disabled)
+{
+	NETADDR Client = Addr("1.2.3.4");
+	int64 Now = 1000 * time_freq();
+	for(int i = 0; i < 100; i++)
+	{
+		EXPECT_TRUE(m_pLimiter->Allow(&Client, Now, 0, 0, 20));
+		EXPECT_TRUE(m_pLimiter->Allow(&Client, Now, 4, 4, 0));
+	}
+	EXPECT_EQ(m_pLimiter->NumAllowed(), 200);
+}
+
+TEST_F(ConnLimit, SpoofedFlood)
+{
+	// a flood of single attempts from random addresses fills the table,
+	// but must not make the limiter forget a client that is limited
+	NETADDR Attacker = Addr("1.2.3.4");
+	int64 Now = 1000 * time_freq();
+	for(int i = 0; i < 10; i++)
+		m_pLimiter->Allow(&Attacker, Now, 4, 0, 20);
+
+	unsigned Seed = 1;
+	for(int i = 0; i < 4 * CNetConnLimiter::TABLE_SIZE; i++)
+	{
+		NETADDR Spoofed;
+		mem_zero(&Spoofed, sizeof(Spoofed));
+		Spoofed.type = NETTYPE_IPV4;
+		Seed ^= Seed << 13;
+		Seed ^= Seed >> 17;
+		Seed ^= Seed << 5;
+		mem_copy(Spoofed.ip, &Seed, sizeof(Seed));
+		EXPECT_TRUE(m_pLimiter->Allow(&Spoofed, Now, 4, 0, 20));
+		if(i % 64 == 0)
+		{
+			ASSERT_FALSE(m_pLimiter->Allow(&Attacker, Now, 4, 0, 20));
+		}
+	}
+	EXPECT_GT(m_pLimiter->NumEvicted(), 0);
+}
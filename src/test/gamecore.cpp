@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <game/gamecore.h>
+
+#include <set>
+
+// the exact checks of CCharacterCore, the characters they accept must
+// never be filtered out by FindCharacters
+static bool HookHits(vec2 HookPos, vec2 NewPos, vec2 Pos)
+{
+	return distance(Pos, closest_point_on_line(HookPos, NewPos, Pos)) < 28.0f+2.0f;
+}
+
+static bool Collides(vec2 Pos, vec2 Other)
+{
+	return distance(Pos, Other) < 28.0f*1.25f;
+}
+
+static bool MoveBlocked(vec2 Pos0, vec2 Pos1, vec2 Other)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End = Distance+1;
+	for(int i = 0; i < End; i++)
+	{
+		float D = distance(mix(Pos0, Pos1, i/Distance), Other);
+		if(D < 28.0f || (D <= 0.001f && D >= -0.001f))
+			return true;
+	}
+	return false;
+}
+
+class WorldCore : public ::testing::Test
+{
+protected:
+	CWorldCore m_World;
+	CCharacterCore m_aCores[MAX_CLIENTS];
+	unsigned m_Seed;
+
+	WorldCore() : m_Seed(12345) {}
+
+	// deterministic, so a failure can be reproduced
+	float Random(float Min, float Max)
+	{
+		m_Seed = m_Seed * 1103515245 + 12345;
+		return Min + (Max - Min) * ((m_Seed >> 8) & 0xffff) / 65535.0f;
+	}
+
+	vec2 RandomPos()
+	{
+		return vec2(Random(0.0f, 400.0f), Random(0.0f, 400.0f));
+	}
+
+	void Scatter()
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aCores[i].m_Pos = RandomPos();
+			m_World.m_apCharacters[i] = Random(0.0f, 1.0f) < 0.8f ? &m_aCores[i] : 0;
+		}
+	}
+
+	std::set<int> Find(vec2 Pos0, vec2 Pos1, float Margin, int IncludeID = -1)
+	{
+		int aIDs[MAX_CLIENTS];
+		int Num = m_World.FindCharacters(Pos0, Pos1, Margin, aIDs, IncludeID);
+		EXPECT_GE(Num, 0);
+		EXPECT_LE(Num, MAX_CLIENTS);
+		std::set<int> IDs;
+		for(int i = 0; i < Num; i++)
+		{
+			EXPECT_TRUE(m_World.m_apCharacters[aIDs[i]]);
+			if(i > 0)
+			{
+				EXPECT_LT(aIDs[i-1], aIDs[i]);
+			}
+			IDs.insert(aIDs[i]);
+		}
+		return IDs;
+	}
+};
+
+TEST_F(WorldCore, FindCharactersEmpty)
+{
+	int aIDs[MAX_CLIENTS];
+	EXPECT_EQ(m_World.FindCharacters(vec2(0, 0), vec2(100, 100), 28.0f, aIDs), 0);
+	EXPECT_EQ(m_World.FindCharacters(vec2(0, 0), vec2(0, 0), 28.0f, aIDs, 5), 0);
+}
+
+TEST_F(WorldCore, FindCharactersHook)
+{
+	for(int Round = 0; Round < 200; Round++)
+	{
+		Scatter();
+		vec2 HookPos = RandomPos();
+		vec2 NewPos = HookPos + vec2(Random(-80.0f, 80.0f), Random(-80.0f, 80.0f));
+		std::set<int> Found = Find(HookPos, NewPos, 28.0f+2.0f);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(m_World.m_apCharacters[i] && HookHits(HookPos, NewPos, m_aCores[i].m_Pos))
+			{
+				EXPECT_EQ(Found.count(i), 1u) << "round " << Round << " id " << i;
+			}
+	}
+}
+
+TEST_F(WorldCore, FindCharactersCollision)
+{
+	for(int Round = 0; Round < 200; Round++)
+	{
+		Scatter();
+		int Self = Round % MAX_CLIENTS;
+		int Hooked = (Round * 7) % MAX_CLIENTS;
+		vec2 Pos = RandomPos();
+		std::set<int> Found = Find(Pos, Pos, 28.0f*1.25f, Hooked);
+		if(m_World.m_apCharacters[Hooked])
+		{
+			EXPECT_EQ(Found.count(Hooked), 1u) << "round " << Round;
+		}
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(i != Self && m_World.m_apCharacters[i] && Collides(Pos, m_aCores[i].m_Pos))
+			{
+				EXPECT_EQ(Found.count(i), 1u) << "round " << Round << " id " << i;
+			}
+	}
+}
+
+TEST_F(WorldCore, FindCharactersMove)
+{
+	for(int Round = 0; Round < 200; Round++)
+	{
+		Scatter();
+		vec2 Pos0 = RandomPos();
+		vec2 Pos1 = Pos0 + vec2(Random(-40.0f, 40.0f), Random(-40.0f, 40.0f));
+		std::set<int> Found = Find(Pos0, Pos1, 28.0f);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(m_World.m_apCharacters[i] && MoveBlocked(Pos0, Pos1, m_aCores[i].m_Pos))
+			{
+				EXPECT_EQ(Found.count(i), 1u) << "round " << Round << " id " << i;
+			}
+	}
+}
+
+TEST_F(WorldCore, FindCharactersOnBoxEdge)
+{
+	// exactly at the distance of the exact check, on the axes and diagonals
+	vec2 Pos(200.0f, 200.0f);
+	float Margin = 28.0f*1.25f;
+	for(int i = 0; i < 8; i++)
+	{
+		float Angle = i * pi / 4;
+		m_aCores[i].m_Pos = Pos + vec2(cosf(Angle), sinf(Angle)) * (Margin - 0.0001f);
+		m_World.m_apCharacters[i] = &m_aCores[i];
+	}
+	std::set<int> Found = Find(Pos, Pos, Margin);
+	for(int i = 0; i < 8; i++)
+		EXPECT_EQ(Found.count(i), 1u) << i;
+}
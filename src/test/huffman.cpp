@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/huffman.h>
+
+static unsigned s_Seed = 11;
+static unsigned Random()
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return s_Seed >> 8;
+}
+
+static void RandomFrequencies(unsigned *pFrequencies, bool Skewed)
+{
+	for(int i = 0; i < 256; i++)
+		pFrequencies[i] = 1 + Random() % (Skewed ? 500 : 50000);
+	// like the network table, where zero is by far the most common byte
+	if(Skewed)
+		pFrequencies[0] = 1<<30;
+}
+
+static int RandomData(unsigned char *pData, int MaxSize)
+{
+	int Size = Random() % MaxSize;
+	int Kind = Random() % 3;
+	for(int i = 0; i < Size; i++)
+	{
+		if(Kind == 0)
+			pData[i] = Random();
+		else if(Kind == 1)
+			pData[i] = Random() % 4 ? 0 : Random();
+		else
+			pData[i] = Random() % 16;
+	}
+	return Size;
+}
+
+static CHuffman s_Huffman;
+
+TEST(Huffman, MatchesLegacy)
+{
+	static unsigned char s_aData[4096];
+	static unsigned char s_aExpected[8192];
+	static unsigned char s_aOut[8192];
+	static unsigned char s_aDecoded[4096];
+	static unsigned char s_aExpectedDecoded[4096];
+	unsigned aFrequencies[256];
+
+	for(int Table = 0; Table < 8; Table++)
+	{
+		RandomFrequencies(aFrequencies, Table%2);
+		s_Huffman.Init(aFrequencies);
+
+		for(int Round = 0; Round < 200; Round++)
+		{
+			int Size = RandomData(s_aData, sizeof(s_aData));
+
+			// also with too small buffers
+			int DstSize = Round%4 == 0 ? 1 + Random() % (Size+8) : sizeof(s_aOut);
+			int Expected = s_Huffman.CompressLegacy(s_aData, Size, s_aExpected, DstSize);
+			int Compressed = s_Huffman.Compress(s_aData, Size, s_aOut, DstSize);
+			ASSERT_EQ(Compressed, Expected);
+			if(Compressed < 0)
+				continue;
+			ASSERT_EQ(mem_comp(s_aOut, s_aExpected, Compressed), 0);
+
+			int DecodeSize = Round%3 == 0 ? Random() % (Size+8) : sizeof(s_aDecoded);
+			int ExpectedDecoded = s_Huffman.DecompressLegacy(s_aOut, Compressed, s_aExpectedDecoded, DecodeSize);
+			int Decoded = s_Huffman.Decompress(s_aOut, Compressed, s_aDecoded, DecodeSize);
+			ASSERT_EQ(Decoded, ExpectedDecoded);
+			if(Decoded >= 0)
+			{
+				ASSERT_EQ(Decoded, Size);
+				ASSERT_EQ(mem_comp(s_aDecoded, s_aData, Size), 0);
+			}
+		}
+	}
+}
+
+TEST(Huffman, GarbageInput)
+{
+	// truncated and arbitrary input must fail or decode exactly like before
+	static unsigned char s_aData[2048];
+	static unsigned char s_aCompressed[4096];
+	static unsigned char s_aExpected[4096];
+	static unsigned char s_aDecoded[4096];
+	unsigned aFrequencies[256];
+
+	for(int Table = 0; Table < 4; Table++)
+	{
+		RandomFrequencies(aFrequencies, Table%2);
+		s_Huffman.Init(aFrequencies);
+
+		for(int Round = 0; Round < 300; Round++)
+		{
+			int Size;
+			if(Round%2)
+			{
+				Size = RandomData(s_aData, sizeof(s_aData));
+				Size = s_Huffman.Compress(s_aData, Size, s_aCompressed, sizeof(s_aCompressed));
+				ASSERT_GT(Size, 0);
+				Size = Random() % (Size+1);
+				if(Size && Random()%2)
+					s_aCompressed[Random()%Size] ^= 1<<(Random()%8);
+			}
+			else
+			{
+				Size = Random() % 512;
+				for(int i = 0; i < Size; i++)
+					s_aCompressed[i] = Random();
+			}
+
+			int DecodeSize = Random()%2 ? Random() % 4096 : sizeof(s_aDecoded);
+			int Expected = s_Huffman.DecompressLegacy(s_aCompressed, Size, s_aExpected, DecodeSize);
+			int Decoded = s_Huffman.Decompress(s_aCompressed, Size, s_aDecoded, DecodeSize);
+			ASSERT_EQ(Decoded, Expected);
+			if(Decoded > 0)
+			{
+				ASSERT_EQ(mem_comp(s_aDecoded, s_aExpected, Decoded), 0);
+			}
+		}
+	}
+}
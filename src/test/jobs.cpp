@@ -105,3 +105,28 @@ TEST_F(Jobs, Many)
 	}
 	new(&m_Pool) CJobPool();
 }
+
+static void AddIndex(int Index, void *pUser)
+{
+	std::atomic<int> *pSums = (std::atomic<int> *)pUser;
+	pSums[Index] += Index + 1;
+}
+
+TEST(WorkerGroup, Run)
+{
+	static const int NUM_ITEMS = 1000;
+	std::atomic<int> aSums[NUM_ITEMS];
+	for(int i = 0; i < NUM_ITEMS; i++)
+		aSums[i] = 0;
+
+	CWorkerGroup Group;
+	Group.Init(TEST_NUM_THREADS);
+	for(int Round = 0; Round < 10; Round++)
+		Group.Run(AddIndex, aSums, NUM_ITEMS);
+	Group.Shutdown();
+	// works without threads as well
+	Group.Run(AddIndex, aSums, NUM_ITEMS);
+
+	for(int i = 0; i < NUM_ITEMS; i++)
+		EXPECT_EQ(aSums[i], 11 * (i + 1));
+}
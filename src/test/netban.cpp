@@ -0,0 +1,191 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/netban.h>
+
+#include <vector>
+
+static unsigned s_Seed = 5;
+static unsigned Random()
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return s_Seed >> 8;
+}
+
+static NETADDR RandomAddr(bool IPv6)
+{
+	// a small address space so that bans overlap a lot
+	NETADDR Addr;
+	mem_zero(&Addr, sizeof(Addr));
+	Addr.type = IPv6 ? NETTYPE_IPV6 : NETTYPE_IPV4;
+	int Length = IPv6 ? 16 : 4;
+	Addr.ip[0] = 10;
+	Addr.ip[Length-3] = Random() % 2 ? 0 : Random();
+	Addr.ip[Length-2] = Random() % 4;
+	Addr.ip[Length-1] = Random();
+	return Addr;
+}
+
+class CNetBanTest : public CNetBan
+{
+public:
+	std::vector<NETADDR> m_aAddrs;
+	std::vector<CNetRange> m_aRanges;
+
+	bool Expected(const NETADDR *pAddr) const
+	{
+		for(unsigned i = 0; i < m_aAddrs.size(); i++)
+			if(NetComp(&m_aAddrs[i], pAddr) == 0)
+				return true;
+		for(unsigned i = 0; i < m_aRanges.size(); i++)
+			if(NetMatch(&m_aRanges[i], pAddr))
+				return true;
+		return false;
+	}
+};
+
+static void CheckBans(const CNetBanTest *pBan)
+{
+	for(int i = 0; i < 200; i++)
+	{
+		NETADDR Addr = RandomAddr(Random() % 2);
+		char aBuf[256];
+		bool Expected = pBan->Expected(&Addr);
+		ASSERT_EQ(pBan->IsBanned(&Addr, aBuf, sizeof(aBuf)), Expected);
+		ASSERT_EQ(pBan->IsBannedLegacy(&Addr, aBuf, sizeof(aBuf)), Expected);
+	}
+}
+
+TEST(NetBan, MatchesBruteForce)
+{
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CNetBanTest *pBan = new CNetBanTest;
+	pBan->Init(pConsole, 0);
+
+	for(int Round = 0; Round < 300; Round++)
+	{
+		bool IPv6 = Random() % 2;
+		int Op = Random() % 5;
+		if(Op == 0 && pBan->m_aAddrs.size())
+		{
+			int Index = Random() % pBan->m_aAddrs.size();
+			EXPECT_EQ(pBan->UnbanByAddr(&pBan->m_aAddrs[Index]), 0);
+			pBan->m_aAddrs.erase(pBan->m_aAddrs.begin() + Index);
+		}
+		else if(Op == 1 && pBan->m_aRanges.size())
+		{
+			int Index = Random() % pBan->m_aRanges.size();
+			EXPECT_EQ(pBan->UnbanByRange(&pBan->m_aRanges[Index]), 0);
+			pBan->m_aRanges.erase(pBan->m_aRanges.begin() + Index);
+		}
+		else if(Op == 2)
+		{
+			NETADDR Addr = RandomAddr(IPv6);
+			int Result = pBan->BanAddr(&Addr, 0, "test");
+			ASSERT_GE(Result, 0);
+			if(Result == 0)
+				pBan->m_aAddrs.push_back(Addr);
+		}
+		else
+		{
+			CNetRange Range;
+			Range.m_LB = RandomAddr(IPv6);
+			Range.m_UB = RandomAddr(IPv6);
+			if(NetComp(&Range.m_LB, &Range.m_UB) > 0)
+			{
+				NETADDR Tmp = Range.m_LB;
+				Range.m_LB = Range.m_UB;
+				Range.m_UB = Tmp;
+			}
+			if(!Range.IsValid())
+				continue;
+			int Result = pBan->BanRange(&Range, 0, "test");
+			ASSERT_GE(Result, 0);
+			if(Result == 0)
+				pBan->m_aRanges.push_back(Range);
+		}
+
+		CheckBans(pBan);
+	}
+
+	// wide ipv6 ranges split into many prefixes, removing most of them
+	// leaves enough empty nodes behind for Update to rebuild the index
+	for(int i = 0; i < 50; i++)
+	{
+		CNetRange Range;
+		Range.m_LB = RandomAddr(true);
+		Range.m_UB = Range.m_LB;
+		for(int j = 1; j < 16; j++)
+		{
+			Range.m_LB.ip[j] = Random();
+			Range.m_UB.ip[j] = Random();
+		}
+		if(!Range.IsValid() || pBan->BanRange(&Range, 0, "test") != 0)
+			continue;
+		pBan->m_aRanges.push_back(Range);
+	}
+	while(pBan->m_aRanges.size() > 5)
+	{
+		EXPECT_EQ(pBan->UnbanByRange(&pBan->m_aRanges.back()), 0);
+		pBan->m_aRanges.pop_back();
+	}
+	pBan->Update();
+	CheckBans(pBan);
+
+	delete pBan;
+	delete pConsole;
+}
+
+TEST(NetBan, ImportFile)
+{
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	const char aList[] =
+		"# comment\n"
+		"1.2.3.4\n"
+		"  5.6.7.0/24  # trailing comment\n"
+		"9.9.9.1 - 9.9.9.5\r\n"
+		"2001:db8::/32\n"
+		"[2001:db9::1]\n"
+		"\n"
+		"garbage\n"
+		"10.0.0.0/33\n"
+		"9.9.9.5-9.9.9.1\n";
+	io_write(File, aList, str_length(aList));
+	io_close(File);
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CNetBan *pBan = new CNetBan;
+	pBan->Init(pConsole, 0);
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	int NumInvalid;
+	EXPECT_EQ(pBan->ImportBans(File, 0, "list", &NumInvalid), 5);
+	EXPECT_EQ(NumInvalid, 3);
+	io_close(File);
+
+	const char *apBanned[] = {"1.2.3.4", "5.6.7.0", "5.6.7.255", "9.9.9.1", "9.9.9.3", "9.9.9.5", "[2001:db8::]", "[2001:db8:ffff:ffff:ffff:ffff:ffff:ffff]", "[2001:db9::1]"};
+	const char *apFree[] = {"1.2.3.5", "5.6.6.255", "5.6.8.0", "9.9.9.0", "9.9.9.6", "[2001:db7:ffff::]", "[2001:db9::]", "[2001:db9::2]"};
+	char aBuf[256];
+	for(unsigned i = 0; i < sizeof(apBanned)/sizeof(apBanned[0]); i++)
+	{
+		NETADDR Addr;
+		ASSERT_EQ(net_addr_from_str(&Addr, apBanned[i]), 0);
+		EXPECT_TRUE(pBan->IsBanned(&Addr, aBuf, sizeof(aBuf))) << apBanned[i];
+	}
+	for(unsigned i = 0; i < sizeof(apFree)/sizeof(apFree[0]); i++)
+	{
+		NETADDR Addr;
+		ASSERT_EQ(net_addr_from_str(&Addr, apFree[i]), 0);
+		EXPECT_FALSE(pBan->IsBanned(&Addr, aBuf, sizeof(aBuf))) << apFree[i];
+	}
+
+	delete pBan;
+	delete pConsole;
+	fs_remove(Info.m_aFilename);
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/network.h>
+
+#include <vector>
+
+struct CSentChunk
+{
+	int m_Packet;
+	int m_Flags;
+	int m_Sequence;
+	std::vector<unsigned char> m_vData;
+};
+
+class NetConnection : public ::testing::Test
+{
+protected:
+	CNetConnection m_Conn;
+	std::vector<CSentChunk> m_vSent;
+	int m_NumPackets;
+
+	static void Capture(const NETADDR *pAddr, const void *pData, int DataSize, void *pUser)
+	{
+		NetConnection *pThis = (NetConnection *)pUser;
+		CNetPacketConstruct Packet;
+		ASSERT_EQ(CNetBase::UnpackPacket((unsigned char *)pData, DataSize, &Packet), 0);
+		EXPECT_LE(Packet.m_DataSize, NET_MAX_PAYLOAD);
+
+		unsigned char *pChunkData = Packet.m_aChunkData;
+		unsigned char *pEnd = Packet.m_aChunkData + Packet.m_DataSize;
+		for(int i = 0; i < Packet.m_NumChunks; i++)
+		{
+			CNetChunkHeader Header;
+			pChunkData = Header.Unpack(pChunkData);
+			ASSERT_LE(pChunkData + Header.m_Size, pEnd);
+			CSentChunk Chunk;
+			Chunk.m_Packet = pThis->m_NumPackets;
+			Chunk.m_Flags = Header.m_Flags;
+			Chunk.m_Sequence = Header.m_Sequence;
+			Chunk.m_vData.assign(pChunkData, pChunkData + Header.m_Size);
+			pThis->m_vSent.push_back(Chunk);
+			pChunkData += Header.m_Size;
+		}
+		EXPECT_EQ(pChunkData, pEnd);
+		pThis->m_NumPackets++;
+	}
+
+	NetConnection() : m_NumPackets(0) {}
+
+	virtual void SetUp()
+	{
+		CNetBase::Init();
+		CNetBase::SetSendRaw(Capture, this);
+
+		NETSOCKET Socket;
+		mem_zero(&Socket, sizeof(Socket));
+		NETADDR Addr;
+		mem_zero(&Addr, sizeof(Addr));
+		net_addr_from_str(&Addr, "127.0.0.1:8303");
+		m_Conn.Init(Socket, false);
+		m_Conn.DirectInit(Addr, NET_SECURITY_TOKEN_UNSUPPORTED);
+		m_Conn.SetCoalesce(true);
+	}
+
+	virtual void TearDown()
+	{
+		CNetBase::SetSendRaw(0, 0);
+	}
+
+	// the payload tells which chunk it is
+	static std::vector<unsigned char> Payload(int ID, int Size)
+	{
+		std::vector<unsigned char> vData(Size);
+		for(int i = 0; i < Size; i++)
+			vData[i] = (unsigned char)(ID * 31 + i);
+		vData[0] = ID;
+		return vData;
+	}
+};
+
+TEST_F(NetConnection, FlushPendingSmall)
+{
+	std::vector<unsigned char> vData = Payload(1, 10);
+	EXPECT_EQ(m_Conn.QueueChunk(NET_CHUNKFLAG_VITAL, vData.size(), vData.data()), 0);
+	EXPECT_EQ(m_Conn.QueueChunk(0, vData.size(), vData.data()), 0);
+	EXPECT_EQ(m_Conn.QueuePriorityChunk(vData.size(), vData.data()), 0);
+	EXPECT_EQ(m_NumPackets, 0);
+
+	EXPECT_EQ(m_Conn.Flush(), 3);
+	EXPECT_EQ(m_NumPackets, 1);
+	ASSERT_EQ(m_vSent.size(), 3u);
+	// the priority chunk goes first
+	EXPECT_EQ(m_vSent[0].m_Flags, 0);
+	EXPECT_EQ(m_vSent[1].m_Flags, NET_CHUNKFLAG_VITAL);
+	EXPECT_EQ(m_vSent[2].m_Flags, 0);
+	EXPECT_EQ(m_Conn.Flush(), 0);
+	EXPECT_EQ(m_NumPackets, 1);
+}
+
+TEST_F(NetConnection, FlushPendingMixed)
+{
+	struct CQueued
+	{
+		int m_Flags;
+		bool m_Priority;
+		std::vector<unsigned char> m_vData;
+	};
+	std::vector<CQueued> vQueued;
+
+	// messages with snapshot parts in between, more than fits into the
+	// pending buffer, so it is flushed once on the way
+	for(int i = 0; i < 60; i++)
+	{
+		CQueued Queued;
+		Queued.m_Priority = i % 7 == 3;
+		Queued.m_Flags = !Queued.m_Priority && i % 3 != 0 ? NET_CHUNKFLAG_VITAL : 0;
+		int Size = Queued.m_Priority ? 900 : 20 + (i * 37) % 200;
+		Queued.m_vData = Payload(i, Size);
+		int Result;
+		if(Queued.m_Priority)
+			Result = m_Conn.QueuePriorityChunk(Size, Queued.m_vData.data());
+		else
+			Result = m_Conn.QueueChunk(Queued.m_Flags, Size, Queued.m_vData.data());
+		EXPECT_EQ(Result, 0);
+		vQueued.push_back(Queued);
+	}
+	int NumSentEarly = m_vSent.size();
+	EXPECT_GT(NumSentEarly, 0);
+	EXPECT_EQ(m_Conn.Flush(), (int)vQueued.size() - NumSentEarly);
+	EXPECT_GT(m_NumPackets, 2);
+	ASSERT_EQ(m_vSent.size(), vQueued.size());
+
+	// every chunk arrives once and unchanged
+	std::vector<int> vSentIndex(vQueued.size(), -1);
+	for(unsigned i = 0; i < m_vSent.size(); i++)
+	{
+		int ID = m_vSent[i].m_vData[0];
+		ASSERT_LT(ID, (int)vQueued.size());
+		EXPECT_EQ(vSentIndex[ID], -1) << ID;
+		vSentIndex[ID] = i;
+		EXPECT_EQ(m_vSent[i].m_Flags, vQueued[ID].m_Flags) << ID;
+		EXPECT_TRUE(m_vSent[i].m_vData == vQueued[ID].m_vData) << ID;
+	}
+
+	// the other chunks keep their order, so the vital sequence numbers
+	// arrive one after another
+	int LastSent = -1;
+	int LastSequence = -1;
+	for(unsigned ID = 0; ID < vQueued.size(); ID++)
+	{
+		if(vQueued[ID].m_Priority)
+			continue;
+		EXPECT_GT(vSentIndex[ID], LastSent) << ID;
+		LastSent = vSentIndex[ID];
+		if(vQueued[ID].m_Flags&NET_CHUNKFLAG_VITAL)
+		{
+			const CSentChunk &Sent = m_vSent[vSentIndex[ID]];
+			if(LastSequence != -1)
+			{
+				EXPECT_EQ(Sent.m_Sequence, (LastSequence + 1) % NET_MAX_SEQUENCE) << ID;
+			}
+			LastSequence = Sent.m_Sequence;
+		}
+	}
+	EXPECT_EQ(LastSequence, m_Conn.SeqSequence());
+
+	// in each packet the priority chunks come first
+	for(unsigned i = 1; i < m_vSent.size(); i++)
+	{
+		if(m_vSent[i].m_Packet != m_vSent[i-1].m_Packet)
+			continue;
+		bool Priority = vQueued[m_vSent[i].m_vData[0]].m_Priority;
+		bool PrevPriority = vQueued[m_vSent[i-1].m_vData[0]].m_Priority;
+		EXPECT_FALSE(Priority && !PrevPriority) << i;
+	}
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/pool.h>
+
+#include <set>
+
+TEST(Pool, Counters)
+{
+	CPool Pool(100, 4);
+	EXPECT_EQ(Pool.NumLive(), 0);
+	EXPECT_EQ(Pool.Capacity(), 0);
+
+	void *apBlocks[6];
+	for(int i = 0; i < 6; i++)
+		apBlocks[i] = Pool.Allocate();
+	EXPECT_EQ(Pool.NumLive(), 6);
+	EXPECT_EQ(Pool.PeakLive(), 6);
+	EXPECT_EQ(Pool.Capacity(), 8);
+
+	for(int i = 0; i < 6; i++)
+		Pool.Free(apBlocks[i]);
+	EXPECT_EQ(Pool.NumLive(), 0);
+	EXPECT_EQ(Pool.PeakLive(), 6);
+	EXPECT_EQ(Pool.Capacity(), 8);
+}
+
+TEST(Pool, BlocksDontOverlap)
+{
+	CPool Pool(100, 8);
+	std::set<char *> Blocks;
+	for(int i = 0; i < 50; i++)
+	{
+		char *pBlock = (char *)Pool.Allocate();
+		EXPECT_EQ((size_t)pBlock % 16, 0u);
+		mem_zero(pBlock, 100);
+		std::set<char *>::iterator Next = Blocks.insert(pBlock).first;
+		if(++Next != Blocks.end())
+		{
+			EXPECT_GE(*Next - pBlock, 100);
+		}
+	}
+	EXPECT_EQ(Blocks.size(), 50u);
+}
+
+TEST(Pool, ReusesNewestFirst)
+{
+	CPool Pool(32);
+	void *pA = Pool.Allocate();
+	void *pB = Pool.Allocate();
+	void *pC = Pool.Allocate();
+	Pool.Free(pA);
+	Pool.Free(pC);
+	EXPECT_EQ(Pool.Allocate(), pC);
+	EXPECT_EQ(Pool.Allocate(), pA);
+	EXPECT_EQ(Pool.Capacity(), 64);
+	Pool.Free(pB);
+	Pool.Free(0);
+	EXPECT_EQ(Pool.NumLive(), 2);
+}
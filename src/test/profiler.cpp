@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/profiler.h>
+
+static void AddMicroseconds(CProfiler *pProfiler, int Phase, int Microseconds)
+{
+	pProfiler->AddDuration(Phase, Microseconds * time_freq() / 1000000);
+}
+
+TEST(Profiler, Percentiles)
+{
+	CProfiler Profiler;
+	Profiler.SetEnabled(true);
+	int Phase = Profiler.Register("phase");
+	int Other = Profiler.Register("other");
+	EXPECT_EQ(Profiler.Register("phase"), Phase);
+
+	// 1..100ms, the histogram is exact to about 6%
+	for(int i = 1; i <= 100; i++)
+	{
+		AddMicroseconds(&Profiler, Phase, i * 1000);
+		Profiler.EndFrame();
+	}
+
+	CProfiler::CStats Stats;
+	Profiler.GetStats(Phase, &Stats);
+	EXPECT_STREQ(Stats.m_pName, "phase");
+	EXPECT_EQ(Stats.m_NumSamples, 100);
+	EXPECT_EQ(Stats.m_Max, 100000);
+	EXPECT_NEAR(Stats.m_P50, 50000, 3000);
+	EXPECT_NEAR(Stats.m_P99, 99000, 6000);
+	EXPECT_LE(Stats.m_P99, Stats.m_Max);
+	EXPECT_EQ(Stats.m_Total / Stats.m_NumSamples, 50500);
+
+	// phases that didn't run in a frame don't get a sample
+	Profiler.GetStats(Other, &Stats);
+	EXPECT_EQ(Stats.m_NumSamples, 0);
+}
+
+TEST(Profiler, SumPerFrame)
+{
+	CProfiler Profiler;
+	Profiler.SetEnabled(true);
+	int Phase = Profiler.Register("phase");
+	for(int i = 0; i < 10; i++)
+	{
+		AddMicroseconds(&Profiler, Phase, 3);
+		AddMicroseconds(&Profiler, Phase, 4);
+		Profiler.EndFrame();
+	}
+	CProfiler::CStats Stats;
+	Profiler.GetStats(Phase, &Stats);
+	EXPECT_EQ(Stats.m_NumSamples, 10);
+	EXPECT_EQ(Stats.m_P50, 7);
+	EXPECT_EQ(Stats.m_Max, 7);
+}
+
+TEST(Profiler, RollingWindow)
+{
+	CProfiler Profiler;
+	Profiler.SetEnabled(true);
+	int Phase = Profiler.Register("phase");
+	AddMicroseconds(&Profiler, Phase, 50000);
+	Profiler.EndFrame();
+	for(int i = 0; i < 2 * CProfiler::WINDOW_FRAMES; i++)
+	{
+		AddMicroseconds(&Profiler, Phase, 100);
+		Profiler.EndFrame();
+	}
+
+	// the slow frame has been dropped with its window
+	CProfiler::CStats Stats;
+	Profiler.GetStats(Phase, &Stats);
+	EXPECT_EQ(Stats.m_NumSamples, CProfiler::WINDOW_FRAMES + 1);
+	EXPECT_EQ(Stats.m_Max, 100);
+
+	Profiler.SetRolling(false);
+	Profiler.Reset();
+	AddMicroseconds(&Profiler, Phase, 50000);
+	Profiler.EndFrame();
+	for(int i = 0; i < 2 * CProfiler::WINDOW_FRAMES; i++)
+	{
+		AddMicroseconds(&Profiler, Phase, 100);
+		Profiler.EndFrame();
+	}
+	Profiler.GetStats(Phase, &Stats);
+	EXPECT_EQ(Stats.m_NumSamples, 2 * CProfiler::WINDOW_FRAMES + 1);
+	EXPECT_EQ(Stats.m_Max, 50000);
+}
+
+TEST(Profiler, Disabled)
+{
+	CProfiler Profiler;
+	int Phase = Profiler.Register("phase");
+	EXPECT_FALSE(Profiler.Active());
+	AddMicroseconds(&Profiler, Phase, 100);
+	Profiler.EndFrame();
+	CProfiler::CStats Stats;
+	Profiler.GetStats(Phase, &Stats);
+	EXPECT_EQ(Stats.m_NumSamples, 0);
+}
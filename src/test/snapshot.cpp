@@ -0,0 +1,317 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+
+#include <algorithm>
+
+static void FillData(int *pData, int Size, int Tick)
+{
+	for(int i = 0; i < Size/4; i++)
+		pData[i] = Tick * 1000 + i;
+}
+
+static void ExpectSame(CSnapshotStorage *pList, CSnapshotStorage *pRing, int FirstTick, int LastTick)
+{
+	for(int Tick = FirstTick; Tick <= LastTick; Tick++)
+	{
+		int64 ListTime = 0, RingTime = 0;
+		CSnapshot *pListData = 0, *pRingData = 0;
+		int ListSize = pList->Get(Tick, &ListTime, &pListData, 0);
+		int RingSize = pRing->Get(Tick, &RingTime, &pRingData, 0);
+		ASSERT_EQ(ListSize, RingSize) << "tick " << Tick;
+		if(ListSize >= 0)
+		{
+			EXPECT_EQ(ListTime, RingTime);
+			EXPECT_EQ(mem_comp(pListData, pRingData, ListSize), 0);
+		}
+	}
+}
+
+TEST(SnapshotStorage, RingEmpty)
+{
+	CSnapshotStorage Ring;
+	Ring.Init();
+	Ring.InitRing(16, 1024);
+	EXPECT_EQ(Ring.Get(-1, 0, 0, 0), -1);
+	EXPECT_EQ(Ring.Get(0, 0, 0, 0), -1);
+	EXPECT_FALSE(Ring.m_pFirst);
+}
+
+TEST(SnapshotStorage, RingMatchesList)
+{
+	CSnapshotStorage List;
+	CSnapshotStorage Ring;
+	List.Init();
+	Ring.Init();
+	// small arena so that some snapshots fall back to the heap
+	Ring.InitRing(151, 151*256);
+
+	int aData[1024];
+	for(int Tick = 0; Tick < 2000; Tick++)
+	{
+		List.PurgeUntil(Tick-150);
+		Ring.PurgeUntil(Tick-150);
+		// skip some ticks like clients recovering their snap rate
+		if(Tick%7 == 3)
+			continue;
+		int Size = 16 + (Tick*37)%(sizeof(aData)-16);
+		Size &= ~3;
+		FillData(aData, Size, Tick);
+		List.Add(Tick, Tick*10, Size, aData, Tick%2);
+		Ring.Add(Tick, Tick*10, Size, aData, Tick%2);
+		ExpectSame(&List, &Ring, Tick-160, Tick+1);
+		ASSERT_EQ(Ring.m_pFirst->m_Tick, List.m_pFirst->m_Tick);
+		ASSERT_EQ(Ring.m_pLast->m_Tick, Tick);
+	}
+
+	List.PurgeAll();
+	Ring.PurgeAll();
+	EXPECT_FALSE(Ring.m_pFirst);
+	EXPECT_FALSE(Ring.m_pLast);
+	ExpectSame(&List, &Ring, 1800, 2000);
+}
+
+TEST(SnapshotStorage, RingEvictsOldest)
+{
+	CSnapshotStorage Ring;
+	Ring.Init();
+	Ring.InitRing(4, 4096);
+
+	int aData[4];
+	for(int Tick = 0; Tick < 10; Tick++)
+	{
+		FillData(aData, sizeof(aData), Tick);
+		Ring.Add(Tick, 0, sizeof(aData), aData, 0);
+	}
+	EXPECT_EQ(Ring.Get(5, 0, 0, 0), -1);
+	for(int Tick = 6; Tick < 10; Tick++)
+		EXPECT_EQ(Ring.Get(Tick, 0, 0, 0), (int)sizeof(aData));
+	EXPECT_EQ(Ring.m_pFirst->m_Tick, 6);
+}
+
+// CreateDelta as it was before the item index, used as reference
+struct CLegacyItemList
+{
+	int m_Num;
+	int m_aKeys[64];
+	int m_aIndex[64];
+};
+
+static void LegacyGenerateHash(CLegacyItemList *pHashlist, CSnapshot *pSnapshot)
+{
+	for(int i = 0; i < 256; i++)
+		pHashlist[i].m_Num = 0;
+
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	{
+		int Key = pSnapshot->GetItem(i)->Key();
+		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
+		if(pHashlist[HashID].m_Num != 64)
+		{
+			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
+			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
+			pHashlist[HashID].m_Num++;
+		}
+	}
+}
+
+static int LegacyGetItemIndexHashed(int Key, const CLegacyItemList *pHashlist)
+{
+	int HashID = ((Key>>12)&0xf0) | (Key&0xf);
+	for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+	{
+		if(pHashlist[HashID].m_aKeys[i] == Key)
+			return pHashlist[HashID].m_aIndex[i];
+	}
+	return -1;
+}
+
+static int LegacyCreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+{
+	CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pDstData;
+	int *pData = (int *)pDelta->m_pData;
+	static CLegacyItemList s_aHashlist[256];
+
+	pDelta->m_NumDeletedItems = 0;
+	pDelta->m_NumUpdateItems = 0;
+	pDelta->m_NumTempItems = 0;
+
+	LegacyGenerateHash(s_aHashlist, pTo);
+	for(int i = 0; i < pFrom->NumItems(); i++)
+	{
+		if(LegacyGetItemIndexHashed(pFrom->GetItem(i)->Key(), s_aHashlist) == -1)
+		{
+			pDelta->m_NumDeletedItems++;
+			*pData++ = pFrom->GetItem(i)->Key();
+		}
+	}
+
+	LegacyGenerateHash(s_aHashlist, pFrom);
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		int ItemSize = pTo->GetItemSize(i);
+		CSnapshotItem *pCurItem = pTo->GetItem(i);
+		int PastIndex = LegacyGetItemIndexHashed(pCurItem->Key(), s_aHashlist);
+		if(PastIndex != -1)
+		{
+			int *pPast = pFrom->GetItem(PastIndex)->Data();
+			int Needed = 0;
+			for(int b = 0; b < ItemSize/4; b++)
+			{
+				pData[3+b] = (int)((unsigned)pCurItem->Data()[b] - (unsigned)pPast[b]);
+				Needed |= pData[3+b];
+			}
+			if(Needed)
+			{
+				*pData++ = pCurItem->Type();
+				*pData++ = pCurItem->ID();
+				*pData++ = ItemSize/4;
+				pData += ItemSize/4;
+				pDelta->m_NumUpdateItems++;
+			}
+		}
+		else
+		{
+			*pData++ = pCurItem->Type();
+			*pData++ = pCurItem->ID();
+			*pData++ = ItemSize/4;
+			mem_copy(pData, pCurItem->Data(), ItemSize);
+			pData += ItemSize/4;
+			pDelta->m_NumUpdateItems++;
+		}
+	}
+
+	if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems && !pDelta->m_NumTempItems)
+		return 0;
+	return (int)((char *)pData-(char *)pDstData);
+}
+
+static unsigned s_Seed = 1;
+static int Random()
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) & 0x7fffff;
+}
+
+static int BuildRandomSnapshot(CSnapshotBuilder *pBuilder, void *pData, int NumItems, int Tick)
+{
+	pBuilder->Init();
+	for(int i = 0; i < NumItems; i++)
+	{
+		// few types and many ids, so that some hash buckets overflow
+		int Type = 1 + i%3;
+		int ID = (i/3)*(i%5 == 0 ? 16 : 1);
+		int Size = 4 * (1 + (Type*3)%7);
+		int *pItem = (int *)pBuilder->NewItem(Type, ID, Size);
+		if(!pItem)
+			break;
+		for(int b = 0; b < Size/4; b++)
+			pItem[b] = (Random()%4 == 0) ? Random() - 0x400000 : ID*b + (Tick/4);
+	}
+	return pBuilder->Finish(pData);
+}
+
+TEST(SnapshotDelta, DiffImplsMatchScalar)
+{
+	int aPast[64], aCurrent[64], aExpected[64], aOut[64];
+	int Previous = CSnapshotDelta::GetDiffImpl();
+	for(int Impl = 0; Impl < CSnapshotDelta::NUM_DIFFIMPLS; Impl++)
+	{
+		if(!CSnapshotDelta::SetDiffImpl(Impl))
+			continue;
+		for(int Round = 0; Round < 500; Round++)
+		{
+			int Size = Round%40;
+			for(int i = 0; i < Size; i++)
+			{
+				aPast[i] = Random() * (Random()%3 - 1);
+				aCurrent[i] = Round%3 ? aPast[i] : Random() ^ (Random() << 9);
+			}
+			CSnapshotDelta::SetDiffImpl(CSnapshotDelta::DIFFIMPL_SCALAR);
+			int ExpectedNeeded = CSnapshotDelta::DiffItem(aPast, aCurrent, aExpected, Size);
+			CSnapshotDelta::SetDiffImpl(Impl);
+			int Needed = CSnapshotDelta::DiffItem(aPast, aCurrent, aOut, Size);
+			ASSERT_EQ(Needed, ExpectedNeeded) << CSnapshotDelta::DiffImplName(Impl);
+			ASSERT_EQ(mem_comp(aOut, aExpected, Size*sizeof(int)), 0) << CSnapshotDelta::DiffImplName(Impl);
+		}
+	}
+	CSnapshotDelta::SetDiffImpl(Previous);
+}
+
+TEST(SnapshotDelta, MatchesLegacy)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aaSnap[2][CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE*2];
+	static char s_aLegacyDelta[CSnapshot::MAX_SIZE*2];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	static CSnapshotDelta s_Delta;
+
+	int Previous = CSnapshotDelta::GetDiffImpl();
+	for(int Impl = 0; Impl < CSnapshotDelta::NUM_DIFFIMPLS; Impl++)
+	{
+		if(!CSnapshotDelta::SetDiffImpl(Impl))
+			continue;
+		CSnapshot *pFrom = (CSnapshot *)s_aaSnap[0];
+		CSnapshot *pTo = (CSnapshot *)s_aaSnap[1];
+		pFrom->Clear();
+		for(int Tick = 0; Tick < 60; Tick++)
+		{
+			int NumItems = Tick%20 == 19 ? 1024 : 50 + Random()%300;
+			int Size = BuildRandomSnapshot(&s_Builder, pTo, NumItems, Tick);
+			int DeltaSize = s_Delta.CreateDelta(pFrom, pTo, s_aDelta);
+			// again, with the cached index of the from snapshot
+			ASSERT_EQ(s_Delta.CreateDelta(pFrom, pTo, s_aDelta), DeltaSize);
+			int LegacySize = LegacyCreateDelta(pFrom, pTo, s_aLegacyDelta);
+			ASSERT_EQ(DeltaSize, LegacySize) << CSnapshotDelta::DiffImplName(Impl) << " tick " << Tick;
+			ASSERT_EQ(mem_comp(s_aDelta, s_aLegacyDelta, DeltaSize), 0) << CSnapshotDelta::DiffImplName(Impl) << " tick " << Tick;
+
+			if(DeltaSize)
+			{
+				int UnpackedSize = s_Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, s_aDelta, DeltaSize);
+				ASSERT_EQ(UnpackedSize, Size);
+				ASSERT_EQ(mem_comp(s_aUnpacked, pTo, Size), 0);
+			}
+
+			std::swap(pFrom, pTo);
+		}
+	}
+	CSnapshotDelta::SetDiffImpl(Previous);
+}
+
+TEST(SnapshotDelta, DataRate)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aFrom[CSnapshot::MAX_SIZE];
+	static char s_aTo[CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	const int aValues[] = {0, 1, -1, 63, 64, -64, -65, 8191, 8192, -8193, 1<<20, -(1<<20), 1<<27, 0x7fffffff, (int)0x80000000};
+	const int NumValues = sizeof(aValues)/sizeof(aValues[0]);
+
+	s_Builder.Init();
+	mem_zero(s_Builder.NewItem(5, 1, sizeof(aValues)), sizeof(aValues));
+	s_Builder.Finish(s_aFrom);
+	s_Builder.Init();
+	mem_copy(s_Builder.NewItem(5, 1, sizeof(aValues)), aValues, sizeof(aValues));
+	s_Builder.Finish(s_aTo);
+
+	int Expected = 0;
+	for(int i = 0; i < NumValues; i++)
+	{
+		unsigned char aBuf[16];
+		Expected += aValues[i] ? (int)(CVariableInt::Pack(aBuf, aValues[i]) - aBuf) * 8 : 1;
+	}
+
+	for(int Impl = 0; Impl < CSnapshotDelta::NUM_DIFFIMPLS; Impl++)
+	{
+		if(!CSnapshotDelta::SetDiffImpl(Impl))
+			continue;
+		CSnapshotDelta Delta;
+		int DeltaSize = Delta.CreateDelta((CSnapshot *)s_aFrom, (CSnapshot *)s_aTo, s_aDelta);
+		ASSERT_GT(DeltaSize, 0);
+		Delta.UnpackDelta((CSnapshot *)s_aFrom, (CSnapshot *)s_aUnpacked, s_aDelta, DeltaSize);
+		EXPECT_EQ(Delta.GetDataRate(5), Expected) << CSnapshotDelta::DiffImplName(Impl);
+	}
+}
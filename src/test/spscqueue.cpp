@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/spscqueue.h>
+
+TEST(SpscQueue, Empty)
+{
+	TSpscQueue<int, 4> Queue;
+	int Item;
+	EXPECT_EQ(Queue.Size(), 0);
+	EXPECT_FALSE(Queue.Front());
+	EXPECT_FALSE(Queue.Pop(&Item));
+}
+
+TEST(SpscQueue, Full)
+{
+	TSpscQueue<int, 4> Queue;
+	for(int i = 0; i < 4; i++)
+		EXPECT_TRUE(Queue.Push(i));
+	EXPECT_FALSE(Queue.Push(4));
+	EXPECT_FALSE(Queue.Back());
+	EXPECT_EQ(Queue.Size(), 4);
+
+	int Item;
+	for(int i = 0; i < 4; i++)
+	{
+		EXPECT_TRUE(Queue.Pop(&Item));
+		EXPECT_EQ(Item, i);
+	}
+	EXPECT_FALSE(Queue.Pop(&Item));
+}
+
+static const int TEST_NUM_ITEMS = 100000;
+
+static void Produce(void *pUser)
+{
+	TSpscQueue<int, 16> *pQueue = (TSpscQueue<int, 16> *)pUser;
+	for(int i = 0; i < TEST_NUM_ITEMS; i++)
+		while(!pQueue->Push(i))
+			thread_yield();
+}
+
+TEST(SpscQueue, Threaded)
+{
+	TSpscQueue<int, 16> Queue;
+	void *pThread = thread_init(Produce, &Queue, "spsc producer");
+
+	int Expected = 0;
+	while(Expected < TEST_NUM_ITEMS)
+	{
+		int Item;
+		if(!Queue.Pop(&Item))
+		{
+			thread_yield();
+			continue;
+		}
+		ASSERT_EQ(Item, Expected);
+		Expected++;
+	}
+	thread_wait(pThread);
+	EXPECT_EQ(Queue.Size(), 0);
+}
@@ -361,3 +361,87 @@ TEST_F(TeeHistorian, Auth)
 	Finish();
 	Expect(EXPECTED, sizeof(EXPECTED));
 }
+
+TEST_F(TeeHistorian, ReadBack)
+{
+	CNetObj_PlayerInput Input;
+	mem_zero(&Input, sizeof(Input));
+	Input.m_Direction = -1;
+	Input.m_TargetX = 100;
+	CNetObj_PlayerInput Input2 = Input;
+	Input2.m_Jump = 1;
+	Input2.m_TargetY = -50;
+
+	Tick(1); Player(0, 1, 2); Player(3, 5, 6);
+	Inputs(); m_TH.RecordPlayerJoin(5); m_TH.RecordPlayerInput(0, &Input); m_TH.RecordPlayerMessage(0, "\x02", 1);
+	Tick(2); Player(0, 2, 2); Player(3, 5, 6);
+	Inputs(); m_TH.RecordPlayerInput(0, &Input2);
+	Tick(3); DeadPlayer(0); Player(3, 5, 6);
+	Tick(5); Player(3, 7, 8);
+	Inputs(); m_TH.RecordPlayerDrop(5, "gone");
+	Finish();
+	ASSERT_FALSE(m_Buffer.Error());
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Open(m_Buffer.Data(), m_Buffer.Size()));
+	EXPECT_TRUE(str_find(Reader.Header(), "\"map_name\":\"Kobra 3 Solo\""));
+
+	CTeeHistorianReader::CItem Item;
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_TICK);
+	EXPECT_EQ(Reader.Tick(), 1);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_PLAYER);
+	EXPECT_EQ(Item.m_ClientID, 0); EXPECT_EQ(Item.m_X, 1); EXPECT_EQ(Item.m_Y, 2);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_PLAYER);
+	EXPECT_EQ(Item.m_ClientID, 3); EXPECT_EQ(Item.m_X, 5); EXPECT_EQ(Item.m_Y, 6);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_JOIN);
+	EXPECT_EQ(Item.m_ClientID, 5);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_INPUT);
+	EXPECT_EQ(Item.m_ClientID, 0);
+	EXPECT_EQ(mem_comp(&Item.m_Input, &Input, sizeof(Input)), 0);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_MESSAGE);
+	ASSERT_EQ(Item.m_DataSize, 1);
+	EXPECT_EQ(*(const char *)Item.m_pData, '\x02');
+
+	// implicit tick, the client ids start over
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_TICK);
+	EXPECT_EQ(Reader.Tick(), 2);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_PLAYER);
+	EXPECT_EQ(Item.m_ClientID, 0); EXPECT_EQ(Item.m_X, 2); EXPECT_EQ(Item.m_Y, 2);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_INPUT);
+	EXPECT_EQ(mem_comp(&Item.m_Input, &Input2, sizeof(Input2)), 0);
+
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_TICK);
+	EXPECT_EQ(Reader.Tick(), 3);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_PLAYER_DEAD);
+	EXPECT_EQ(Item.m_ClientID, 0);
+
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_TICK);
+	EXPECT_EQ(Reader.Tick(), 5);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_PLAYER);
+	EXPECT_EQ(Item.m_ClientID, 3); EXPECT_EQ(Item.m_X, 7); EXPECT_EQ(Item.m_Y, 8);
+	ASSERT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_DROP);
+	EXPECT_EQ(Item.m_ClientID, 5);
+	EXPECT_STREQ(Item.m_pString, "gone");
+
+	EXPECT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_FINISH);
+	EXPECT_EQ(Reader.Next(&Item), (int)CTeeHistorianReader::ITEM_FINISH);
+}
+
+TEST_F(TeeHistorian, ReadBroken)
+{
+	CTeeHistorianReader Reader;
+	EXPECT_FALSE(Reader.Open("teehistorian", 12));
+
+	Tick(1); Player(0, 1, 2);
+	Inputs(); m_TH.RecordPlayerDrop(0, "gone");
+	ASSERT_FALSE(m_Buffer.Error());
+
+	// cut off in the middle of the reason
+	ASSERT_TRUE(Reader.Open(m_Buffer.Data(), m_Buffer.Size() - 2));
+	CTeeHistorianReader::CItem Item;
+	int Type;
+	while((Type = Reader.Next(&Item)) > CTeeHistorianReader::ITEM_FINISH)
+		;
+	EXPECT_EQ(Type, (int)CTeeHistorianReader::ITEM_ERROR);
+	EXPECT_TRUE(Reader.Error()[0]);
+}
@@ -0,0 +1,588 @@
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/config.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+#include <game/generated/protocol.h>
+#include <game/version.h>
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+// connects headless bots to a server, adding a few at a time, to find out
+// how many players it can take before the tick time exceeds a budget.
+// every bot runs the handshake of the real client including the map
+// download and then sends inputs at 50 Hz while recording how late its
+// snapshots arrive and how many are lost. the first bot logs into rcon
+// and reads the server's tick times with sv_profile and profile_dump
+//
+// on loopback every bot binds its own 127.1.x.y address, so that the per
+// address and per network connection limits of the server don't apply
+
+enum
+{
+	MAX_BOTS=256,
+	INPUT_RATE=50,
+};
+
+struct CStepStats
+{
+	std::vector<int> m_aLateness;
+	int m_NumSnapshots;
+	int m_NumLost;
+	int m_ServerP50;
+	int m_ServerP99;
+	int m_ServerMax;
+	bool m_GotServerStats;
+};
+
+static CStepStats *s_pStats = 0;
+
+class CBot
+{
+public:
+	enum
+	{
+		STATE_OFFLINE=0,
+		STATE_CONNECTING,
+		STATE_LOADING,
+		STATE_READY,
+		STATE_ENTERING,
+		STATE_INGAME,
+		STATE_GONE,
+	};
+
+	CNetClient m_Net;
+	int m_ID;
+	int m_State;
+	bool m_Monitor;
+	bool m_RconAuthed;
+
+	int m_MapCrc;
+	int m_MapChunk;
+
+	int m_AckTick;
+	int64 m_AckTime;
+	int m_PartsTick;
+	unsigned m_PartsMask;
+	int64 m_MinOffset;
+	int m_SnapStep;
+
+	unsigned m_Seed;
+	CNetObj_PlayerInput m_Input;
+	int m_NextInputChange;
+
+	bool Start(int ID, const NETADDR *pServer, bool Monitor);
+	void Update(int64 Now);
+	void SendInput(int64 Now, bool RandomInput);
+	void Rcon(const char *pCommand);
+
+private:
+	void SendMsg(CMsgPacker *pMsg, int Flags, bool System);
+	void OnSystemMsg(int Msg, CUnpacker *pUnpacker, int Flags, int64 Now);
+	void OnGameMsg(int Msg, CUnpacker *pUnpacker);
+	void OnSnapshot(int Tick, int64 Now);
+	void OnRconLine(const char *pLine);
+	unsigned Random();
+};
+
+unsigned CBot::Random()
+{
+	m_Seed ^= m_Seed << 13;
+	m_Seed ^= m_Seed >> 17;
+	m_Seed ^= m_Seed << 5;
+	return m_Seed;
+}
+
+bool CBot::Start(int ID, const NETADDR *pServer, bool Monitor)
+{
+	mem_zero(&m_Input, sizeof(m_Input));
+	m_ID = ID;
+	m_Monitor = Monitor;
+	m_RconAuthed = false;
+	m_MapCrc = 0;
+	m_MapChunk = 0;
+	m_AckTick = -1;
+	m_AckTime = 0;
+	m_PartsTick = -1;
+	m_PartsMask = 0;
+	m_MinOffset = 0;
+	m_SnapStep = 0;
+	m_Seed = 0x9e3779b9u * (ID + 1);
+	m_NextInputChange = 0;
+
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = pServer->type;
+	if(pServer->type == NETTYPE_IPV4 && pServer->ip[0] == 127)
+	{
+		BindAddr.ip[0] = 127;
+		BindAddr.ip[1] = 1;
+		BindAddr.ip[2] = ID / 8;
+		BindAddr.ip[3] = ID % 8 + 1;
+	}
+	if(!m_Net.Open(BindAddr, 0))
+	{
+		// no loopback range, the server's limits have to be raised instead
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = pServer->type;
+		if(!m_Net.Open(BindAddr, 0))
+			return false;
+	}
+
+	NETADDR Server = *pServer;
+	m_Net.Connect(&Server);
+	m_State = STATE_CONNECTING;
+	return true;
+}
+
+void CBot::SendMsg(CMsgPacker *pMsg, int Flags, bool System)
+{
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(Packet));
+	Packet.m_ClientID = 0;
+	Packet.m_pData = pMsg->Data();
+	Packet.m_DataSize = pMsg->Size();
+
+	// like CClient::SendMsgEx, the message id carries the system flag
+	*((unsigned char *)Packet.m_pData) <<= 1;
+	if(System)
+		*((unsigned char *)Packet.m_pData) |= 1;
+
+	if(Flags&MSGFLAG_VITAL)
+		Packet.m_Flags |= NETSENDFLAG_VITAL;
+	if(Flags&MSGFLAG_FLUSH)
+		Packet.m_Flags |= NETSENDFLAG_FLUSH;
+	m_Net.Send(&Packet);
+}
+
+void CBot::Rcon(const char *pCommand)
+{
+	CMsgPacker Msg(NETMSG_RCON_CMD);
+	Msg.AddString(pCommand, 256);
+	SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+}
+
+void CBot::Update(int64 Now)
+{
+	if(m_State == STATE_OFFLINE || m_State == STATE_GONE)
+		return;
+
+	m_Net.Update();
+
+	if(m_State == STATE_CONNECTING && m_Net.State() == NETSTATE_ONLINE)
+	{
+		CMsgPacker Msg(NETMSG_INFO);
+		Msg.AddString(GAME_NETVERSION, 128);
+		Msg.AddString(g_Config.m_Password, 128);
+		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		m_State = STATE_LOADING;
+	}
+	else if(m_Net.State() == NETSTATE_OFFLINE && m_State != STATE_CONNECTING)
+	{
+		dbg_msg("bot_load", "bot %d disconnected: %s", m_ID, m_Net.ErrorString());
+		m_State = STATE_GONE;
+		return;
+	}
+
+	CNetChunk Packet;
+	while(m_Net.Recv(&Packet))
+	{
+		if(Packet.m_ClientID == -1)
+			continue;
+		CUnpacker Unpacker;
+		Unpacker.Reset(Packet.m_pData, Packet.m_DataSize);
+		int Msg = Unpacker.GetInt();
+		bool System = Msg&1;
+		Msg >>= 1;
+		if(Unpacker.Error())
+			continue;
+		if(System)
+			OnSystemMsg(Msg, &Unpacker, Packet.m_Flags, Now);
+		else
+			OnGameMsg(Msg, &Unpacker);
+	}
+}
+
+void CBot::OnSystemMsg(int Msg, CUnpacker *pUnpacker, int Flags, int64 Now)
+{
+	bool Vital = Flags&NETSENDFLAG_VITAL;
+	if(Msg == NETMSG_MAP_CHANGE && Vital)
+	{
+		pUnpacker->GetString();
+		m_MapCrc = pUnpacker->GetInt();
+		m_MapChunk = 0;
+		CMsgPacker Request(NETMSG_REQUEST_MAP_DATA);
+		Request.AddInt(m_MapChunk);
+		SendMsg(&Request, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+	}
+	else if(Msg == NETMSG_MAP_DATA)
+	{
+		int Last = pUnpacker->GetInt();
+		int MapCrc = pUnpacker->GetInt();
+		int Chunk = pUnpacker->GetInt();
+		if(pUnpacker->Error() || MapCrc != m_MapCrc || Chunk != m_MapChunk)
+			return;
+
+		// the data itself isn't needed
+		if(Last)
+		{
+			CMsgPacker Ready(NETMSG_READY);
+			SendMsg(&Ready, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+			m_State = STATE_READY;
+		}
+		else
+		{
+			CMsgPacker Request(NETMSG_REQUEST_MAP_DATA);
+			Request.AddInt(++m_MapChunk);
+			SendMsg(&Request, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		}
+	}
+	else if(Msg == NETMSG_CON_READY && Vital)
+	{
+		char aName[16];
+		str_format(aName, sizeof(aName), "bot%d", m_ID);
+		CNetMsg_Cl_StartInfo Info;
+		Info.m_pName = aName;
+		Info.m_pClan = "";
+		Info.m_Country = -1;
+		Info.m_pSkin = "default";
+		Info.m_UseCustomColor = 0;
+		Info.m_ColorBody = 0;
+		Info.m_ColorFeet = 0;
+		CMsgPacker Packer(Info.MsgID());
+		Info.Pack(&Packer);
+		SendMsg(&Packer, MSGFLAG_VITAL|MSGFLAG_FLUSH, false);
+	}
+	else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
+	{
+		int Tick = pUnpacker->GetInt();
+		pUnpacker->GetInt();
+		int NumParts = 1;
+		int Part = 0;
+		if(Msg == NETMSG_SNAP)
+		{
+			NumParts = pUnpacker->GetInt();
+			Part = pUnpacker->GetInt();
+		}
+		if(pUnpacker->Error() || NumParts < 1 || NumParts > 32 || Part < 0 || Part >= NumParts || Tick <= m_AckTick)
+			return;
+
+		if(Tick != m_PartsTick)
+		{
+			m_PartsTick = Tick;
+			m_PartsMask = 0;
+		}
+		m_PartsMask |= 1u << Part;
+		if(m_PartsMask == (NumParts == 32 ? ~0u : (1u << NumParts) - 1))
+			OnSnapshot(Tick, Now);
+	}
+	else if(Msg == NETMSG_RCON_AUTH_STATUS)
+	{
+		m_RconAuthed = pUnpacker->GetInt() == 1;
+		if(m_RconAuthed)
+			Rcon("sv_profile 1");
+		else
+			dbg_msg("bot_load", "rcon login failed");
+	}
+	else if(Msg == NETMSG_RCON_LINE)
+	{
+		const char *pLine = pUnpacker->GetString();
+		if(!pUnpacker->Error())
+			OnRconLine(pLine);
+	}
+	else if(Msg == NETMSG_PING)
+	{
+		CMsgPacker Reply(NETMSG_PING_REPLY);
+		SendMsg(&Reply, 0, true);
+	}
+}
+
+void CBot::OnGameMsg(int Msg, CUnpacker *pUnpacker)
+{
+	if(Msg == NETMSGTYPE_SV_READYTOENTER)
+	{
+		CMsgPacker Enter(NETMSG_ENTERGAME);
+		SendMsg(&Enter, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		m_State = STATE_ENTERING;
+	}
+}
+
+void CBot::OnSnapshot(int Tick, int64 Now)
+{
+	// the server starts its ticks at a fixed rate, so on the same machine
+	// the arrival time minus the tick's nominal time only changes when a
+	// snapshot is late. the earliest one seen is taken as on time
+	int64 Offset = Now - Tick * time_freq() / SERVER_TICK_SPEED;
+	if(m_State != STATE_INGAME)
+	{
+		m_State = STATE_INGAME;
+		m_MinOffset = Offset;
+		if(m_Monitor)
+		{
+			CMsgPacker Auth(NETMSG_RCON_AUTH);
+			Auth.AddString("", 32);
+			Auth.AddString(g_Config.m_SvRconPassword, 32);
+			Auth.AddInt(0);
+			SendMsg(&Auth, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		}
+	}
+	m_MinOffset = minimum(m_MinOffset, Offset);
+
+	if(m_AckTick > 0)
+	{
+		int Step = Tick - m_AckTick;
+		m_SnapStep = m_SnapStep ? minimum(m_SnapStep, Step) : Step;
+		if(s_pStats)
+		{
+			s_pStats->m_NumSnapshots++;
+			s_pStats->m_NumLost += Step / m_SnapStep - 1;
+			s_pStats->m_aLateness.push_back((int)((Offset - m_MinOffset) * 1000000 / time_freq()));
+		}
+	}
+	m_AckTick = Tick;
+	m_AckTime = Now;
+}
+
+void CBot::OnRconLine(const char *pLine)
+{
+	// "[profile]: frame   ticks=... avg=...us p50=...us p99=...us max=...us"
+	const char *pFrame = str_find(pLine, "frame ");
+	if(!s_pStats || !pFrame)
+		return;
+	const char *pP50 = str_find(pFrame, "p50=");
+	const char *pP99 = str_find(pFrame, "p99=");
+	const char *pMax = str_find(pFrame, "max=");
+	if(!pP50 || !pP99 || !pMax)
+		return;
+	s_pStats->m_ServerP50 = str_toint(pP50 + 4);
+	s_pStats->m_ServerP99 = str_toint(pP99 + 4);
+	s_pStats->m_ServerMax = str_toint(pMax + 4);
+	s_pStats->m_GotServerStats = true;
+}
+
+void CBot::SendInput(int64 Now, bool RandomInput)
+{
+	if(m_State != STATE_INGAME)
+		return;
+
+	if(RandomInput && m_NextInputChange-- <= 0)
+	{
+		// hold each input for 0.1 to 1 seconds, like a (bad) player would
+		m_NextInputChange = 5 + Random() % 45;
+		m_Input.m_Direction = (int)(Random() % 3) - 1;
+		m_Input.m_Jump = Random() % 4 == 0;
+		m_Input.m_Hook = Random() % 3 == 0;
+		if(Random() % 2)
+			m_Input.m_Fire += 2;
+		int Angle = Random() % 360;
+		m_Input.m_TargetX = (int)(cosf(Angle * pi / 180.0f) * 200.0f);
+		m_Input.m_TargetY = (int)(sinf(Angle * pi / 180.0f) * 200.0f);
+		m_Input.m_WantedWeapon = Random() % 5 == 0 ? Random() % NUM_WEAPONS + 1 : 0;
+	}
+
+	// aim a few ticks ahead of the server, like the client's prediction
+	int ServerTick = m_AckTick + (int)((Now - m_AckTime) * SERVER_TICK_SPEED / time_freq());
+	CMsgPacker Msg(NETMSG_INPUT);
+	Msg.AddInt(m_AckTick);
+	Msg.AddInt(ServerTick + 3);
+	Msg.AddInt(sizeof(m_Input));
+	const int *pData = (const int *)&m_Input;
+	for(unsigned i = 0; i < sizeof(m_Input)/sizeof(int); i++)
+		Msg.AddInt(pData[i]);
+	SendMsg(&Msg, MSGFLAG_FLUSH, true);
+}
+
+static CBot s_aBots[MAX_BOTS];
+static int s_NumBots = 0;
+static int64 s_NextInput = 0;
+static bool s_RandomInput = true;
+
+static void Run(int64 Duration, bool (*pfnDone)())
+{
+	int64 End = time_get() + Duration;
+	while(time_get() < End && !(pfnDone && pfnDone()))
+	{
+		int64 Now = time_get();
+		for(int i = 0; i < s_NumBots; i++)
+			s_aBots[i].Update(Now);
+		if(Now >= s_NextInput)
+		{
+			for(int i = 0; i < s_NumBots; i++)
+				s_aBots[i].SendInput(Now, s_RandomInput);
+			s_NextInput = maximum(s_NextInput + time_freq() / INPUT_RATE, Now);
+		}
+		thread_sleep(1000);
+	}
+}
+
+static bool AllJoined()
+{
+	for(int i = 0; i < s_NumBots; i++)
+		if(s_aBots[i].m_State != CBot::STATE_INGAME && s_aBots[i].m_State != CBot::STATE_GONE)
+			return false;
+	return true;
+}
+
+static bool GotServerStats()
+{
+	return s_pStats->m_GotServerStats;
+}
+
+static int NumIngame()
+{
+	int Num = 0;
+	for(int i = 0; i < s_NumBots; i++)
+		if(s_aBots[i].m_State == CBot::STATE_INGAME)
+			Num++;
+	return Num;
+}
+
+static int Percentile(std::vector<int> &aValues, int Percent)
+{
+	if(aValues.empty())
+		return 0;
+	std::sort(aValues.begin(), aValues.end());
+	return aValues[minimum((int)aValues.size() - 1, (int)(aValues.size() * Percent / 100))];
+}
+
+static void Usage(const char *pProgram)
+{
+	dbg_msg("usage", "%s [options] [server[:port]]", pProgram);
+	dbg_msg("usage", "  -r <password>  rcon password, needed to read the server's tick times");
+	dbg_msg("usage", "  -b <ms>        tick time budget for the 99th percentile (default 5)");
+	dbg_msg("usage", "  -n <bots>      maximum number of bots (default 64)");
+	dbg_msg("usage", "  -s <bots>      bots added per step (default 8)");
+	dbg_msg("usage", "  -t <seconds>   measuring time per step (default 10)");
+	dbg_msg("usage", "  -i             idle bots instead of random inputs");
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+	if(secure_random_init() != 0)
+	{
+		dbg_msg("secure", "could not initialize secure RNG");
+		return -1;
+	}
+	net_init();
+	CNetBase::Init();
+	CreateConfig()->Reset();
+
+	const char *pServer = "127.0.0.1:8303";
+	float BudgetMs = 5.0f;
+	int MaxBots = 64;
+	int StepBots = 8;
+	int StepSeconds = 10;
+	for(int i = 1; i < argc; i++)
+	{
+		bool HasValue = i + 1 < argc;
+		if(str_comp(argv[i], "-r") == 0 && HasValue)
+			str_copy(g_Config.m_SvRconPassword, argv[++i], sizeof(g_Config.m_SvRconPassword));
+		else if(str_comp(argv[i], "-b") == 0 && HasValue)
+			BudgetMs = str_tofloat(argv[++i]);
+		else if(str_comp(argv[i], "-n") == 0 && HasValue)
+			MaxBots = clamp(str_toint(argv[++i]), 1, (int)MAX_BOTS);
+		else if(str_comp(argv[i], "-s") == 0 && HasValue)
+			StepBots = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-t") == 0 && HasValue)
+			StepSeconds = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-i") == 0)
+			s_RandomInput = false;
+		else if(argv[i][0] == '-')
+		{
+			Usage(argv[0]);
+			return -1;
+		}
+		else
+			pServer = argv[i];
+	}
+
+	NETADDR ServerAddr;
+	if(net_addr_from_str(&ServerAddr, pServer) != 0 && net_host_lookup(pServer, &ServerAddr, NETTYPE_ALL) != 0)
+	{
+		dbg_msg("bot_load", "couldn't resolve '%s'", pServer);
+		return -1;
+	}
+	if(!ServerAddr.port)
+		ServerAddr.port = 8303;
+
+	bool Monitor = g_Config.m_SvRconPassword[0] != 0;
+	if(!Monitor)
+		dbg_msg("bot_load", "no rcon password given, only measuring on the bots' side");
+
+	s_NextInput = time_get();
+	int Capacity = -1;
+	bool Exceeded = false;
+	while(s_NumBots < MaxBots)
+	{
+		int NumNew = minimum(StepBots, MaxBots - s_NumBots);
+		for(int i = 0; i < NumNew; i++)
+		{
+			if(!s_aBots[s_NumBots].Start(s_NumBots, &ServerAddr, Monitor && s_NumBots == 0))
+			{
+				dbg_msg("bot_load", "couldn't open a socket for bot %d", s_NumBots);
+				return -1;
+			}
+			s_NumBots++;
+		}
+		Run(15 * time_freq(), AllJoined);
+
+		int Ingame = NumIngame();
+		if(Ingame < s_NumBots)
+			dbg_msg("bot_load", "only %d of %d bots got into the game", Ingame, s_NumBots);
+
+		// measure from a clean state, without the joins
+		if(Monitor)
+			s_aBots[0].Rcon("sv_profile 0; sv_profile 1");
+		Run(time_freq(), 0);
+
+		CStepStats Stats;
+		Stats.m_NumSnapshots = 0;
+		Stats.m_NumLost = 0;
+		Stats.m_GotServerStats = false;
+		s_pStats = &Stats;
+		Run(StepSeconds * time_freq(), 0);
+		if(Monitor && s_aBots[0].m_RconAuthed)
+		{
+			s_aBots[0].Rcon("profile_dump");
+			Run(2 * time_freq(), GotServerStats);
+		}
+		s_pStats = 0;
+
+		int Lateness50 = Percentile(Stats.m_aLateness, 50);
+		int Lateness99 = Percentile(Stats.m_aLateness, 99);
+		float Loss = Stats.m_NumSnapshots ? Stats.m_NumLost * 100.0f / (Stats.m_NumSnapshots + Stats.m_NumLost) : 0.0f;
+		if(Stats.m_GotServerStats)
+		{
+			dbg_msg("bot_load", "%3d players: tick p50=%.2fms p99=%.2fms max=%.2fms, snapshot delay p50=%.2fms p99=%.2fms, loss=%.2f%%",
+				Ingame, Stats.m_ServerP50 / 1000.0f, Stats.m_ServerP99 / 1000.0f, Stats.m_ServerMax / 1000.0f,
+				Lateness50 / 1000.0f, Lateness99 / 1000.0f, Loss);
+			if(Stats.m_ServerP99 > BudgetMs * 1000)
+			{
+				Exceeded = true;
+				break;
+			}
+			Capacity = Ingame;
+		}
+		else
+			dbg_msg("bot_load", "%3d players: snapshot delay p50=%.2fms p99=%.2fms, loss=%.2f%%",
+				Ingame, Lateness50 / 1000.0f, Lateness99 / 1000.0f, Loss);
+
+		if(Ingame < s_NumBots)
+			break;
+	}
+
+	if(Capacity >= 0)
+		dbg_msg("bot_load", "%s%d players within a p99 tick time of %.2fms", Exceeded ? "" : "at least ", Capacity, BudgetMs);
+	else if(Exceeded)
+		dbg_msg("bot_load", "already over a p99 tick time of %.2fms at the first step", BudgetMs);
+
+	for(int i = 0; i < s_NumBots; i++)
+		if(s_aBots[i].m_State != CBot::STATE_GONE)
+			s_aBots[i].m_Net.Disconnect("done");
+	return 0;
+}
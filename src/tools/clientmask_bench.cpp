@@ -0,0 +1,105 @@
+#include <base/system.h>
+#include <engine/shared/bitset.h>
+
+// measures the per tick cost of the client mask work the game server does
+// as the number of clients grows: building a team mask for every event,
+// every client checking every event while snapping and every client
+// checking the owner mask of every projectile. up to 64 clients it is
+// also measured with plain 64 bit masks like before
+
+enum
+{
+	MAX_BENCH_CLIENTS=256,
+	TEAM_SIZE=4,
+};
+
+struct CInt64Mask
+{
+	int64 m_Mask;
+
+	CInt64Mask() : m_Mask(0) {}
+	void Set(int Index) { m_Mask |= 1LL<<Index; }
+	bool Test(int Index) const { return (m_Mask>>Index)&1; }
+};
+
+static int s_aTeams[MAX_BENCH_CLIENTS];
+
+template<class T>
+static T TeamMask(int Team, int NumClients)
+{
+	T Mask;
+	for(int i = 0; i < NumClients; i++)
+		if(s_aTeams[i] == Team || s_aTeams[i] < 0)
+			Mask.Set(i);
+	return Mask;
+}
+
+template<class T>
+static int SimulateTick(int NumClients)
+{
+	static T s_aEventMasks[2*MAX_BENCH_CLIENTS];
+	static T s_aProjectileMasks[MAX_BENCH_CLIENTS];
+
+	// a sound or two per client and a projectile for every other one
+	int NumEvents = 2*NumClients;
+	for(int i = 0; i < NumEvents; i++)
+		s_aEventMasks[i] = TeamMask<T>(s_aTeams[i/2], NumClients);
+	int NumProjectiles = NumClients/2;
+	for(int i = 0; i < NumProjectiles; i++)
+		s_aProjectileMasks[i] = TeamMask<T>(s_aTeams[i*2], NumClients);
+
+	int Snapped = 0;
+	for(int c = 0; c < NumClients; c++)
+	{
+		for(int i = 0; i < NumEvents; i++)
+			Snapped += s_aEventMasks[i].Test(c);
+		for(int i = 0; i < NumProjectiles; i++)
+			Snapped += s_aProjectileMasks[i].Test(c);
+	}
+	return Snapped;
+}
+
+template<class T>
+static double Measure(int NumClients, int *pSnapped)
+{
+	const int Ticks = 2000;
+	*pSnapped = 0;
+	int64 Start = time_get();
+	for(int i = 0; i < Ticks; i++)
+		*pSnapped += SimulateTick<T>(NumClients);
+	return (time_get() - Start) * 1e9 / time_freq() / Ticks;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	// teams of four, every eighth client spectates and sees everyone
+	for(int i = 0; i < MAX_BENCH_CLIENTS; i++)
+		s_aTeams[i] = i%8 == 7 ? -1 : i/TEAM_SIZE;
+
+	const int aNumClients[] = {16, 32, 64, 128, 256};
+	for(unsigned i = 0; i < sizeof(aNumClients)/sizeof(aNumClients[0]); i++)
+	{
+		int NumClients = aNumClients[i];
+		int Snapped;
+		double Time = Measure<CBitset<MAX_BENCH_CLIENTS> >(NumClients, &Snapped);
+		if(NumClients <= 64)
+		{
+			int Snapped64;
+			double Time64 = Measure<CInt64Mask>(NumClients, &Snapped64);
+			double TimeBitset64 = Measure<CBitset<64> >(NumClients, &Snapped);
+			dbg_msg("clientmask_bench", "%3d clients: %9.0f ns per tick (64 bit set %9.0f ns, int64 %9.0f ns)%s",
+				NumClients, Time, TimeBitset64, Time64, Snapped == Snapped64 ? "" : " MISMATCH");
+		}
+		else
+			dbg_msg("clientmask_bench", "%3d clients: %9.0f ns per tick", NumClients, Time);
+	}
+
+	CBitset<MAX_BENCH_CLIENTS> Mask = TeamMask<CBitset<MAX_BENCH_CLIENTS> >(3, MAX_BENCH_CLIENTS);
+	int Visited = 0;
+	for(int i = Mask.FindNext(0); i < Mask.SIZE; i = Mask.FindNext(i+1))
+		Visited++;
+	dbg_msg("clientmask_bench", "team mask has %d members, iterated %d", Mask.Count(), Visited);
+	return 0;
+}
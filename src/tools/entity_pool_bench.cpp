@@ -0,0 +1,133 @@
+#include <base/system.h>
+#include <engine/shared/pool.h>
+#include <game/server/entity.h>
+#include <game/server/entities/laser.h>
+#include <game/server/entities/plasma.h>
+#include <game/server/entities/projectile.h>
+
+#include <stdlib.h>
+#include <vector>
+
+// measures what creating and destroying the entities of shots costs the
+// tick, with malloc like before and with the pools. every tick a number of
+// projectiles, lasers and plasma balls are created, each lives for a few
+// ticks like on a server with shotgun spam and plasma turrets. the blocks
+// are zeroed like the allocators of the entities do
+
+enum
+{
+	NUM_TYPES=3,
+	MAX_LIFETIME=64,
+};
+
+static const int s_aSizes[NUM_TYPES] = {(int)sizeof(CProjectile), (int)sizeof(CLaser), (int)sizeof(CPlasma)};
+
+struct CLive
+{
+	void *m_pBlock;
+	int m_Type;
+};
+
+class CHeapAllocator
+{
+public:
+	void *Allocate(int Type)
+	{
+		void *pBlock = malloc(s_aSizes[Type]);
+		mem_zero(pBlock, s_aSizes[Type]);
+		return pBlock;
+	}
+	void Free(void *pBlock, int Type) { free(pBlock); }
+};
+
+class CPoolAllocator
+{
+	CPool *m_apPools[NUM_TYPES];
+
+public:
+	CPoolAllocator()
+	{
+		for(int i = 0; i < NUM_TYPES; i++)
+			m_apPools[i] = new CPool(s_aSizes[i]);
+	}
+	~CPoolAllocator()
+	{
+		for(int i = 0; i < NUM_TYPES; i++)
+			delete m_apPools[i];
+	}
+	void *Allocate(int Type)
+	{
+		void *pBlock = m_apPools[Type]->Allocate();
+		mem_zero(pBlock, s_aSizes[Type]);
+		return pBlock;
+	}
+	void Free(void *pBlock, int Type) { m_apPools[Type]->Free(pBlock); }
+	int Capacity() const
+	{
+		int Capacity = 0;
+		for(int i = 0; i < NUM_TYPES; i++)
+			Capacity += m_apPools[i]->Capacity();
+		return Capacity;
+	}
+};
+
+template<class T>
+static double Measure(T *pAllocator, int PerTick, int Lifetime, int Ticks)
+{
+	// the entities die at the start of the tick they expire in
+	std::vector<CLive> aaExpiring[MAX_LIFETIME+1];
+	unsigned Seed = 1;
+	int64 Total = 0;
+	for(int Tick = 0; Tick < Ticks; Tick++)
+	{
+		int64 Start = time_get_impl();
+		std::vector<CLive> &Expiring = aaExpiring[Tick % (Lifetime+1)];
+		for(unsigned i = 0; i < Expiring.size(); i++)
+			pAllocator->Free(Expiring[i].m_pBlock, Expiring[i].m_Type);
+		Expiring.clear();
+
+		for(int i = 0; i < PerTick; i++)
+		{
+			Seed ^= Seed << 13;
+			Seed ^= Seed >> 17;
+			Seed ^= Seed << 5;
+			CLive Live;
+			Live.m_Type = Seed % NUM_TYPES;
+			Live.m_pBlock = pAllocator->Allocate(Live.m_Type);
+			int Life = 1 + (Seed >> 8) % Lifetime;
+			aaExpiring[(Tick + Life) % (Lifetime+1)].push_back(Live);
+		}
+		Total += time_get_impl() - Start;
+	}
+
+	for(int i = 0; i <= Lifetime; i++)
+		for(unsigned j = 0; j < aaExpiring[i].size(); j++)
+			pAllocator->Free(aaExpiring[i][j].m_pBlock, aaExpiring[i][j].m_Type);
+	return Total * 1e6 / time_freq() / Ticks;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int Ticks = 20000;
+	if(argc > 1)
+		Ticks = maximum(str_toint(argv[1]), 1);
+
+	dbg_msg("entity_pool_bench", "sizes: projectile=%d laser=%d plasma=%d", s_aSizes[0], s_aSizes[1], s_aSizes[2]);
+	const int aPerTick[] = {16, 64, 256, 1024};
+	const int aLifetimes[] = {2, 10, 50};
+	for(unsigned l = 0; l < sizeof(aLifetimes)/sizeof(aLifetimes[0]); l++)
+	{
+		for(unsigned p = 0; p < sizeof(aPerTick)/sizeof(aPerTick[0]); p++)
+		{
+			CHeapAllocator Heap;
+			CPoolAllocator Pool;
+			double HeapTime = Measure(&Heap, aPerTick[p], aLifetimes[l], Ticks);
+			double PoolTime = Measure(&Pool, aPerTick[p], aLifetimes[l], Ticks);
+			dbg_msg("entity_pool_bench", "%4d per tick, living %2d ticks: malloc %7.2f us per tick, pool %7.2f us per tick (%d blocks)",
+				aPerTick[p], aLifetimes[l], HeapTime, PoolTime, Pool.Capacity());
+		}
+	}
+	return 0;
+}
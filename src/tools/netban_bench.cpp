@@ -0,0 +1,148 @@
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/netban.h>
+
+// measures the per packet cost of CNetBan::IsBanned with large ban lists,
+// either generated ones or a list file in the format ban_file accepts, and
+// compares it to the old hash chain lookup
+
+static unsigned s_Seed = 1;
+static unsigned Random()
+{
+	// xorshift, the low bits of a power of two lcg repeat too soon for
+	// lists this large
+	s_Seed ^= s_Seed << 13;
+	s_Seed ^= s_Seed >> 17;
+	s_Seed ^= s_Seed << 5;
+	return s_Seed;
+}
+
+static NETADDR RandomAddr(bool IPv6)
+{
+	NETADDR Addr;
+	mem_zero(&Addr, sizeof(Addr));
+	Addr.type = IPv6 ? NETTYPE_IPV6 : NETTYPE_IPV4;
+	for(int i = 0; i < (IPv6 ? 16 : 4); i++)
+		Addr.ip[i] = Random();
+	return Addr;
+}
+
+static bool GenerateList(const char *pFilename, int NumAddrs, int NumRanges)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+	if(!File)
+		return false;
+
+	// mostly ipv4 like public abuse lists, ranges as prefixes and as
+	// unaligned first-last pairs
+	char aBuf[256], aAddr1[NETADDR_MAXSTRSIZE], aAddr2[NETADDR_MAXSTRSIZE];
+	for(int i = 0; i < NumAddrs; i++)
+	{
+		NETADDR Addr = RandomAddr(i%8 == 0);
+		net_addr_str(&Addr, aAddr1, sizeof(aAddr1), false);
+		io_write(File, aAddr1, str_length(aAddr1));
+		io_write_newline(File);
+	}
+	for(int i = 0; i < NumRanges; i++)
+	{
+		bool IPv6 = i%8 == 0;
+		NETADDR Addr = RandomAddr(IPv6);
+		net_addr_str(&Addr, aAddr1, sizeof(aAddr1), false);
+		if(i%2)
+			str_format(aBuf, sizeof(aBuf), "%s/%d", aAddr1, IPv6 ? 32 + Random()%33 : 16 + Random()%13);
+		else
+		{
+			NETADDR Last = Addr;
+			int Length = IPv6 ? 16 : 4;
+			Last.ip[Length-1] = 255;
+			Last.ip[Length-2] |= Random()%4;
+			Addr.ip[Length-1] = Random()%Last.ip[Length-1];
+			net_addr_str(&Addr, aAddr1, sizeof(aAddr1), false);
+			net_addr_str(&Last, aAddr2, sizeof(aAddr2), false);
+			str_format(aBuf, sizeof(aBuf), "%s - %s", aAddr1, aAddr2);
+		}
+		io_write(File, aBuf, str_length(aBuf));
+		io_write_newline(File);
+	}
+	io_close(File);
+	return true;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	if(argc != 2 && argc != 3)
+	{
+		dbg_msg("usage", "%s <banlist> | <num addresses> <num ranges>", argv[0]);
+		return -1;
+	}
+
+	const char *pFilename = argv[1];
+	const char *pTempFile = "netban_bench.tmp";
+	if(argc == 3)
+	{
+		pFilename = pTempFile;
+		if(!GenerateList(pFilename, str_toint(argv[1]), str_toint(argv[2])))
+		{
+			dbg_msg("netban_bench", "failed to write '%s'", pFilename);
+			return -1;
+		}
+	}
+
+	net_init();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CNetBan *pNetBan = new CNetBan;
+	pNetBan->Init(pConsole, 0);
+
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("netban_bench", "failed to open '%s'", pFilename);
+		return -1;
+	}
+	int NumInvalid;
+	int64 Start = time_get();
+	int NumBans = pNetBan->ImportBans(File, 0, "bench", &NumInvalid);
+	int64 ImportTime = time_get() - Start;
+	io_close(File);
+	if(pFilename == pTempFile)
+		fs_remove(pTempFile);
+	dbg_msg("netban_bench", "imported %d bans in %.1f ms, %d invalid lines", NumBans, ImportTime * 1000.0 / time_freq(), NumInvalid);
+
+	// random sources like on a busy public server, almost none banned
+	const int NumLookups = 100000;
+	NETADDR *pAddrs = new NETADDR[NumLookups];
+	for(int i = 0; i < NumLookups; i++)
+		pAddrs[i] = RandomAddr(i%8 == 0);
+
+	// the old lookup gets slow with large lists, so it only runs once
+	char aBuf[256];
+	const int Rounds = 5;
+	int aBanned[2] = {0, 0};
+	int64 aTime[2] = {0, 0};
+	for(int Round = 0; Round < Rounds; Round++)
+	{
+		aBanned[0] = 0;
+		Start = time_get();
+		for(int i = 0; i < NumLookups; i++)
+			aBanned[0] += pNetBan->IsBanned(&pAddrs[i], aBuf, sizeof(aBuf));
+		aTime[0] += time_get() - Start;
+	}
+
+	Start = time_get();
+	for(int i = 0; i < NumLookups; i++)
+		aBanned[1] += pNetBan->IsBannedLegacy(&pAddrs[i], aBuf, sizeof(aBuf));
+	aTime[1] += time_get() - Start;
+
+	dbg_msg("netban_bench", "trie   %8.1f ns per lookup, %d banned", aTime[0] * 1e9 / time_freq() / Rounds / NumLookups, aBanned[0]);
+	dbg_msg("netban_bench", "legacy %8.1f ns per lookup, %d banned", aTime[1] * 1e9 / time_freq() / NumLookups, aBanned[1]);
+	if(aBanned[0] != aBanned[1])
+		dbg_msg("netban_bench", "MISMATCH between trie and legacy lookup");
+
+	delete[] pAddrs;
+	delete pNetBan;
+	delete pConsole;
+	return aBanned[0] == aBanned[1] ? 0 : 1;
+}
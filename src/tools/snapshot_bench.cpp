@@ -0,0 +1,337 @@
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/huffman.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+#include <game/generated/protocol.h>
+
+#include <vector>
+
+// measures CreateDelta and UnpackDelta on consecutive snapshots of a demo
+// (or of a generated game if none is given) with every diff kernel the cpu
+// supports, and checks that they all produce the same bytes. the resulting
+// deltas are then used to measure the variable int compression and the
+// packed deltas to compare the huffman coders
+
+static std::vector<std::vector<char> > s_aSnapshots;
+
+class CCollector : public CDemoPlayer::IListener
+{
+public:
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		s_aSnapshots.push_back(std::vector<char>((char *)pData, (char *)pData + Size));
+	}
+	virtual void OnDemoPlayerMessage(void *pData, int Size) {}
+};
+
+static void SetStaticsizes(CSnapshotDelta *pDelta)
+{
+	CNetObjHandler NetObjHandler;
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+		pDelta->SetStaticsize(i, NetObjHandler.GetObjSize(i));
+}
+
+static bool LoadDemo(const char *pFilename)
+{
+	static CSnapshotDelta s_Delta;
+	SetStaticsizes(&s_Delta);
+	IStorage *pStorage = CreateLocalStorage();
+	CDemoPlayer Player(&s_Delta);
+	CCollector Collector;
+	Player.SetListener(&Collector);
+	if(Player.Load(pStorage, 0, pFilename, IStorage::TYPE_ABSOLUTE) == -1)
+		return false;
+	Player.Play();
+	while(Player.IsPlaying() && !Player.Info()->m_Info.m_Paused)
+		Player.Update(false);
+	Player.Stop();
+	return true;
+}
+
+static void GenerateGame(int NumTicks, int NumPlayers)
+{
+	static CSnapshotBuilder s_Builder;
+	static char s_aData[CSnapshot::MAX_SIZE];
+	unsigned Seed = 1;
+
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		s_Builder.Init();
+		for(int i = 0; i < NumPlayers; i++)
+		{
+			CNetObj_PlayerInfo *pInfo = (CNetObj_PlayerInfo *)s_Builder.NewItem(NETOBJTYPE_PLAYERINFO, i, sizeof(CNetObj_PlayerInfo));
+			pInfo->m_Local = 0;
+			pInfo->m_ClientID = i;
+			pInfo->m_Team = 0;
+			pInfo->m_Score = Tick/500;
+			pInfo->m_Latency = 20 + i;
+
+			CNetObj_Character *pChar = (CNetObj_Character *)s_Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+			mem_zero(pChar, sizeof(*pChar));
+			pChar->m_Tick = Tick;
+			pChar->m_X = 500 + i*64 + (Tick*(i%7+1))%800;
+			pChar->m_Y = 1000 + ((Tick/3+i)%40)*8;
+			pChar->m_VelX = (i%7+1)*256;
+			pChar->m_Angle = (Tick*i)%628;
+			pChar->m_Direction = (Tick/20+i)%3-1;
+			pChar->m_Jumped = (Tick/10+i)%2;
+			pChar->m_HookState = (Tick/25+i)%5 == 0 ? 3 : 0;
+			pChar->m_Health = 10;
+			pChar->m_Armor = i%10;
+			pChar->m_Weapon = (Tick/100+i)%5;
+		}
+		for(int i = 0; i < NumPlayers/2; i++)
+		{
+			Seed = Seed * 1103515245 + 12345;
+			if((Seed>>16)%3 == 0)
+				continue;
+			CNetObj_Projectile *pProj = (CNetObj_Projectile *)s_Builder.NewItem(NETOBJTYPE_PROJECTILE, i, sizeof(CNetObj_Projectile));
+			pProj->m_X = i*100;
+			pProj->m_Y = 200;
+			pProj->m_VelX = 1000;
+			pProj->m_VelY = -200;
+			pProj->m_Type = 1;
+			pProj->m_StartTick = Tick - Tick%20;
+		}
+		int Size = s_Builder.Finish(s_aData);
+		s_aSnapshots.push_back(std::vector<char>(s_aData, s_aData + Size));
+	}
+}
+
+static bool BenchVariableInt(const std::vector<std::vector<char> > &aDeltas, std::vector<std::vector<char> > *paPacked)
+{
+	static unsigned char s_aPacked[CSnapshot::MAX_SIZE*2];
+	static unsigned char s_aExpected[CSnapshot::MAX_SIZE*2];
+	static int s_aUnpacked[CSnapshot::MAX_SIZE*2/4];
+	const int Rounds = 20;
+	int64 IntBytes = 0;
+	int64 PackedBytes = 0;
+	int64 aTime[4] = {0}; // pack, unpack, compress, decompress
+
+	for(unsigned i = 0; i < aDeltas.size(); i++)
+	{
+		int Size = aDeltas[i].size();
+		if(!Size)
+			continue;
+		const int *pInts = (const int *)&aDeltas[i][0];
+
+		// the variable int functions one by one, like it used to be done
+		int64 Start = time_get();
+		unsigned char *pCur = s_aExpected;
+		for(int Round = 0; Round < Rounds; Round++)
+		{
+			pCur = s_aExpected;
+			for(int n = 0; n < Size/4; n++)
+				pCur = CVariableInt::Pack(pCur, pInts[n]);
+		}
+		aTime[0] += time_get() - Start;
+		int ExpectedSize = pCur - s_aExpected;
+
+		Start = time_get();
+		for(int Round = 0; Round < Rounds; Round++)
+		{
+			const unsigned char *pSrc = s_aExpected;
+			int *pOut = s_aUnpacked;
+			while(pSrc < s_aExpected + ExpectedSize)
+				pSrc = CVariableInt::Unpack(pSrc, pOut++);
+		}
+		aTime[1] += time_get() - Start;
+
+		int PackedSize = 0;
+		Start = time_get();
+		for(int Round = 0; Round < Rounds; Round++)
+			PackedSize = CVariableInt::Compress(pInts, Size, s_aPacked, sizeof(s_aPacked));
+		aTime[2] += time_get() - Start;
+
+		int UnpackedSize = 0;
+		Start = time_get();
+		for(int Round = 0; Round < Rounds; Round++)
+			UnpackedSize = CVariableInt::Decompress(s_aPacked, PackedSize, s_aUnpacked, sizeof(s_aUnpacked));
+		aTime[3] += time_get() - Start;
+
+		if(PackedSize != ExpectedSize || mem_comp(s_aPacked, s_aExpected, PackedSize) != 0 ||
+			UnpackedSize != Size || mem_comp(s_aUnpacked, pInts, Size) != 0)
+		{
+			dbg_msg("snapshot_bench", "variable int MISMATCH in delta %d", i);
+			return false;
+		}
+		IntBytes += Size;
+		PackedBytes += PackedSize;
+		paPacked->push_back(std::vector<char>(s_aPacked, s_aPacked + PackedSize));
+	}
+
+	double Freq = time_freq();
+	dbg_msg("snapshot_bench", "varint %.1f KiB -> %.1f KiB per round", IntBytes / 1024.0, PackedBytes / 1024.0);
+	dbg_msg("snapshot_bench", "varint pack      %8.1f MB/s  unpack     %8.1f MB/s",
+		IntBytes * Rounds / (aTime[0] / Freq) / 1e6, IntBytes * Rounds / (aTime[1] / Freq) / 1e6);
+	dbg_msg("snapshot_bench", "varint compress  %8.1f MB/s  decompress %8.1f MB/s  identical",
+		IntBytes * Rounds / (aTime[2] / Freq) / 1e6, IntBytes * Rounds / (aTime[3] / Freq) / 1e6);
+	return true;
+}
+
+static bool BenchHuffman(const std::vector<std::vector<char> > &aPacked)
+{
+	// a table trained on the data itself, like the one the network uses
+	unsigned aFrequencies[256] = {0};
+	for(unsigned i = 0; i < aPacked.size(); i++)
+		for(unsigned n = 0; n < aPacked[i].size(); n++)
+			aFrequencies[(unsigned char)aPacked[i][n]]++;
+	for(int i = 0; i < 256; i++)
+		aFrequencies[i]++;
+	static CHuffman s_Huffman;
+	s_Huffman.Init(aFrequencies);
+
+	static unsigned char s_aCompressed[CSnapshot::MAX_SIZE*4];
+	static unsigned char s_aExpected[CSnapshot::MAX_SIZE*4];
+	static unsigned char s_aDecompressed[CSnapshot::MAX_SIZE*2];
+	const int Rounds = 20;
+	int64 Bytes = 0;
+	int64 CompressedBytes = 0;
+	int64 aTime[4] = {0}; // legacy compress, decompress, compress, decompress
+
+	for(unsigned i = 0; i < aPacked.size(); i++)
+	{
+		int Size = aPacked[i].size();
+		if(!Size)
+			continue;
+		const unsigned char *pData = (const unsigned char *)&aPacked[i][0];
+
+		int ExpectedSize = 0;
+		int64 Start = time_get();
+		for(int Round = 0; Round < Rounds; Round++)
+			ExpectedSize = s_Huffman.CompressLegacy(pData, Size, s_aExpected, sizeof(s_aExpected));
+		aTime[0] += time_get() - Start;
+
+		Start = time_get();
+		for(int Round = 0; Round < Rounds; Round++)
+			s_Huffman.DecompressLegacy(s_aExpected, ExpectedSize, s_aDecompressed, sizeof(s_aDecompressed));
+		aTime[1] += time_get() - Start;
+
+		int CompressedSize = 0;
+		Start = time_get();
+		for(int Round = 0; Round < Rounds; Round++)
+			CompressedSize = s_Huffman.Compress(pData, Size, s_aCompressed, sizeof(s_aCompressed));
+		aTime[2] += time_get() - Start;
+
+		int DecompressedSize = 0;
+		Start = time_get();
+		for(int Round = 0; Round < Rounds; Round++)
+			DecompressedSize = s_Huffman.Decompress(s_aCompressed, CompressedSize, s_aDecompressed, sizeof(s_aDecompressed));
+		aTime[3] += time_get() - Start;
+
+		if(ExpectedSize < 0 || CompressedSize != ExpectedSize || mem_comp(s_aCompressed, s_aExpected, CompressedSize) != 0 ||
+			DecompressedSize != Size || mem_comp(s_aDecompressed, pData, Size) != 0)
+		{
+			dbg_msg("snapshot_bench", "huffman MISMATCH in delta %d", i);
+			return false;
+		}
+		Bytes += Size;
+		CompressedBytes += CompressedSize;
+	}
+
+	double Freq = time_freq();
+	dbg_msg("snapshot_bench", "huffman %.1f KiB -> %.1f KiB per round", Bytes / 1024.0, CompressedBytes / 1024.0);
+	dbg_msg("snapshot_bench", "huffman legacy   %8.1f MB/s  decompress %8.1f MB/s",
+		Bytes * Rounds / (aTime[0] / Freq) / 1e6, Bytes * Rounds / (aTime[1] / Freq) / 1e6);
+	dbg_msg("snapshot_bench", "huffman compress %8.1f MB/s  decompress %8.1f MB/s  identical",
+		Bytes * Rounds / (aTime[2] / Freq) / 1e6, Bytes * Rounds / (aTime[3] / Freq) / 1e6);
+	return true;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	if(argc > 2)
+	{
+		dbg_msg("usage", "%s [demo]", argv[0]);
+		return -1;
+	}
+	if(argc == 2)
+	{
+		if(!LoadDemo(argv[1]))
+		{
+			dbg_msg("snapshot_bench", "failed to load demo '%s'", argv[1]);
+			return -1;
+		}
+	}
+	else
+		GenerateGame(3000, 64);
+
+	int NumSnapshots = s_aSnapshots.size();
+	if(NumSnapshots < 2)
+	{
+		dbg_msg("snapshot_bench", "not enough snapshots");
+		return -1;
+	}
+	int64 TotalBytes = 0;
+	for(int i = 0; i < NumSnapshots; i++)
+		TotalBytes += s_aSnapshots[i].size();
+	dbg_msg("snapshot_bench", "%d snapshots, %.1f KiB average", NumSnapshots, TotalBytes / 1024.0 / NumSnapshots);
+
+	static CSnapshotDelta s_Delta;
+	SetStaticsizes(&s_Delta);
+	static char s_aDelta[CSnapshot::MAX_SIZE*2];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	std::vector<std::vector<char> > aReference;
+	int Default = CSnapshotDelta::GetDiffImpl();
+	const int Rounds = 5;
+
+	for(int Impl = 0; Impl < CSnapshotDelta::NUM_DIFFIMPLS; Impl++)
+	{
+		if(!CSnapshotDelta::SetDiffImpl(Impl))
+			continue;
+
+		bool Identical = true;
+		int64 CreateTime = 0;
+		int64 UnpackTime = 0;
+		for(int Round = 0; Round < Rounds; Round++)
+		{
+			for(int i = 1; i < NumSnapshots; i++)
+			{
+				CSnapshot *pFrom = (CSnapshot *)&s_aSnapshots[i-1][0];
+				CSnapshot *pTo = (CSnapshot *)&s_aSnapshots[i][0];
+
+				int64 Start = time_get();
+				int DeltaSize = s_Delta.CreateDelta(pFrom, pTo, s_aDelta);
+				CreateTime += time_get() - Start;
+
+				if(Round == 0)
+				{
+					if(Impl == CSnapshotDelta::DIFFIMPL_SCALAR)
+						aReference.push_back(std::vector<char>(s_aDelta, s_aDelta + DeltaSize));
+					else if((int)aReference[i-1].size() != DeltaSize || (DeltaSize && mem_comp(&aReference[i-1][0], s_aDelta, DeltaSize) != 0))
+						Identical = false;
+				}
+
+				if(!DeltaSize)
+					continue;
+				Start = time_get();
+				int Size = s_Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, s_aDelta, DeltaSize);
+				UnpackTime += time_get() - Start;
+				// items may come out in a different order, compare like the client does
+				if(Round == 0 && (Size != (int)s_aSnapshots[i].size() || ((CSnapshot *)s_aUnpacked)->Crc() != pTo->Crc()))
+					Identical = false;
+			}
+		}
+
+		int NumDeltas = (NumSnapshots-1) * Rounds;
+		double Freq = time_freq();
+		dbg_msg("snapshot_bench", "%-6s create %7.2f us/delta %8.1f MB/s  unpack %7.2f us/delta  %s%s",
+			CSnapshotDelta::DiffImplName(Impl),
+			CreateTime / Freq * 1e6 / NumDeltas, TotalBytes * Rounds / (CreateTime / Freq) / 1e6,
+			UnpackTime / Freq * 1e6 / NumDeltas,
+			Identical ? "identical" : "MISMATCH",
+			Impl == Default ? " (default)" : "");
+		if(!Identical)
+			return 1;
+	}
+	CSnapshotDelta::SetDiffImpl(Default);
+
+	std::vector<std::vector<char> > aPacked;
+	if(!BenchVariableInt(aReference, &aPacked))
+		return 1;
+	return BenchHuffman(aPacked) ? 0 : 1;
+}